@@ -18,13 +18,7 @@
 
 #include <hilog/log.h>
 #include <napi/native_api.h>
-
-#define APP_LOG_DOMAIN 0x0001
-#define APP_LOG_TAG "XEngine Vulkan Demo"
-#define LOGI(...) ((void)OH_LOG_Print(LOG_APP, LOG_INFO, LOG_DOMAIN, APP_LOG_TAG, __VA_ARGS__))
-#define LOGD(...) ((void)OH_LOG_Print(LOG_APP, LOG_DEBUG, LOG_DOMAIN, APP_LOG_TAG, __VA_ARGS__))
-#define LOGW(...) ((void)OH_LOG_Print(LOG_APP, LOG_WARN, LOG_DOMAIN, APP_LOG_TAG, __VA_ARGS__))
-#define LOGE(...) ((void)OH_LOG_Print(LOG_APP, LOG_ERROR, LOG_DOMAIN, APP_LOG_TAG, __VA_ARGS__))
+#include "common/logger.h"
 
 /**
  * Log print domain.
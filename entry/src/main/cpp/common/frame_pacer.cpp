@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "frame_pacer.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include "common/common.h"
+
+void FramePacer::SetTargetFps(uint32_t targetFps, float displayRefreshRate)
+{
+    m_targetFps = targetFps;
+    if (targetFps == 0) {
+        m_interval = Clock::duration(0);
+    } else if (displayRefreshRate > 0.0f) {
+        // Small tolerance, a 60 fps target on a 59.94 Hz panel stays at one period
+        float periods = std::max(1.0f, std::ceil(displayRefreshRate / static_cast<float>(targetFps) - 0.01f));
+        m_interval = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(static_cast<double>(periods) / displayRefreshRate));
+    } else {
+        m_interval = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(1.0 / static_cast<double>(targetFps)));
+    }
+    LOGI("FramePacer target %{public}u fps, display %{public}.2f Hz, interval %{public}lld us", targetFps,
+        displayRefreshRate,
+        static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(m_interval).count()));
+    Reset();
+}
+
+void FramePacer::Reset()
+{
+    m_started = false;
+    m_smoothedDelta = m_interval.count() > 0 ? std::chrono::duration<float>(m_interval).count() :
+        FRAME_PACER_DEFAULT_DELTA;
+}
+
+float FramePacer::BeginFrame()
+{
+    Clock::time_point now = Clock::now();
+    if (m_interval.count() > 0) {
+        if (!m_started || now > m_deadline + m_interval) {
+            // First frame, or more than a frame late: restart the schedule instead of catching up with a burst
+            m_deadline = now;
+        } else {
+            WaitUntil(m_deadline);
+            now = Clock::now();
+        }
+        m_deadline += m_interval;
+    }
+    if (m_started) {
+        float delta = std::min(std::chrono::duration<float>(now - m_lastFrame).count(), FRAME_PACER_MAX_DELTA);
+        m_smoothedDelta += (delta - m_smoothedDelta) * FRAME_PACER_SMOOTHING;
+    }
+    m_started = true;
+    m_lastFrame = now;
+    return m_smoothedDelta;
+}
+
+void FramePacer::WaitUntil(Clock::time_point deadline)
+{
+    Clock::time_point spinStart = deadline - std::chrono::microseconds(FRAME_PACER_SPIN_US);
+    if (Clock::now() < spinStart) {
+        std::this_thread::sleep_until(spinStart);
+    }
+    while (Clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMMON_FRAME_PACER_H
+#define COMMON_FRAME_PACER_H
+
+#include <chrono>
+#include <cstdint>
+
+#define FRAME_PACER_SPIN_US 1500      // end of the wait that is spun, sleeps overshoot by up to a scheduler tick
+#define FRAME_PACER_SMOOTHING 0.1f    // weight of the newest frame in the smoothed frame time
+#define FRAME_PACER_MAX_DELTA 0.1f    // seconds, a stall does not move the camera across the scene
+#define FRAME_PACER_DEFAULT_DELTA (1.0f / 60.0f)
+
+// Starts frames at a fixed interval and measures the time between them. Waiting sleeps until shortly before the
+// frame is due and spins the rest, so frames start within microseconds of their schedule.
+class FramePacer {
+public:
+    // 0 lets the present mode decide. With a known refresh rate the interval is rounded up to whole display
+    // periods: 50 fps on a 60 Hz panel would alternate between one and two periods and judder, it runs at 30.
+    void SetTargetFps(uint32_t targetFps, float displayRefreshRate);
+    void Reset();
+    // Waits until the next frame is due, returns the smoothed time between frames in seconds
+    float BeginFrame();
+    float GetFrameTime() const { return m_smoothedDelta; }
+    uint32_t GetTargetFps() const { return m_targetFps; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static void WaitUntil(Clock::time_point deadline);
+
+    uint32_t m_targetFps = 0;
+    Clock::duration m_interval{0};
+    Clock::time_point m_deadline;
+    Clock::time_point m_lastFrame;
+    bool m_started = false;
+    float m_smoothedDelta = FRAME_PACER_DEFAULT_DELTA;
+};
+#endif // COMMON_FRAME_PACER_H
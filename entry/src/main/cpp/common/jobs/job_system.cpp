@@ -0,0 +1,322 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "job_system.h"
+#include <sched.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include "common/common.h"
+#include "common/trace.h"
+
+struct JobSystem::Job {
+    JobFunc func;
+    Priority priority = PRIORITY_NORMAL;
+    // Unfinished dependencies, the job is queued when it drops to 0
+    std::atomic<uint32_t> pendingDependencies{0};
+    std::mutex mutex;
+    bool finished = false;
+    std::vector<JobHandle> continuations;
+};
+
+JobSystem JobSystem::m_jobSystem;
+
+namespace {
+// Index of the worker running on this thread, -1 on other threads
+thread_local int32_t g_workerIndex = -1;
+}
+
+JobSystem::~JobSystem() { Shutdown(); }
+
+bool JobSystem::Init(uint32_t threadCount)
+{
+    if (!m_workers.empty()) {
+        return true;
+    }
+    if (threadCount == 0) {
+        threadCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    }
+    for (uint32_t i = 0; i < threadCount; i++) {
+        m_workers.push_back(std::unique_ptr<Worker>(new Worker()));
+    }
+    AssignCores();
+    for (uint32_t i = 0; i < threadCount; i++) {
+        m_workers[i]->thread = std::thread(&JobSystem::WorkerLoop, this, i);
+    }
+    LOGI("JobSystem Init: %{public}u workers", threadCount);
+    return true;
+}
+
+void JobSystem::Shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_stop = true;
+    }
+    m_workCondition.notify_all();
+    for (auto &worker : m_workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+    m_workers.clear();
+    m_stop = false;
+}
+
+void JobSystem::AssignCores()
+{
+    // cpufreq exposes the cluster layout: cores with the lowest max frequency are the little ones
+    uint32_t cpuCount = std::thread::hardware_concurrency();
+    std::vector<uint64_t> maxFrequencies(cpuCount, 0);
+    uint64_t lowest = UINT64_MAX;
+    uint64_t highest = 0;
+    for (uint32_t cpu = 0; cpu < cpuCount; cpu++) {
+        std::ifstream file("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cpufreq/cpuinfo_max_freq");
+        if (!(file >> maxFrequencies[cpu]) || maxFrequencies[cpu] == 0) {
+            LOGW("JobSystem cpu %{public}u max frequency unknown, workers are not pinned", cpu);
+            return;
+        }
+        lowest = std::min(lowest, maxFrequencies[cpu]);
+        highest = std::max(highest, maxFrequencies[cpu]);
+    }
+    if (cpuCount == 0 || lowest == highest) {
+        return;
+    }
+    std::vector<uint32_t> bigCpus;
+    std::vector<uint32_t> littleCpus;
+    for (uint32_t cpu = 0; cpu < cpuCount; cpu++) {
+        (maxFrequencies[cpu] > lowest ? bigCpus : littleCpus).push_back(cpu);
+    }
+    // The first workers go to the big cluster, the rest share the little one
+    for (size_t i = 0; i < m_workers.size(); i++) {
+        Worker &worker = *m_workers[i];
+        worker.bigCore = i < bigCpus.size();
+        worker.cpus = worker.bigCore ? bigCpus : littleCpus;
+    }
+    LOGI("JobSystem %{public}zu big cores, %{public}zu little cores", bigCpus.size(), littleCpus.size());
+}
+
+JobSystem::JobHandle JobSystem::Submit(JobFunc func, const std::vector<JobHandle> &dependencies, Priority priority)
+{
+    JobHandle job = std::make_shared<Job>();
+    job->func = std::move(func);
+    job->priority = priority;
+    // Held until every dependency is registered, so one finishing meanwhile cannot queue the job early
+    job->pendingDependencies = 1;
+    for (auto &dependency : dependencies) {
+        if (dependency == nullptr) {
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(dependency->mutex);
+        if (!dependency->finished) {
+            job->pendingDependencies++;
+            dependency->continuations.push_back(job);
+        }
+    }
+    if (--job->pendingDependencies == 0) {
+        Enqueue(job);
+    }
+    return job;
+}
+
+bool JobSystem::IsFinished(const JobHandle &job) const
+{
+    if (job == nullptr) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(job->mutex);
+    return job->finished;
+}
+
+void JobSystem::Wait(const JobHandle &job)
+{
+    while (!IsFinished(job)) {
+        JobHandle other = FindJob(g_workerIndex);
+        if (other != nullptr) {
+            Execute(other);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_finishCondition.wait(lock, [this, &job]() { return IsFinished(job) || HasRunnableJob(g_workerIndex); });
+    }
+}
+
+void JobSystem::WaitAll(const std::vector<JobHandle> &jobs)
+{
+    for (auto &job : jobs) {
+        Wait(job);
+    }
+}
+
+void JobSystem::ParallelFor(uint32_t count, uint32_t grainSize, const RangeFunc &func, Priority priority)
+{
+    if (count == 0) {
+        return;
+    }
+    uint32_t grain = std::max(1u, grainSize);
+    std::vector<JobHandle> jobs;
+    for (uint32_t first = grain; first < count; first += grain) {
+        uint32_t rangeCount = std::min(grain, count - first);
+        jobs.push_back(Submit([&func, first, rangeCount]() { func(first, rangeCount); }, {}, priority));
+    }
+    func(0, std::min(grain, count));
+    WaitAll(jobs);
+}
+
+void JobSystem::Enqueue(const JobHandle &job)
+{
+    if (m_workers.empty()) {
+        Execute(job);
+        return;
+    }
+    if (job->priority == PRIORITY_HIGH) {
+        std::lock_guard<std::mutex> lock(m_globalMutex);
+        m_highJobs.push_back(job);
+        m_queuedHigh++;
+    } else if (g_workerIndex >= 0) {
+        Worker &worker = *m_workers[g_workerIndex];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.jobs.push_back(job);
+        m_queuedNormal++;
+    } else {
+        std::lock_guard<std::mutex> lock(m_globalMutex);
+        m_globalJobs.push_back(job);
+        m_queuedNormal++;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+    }
+    // A little core woken for a high priority job would go back to sleep, so those wake every worker
+    if (job->priority == PRIORITY_HIGH) {
+        m_workCondition.notify_all();
+    } else {
+        m_workCondition.notify_one();
+    }
+    m_finishCondition.notify_all();
+}
+
+bool JobSystem::HasRunnableJob(int32_t workerIndex) const
+{
+    bool bigCore = workerIndex < 0 || m_workers[workerIndex]->bigCore;
+    return m_queuedNormal.load() > 0 || (bigCore && m_queuedHigh.load() > 0);
+}
+
+JobSystem::JobHandle JobSystem::FindJob(int32_t workerIndex)
+{
+    JobHandle job;
+    bool bigCore = workerIndex < 0 || m_workers[workerIndex]->bigCore;
+    if (bigCore && m_queuedHigh.load() > 0) {
+        std::lock_guard<std::mutex> lock(m_globalMutex);
+        if (!m_highJobs.empty()) {
+            job = m_highJobs.front();
+            m_highJobs.pop_front();
+            m_queuedHigh--;
+            return job;
+        }
+    }
+    if (m_queuedNormal.load() == 0) {
+        return nullptr;
+    }
+    // Own jobs newest first while they are still in cache
+    if (workerIndex >= 0) {
+        Worker &worker = *m_workers[workerIndex];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (!worker.jobs.empty()) {
+            job = worker.jobs.back();
+            worker.jobs.pop_back();
+            m_queuedNormal--;
+            return job;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_globalMutex);
+        if (!m_globalJobs.empty()) {
+            job = m_globalJobs.front();
+            m_globalJobs.pop_front();
+            m_queuedNormal--;
+            return job;
+        }
+    }
+    // Steal the oldest job of another worker, usually the biggest piece of its work left
+    uint32_t workerCount = static_cast<uint32_t>(m_workers.size());
+    uint32_t start = workerIndex >= 0 ? static_cast<uint32_t>(workerIndex) + 1 : 0;
+    for (uint32_t i = 0; i < workerCount; i++) {
+        Worker &victim = *m_workers[(start + i) % workerCount];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty()) {
+            job = victim.jobs.front();
+            victim.jobs.pop_front();
+            m_queuedNormal--;
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+void JobSystem::Execute(const JobHandle &job)
+{
+    if (job->func) {
+        TRACE_SCOPE("job");
+        job->func();
+    }
+    // Drops the captures now, handles may outlive the job for a long time
+    job->func = nullptr;
+    std::vector<JobHandle> continuations;
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->finished = true;
+        continuations.swap(job->continuations);
+    }
+    for (auto &continuation : continuations) {
+        if (--continuation->pendingDependencies == 0) {
+            Enqueue(continuation);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+    }
+    m_finishCondition.notify_all();
+}
+
+void JobSystem::WorkerLoop(uint32_t index)
+{
+    g_workerIndex = static_cast<int32_t>(index);
+    Tracer::GetInstance()->SetThreadName("worker " + std::to_string(index));
+    Worker &worker = *m_workers[index];
+    if (!worker.cpus.empty()) {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        for (uint32_t cpu : worker.cpus) {
+            CPU_SET(cpu, &cpuSet);
+        }
+        if (sched_setaffinity(0, sizeof(cpuSet), &cpuSet) != 0) {
+            LOGW("JobSystem worker %{public}u set affinity failed, errno: %{public}d", index, errno);
+        }
+    }
+    while (true) {
+        JobHandle job = FindJob(g_workerIndex);
+        if (job != nullptr) {
+            Execute(job);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        if (m_stop) {
+            return;
+        }
+        m_workCondition.wait(lock, [this]() { return m_stop || HasRunnableJob(g_workerIndex); });
+    }
+}
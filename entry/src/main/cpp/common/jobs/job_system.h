@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMMON_JOBS_JOB_SYSTEM_H
+#define COMMON_JOBS_JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Process wide worker pool shared by asset loading, CPU image work and command recording.
+// Every worker owns a deque: jobs submitted from a worker go to its own deque and run LIFO, idle workers steal the
+// oldest job of the others. Jobs submitted from other threads go to a shared queue. A job can depend on other jobs
+// and only becomes runnable when all of them finished, so small task graphs need no fibers or blocking waits.
+// Workers are pinned to the big or little cluster on big.LITTLE devices, PRIORITY_HIGH jobs only run on big cores
+// (or on a thread waiting for them).
+class JobSystem {
+public:
+    enum Priority : uint32_t {
+        PRIORITY_NORMAL = 0,
+        PRIORITY_HIGH, // latency critical, e.g. command recording
+    };
+
+    struct Job;
+    using JobHandle = std::shared_ptr<Job>;
+    using JobFunc = std::function<void()>;
+    // Processes items [first, first + count)
+    using RangeFunc = std::function<void(uint32_t first, uint32_t count)>;
+
+    static JobSystem *GetInstance() { return &JobSystem::m_jobSystem; }
+    ~JobSystem();
+
+    // threadCount 0 means one worker per core but the calling one. Until Init, jobs run inline on the submitter.
+    bool Init(uint32_t threadCount = 0);
+    void Shutdown();
+    uint32_t GetWorkerCount() const { return static_cast<uint32_t>(m_workers.size()); }
+
+    JobHandle Submit(JobFunc func, const std::vector<JobHandle> &dependencies = {},
+        Priority priority = PRIORITY_NORMAL);
+    bool IsFinished(const JobHandle &job) const;
+    // Runs other jobs while waiting, so it is safe to call from a job
+    void Wait(const JobHandle &job);
+    void WaitAll(const std::vector<JobHandle> &jobs);
+    // Splits [0, count) into ranges of grainSize items, the caller runs the first range and returns when all are done
+    void ParallelFor(uint32_t count, uint32_t grainSize, const RangeFunc &func, Priority priority = PRIORITY_NORMAL);
+
+private:
+    struct Worker {
+        std::thread thread;
+        std::mutex mutex;
+        std::deque<JobHandle> jobs;
+        std::vector<uint32_t> cpus; // affinity, empty when not pinned
+        bool bigCore = true;
+    };
+
+    JobSystem() {}
+    void AssignCores();
+    void WorkerLoop(uint32_t index);
+    void Enqueue(const JobHandle &job);
+    JobHandle FindJob(int32_t workerIndex);
+    void Execute(const JobHandle &job);
+    bool HasRunnableJob(int32_t workerIndex) const;
+
+    static JobSystem m_jobSystem;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::mutex m_globalMutex;
+    std::deque<JobHandle> m_globalJobs;
+    std::deque<JobHandle> m_highJobs;
+
+    // Idle workers and waiters sleep on m_sleepMutex, the counters let them check for work without the queue locks
+    std::mutex m_sleepMutex;
+    std::condition_variable m_workCondition;
+    std::condition_variable m_finishCondition;
+    std::atomic<uint32_t> m_queuedNormal{0};
+    std::atomic<uint32_t> m_queuedHigh{0};
+    bool m_stop = false;
+};
+#endif // COMMON_JOBS_JOB_SYSTEM_H
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "logger.h"
+#include <chrono>
+#include <cstring>
+
+static_assert((LOG_RECORD_COUNT & (LOG_RECORD_COUNT - 1)) == 0, "LOG_RECORD_COUNT must be a power of two");
+
+Logger Logger::m_logger;
+
+Logger::Logger()
+{
+    // Slot i is free for position i
+    for (uint64_t i = 0; i < LOG_RECORD_COUNT; i++) {
+        m_records[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+Logger::~Logger() { Stop(); }
+
+void Logger::Start()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_thread.joinable()) {
+        return;
+    }
+    m_stop = false;
+    m_thread = std::thread(&Logger::FlushLoop, this);
+    m_running.store(true, std::memory_order_release);
+}
+
+void Logger::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_thread.joinable()) {
+            return;
+        }
+        // Lines logged from now on are printed directly
+        m_running.store(false, std::memory_order_release);
+        m_stop = true;
+    }
+    m_condition.notify_one();
+    m_thread.join();
+}
+
+Logger::Record *Logger::Acquire(uint64_t &position)
+{
+    // Multiple producers claim positions with a CAS, the slot sequence tells whether the consumer released it
+    position = m_enqueuePosition.load(std::memory_order_relaxed);
+    while (true) {
+        Record &record = m_records[position & (LOG_RECORD_COUNT - 1)];
+        uint64_t sequence = record.sequence.load(std::memory_order_acquire);
+        int64_t difference = static_cast<int64_t>(sequence - position);
+        if (difference == 0) {
+            if (m_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                return &record;
+            }
+        } else if (difference < 0) {
+            return nullptr;
+        } else {
+            position = m_enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool Logger::PrintNext()
+{
+    Record &record = m_records[m_dequeuePosition & (LOG_RECORD_COUNT - 1)];
+    // Lines claimed but not published yet stop the flush, they are printed in order the next time
+    if (record.sequence.load(std::memory_order_acquire) != m_dequeuePosition + 1) {
+        return false;
+    }
+    record.print(record);
+    record.sequence.store(m_dequeuePosition + LOG_RECORD_COUNT, std::memory_order_release);
+    m_dequeuePosition++;
+    return true;
+}
+
+void Logger::FlushLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        // Producers never signal, a line waits at most one interval
+        bool stop = m_condition.wait_for(lock, std::chrono::milliseconds(LOG_FLUSH_INTERVAL_MS),
+            [this]() { return m_stop; });
+        lock.unlock();
+        while (PrintNext()) {
+        }
+        uint64_t dropped = m_dropped.exchange(0, std::memory_order_relaxed);
+        if (dropped > 0) {
+            OH_LOG_Print(LOG_APP, LOG_WARN, LOG_DOMAIN, APP_LOG_TAG, "Logger ring full, %{public}llu lines dropped",
+                static_cast<unsigned long long>(dropped));
+        }
+        lock.lock();
+        if (stop) {
+            return;
+        }
+    }
+}
+
+uint32_t Logger::PackString(const char *value, char *payload, uint32_t &used)
+{
+    uint32_t offset = used;
+    if (offset >= LOG_RECORD_PAYLOAD) {
+        // No room left, points at the terminator of the previous string
+        return LOG_RECORD_PAYLOAD - 1;
+    }
+    size_t length = value != nullptr ? strnlen(value, LOG_RECORD_PAYLOAD - offset - 1) : 0;
+    if (length > 0) {
+        memcpy(payload + offset, value, length);
+    }
+    payload[offset + length] = '\0';
+    used = offset + static_cast<uint32_t>(length) + 1;
+    return offset;
+}
+
+bool LogRateLimiter::Allow()
+{
+    uint64_t nowNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+    uint64_t nextNs = m_nextNs.load(std::memory_order_relaxed);
+    if (nowNs < nextNs) {
+        return false;
+    }
+    // One of the threads racing for the same call site wins
+    return m_nextNs.compare_exchange_strong(nextNs, nowNs + m_intervalNs, std::memory_order_relaxed);
+}
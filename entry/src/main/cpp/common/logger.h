@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMMON_LOGGER_H
+#define COMMON_LOGGER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <hilog/log.h>
+
+#define APP_LOG_DOMAIN 0x0001
+#define APP_LOG_TAG "XEngine Vulkan Demo"
+
+// Levels below APP_LOG_MIN_LEVEL are compiled out, their arguments are not evaluated
+#define APP_LOG_LEVEL_DEBUG 0
+#define APP_LOG_LEVEL_INFO 1
+#define APP_LOG_LEVEL_WARN 2
+#define APP_LOG_LEVEL_ERROR 3
+#ifndef APP_LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define APP_LOG_MIN_LEVEL APP_LOG_LEVEL_INFO
+#else
+#define APP_LOG_MIN_LEVEL APP_LOG_LEVEL_DEBUG
+#endif
+#endif
+
+#define LOG_RECORD_COUNT 1024 // power of two
+#define LOG_RECORD_PAYLOAD 240 // arguments and copied strings of one line, longer strings are truncated
+#define LOG_FLUSH_INTERVAL_MS 20
+
+// Deferred hilog printing for the info and debug lines. The calling thread only copies the format pointer and the
+// arguments into a lock free ring, strings included, a background thread formats them and calls OH_LOG_Print. Lines
+// are dropped, and counted, while the ring is full. Before Start and after Stop lines are printed on the calling
+// thread. Warnings and errors always are, they must not be lost when the process goes down right after them.
+class Logger {
+public:
+    static Logger *GetInstance() { return &Logger::m_logger; }
+    ~Logger();
+
+    void Start();
+    // Prints the lines still in the ring
+    void Stop();
+
+    // format must be a string literal, it is read when the line is printed
+    template <typename... Args>
+    void Print(LogLevel level, const char *format, Args... args)
+    {
+        if (!m_running.load(std::memory_order_acquire)) {
+            OH_LOG_Print(LOG_APP, level, LOG_DOMAIN, APP_LOG_TAG, format, args...);
+            return;
+        }
+        uint64_t position;
+        Record *record = Acquire(position);
+        if (record == nullptr) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        using Values = std::tuple<typename Arg<Args>::Stored...>;
+        static_assert(sizeof(Values) <= LOG_RECORD_PAYLOAD / 2, "too many log arguments");
+        uint32_t used = sizeof(Values);
+        // Braced initialization evaluates left to right, the strings are copied after the values
+        new (record->payload) Values{Arg<Args>::Pack(args, record->payload, used)...};
+        (void)used; // lines without arguments
+        record->print = &Logger::PrintRecord<Args...>;
+        record->level = level;
+        record->format = format;
+        record->sequence.store(position + 1, std::memory_order_release);
+    }
+
+private:
+    struct Record {
+        std::atomic<uint64_t> sequence{0}; // position + 1 once published, position + LOG_RECORD_COUNT once printed
+        void (*print)(const Record &record) = nullptr;
+        LogLevel level = LOG_INFO;
+        const char *format = nullptr;
+        alignas(8) char payload[LOG_RECORD_PAYLOAD];
+    };
+
+    // Arithmetic values, enums and pointers are copied as they are
+    template <typename T>
+    struct Arg {
+        static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value,
+            "log arguments are copied by value");
+        using Stored = T;
+        static Stored Pack(T value, char *, uint32_t &) { return value; }
+        static T Unpack(Stored value, const char *) { return value; }
+    };
+
+    Logger();
+    Record *Acquire(uint64_t &position);
+    // Returns false when the ring is empty
+    bool PrintNext();
+    void FlushLoop();
+    // Copies value behind the argument values, returns its offset in payload
+    static uint32_t PackString(const char *value, char *payload, uint32_t &used);
+
+    template <typename... Args, size_t... I>
+    static void PrintValues(const Record &record, std::index_sequence<I...>)
+    {
+        const auto &values = *reinterpret_cast<const std::tuple<typename Arg<Args>::Stored...> *>(record.payload);
+        OH_LOG_Print(LOG_APP, record.level, LOG_DOMAIN, APP_LOG_TAG, record.format,
+            Arg<Args>::Unpack(std::get<I>(values), record.payload)...);
+    }
+
+    template <typename... Args>
+    static void PrintRecord(const Record &record)
+    {
+        PrintValues<Args...>(record, std::index_sequence_for<Args...>{});
+    }
+
+    static Logger m_logger;
+    std::atomic<bool> m_running{false};
+    std::atomic<uint64_t> m_enqueuePosition{0};
+    uint64_t m_dequeuePosition = 0; // flush thread only
+    std::atomic<uint64_t> m_dropped{0};
+    Record m_records[LOG_RECORD_COUNT];
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stop = false;
+};
+
+// Strings are copied, the pointer the caller passed may be gone when the line is printed
+template <>
+struct Logger::Arg<const char *> {
+    using Stored = uint32_t;
+    static Stored Pack(const char *value, char *payload, uint32_t &used) { return PackString(value, payload, used); }
+    static const char *Unpack(Stored offset, const char *payload) { return payload + offset; }
+};
+
+template <>
+struct Logger::Arg<char *> : Logger::Arg<const char *> {};
+
+// Lets a call site through at most once per interval, e.g. for lines in the frame loop
+class LogRateLimiter {
+public:
+    explicit LogRateLimiter(uint32_t intervalMs) : m_intervalNs(static_cast<uint64_t>(intervalMs) * 1000000ull) {}
+    bool Allow();
+
+private:
+    uint64_t m_intervalNs;
+    std::atomic<uint64_t> m_nextNs{0};
+};
+
+// Type checks the arguments against the format, nothing is evaluated
+#define APP_LOG_CHECK(level, ...) ((void)sizeof(OH_LOG_Print(LOG_APP, level, LOG_DOMAIN, APP_LOG_TAG, __VA_ARGS__)))
+#define APP_LOG_RATE_LIMITED(log, intervalMs, ...) \
+    do { \
+        static LogRateLimiter logRateLimiter(intervalMs); \
+        if (logRateLimiter.Allow()) { \
+            log(__VA_ARGS__); \
+        } \
+    } while (0)
+
+#if APP_LOG_MIN_LEVEL <= APP_LOG_LEVEL_DEBUG
+#define LOGD(...) (APP_LOG_CHECK(LOG_DEBUG, __VA_ARGS__), Logger::GetInstance()->Print(LOG_DEBUG, __VA_ARGS__))
+#define LOGD_RATE(intervalMs, ...) APP_LOG_RATE_LIMITED(LOGD, intervalMs, __VA_ARGS__)
+#else
+#define LOGD(...) APP_LOG_CHECK(LOG_DEBUG, __VA_ARGS__)
+#define LOGD_RATE(intervalMs, ...) APP_LOG_CHECK(LOG_DEBUG, __VA_ARGS__)
+#endif
+#if APP_LOG_MIN_LEVEL <= APP_LOG_LEVEL_INFO
+#define LOGI(...) (APP_LOG_CHECK(LOG_INFO, __VA_ARGS__), Logger::GetInstance()->Print(LOG_INFO, __VA_ARGS__))
+#define LOGI_RATE(intervalMs, ...) APP_LOG_RATE_LIMITED(LOGI, intervalMs, __VA_ARGS__)
+#else
+#define LOGI(...) APP_LOG_CHECK(LOG_INFO, __VA_ARGS__)
+#define LOGI_RATE(intervalMs, ...) APP_LOG_CHECK(LOG_INFO, __VA_ARGS__)
+#endif
+#if APP_LOG_MIN_LEVEL <= APP_LOG_LEVEL_WARN
+#define LOGW(...) ((void)OH_LOG_Print(LOG_APP, LOG_WARN, LOG_DOMAIN, APP_LOG_TAG, __VA_ARGS__))
+#define LOGW_RATE(intervalMs, ...) APP_LOG_RATE_LIMITED(LOGW, intervalMs, __VA_ARGS__)
+#else
+#define LOGW(...) APP_LOG_CHECK(LOG_WARN, __VA_ARGS__)
+#define LOGW_RATE(intervalMs, ...) APP_LOG_CHECK(LOG_WARN, __VA_ARGS__)
+#endif
+#define LOGE(...) ((void)OH_LOG_Print(LOG_APP, LOG_ERROR, LOG_DOMAIN, APP_LOG_TAG, __VA_ARGS__))
+#endif // COMMON_LOGGER_H
@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "trace.h"
+#include <time.h>
+#include <cstdio>
+#include "common/common.h"
+#include "file/file.h"
+
+#define TRACE_CPU_PID 1
+#define TRACE_GPU_PID 2
+
+static_assert((TRACE_THREAD_EVENTS & (TRACE_THREAD_EVENTS - 1)) == 0, "TRACE_THREAD_EVENTS must be a power of two");
+
+Tracer Tracer::m_tracer;
+thread_local Tracer::ThreadBuffer *Tracer::m_threadBuffer = nullptr;
+thread_local Tracer::ThreadBuffer *Tracer::m_gpuBuffer = nullptr;
+thread_local Tracer::ThreadExit Tracer::m_threadExit;
+
+namespace {
+// Name given before the thread recorded its first event
+thread_local std::string g_threadName;
+
+void AppendEscaped(std::string &out, const char *text)
+{
+    for (const char *c = text; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            out += '\\';
+        }
+        out += *c;
+    }
+}
+
+void AppendMetadata(std::string &out, const char *type, uint32_t pid, uint32_t tid, const char *name)
+{
+    out += "{\"name\":\"";
+    out += type;
+    out += "\",\"ph\":\"M\",\"pid\":" + std::to_string(pid) + ",\"tid\":" + std::to_string(tid) +
+        ",\"args\":{\"name\":\"";
+    AppendEscaped(out, name);
+    out += "\"}},\n";
+}
+}
+
+uint64_t Tracer::NowNs()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000000ull + static_cast<uint64_t>(now.tv_nsec);
+}
+
+void Tracer::SetThreadName(const std::string &name)
+{
+    g_threadName = name;
+    if (m_threadBuffer != nullptr) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_threadBuffer->name = name;
+        if (m_gpuBuffer != nullptr) {
+            m_gpuBuffer->name = name;
+        }
+    }
+}
+
+void Tracer::AddCpuEvent(const char *name, uint64_t startNs, uint64_t endNs)
+{
+    Record(*GetThreadBuffer(), name, startNs, endNs);
+}
+
+void Tracer::AddGpuEvent(const char *name, uint64_t startNs, uint64_t endNs)
+{
+    Record(*GetGpuBuffer(), name, startNs, endNs);
+}
+
+Tracer::ThreadExit::~ThreadExit()
+{
+    Tracer::GetInstance()->ReleaseThreadBuffers();
+}
+
+Tracer::ThreadBuffer *Tracer::GetThreadBuffer()
+{
+    if (m_threadBuffer != nullptr) {
+        return m_threadBuffer;
+    }
+    // Constructs the exit hook of this thread, its destructor releases the rings taken below
+    (void)&m_threadExit;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint32_t id = m_nextThreadId++;
+    m_threadBuffer = AcquireBuffer(m_threads, id, g_threadName.empty() ? "thread " + std::to_string(id) :
+        g_threadName);
+    return m_threadBuffer;
+}
+
+Tracer::ThreadBuffer *Tracer::GetGpuBuffer()
+{
+    if (m_gpuBuffer != nullptr) {
+        return m_gpuBuffer;
+    }
+    // Same tid as the CPU track, the GPU work of a render thread lines up with the frames it submitted
+    ThreadBuffer *threadBuffer = GetThreadBuffer();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_gpuBuffer = AcquireBuffer(m_gpuTracks, threadBuffer->id, threadBuffer->name);
+    return m_gpuBuffer;
+}
+
+Tracer::ThreadBuffer *Tracer::AcquireBuffer(std::vector<std::unique_ptr<ThreadBuffer>> &buffers, uint32_t id,
+    const std::string &name)
+{
+    ThreadBuffer *buffer = nullptr;
+    for (auto &candidate : buffers) {
+        if (candidate->exited) {
+            buffer = candidate.get();
+            break;
+        }
+    }
+    if (buffer == nullptr) {
+        buffers.push_back(std::unique_ptr<ThreadBuffer>(new ThreadBuffer()));
+        buffer = buffers.back().get();
+    }
+    // A new tid, the events of the previous owner are dropped rather than shown on the wrong track
+    buffer->id = id;
+    buffer->name = name;
+    buffer->exited = false;
+    buffer->written.store(0, std::memory_order_relaxed);
+    return buffer;
+}
+
+void Tracer::ReleaseThreadBuffers()
+{
+    if (m_threadBuffer == nullptr) {
+        return;
+    }
+    // Still dumped until another thread takes them over
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_threadBuffer->exited = true;
+    if (m_gpuBuffer != nullptr) {
+        m_gpuBuffer->exited = true;
+    }
+    m_threadBuffer = nullptr;
+    m_gpuBuffer = nullptr;
+}
+
+void Tracer::Record(ThreadBuffer &buffer, const char *name, uint64_t startNs, uint64_t endNs)
+{
+    uint64_t index = buffer.written.load(std::memory_order_relaxed);
+    Event &event = buffer.events[index & (TRACE_THREAD_EVENTS - 1)];
+    event.name = name;
+    event.startNs = startNs;
+    event.endNs = endNs;
+    buffer.written.store(index + 1, std::memory_order_release);
+}
+
+void Tracer::Snapshot(const ThreadBuffer &buffer, std::vector<Event> &events)
+{
+    uint64_t end = buffer.written.load(std::memory_order_acquire);
+    uint64_t begin = end > TRACE_THREAD_EVENTS ? end - TRACE_THREAD_EVENTS : 0;
+    std::vector<Event> copied;
+    copied.reserve(end - begin);
+    for (uint64_t i = begin; i < end; i++) {
+        copied.push_back(buffer.events[i & (TRACE_THREAD_EVENTS - 1)]);
+    }
+    // The owner kept recording during the copy, event i is overwritten by event i + TRACE_THREAD_EVENTS
+    uint64_t written = buffer.written.load(std::memory_order_acquire);
+    uint64_t valid = written >= TRACE_THREAD_EVENTS ? written - TRACE_THREAD_EVENTS + 1 : 0;
+    for (uint64_t i = begin; i < end; i++) {
+        if (i >= valid) {
+            events.push_back(copied[i - begin]);
+        }
+    }
+}
+
+bool Tracer::Dump(const std::string &filePath)
+{
+    struct Track {
+        uint32_t pid;
+        uint32_t tid;
+        std::string name;
+        std::vector<Event> events;
+    };
+    std::vector<Track> tracks;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto &thread : m_threads) {
+            tracks.push_back({TRACE_CPU_PID, thread->id, thread->name, {}});
+            Snapshot(*thread, tracks.back().events);
+        }
+        for (auto &gpuTrack : m_gpuTracks) {
+            tracks.push_back({TRACE_GPU_PID, gpuTrack->id, gpuTrack->name, {}});
+            Snapshot(*gpuTrack, tracks.back().events);
+        }
+    }
+
+    // Chrome trace event format, complete events with microsecond timestamps
+    std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    AppendMetadata(json, "process_name", TRACE_CPU_PID, 0, "CPU");
+    AppendMetadata(json, "process_name", TRACE_GPU_PID, 0, "GPU");
+    size_t eventCount = 0;
+    char line[96];
+    for (const Track &track : tracks) {
+        AppendMetadata(json, "thread_name", track.pid, track.tid, track.name.c_str());
+        for (const Event &event : track.events) {
+            json += "{\"name\":\"";
+            AppendEscaped(json, event.name);
+            uint64_t durationNs = event.endNs > event.startNs ? event.endNs - event.startNs : 0;
+            snprintf(line, sizeof(line), "\",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f},\n",
+                track.pid, track.tid, static_cast<double>(event.startNs) / 1e3, static_cast<double>(durationNs) / 1e3);
+            json += line;
+        }
+        eventCount += track.events.size();
+    }
+    // Drop the separator after the last entry, the format does not allow a trailing comma
+    json.resize(json.size() - 2);
+    json += "\n]}\n";
+
+    // Write next to the target and rename, a reader never sees a partial trace
+    std::string tmpPath = filePath + ".tmp";
+    File file;
+    if (!file.Open(tmpPath, File::FILE_CREATE) || !file.Truncate(0)) {
+        LOGE("Tracer Dump: failed to create %{public}s", tmpPath.c_str());
+        return false;
+    }
+    bool written = file.Write(json.data(), json.size()) == json.size() && file.Sync() == 0;
+    file.Close();
+    if (!written || !File::Move(tmpPath, filePath)) {
+        LOGE("Tracer Dump: failed to write %{public}s", filePath.c_str());
+        File::Remove(tmpPath);
+        return false;
+    }
+    LOGI("Tracer Dump: %{public}zu events of %{public}zu tracks to %{public}s", eventCount, tracks.size(),
+        filePath.c_str());
+    return true;
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMMON_TRACE_H
+#define COMMON_TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Build with -DTRACE_ENABLED=0 to compile the markers out
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 1
+#endif
+#define TRACE_THREAD_EVENTS 8192 // per thread, the oldest events are overwritten, power of two
+
+// Flight recorder of scoped CPU markers and GPU intervals, dumped on demand as a Chrome trace that
+// chrome://tracing and ui.perfetto.dev open. Every thread records into its own ring, so a marker costs two clock
+// reads and a few stores, no lock. GPU intervals are given in the CPU clock (CLOCK_MONOTONIC) by the caller and go
+// to a GPU track of the recording thread, so every render thread sharing the queue has its own. The rings of an
+// exited thread are handed to the next new one. Names must outlive the tracer, e.g. string literals.
+class Tracer {
+public:
+    static Tracer *GetInstance() { return &Tracer::m_tracer; }
+    // CLOCK_MONOTONIC, the CPU domain of VK_EXT_calibrated_timestamps
+    static uint64_t NowNs();
+
+    void SetEnabled(bool enabled) { m_enabled.store(enabled, std::memory_order_relaxed); }
+    bool IsEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+    // Shown as the track name, e.g. "render" or "worker 2"
+    void SetThreadName(const std::string &name);
+    void AddCpuEvent(const char *name, uint64_t startNs, uint64_t endNs);
+    // Into the GPU track of the calling thread, shown with the tid and the name of its CPU track
+    void AddGpuEvent(const char *name, uint64_t startNs, uint64_t endNs);
+    // Safe while other threads keep recording, events they overwrite during the copy are dropped
+    bool Dump(const std::string &filePath);
+
+private:
+    struct Event {
+        const char *name;
+        uint64_t startNs;
+        uint64_t endNs;
+    };
+    // Written by its thread only, Dump reads it from another one
+    struct ThreadBuffer {
+        uint32_t id = 0;
+        std::string name;
+        bool exited = false; // guarded by m_mutex, the ring is dumped until a new thread takes it over
+        std::atomic<uint64_t> written{0};
+        Event events[TRACE_THREAD_EVENTS];
+    };
+    // Hands the rings of a thread back when it exits
+    struct ThreadExit {
+        ~ThreadExit();
+    };
+
+    Tracer() {}
+    ThreadBuffer *GetThreadBuffer();
+    ThreadBuffer *GetGpuBuffer();
+    // Reuses the ring of an exited thread, so threads coming and going, e.g. a render thread per surface, do not
+    // grow the tracer. Called with m_mutex held.
+    ThreadBuffer *AcquireBuffer(std::vector<std::unique_ptr<ThreadBuffer>> &buffers, uint32_t id,
+        const std::string &name);
+    void ReleaseThreadBuffers();
+    static void Record(ThreadBuffer &buffer, const char *name, uint64_t startNs, uint64_t endNs);
+    static void Snapshot(const ThreadBuffer &buffer, std::vector<Event> &events);
+
+    static Tracer m_tracer;
+    // Ring of the calling thread, registered with its first event
+    static thread_local ThreadBuffer *m_threadBuffer;
+    static thread_local ThreadBuffer *m_gpuBuffer;
+    static thread_local ThreadExit m_threadExit;
+    std::atomic<bool> m_enabled{true};
+    // Taken when a thread records its first event and by Dump, never on the recording path
+    std::mutex m_mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> m_threads;
+    std::vector<std::unique_ptr<ThreadBuffer>> m_gpuTracks;
+    uint32_t m_nextThreadId = 1;
+};
+
+// Records the enclosing scope on the calling thread
+class TraceScope {
+public:
+    explicit TraceScope(const char *name) : m_name(name), m_startNs(Tracer::NowNs()) {}
+    ~TraceScope()
+    {
+        Tracer *tracer = Tracer::GetInstance();
+        if (tracer->IsEnabled()) {
+            tracer->AddCpuEvent(m_name, m_startNs, Tracer::NowNs());
+        }
+    }
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const char *m_name;
+    uint64_t m_startNs;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#if TRACE_ENABLED
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#endif
+#endif // COMMON_TRACE_H
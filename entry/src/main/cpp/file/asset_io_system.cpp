@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "asset_io_system.h"
+#include <cstring>
+
+AssetIOStream::~AssetIOStream() { FileOperator::GetInstance()->CloseAsset(m_descriptor); }
+
+size_t AssetIOStream::Read(void *buffer, size_t size, size_t count)
+{
+    if (size == 0 || count == 0) {
+        return 0;
+    }
+    int64_t bytes = FileOperator::ReadAsset(m_descriptor, buffer, static_cast<int64_t>(size * count), m_position);
+    if (bytes <= 0) {
+        return 0;
+    }
+    // Whole elements only, like fread
+    bytes -= bytes % static_cast<int64_t>(size);
+    m_position += bytes;
+    return static_cast<size_t>(bytes) / size;
+}
+
+aiReturn AssetIOStream::Seek(size_t offset, aiOrigin origin)
+{
+    int64_t position;
+    switch (origin) {
+        case aiOrigin_SET:
+            position = static_cast<int64_t>(offset);
+            break;
+        case aiOrigin_CUR:
+            position = m_position + static_cast<int64_t>(offset);
+            break;
+        case aiOrigin_END:
+            position = m_descriptor.length - static_cast<int64_t>(offset);
+            break;
+        default:
+            return aiReturn_FAILURE;
+    }
+    if (position < 0 || position > m_descriptor.length) {
+        return aiReturn_FAILURE;
+    }
+    m_position = position;
+    return aiReturn_SUCCESS;
+}
+
+bool AssetIOSystem::Exists(const char *file) const
+{
+    return FileOperator::GetInstance()->GetAssetSize(file) >= 0;
+}
+
+Assimp::IOStream *AssetIOSystem::Open(const char *file, const char *mode)
+{
+    if (strchr(mode, 'w') != nullptr || strchr(mode, 'a') != nullptr) {
+        LOGE("AssetIOSystem assets are read only, open %{public}s with mode %{public}s", file, mode);
+        return nullptr;
+    }
+    AssetDescriptor descriptor;
+    if (!FileOperator::GetInstance()->OpenAsset(file, descriptor)) {
+        LOGE("AssetIOSystem open %{public}s failed", file);
+        return nullptr;
+    }
+    return new AssetIOStream(descriptor);
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FILE_ASSET_IO_SYSTEM_H
+#define FILE_ASSET_IO_SYSTEM_H
+
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+#include "file_operator.h"
+
+// Lets Assimp read a model and the files it references straight from the assets, paths are raw file paths
+class AssetIOStream : public Assimp::IOStream {
+public:
+    explicit AssetIOStream(const AssetDescriptor &descriptor) : m_descriptor(descriptor) {}
+    ~AssetIOStream() override;
+    size_t Read(void *buffer, size_t size, size_t count) override;
+    size_t Write(const void *buffer, size_t size, size_t count) override { return 0; }
+    aiReturn Seek(size_t offset, aiOrigin origin) override;
+    size_t Tell() const override { return static_cast<size_t>(m_position); }
+    size_t FileSize() const override { return static_cast<size_t>(m_descriptor.length); }
+    void Flush() override {}
+
+private:
+    AssetDescriptor m_descriptor;
+    int64_t m_position = 0;
+};
+
+class AssetIOSystem : public Assimp::IOSystem {
+public:
+    bool Exists(const char *file) const override;
+    char getOsSeparator() const override { return '/'; }
+    // Read only, fails for write modes
+    Assimp::IOStream *Open(const char *file, const char *mode = "rb") override;
+    void Close(Assimp::IOStream *stream) override { delete stream; }
+};
+#endif // FILE_ASSET_IO_SYSTEM_H
@@ -17,6 +17,8 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <cerrno>
+#include <cstdint>
 #include "common/common.h"
 #include "fcntl.h"
 #include "napi/native_api.h"
@@ -68,8 +70,22 @@ size_t File::Read(void *buffer, size_t size)
         return -1;
     }
 
-    size_t len = read(m_fd, buffer, size);
-    return len;
+    // read may return less than asked for, keep going until size or end of file
+    size_t readSize = 0;
+    while (readSize < size) {
+        auto len = read(m_fd, static_cast<uint8_t *>(buffer) + readSize, size - readSize);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (len == 0) {
+            break;
+        }
+        readSize += static_cast<size_t>(len);
+    }
+    return readSize;
 }
 
 size_t File::Write(const void *buffer, size_t size)
@@ -80,11 +96,59 @@ size_t File::Write(const void *buffer, size_t size)
 
     size_t writeSize = 0;
     while (writeSize < size) {
-        auto len = write(m_fd, buffer, size);
+        auto len = write(m_fd, static_cast<const uint8_t *>(buffer) + writeSize, size - writeSize);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        writeSize += static_cast<size_t>(len);
+    }
+    return writeSize;
+}
+
+size_t File::ReadAt(void *buffer, size_t size, int64_t offset)
+{
+    if (m_fd == FILE_INVALID_FD || offset < 0) {
+        return -1;
+    }
+
+    size_t readSize = 0;
+    while (readSize < size) {
+        auto len = pread(m_fd, static_cast<uint8_t *>(buffer) + readSize, size - readSize,
+            static_cast<off_t>(offset + static_cast<int64_t>(readSize)));
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (len == 0) {
+            break;
+        }
+        readSize += static_cast<size_t>(len);
+    }
+    return readSize;
+}
+
+size_t File::WriteAt(const void *buffer, size_t size, int64_t offset)
+{
+    if (m_fd == FILE_INVALID_FD || offset < 0) {
+        return -1;
+    }
+
+    size_t writeSize = 0;
+    while (writeSize < size) {
+        auto len = pwrite(m_fd, static_cast<const uint8_t *>(buffer) + writeSize, size - writeSize,
+            static_cast<off_t>(offset + static_cast<int64_t>(writeSize)));
         if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
             return -1;
         }
-        writeSize += len;
+        writeSize += static_cast<size_t>(len);
     }
     return writeSize;
 }
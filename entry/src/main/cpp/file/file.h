@@ -16,6 +16,7 @@
 #ifndef FILE_FILE_H
 #define FILE_FILE_H
 
+#include <cstdint>
 #include <string>
 #define FILE_INVALID_FD (-1)
 
@@ -39,6 +40,11 @@ public:
 
     size_t Write(const void *buffer, size_t size);
 
+    // Positional, leave the file offset alone and can be used from several threads on one File
+    size_t ReadAt(void *buffer, size_t size, int64_t offset);
+
+    size_t WriteAt(const void *buffer, size_t size, int64_t offset);
+
     int Sync();
 
     bool Seek(int64_t offset);
@@ -17,11 +17,19 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <algorithm>
+#include <cerrno>
+#include <rawfile/raw_file.h>
 #include "file_operator.h"
 
 FileOperator FileOperator::m_fileOperator;
 
-FileOperator::~FileOperator() { OH_ResourceManager_ReleaseNativeResourceManager(mgr); }
+FileOperator::~FileOperator()
+{
+    if (mgr != nullptr) {
+        OH_ResourceManager_ReleaseNativeResourceManager(mgr);
+    }
+}
 
 std::string FileOperator::UnwrapStringFromJs(napi_env env, napi_value param)
 {
@@ -102,68 +110,231 @@ void FileOperator::InitEnv(napi_env env)
     GetHapFilesDir();
 }
 
+void FileOperator::SetAssetDirectory(const std::string &directory)
+{
+    std::lock_guard<std::mutex> lock(m_assetMutex);
+    m_assetDirectory = directory;
+}
+
+bool FileOperator::OpenAsset(const std::string &rawPath, AssetDescriptor &descriptor)
+{
+    // Importers build paths with ./ and backslashes
+    std::string path = rawPath;
+    std::replace(path.begin(), path.end(), '\\', '/');
+    while (path.compare(0, 2, "./") == 0) {
+        path.erase(0, 2);
+    }
+    std::lock_guard<std::mutex> lock(m_assetMutex);
+    if (!m_assetDirectory.empty() || mgr == nullptr) {
+        std::string filePath = (m_assetDirectory.empty() ? m_sCurrentHapFilesDir : m_assetDirectory) + "/" + path;
+        int fd = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == FILE_INVALID_FD) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+            close(fd);
+            return false;
+        }
+        descriptor.fd = fd;
+        descriptor.offset = 0;
+        descriptor.length = static_cast<int64_t>(st.st_size);
+        descriptor.rawFile = false;
+        return true;
+    }
+    RawFile *rawFile = OH_ResourceManager_OpenRawFile(mgr, path.c_str());
+    if (rawFile == nullptr) {
+        return false;
+    }
+    RawFileDescriptor rawDescriptor;
+    bool opened = OH_ResourceManager_GetRawFileDescriptor(rawFile, rawDescriptor);
+    OH_ResourceManager_CloseRawFile(rawFile);
+    if (!opened) {
+        LOGE("FileOperator get descriptor of %{public}s failed", path.c_str());
+        return false;
+    }
+    descriptor.fd = rawDescriptor.fd;
+    descriptor.offset = rawDescriptor.start;
+    descriptor.length = rawDescriptor.length;
+    descriptor.rawFile = true;
+    return true;
+}
+
+void FileOperator::CloseAsset(AssetDescriptor &descriptor)
+{
+    if (descriptor.fd == FILE_INVALID_FD) {
+        return;
+    }
+    if (descriptor.rawFile) {
+        RawFileDescriptor rawDescriptor;
+        rawDescriptor.fd = descriptor.fd;
+        rawDescriptor.start = static_cast<long>(descriptor.offset);
+        rawDescriptor.length = static_cast<long>(descriptor.length);
+        std::lock_guard<std::mutex> lock(m_assetMutex);
+        OH_ResourceManager_ReleaseRawFileDescriptor(rawDescriptor);
+    } else {
+        close(descriptor.fd);
+    }
+    descriptor.fd = FILE_INVALID_FD;
+}
+
+int64_t FileOperator::GetAssetSize(const std::string &rawPath)
+{
+    AssetDescriptor descriptor;
+    if (!OpenAsset(rawPath, descriptor)) {
+        return -1;
+    }
+    int64_t size = descriptor.length;
+    CloseAsset(descriptor);
+    return size;
+}
+
+int64_t FileOperator::ReadAsset(const AssetDescriptor &descriptor, void *buffer, int64_t size, int64_t position)
+{
+    if (descriptor.fd == FILE_INVALID_FD || position < 0 || size < 0) {
+        return -1;
+    }
+    size = std::min(size, descriptor.length - std::min(position, descriptor.length));
+    int64_t total = 0;
+    while (total < size) {
+        ssize_t len = pread(descriptor.fd, static_cast<uint8_t *>(buffer) + total, static_cast<size_t>(size - total),
+            static_cast<off_t>(descriptor.offset + position + total));
+        if (len < 0 && errno == EINTR) {
+            continue;
+        }
+        if (len <= 0) {
+            return len < 0 ? -1 : total;
+        }
+        total += len;
+    }
+    return total;
+}
+
+bool FileOperator::ReadAsset(const std::string &rawPath, std::vector<uint8_t> &data)
+{
+    AssetDescriptor descriptor;
+    if (!OpenAsset(rawPath, descriptor)) {
+        LOGE("FileOperator open asset %{public}s failed", rawPath.c_str());
+        return false;
+    }
+    data.resize(static_cast<size_t>(descriptor.length));
+    int64_t bytes = ReadAsset(descriptor, data.data(), descriptor.length, 0);
+    CloseAsset(descriptor);
+    if (bytes != descriptor.length) {
+        LOGE("FileOperator read asset %{public}s failed, size: %{public}lld, read: %{public}lld", rawPath.c_str(),
+            static_cast<long long>(descriptor.length), static_cast<long long>(bytes));
+        data.clear();
+        return false;
+    }
+    return true;
+}
+
+bool FileOperator::MapAsset(const std::string &rawPath, MappedFile &file, MappedFile::Access access)
+{
+    AssetDescriptor descriptor;
+    if (!OpenAsset(rawPath, descriptor)) {
+        LOGE("FileOperator open asset %{public}s failed", rawPath.c_str());
+        return false;
+    }
+    bool mapped = file.Map(descriptor.fd, descriptor.offset, descriptor.length, access);
+    CloseAsset(descriptor);
+    if (!mapped) {
+        LOGE("FileOperator map asset %{public}s failed", rawPath.c_str());
+    }
+    return mapped;
+}
+
+bool FileOperator::MakeParentDirs(const std::string &filePath)
+{
+    for (size_t pos = filePath.find('/', 1); pos != std::string::npos; pos = filePath.find('/', pos + 1)) {
+        std::string dir = filePath.substr(0, pos);
+        if (mkdir(dir.c_str(), RWXRWXRWX) != 0 && errno != EEXIST) {
+            LOGE("FileOperator mkdir %{public}s failed, errno: %{public}d", dir.c_str(), errno);
+            return false;
+        }
+    }
+    return true;
+}
+
 bool FileOperator::CopyRawFile(const std::string &rawPath, const std::string  &targetPath,
     bool overWrite)
 {
     if ((access(targetPath.c_str(), F_OK) == 0) && !overWrite) {
         return true;
     }
-    
-    auto srcFile = OH_ResourceManager_OpenRawFile(mgr, rawPath.c_str());
-    if (srcFile == nullptr) {
+
+    AssetDescriptor srcFile;
+    if (!OpenAsset(rawPath, srcFile)) {
         LOGE("FileOperator open src dir %{public}s failed", rawPath.c_str());
         return false;
     }
 
+    // Written next to the target and renamed, an interrupted copy never looks like an extracted asset
+    std::string tmpPath = targetPath + ".tmp";
     File dstFile;
-    if (!dstFile.Open(targetPath, File::FILE_CREATE)) {
+    if (!MakeParentDirs(targetPath) || !dstFile.Open(tmpPath, File::FILE_CREATE)) {
         LOGE("FileOperator open dst dir %{public}s failed", targetPath.c_str());
-        OH_ResourceManager_CloseRawFile(srcFile);
+        CloseAsset(srcFile);
         return false;
     }
 
-    bool result = false;
-    int srcFileSize = OH_ResourceManager_GetRawFileSize(srcFile);
-    int realReadBytes = 0;
-    unsigned char *buffer = nullptr;
-
-    do {
-        buffer = new (std::nothrow) unsigned char[srcFileSize];
-        if (buffer == nullptr) {
-            LOGE("FileOperator alloc mem for read rawfile %s failed, file size: %d", rawPath.c_str(), srcFileSize);
+    // Copied in bounded chunks, textures are several MB each
+    std::vector<uint8_t> buffer(static_cast<size_t>(std::min<int64_t>(srcFile.length, ASSET_COPY_CHUNK_SIZE)));
+    bool result = true;
+    for (int64_t position = 0; position < srcFile.length;) {
+        int64_t realReadBytes = ReadAsset(srcFile, buffer.data(), static_cast<int64_t>(buffer.size()), position);
+        if (realReadBytes <= 0) {
+            LOGE("FileOperator read raw file %{public}s failed at %{public}lld", rawPath.c_str(),
+                static_cast<long long>(position));
+            result = false;
             break;
         }
-
-        realReadBytes = OH_ResourceManager_ReadRawFile(srcFile, buffer, srcFileSize);
-        if (srcFileSize != realReadBytes) {
-            LOGE("FileOperator read raw file %s failed, file size: %d, real read: %d", rawPath.c_str(),
-                 srcFileSize, realReadBytes);
+        if (dstFile.Write(buffer.data(), static_cast<size_t>(realReadBytes)) != static_cast<size_t>(realReadBytes)) {
+            LOGE("FileOperator write %{public}s failed, realBytes: %{public}lld", targetPath.c_str(),
+                static_cast<long long>(realReadBytes));
+            result = false;
             break;
         }
+        position += realReadBytes;
+    }
 
-        if (dstFile.Write(buffer, realReadBytes) != realReadBytes) {
-            LOGE("FileOperator write %s failed, realBytes: %d", targetPath.c_str(), realReadBytes);
-            break;
-        }
-        result = true;
-    } while (false);
-
-    delete[] buffer;
-    OH_ResourceManager_CloseRawFile(srcFile);
+    CloseAsset(srcFile);
     dstFile.Close();
-
-    return result;
+    if (!result || !File::Move(tmpPath, targetPath)) {
+        File::Remove(tmpPath);
+        return false;
+    }
+    return true;
 }
 
 std::string FileOperator::GetFileAbsolutePath(std::string fileName)
 {
-    return m_sCurrentHapFilesDir + "/" + fileName;
+    std::string filePath;
+    {
+        std::lock_guard<std::mutex> lock(m_assetMutex);
+        if (!m_assetDirectory.empty()) {
+            return m_assetDirectory + "/" + fileName;
+        }
+        filePath = m_sCurrentHapFilesDir + "/" + fileName;
+        if (mgr == nullptr || access(filePath.c_str(), F_OK) == 0) {
+            return filePath;
+        }
+    }
+    // Serialized, two threads asking for the same asset would share its temporary file
+    std::lock_guard<std::mutex> lock(m_extractMutex);
+    if (!CopyRawFile(fileName, filePath, false)) {
+        LOGE("FileOperator extract %{public}s failed", fileName.c_str());
+    }
+    return filePath;
 }
 
 std::string FileOperator::GetAssetPath() { return m_sCurrentHapFilesDir; }
 
 void FileOperator::CopyRawDir(std::string assetsDirName)
 {
+    if (mgr == nullptr) {
+        return;
+    }
     RawDir *rawDir = OH_ResourceManager_OpenRawDir(mgr, assetsDirName.c_str());
     int count = OH_ResourceManager_GetRawFileCount(rawDir);
     if (count == 0) {
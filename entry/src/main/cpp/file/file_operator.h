@@ -16,22 +16,52 @@
 #ifndef FILE_FILE_OPERATOR_H
 #define FILE_FILE_OPERATOR_H
 
+#include <cstdint>
+#include <mutex>
 #include <string>
+#include <vector>
 #include <rawfile/raw_file_manager.h>
 #include <js_native_api.h>
 #include <js_native_api_types.h>
 #include "common/common.h"
 #include "file.h"
+#include "mapped_file.h"
 
 #define RWXRWXRWX 0777
+#define ASSET_COPY_CHUNK_SIZE (256 * 1024)
 
+// Read only view of one asset: bytes [offset, offset + length) of fd, read with pread so views can be shared
+// between threads
+struct AssetDescriptor {
+    int fd = FILE_INVALID_FD;
+    int64_t offset = 0;
+    int64_t length = 0;
+    bool rawFile = false; // owned by the resource manager
+};
+
+// Assets are read in place from the hap through the resource manager, rawfiles are stored uncompressed so a raw
+// file descriptor gives direct access. Consumers that only take a path get the asset extracted to filesDir the
+// first time they ask for it. Without a resource manager, e.g. on a Linux host, SetAssetDirectory serves the assets
+// from a plain directory instead.
 class FileOperator {
 public:
     static FileOperator *GetInstance() { return &FileOperator::m_fileOperator; }
     ~FileOperator();
     void InitEnv(napi_env env);
+    void SetAssetDirectory(const std::string &directory);
+    // Path of the asset on the file system, extracted first when needed
     std::string GetFileAbsolutePath(std::string fileName);
     std::string GetAssetPath();
+    bool OpenAsset(const std::string &rawPath, AssetDescriptor &descriptor);
+    void CloseAsset(AssetDescriptor &descriptor);
+    // Size in bytes, -1 when the asset does not exist
+    int64_t GetAssetSize(const std::string &rawPath);
+    bool ReadAsset(const std::string &rawPath, std::vector<uint8_t> &data);
+    // Maps the asset in place, the mapping stays valid after the asset is closed
+    bool MapAsset(const std::string &rawPath, MappedFile &file,
+        MappedFile::Access access = MappedFile::ACCESS_SEQUENTIAL);
+    // Reads up to size bytes at position of the asset, returns the bytes read or -1
+    static int64_t ReadAsset(const AssetDescriptor &descriptor, void *buffer, int64_t size, int64_t position);
     bool CopyRawFile(const std::string &rawPath, const std::string &targetPath, bool overWrite);
     void CopyRawDir(std::string assetsDirName);
 
@@ -39,7 +69,11 @@ private:
     static FileOperator m_fileOperator;
     std::string UnwrapStringFromJs(napi_env env, napi_value param);
     std::string GetHapFilesDir();
-    NativeResourceManager *mgr;
+    static bool MakeParentDirs(const std::string &filePath);
+    NativeResourceManager *mgr = nullptr;
+    std::mutex m_assetMutex; // resource manager calls and the asset directory
+    std::mutex m_extractMutex;
+    std::string m_assetDirectory;
     napi_env m_env;
     napi_value m_stageContext;
     std::string m_defaultDir = "/data/storage/el2/base/haps/entry/files";
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mapped_file.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cerrno>
+#include "common/common.h"
+
+FileView FileView::SubView(size_t offset, size_t length) const
+{
+    FileView view;
+    offset = std::min(offset, size);
+    view.data = data + offset;
+    view.size = std::min(length, size - offset);
+    return view;
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : m_base(other.m_base), m_mapLength(other.m_mapLength), m_view(other.m_view)
+{
+    other.m_base = nullptr;
+    other.m_mapLength = 0;
+    other.m_view = FileView();
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+    if (this != &other) {
+        Close();
+        m_base = other.m_base;
+        m_mapLength = other.m_mapLength;
+        m_view = other.m_view;
+        other.m_base = nullptr;
+        other.m_mapLength = 0;
+        other.m_view = FileView();
+    }
+    return *this;
+}
+
+bool MappedFile::Open(const std::string &filePath, Access access)
+{
+    int fd = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOGE("MappedFile open %{public}s failed, errno: %{public}d", filePath.c_str(), errno);
+        return false;
+    }
+    struct stat st;
+    bool mapped = fstat(fd, &st) == 0 && Map(fd, 0, static_cast<int64_t>(st.st_size), access);
+    close(fd);
+    if (!mapped) {
+        LOGE("MappedFile map %{public}s failed", filePath.c_str());
+    }
+    return mapped;
+}
+
+bool MappedFile::Map(int fd, int64_t offset, int64_t length, Access access)
+{
+    Close();
+    if (fd < 0 || offset < 0 || length <= 0) {
+        return false;
+    }
+    // mmap offsets must be page aligned, assets inside the hap start anywhere
+    int64_t pageSize = static_cast<int64_t>(sysconf(_SC_PAGESIZE));
+    int64_t alignedOffset = offset - offset % pageSize;
+    size_t mapLength = static_cast<size_t>(length + offset - alignedOffset);
+    void *base = mmap(nullptr, mapLength, PROT_READ, MAP_PRIVATE, fd, static_cast<off_t>(alignedOffset));
+    if (base == MAP_FAILED) {
+        LOGE("MappedFile mmap of %{public}lld bytes failed, errno: %{public}d", static_cast<long long>(length), errno);
+        return false;
+    }
+    m_base = base;
+    m_mapLength = mapLength;
+    m_view.data = static_cast<const uint8_t *>(base) + (offset - alignedOffset);
+    m_view.size = static_cast<size_t>(length);
+    Advise(access);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_base != nullptr) {
+        munmap(m_base, m_mapLength);
+        m_base = nullptr;
+        m_mapLength = 0;
+        m_view = FileView();
+    }
+}
+
+void MappedFile::Advise(Access access)
+{
+    if (m_base == nullptr) {
+        return;
+    }
+    int advice = MADV_SEQUENTIAL;
+    if (access == ACCESS_RANDOM) {
+        advice = MADV_RANDOM;
+    } else if (access == ACCESS_WILLNEED) {
+        advice = MADV_WILLNEED;
+    }
+    // Only a hint, a failure changes nothing but read ahead
+    if (madvise(m_base, m_mapLength, advice) != 0) {
+        LOGW("MappedFile madvise %{public}d failed, errno: %{public}d", advice, errno);
+    }
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FILE_MAPPED_FILE_H
+#define FILE_MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Non owning range of file bytes, valid as long as the MappedFile it came from
+struct FileView {
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+
+    bool Empty() const { return size == 0; }
+    // Clamped to the view
+    FileView SubView(size_t offset, size_t length) const;
+};
+
+// Read only mapping of a file, or of a range of an open descriptor, unmapped when destroyed.
+// Pages are read on first access instead of copying the file into a heap buffer, the access hint tells the kernel
+// how to read ahead.
+class MappedFile {
+public:
+    enum Access {
+        ACCESS_SEQUENTIAL = 0, // read once from front to back, e.g. decoders
+        ACCESS_RANDOM,         // jumps around, e.g. containers with offset tables
+        ACCESS_WILLNEED,       // read ahead now, all of it is needed soon
+    };
+
+    MappedFile() {}
+    ~MappedFile() { Close(); }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    bool Open(const std::string &filePath, Access access = ACCESS_SEQUENTIAL);
+    // Maps [offset, offset + length) of fd, the descriptor can be closed afterwards
+    bool Map(int fd, int64_t offset, int64_t length, Access access = ACCESS_SEQUENTIAL);
+    void Close();
+    void Advise(Access access);
+
+    bool IsOpen() const { return m_base != nullptr; }
+    const FileView &GetView() const { return m_view; }
+    const uint8_t *Data() const { return m_view.data; }
+    size_t Size() const { return m_view.size; }
+
+private:
+    void *m_base = nullptr; // page aligned start of the mapping
+    size_t m_mapLength = 0;
+    FileView m_view;
+};
+#endif // FILE_MAPPED_FILE_H
@@ -17,6 +17,7 @@
 #include "file/file_operator.h"
 #include "manager/plugin_manager.h"
 #include "common/common.h"
+#include "common/jobs/job_system.h"
 #include <rawfile/raw_file.h>
 #include <rawfile/raw_dir.h>
 #include <rawfile/raw_file_manager.h>
@@ -38,9 +39,12 @@ static napi_value Init(napi_env env, napi_value exports)
         return nullptr;
     }
 
+    // Info and debug lines of the frame loop are printed by a background thread from now on
+    Logger::GetInstance()->Start();
+    JobSystem::GetInstance()->Init();
     PluginManager::GetInstance()->Export(env, exports);
+    // Assets are read from the hap on demand, see FileOperator
     FileOperator::GetInstance()->InitEnv(env);
-    FileOperator::GetInstance()->CopyRawDir("");
     return exports;
 }
 EXTERN_C_END
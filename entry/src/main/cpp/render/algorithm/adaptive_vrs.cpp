@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "adaptive_vrs.h"
+#include <array>
+#include <cstring>
+#include "common/common.h"
+
+AdaptiveVRS::~AdaptiveVRS()
+{
+    if (m_device == VK_NULL_HANDLE) {
+        return;
+    }
+    vkDestroyPipeline(m_device, m_pipeline, nullptr);
+    vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_descriptorSetLayout, nullptr);
+    vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+    vkDestroySampler(m_device, m_sampler, nullptr);
+    vkDestroyImageView(m_device, m_inputDepthView, nullptr);
+}
+
+bool AdaptiveVRS::Init(InitParams &initParams)
+{
+    m_device = initParams.device;
+    m_inputColorView = initParams.inputColorView;
+    m_inputDepthImage = initParams.inputDepthImage;
+    m_inputDepthFormat = initParams.inputDepthFormat;
+    m_outputView = initParams.outputShadingRateView;
+    m_inputSize = initParams.inputSize;
+    m_vulkanDevice = initParams.vulkanDevice;
+
+    pushConstants.inputWidth = static_cast<int32_t>(m_inputSize.width);
+    pushConstants.inputHeight = static_cast<int32_t>(m_inputSize.height);
+    pushConstants.tileSize = initParams.tileSize;
+    pushConstants.errorSensitivity = initParams.errorSensitivity;
+    pushConstants.useReprojection = 0;
+    pushConstants.maxFragmentWidth = initParams.maxFragmentSize.width;
+    pushConstants.maxFragmentHeight = initParams.maxFragmentSize.height;
+
+    CreateDepthView();
+    SetupDescriptorPool();
+    SetupLayouts();
+    SetupDescriptors();
+    return PreparePipeline();
+}
+
+void AdaptiveVRS::CreateDepthView()
+{
+    // The G-Buffer depth view may include stencil, which can not be sampled, so use a depth only view.
+    VkImageViewCreateInfo imageView = vks::initializers::imageViewCreateInfo();
+    imageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    imageView.format = m_inputDepthFormat;
+    imageView.subresourceRange = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1};
+    imageView.image = m_inputDepthImage;
+    VK_CHECK_RESULT(vkCreateImageView(m_device, &imageView, nullptr, &m_inputDepthView));
+
+    VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
+    sampler.magFilter = VK_FILTER_NEAREST;
+    sampler.minFilter = VK_FILTER_NEAREST;
+    sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler.addressModeV = sampler.addressModeU;
+    sampler.addressModeW = sampler.addressModeU;
+    sampler.maxAnisotropy = 1.0f;
+    sampler.minLod = 0.0f;
+    sampler.maxLod = 1.0f;
+    sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    VK_CHECK_RESULT(vkCreateSampler(m_device, &sampler, nullptr, &m_sampler));
+}
+
+void AdaptiveVRS::SetupDescriptorPool()
+{
+    std::vector<VkDescriptorPoolSize> poolSizes = {
+        vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2),
+        vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1)
+    };
+    VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+    VK_CHECK_RESULT(vkCreateDescriptorPool(m_device, &descriptorPoolInfo, nullptr, &m_descriptorPool));
+}
+
+void AdaptiveVRS::SetupLayouts()
+{
+    std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+        vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            VK_SHADER_STAGE_COMPUTE_BIT, 0),
+        vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            VK_SHADER_STAGE_COMPUTE_BIT, 1),
+        vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            VK_SHADER_STAGE_COMPUTE_BIT, 2),
+    };
+    VkDescriptorSetLayoutCreateInfo setLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(
+        setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+    VK_CHECK_RESULT(vkCreateDescriptorSetLayout(m_device, &setLayoutCreateInfo, nullptr, &m_descriptorSetLayout));
+
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo();
+    pipelineLayoutCreateInfo.pSetLayouts = &m_descriptorSetLayout;
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+    VK_CHECK_RESULT(vkCreatePipelineLayout(m_device, &pipelineLayoutCreateInfo, nullptr, &m_pipelineLayout));
+}
+
+void AdaptiveVRS::SetupDescriptors()
+{
+    VkDescriptorSetAllocateInfo descriptorAllocInfo =
+        vks::initializers::descriptorSetAllocateInfo(m_descriptorPool, &m_descriptorSetLayout, 1);
+    VK_CHECK_RESULT(vkAllocateDescriptorSets(m_device, &descriptorAllocInfo, &m_descriptorSet));
+
+    std::vector<VkDescriptorImageInfo> imageDescriptors = {
+        vks::initializers::descriptorImageInfo(m_sampler, m_inputColorView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+        vks::initializers::descriptorImageInfo(m_sampler, m_inputDepthView,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL),
+        vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, m_outputView, VK_IMAGE_LAYOUT_GENERAL),
+    };
+    std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+        vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0,
+            &imageDescriptors[0]),
+        vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1,
+            &imageDescriptors[1]),
+        vks::initializers::writeDescriptorSet(m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2,
+            &imageDescriptors[2]),
+    };
+    vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(),
+        0, nullptr);
+}
+
+bool AdaptiveVRS::PreparePipeline()
+{
+    std::string fileName = GetShaderFile("shader/algorithm/adaptive_vrs.comp.spv");
+    VkShaderModule shaderModule = vks::tools::loadShader(fileName.c_str(), m_device);
+    if (shaderModule == VK_NULL_HANDLE) {
+        LOGE("AdaptiveVRS PreparePipeline: failed to load %{public}s", fileName.c_str());
+        return false;
+    }
+
+    VkComputePipelineCreateInfo computePipelineCreateInfo =
+        vks::initializers::computePipelineCreateInfo(m_pipelineLayout, 0);
+    computePipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    computePipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    computePipelineCreateInfo.stage.module = shaderModule;
+    computePipelineCreateInfo.stage.pName = "main";
+    VkResult res = vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &computePipelineCreateInfo, nullptr,
+        &m_pipeline);
+    vkDestroyShaderModule(m_device, shaderModule, nullptr);
+    if (res != VK_SUCCESS) {
+        LOGE("AdaptiveVRS PreparePipeline: vkCreateComputePipelines failed, result: %{public}d", res);
+        return false;
+    }
+    return true;
+}
+
+std::string AdaptiveVRS::GetShaderFile(const std::string &name) const
+{
+    return FileOperator::GetInstance()->GetFileAbsolutePath(name);
+}
+
+void AdaptiveVRS::Dispatch(VkCommandBuffer cmdBuffer, const float *reprojectionMatrix)
+{
+    if (m_pipeline == VK_NULL_HANDLE) {
+        return;
+    }
+    if (reprojectionMatrix != nullptr) {
+        memcpy(pushConstants.reprojection, reprojectionMatrix, sizeof(pushConstants.reprojection));
+        pushConstants.useReprojection = 1;
+    } else {
+        pushConstants.useReprojection = 0;
+    }
+
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &m_descriptorSet, 0,
+        nullptr);
+    vkCmdPushConstants(cmdBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants),
+        &pushConstants);
+    vkCmdDispatch(cmdBuffer, m_inputSize.width / pushConstants.tileSize, m_inputSize.height / pushConstants.tileSize,
+        1);
+}
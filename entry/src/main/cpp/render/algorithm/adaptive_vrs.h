@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RENDER_ALGORITHM_ADAPTIVE_VRS_H
+#define RENDER_ALGORITHM_ADAPTIVE_VRS_H
+
+#include <assert.h>
+#include <vector>
+#include <string>
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanDevice.h"
+#include "file/file_operator.h"
+
+// Built-in adaptive shading rate generator, used when the XEngine adaptive VRS extension is missing.
+// Takes the same inputs as HMS_XEG_CmdDispatchAdaptiveVRS and fills the R8_UINT shading rate image
+// from per-tile luma variance, luma steps and reprojected motion.
+class AdaptiveVRS {
+public:
+    struct InitParams {
+        VkDevice device;
+        VkImageView inputColorView;
+        VkImage inputDepthImage;
+        VkFormat inputDepthFormat;
+        VkImageView outputShadingRateView;
+        VkExtent2D inputSize;
+        uint32_t tileSize;
+        float errorSensitivity;
+        VkExtent2D maxFragmentSize;
+        vks::VulkanDevice *vulkanDevice;
+    };
+
+    AdaptiveVRS() {}
+    ~AdaptiveVRS();
+
+    bool Init(InitParams &initParams);
+    // reprojectionMatrix is column-major previous-view-projection * inverse(current-view-projection),
+    // nullptr disables the motion term. Records no barriers: the caller makes the depth readable in
+    // DEPTH_STENCIL_READ_ONLY_OPTIMAL and the color in SHADER_READ_ONLY_OPTIMAL by the compute stage and gets the
+    // shading rate image in GENERAL, see the VRS pass of the frame graph.
+    void Dispatch(VkCommandBuffer cmdBuffer, const float *reprojectionMatrix);
+
+    struct PushConstants {
+        float reprojection[16];
+        int32_t inputWidth;
+        int32_t inputHeight;
+        uint32_t tileSize;
+        float errorSensitivity;
+        uint32_t useReprojection;
+        uint32_t maxFragmentWidth;
+        uint32_t maxFragmentHeight;
+    } pushConstants;
+
+private:
+    void CreateDepthView();
+    void SetupDescriptorPool();
+    void SetupLayouts();
+    void SetupDescriptors();
+    bool PreparePipeline();
+    std::string GetShaderFile(const std::string &name) const;
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkImageView m_inputColorView = VK_NULL_HANDLE;
+    VkImage m_inputDepthImage = VK_NULL_HANDLE;
+    VkFormat m_inputDepthFormat = VK_FORMAT_UNDEFINED;
+    VkImageView m_inputDepthView = VK_NULL_HANDLE;
+    VkImageView m_outputView = VK_NULL_HANDLE;
+    VkExtent2D m_inputSize = {0, 0};
+    VkSampler m_sampler = VK_NULL_HANDLE;
+    VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
+    VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline m_pipeline = VK_NULL_HANDLE;
+    vks::VulkanDevice *m_vulkanDevice = nullptr;
+};
+#endif // RENDER_ALGORITHM_ADAPTIVE_VRS_H
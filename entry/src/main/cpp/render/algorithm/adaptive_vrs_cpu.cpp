@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "adaptive_vrs_cpu.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// Keep in sync with shader/algorithm/adaptive_vrs.comp
+constexpr float CONTRAST_SCALE = 0.1f;
+constexpr float BLACK_LEVEL = 0.05f;
+constexpr float MOTION_PIXELS = 4.0f;
+constexpr float MOTION_MAX_BOOST = 2.0f;
+constexpr float FLAT_TILE_RATIO = 0.25f;
+constexpr float QUARTER_RATE_ERROR = 2.13f;
+
+inline float Luma(const uint8_t *rgba)
+{
+    return (0.299f * rgba[0] + 0.587f * rgba[1] + 0.114f * rgba[2]) * (1.0f / 255.0f);
+}
+
+inline uint32_t Log2(uint32_t v)
+{
+    return v >= 4 ? 2 : (v >= 2 ? 1 : 0);
+}
+
+inline uint32_t RateForError(float error, float threshold)
+{
+    if (error * QUARTER_RATE_ERROR < threshold) {
+        return 4;
+    }
+    return error < threshold ? 2 : 1;
+}
+}
+
+uint8_t AdaptiveVRSCpu::EncodeRate(uint32_t width, uint32_t height)
+{
+    return static_cast<uint8_t>((Log2(width) << 2) | Log2(height));
+}
+
+void AdaptiveVRSCpu::DecodeRate(uint8_t rate, uint32_t &width, uint32_t &height)
+{
+    width = 1u << ((rate >> 2) & 3);
+    height = 1u << (rate & 3);
+}
+
+void AdaptiveVRSCpu::Init(const InitParams &initParams)
+{
+    m_width = initParams.width;
+    m_height = initParams.height;
+    m_tileSize = std::max(1u, initParams.tileSize);
+    m_errorSensitivity = initParams.errorSensitivity;
+    m_maxFragmentWidth = std::max(1u, initParams.maxFragmentWidth);
+    m_maxFragmentHeight = std::max(1u, initParams.maxFragmentHeight);
+}
+
+bool AdaptiveVRSCpu::Generate(const uint8_t *color, const float *depth, const float *reprojection,
+    std::vector<uint8_t> &rates)
+{
+    if (color == nullptr || depth == nullptr || m_width < m_tileSize || m_height < m_tileSize) {
+        return false;
+    }
+    uint32_t rateWidth = GetRateWidth();
+    uint32_t rateHeight = GetRateHeight();
+    rates.resize(static_cast<size_t>(rateWidth) * rateHeight);
+    for (uint32_t ty = 0; ty < rateHeight; ty++) {
+        for (uint32_t tx = 0; tx < rateWidth; tx++) {
+            rates[static_cast<size_t>(ty) * rateWidth + tx] =
+                SelectRate(GatherTile(color, depth, reprojection, tx, ty));
+        }
+    }
+    return true;
+}
+
+AdaptiveVRSCpu::TileStats AdaptiveVRSCpu::GatherTile(const uint8_t *color, const float *depth,
+    const float *reprojection, uint32_t tileX, uint32_t tileY) const
+{
+    uint32_t x0 = tileX * m_tileSize;
+    uint32_t y0 = tileY * m_tileSize;
+    float sum = 0.0f;
+    float sumSq = 0.0f;
+    float stepX = 0.0f;
+    float stepY = 0.0f;
+    for (uint32_t y = y0; y < y0 + m_tileSize; y++) {
+        for (uint32_t x = x0; x < x0 + m_tileSize; x++) {
+            float l = Luma(color + (static_cast<size_t>(y) * m_width + x) * 4);
+            sum += l;
+            sumSq += l * l;
+            if (x + 1 < x0 + m_tileSize) {
+                stepX += std::fabs(Luma(color + (static_cast<size_t>(y) * m_width + x + 1) * 4) - l);
+            }
+            if (y + 1 < y0 + m_tileSize) {
+                stepY += std::fabs(Luma(color + (static_cast<size_t>(y + 1) * m_width + x) * 4) - l);
+            }
+        }
+    }
+    float count = static_cast<float>(m_tileSize * m_tileSize);
+    float pairs = static_cast<float>(std::max(1u, m_tileSize * (m_tileSize - 1)));
+    TileStats stats;
+    stats.mean = sum / count;
+    stats.variance = std::max(0.0f, sumSq / count - stats.mean * stats.mean);
+    stats.errorX = stepX / pairs;
+    stats.errorY = stepY / pairs;
+    stats.motion = 0.0f;
+
+    if (reprojection != nullptr) {
+        uint32_t cx = x0 + m_tileSize / 2;
+        uint32_t cy = y0 + m_tileSize / 2;
+        float u = (cx + 0.5f) / m_width;
+        float v = (cy + 0.5f) / m_height;
+        float ndc[4] = {u * 2.0f - 1.0f, v * 2.0f - 1.0f, depth[static_cast<size_t>(cy) * m_width + cx], 1.0f};
+        float prev[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        for (int row = 0; row < 4; row++) {
+            for (int col = 0; col < 4; col++) {
+                prev[row] += reprojection[col * 4 + row] * ndc[col];
+            }
+        }
+        if (prev[3] > 0.0f) {
+            float du = (prev[0] / prev[3] * 0.5f + 0.5f - u) * m_width;
+            float dv = (prev[1] / prev[3] * 0.5f + 0.5f - v) * m_height;
+            stats.motion = std::sqrt(du * du + dv * dv);
+        }
+    }
+    return stats;
+}
+
+uint8_t AdaptiveVRSCpu::SelectRate(const TileStats &stats) const
+{
+    // Fast motion hides detail, so the just noticeable difference grows with it.
+    float threshold = m_errorSensitivity * CONTRAST_SCALE * (stats.mean + BLACK_LEVEL) *
+        (1.0f + std::min(stats.motion / MOTION_PIXELS, MOTION_MAX_BOOST));
+    uint32_t rateX = 4;
+    uint32_t rateY = 4;
+    if (std::sqrt(stats.variance) >= threshold * FLAT_TILE_RATIO) {
+        rateX = RateForError(stats.errorX, threshold);
+        rateY = RateForError(stats.errorY, threshold);
+        // 4x1 and 1x4 are optional fragment sizes, keep the aspect within 2:1
+        if (rateX == 4 && rateY == 1) {
+            rateX = 2;
+        }
+        if (rateY == 4 && rateX == 1) {
+            rateY = 2;
+        }
+    }
+    return EncodeRate(std::min(rateX, m_maxFragmentWidth), std::min(rateY, m_maxFragmentHeight));
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RENDER_ALGORITHM_ADAPTIVE_VRS_CPU_H
+#define RENDER_ALGORITHM_ADAPTIVE_VRS_CPU_H
+
+#include <cstdint>
+#include <vector>
+
+// CPU reference of the adaptive shading rate generator in shader/algorithm/adaptive_vrs.comp.
+// Both sides must pick the same rate for the same inputs, so the constants below mirror the shader.
+class AdaptiveVRSCpu {
+public:
+    struct InitParams {
+        uint32_t width;
+        uint32_t height;
+        uint32_t tileSize;
+        float errorSensitivity;
+        uint32_t maxFragmentWidth;
+        uint32_t maxFragmentHeight;
+    };
+
+    // Tile statistics gathered from the previous frame's color and the current depth.
+    struct TileStats {
+        float mean;
+        float variance;
+        float errorX;   // mean absolute luma step between horizontal neighbours
+        float errorY;   // mean absolute luma step between vertical neighbours
+        float motion;   // reprojected screen-space motion of the tile centre in pixels
+    };
+
+    // Encodes a fragment size as VK_KHR_fragment_shading_rate expects: (log2(width) << 2) | log2(height)
+    static uint8_t EncodeRate(uint32_t width, uint32_t height);
+    static void DecodeRate(uint8_t rate, uint32_t &width, uint32_t &height);
+
+    void Init(const InitParams &initParams);
+
+    // color is RGBA8 and depth is [0, 1], both width x height. reprojection is the column-major
+    // previous-view-projection * inverse(current-view-projection), or nullptr to ignore motion.
+    // Returns false when color or depth is missing or the image is smaller than one tile.
+    bool Generate(const uint8_t *color, const float *depth, const float *reprojection, std::vector<uint8_t> &rates);
+
+    TileStats GatherTile(const uint8_t *color, const float *depth, const float *reprojection, uint32_t tileX,
+        uint32_t tileY) const;
+    uint8_t SelectRate(const TileStats &stats) const;
+
+    uint32_t GetRateWidth() const { return m_width / m_tileSize; }
+    uint32_t GetRateHeight() const { return m_height / m_tileSize; }
+
+private:
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint32_t m_tileSize = 0;
+    float m_errorSensitivity = 0.0f;
+    uint32_t m_maxFragmentWidth = 1;
+    uint32_t m_maxFragmentHeight = 1;
+};
+#endif // RENDER_ALGORITHM_ADAPTIVE_VRS_CPU_H
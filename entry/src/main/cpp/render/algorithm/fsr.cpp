@@ -122,8 +122,10 @@ void FSR::PrepareOffscreenFramebuffers()
     colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    // Both passes overwrite their target and leave it for the fragment shader reading it next, RCAS reads the EASU
+    // result and the caller's swapchain pass the RCAS output
     colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
     VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
 
     VkSubpassDescription subpass = {};
@@ -133,21 +135,27 @@ void FSR::PrepareOffscreenFramebuffers()
 
     std::array<VkSubpassDependency, 2> dependencies;
 
+    // The target was last sampled by a fragment shader (the RCAS pass or the swapchain pass of the previous frame)
+    // and is only written here, the caller's barrier in front of the upscale chains through the attachment stage
     dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
     dependencies[0].dstSubpass = 0;
-    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    dependencies[0].srcStageMask =
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
     dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+    dependencies[0].srcAccessMask = 0;
+    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[0].dependencyFlags = 0;
 
+    // Makes the EASU result readable by the RCAS pass, which samples around every pixel, and chains with the
+    // caller's barrier after the upscale
     dependencies[1].srcSubpass = 0;
     dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
     dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-    dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+    dependencies[1].dstStageMask =
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    dependencies[1].dependencyFlags = 0;
 
     VkRenderPassCreateInfo renderPassInfo = {};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -326,9 +334,9 @@ void FSR::PreparePipelines()
         colorBlendState.attachmentCount = 1;
         colorBlendState.pAttachments = &blendAttachmentState;
 
-        shaderStages[0] = LoadShader(GetShadersPath() + "/shader/algorithm/fullscreen.vert.spv",
+        shaderStages[0] = LoadShader(GetShaderFile("shader/algorithm/fullscreen.vert.spv"),
             VK_SHADER_STAGE_VERTEX_BIT);
-        shaderStages[1] = LoadShader(GetShadersPath() + "/shader/algorithm/easu.frag.spv",
+        shaderStages[1] = LoadShader(GetShaderFile("shader/algorithm/easu.frag.spv"),
             VK_SHADER_STAGE_FRAGMENT_BIT);
         VK_CHECK_RESULT(vkCreateGraphicsPipelines(m_device, m_pipelineCache, 1, &pipelineCreateInfo, nullptr,
             &pipelines.easu));
@@ -346,9 +354,9 @@ void FSR::PreparePipelines()
         colorBlendState.attachmentCount = 1;
         colorBlendState.pAttachments = &blendAttachmentState;
 
-        shaderStages[0] = LoadShader(GetShadersPath() + "/shader/algorithm/fullscreen.vert.spv",
+        shaderStages[0] = LoadShader(GetShaderFile("shader/algorithm/fullscreen.vert.spv"),
             VK_SHADER_STAGE_VERTEX_BIT);
-        shaderStages[1] = LoadShader(GetShadersPath() + "/shader/algorithm/rcas.frag.spv",
+        shaderStages[1] = LoadShader(GetShaderFile("shader/algorithm/rcas.frag.spv"),
             VK_SHADER_STAGE_FRAGMENT_BIT);
         VK_CHECK_RESULT(vkCreateGraphicsPipelines(m_device, m_pipelineCache, 1, &pipelineCreateInfo, nullptr,
             &pipelines.rcas));
@@ -381,9 +389,9 @@ VkPipelineShaderStageCreateInfo FSR::LoadShader(std::string fileName, VkShaderSt
     return shaderStage;
 }
 
-std::string FSR::GetShadersPath() const
+std::string FSR::GetShaderFile(const std::string &name) const
 {
-    return FileOperator::GetInstance()->GetAssetPath();
+    return FileOperator::GetInstance()->GetFileAbsolutePath(name);
 }
 
 void FSR::CreatePipelineCache()
@@ -427,20 +435,8 @@ void FSR::BuildCommandBuffers(VkCommandBuffer cmdBuffer)
     vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
     vkCmdEndRenderPass(cmdBuffer);
 
-    VkImageMemoryBarrier imageMemoryBarrier{};
-    imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    imageMemoryBarrier.image = frameBuffers.easu.color.image;
-    imageMemoryBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-    imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    imageMemoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-
-    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-    
+    // The render pass left the EASU result in SHADER_READ_ONLY_OPTIMAL, its outgoing dependency makes it
+    // readable here
     renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
     renderPassBeginInfo.pNext = nullptr;
     renderPassBeginInfo.renderPass = frameBuffers.easu.renderPass;
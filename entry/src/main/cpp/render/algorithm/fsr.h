@@ -145,7 +145,7 @@ private:
     void CreatePipelineCache();
     void BuildCommandBuffers(VkCommandBuffer cmdBuffer);
     VkPipelineShaderStageCreateInfo LoadShader(std::string fileName, VkShaderStageFlagBits stage);
-    std::string GetShadersPath() const;
+    std::string GetShaderFile(const std::string &name) const;
     VkFormat m_format;
     VkPhysicalDevice m_physicalDevice;
     VkDevice m_device;
@@ -0,0 +1,371 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fsr_cpu.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include "simd_vec4.h"
+
+namespace {
+constexpr uint32_t TILE_SIZE = 64;
+constexpr float EASU_DIR_EPSILON = 1.0f / 32768.0f;
+constexpr float RCAS_LIMIT = 0.25f - (1.0f / 16.0f);
+
+using simd::Vec4;
+
+inline float Luma(const float *c)
+{
+    return c[2] * 0.5f + (c[0] * 0.5f + c[1]);
+}
+
+inline float Saturate(float x)
+{
+    return std::min(1.0f, std::max(0.0f, x));
+}
+
+inline float Rcp(float x)
+{
+    return x != 0.0f ? 1.0f / x : 0.0f;
+}
+
+inline float AsFloat(uint32_t u)
+{
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+inline uint32_t AsUint(float f)
+{
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+// Bit tricks of APrxLoRcpF1, APrxLoRsqF1 and APrxMedRcpF1, the shaders use them instead of exact divides.
+inline float PrxLoRcp(float a)
+{
+    return AsFloat(0x7ef07ebbu - AsUint(a));
+}
+
+inline float PrxLoRsq(float a)
+{
+    return AsFloat(0x5f347d74u - (AsUint(a) >> 1));
+}
+
+inline float PrxMedRcp(float a)
+{
+    float b = AsFloat(0x7ef19fffu - AsUint(a));
+    return b * (-b * a + 2.0f);
+}
+
+// Accumulates direction and edge length for one bilinear corner, see FsrEasuSetF.
+inline void EasuSet(float &dirX, float &dirY, float &len, float w, float lA, float lB, float lC, float lD, float lE)
+{
+    float lenX = PrxLoRcp(std::max(std::fabs(lD - lC), std::fabs(lC - lB)));
+    float dx = lD - lB;
+    dirX += dx * w;
+    lenX = Saturate(std::fabs(dx) * lenX);
+    len += lenX * lenX * w;
+
+    float lenY = PrxLoRcp(std::max(std::fabs(lE - lC), std::fabs(lC - lA)));
+    float dy = lE - lA;
+    dirY += dy * w;
+    lenY = Saturate(std::fabs(dy) * lenY);
+    len += lenY * lenY * w;
+}
+
+// Filters one tap with the approximated lanczos2 kernel, see FsrEasuTapF.
+inline void EasuTap(Vec4 &aC, float &aW, float offX, float offY, float dirX, float dirY, float len2X, float len2Y,
+    float lob, float clp, const float *c)
+{
+    float vx = (offX * dirX + offY * dirY) * len2X;
+    float vy = (offX * -dirY + offY * dirX) * len2Y;
+    float d2 = std::min(vx * vx + vy * vy, clp);
+    float wB = 2.0f / 5.0f * d2 - 1.0f;
+    float wA = lob * d2 - 1.0f;
+    wB *= wB;
+    wA *= wA;
+    wB = 25.0f / 16.0f * wB - (25.0f / 16.0f - 1.0f);
+    float w = wB * wA;
+    aC = aC.MulAdd(Vec4::Load(c), w);
+    aW += w;
+}
+}
+
+void FSRCpu::Image::FromRGBA8(const uint8_t *data, uint32_t w, uint32_t h)
+{
+    Resize(w, h);
+    const float scale = 1.0f / 255.0f;
+    for (size_t i = 0; i < pixels.size(); i++) {
+        pixels[i] = data[i] * scale;
+    }
+}
+
+void FSRCpu::Image::ToRGBA8(std::vector<uint8_t> &data) const
+{
+    data.resize(pixels.size());
+    for (size_t i = 0; i < pixels.size(); i++) {
+        data[i] = static_cast<uint8_t>(Saturate(pixels[i]) * 255.0f + 0.5f);
+    }
+}
+
+void FSRCpu::Init(const InitParams &initParams)
+{
+    m_inputRegion = initParams.inputRegion;
+    m_outputSize = initParams.outputSize;
+    m_outputRegion = initParams.outputRegion;
+    m_sharpness = initParams.sharpness;
+    m_threadCount = initParams.threadCount;
+    if (m_threadCount == 0) {
+        m_threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+bool FSRCpu::Upscale(const Image &input, Image &output)
+{
+    if (m_inputRegion.extent.width == 0 || m_inputRegion.extent.height == 0 ||
+        m_outputRegion.extent.width == 0 || m_outputRegion.extent.height == 0) {
+        m_error = "invalid region, call Init first";
+        return false;
+    }
+    if (m_inputRegion.offset.x < 0 || m_inputRegion.offset.y < 0 ||
+        m_inputRegion.offset.x + m_inputRegion.extent.width > input.width ||
+        m_inputRegion.offset.y + m_inputRegion.extent.height > input.height) {
+        m_error = "input region out of image " + std::to_string(input.width) + " x " +
+            std::to_string(input.height);
+        return false;
+    }
+    if (m_outputRegion.offset.x < 0 || m_outputRegion.offset.y < 0 ||
+        m_outputRegion.offset.x + m_outputRegion.extent.width > m_outputSize.width ||
+        m_outputRegion.offset.y + m_outputRegion.extent.height > m_outputSize.height) {
+        m_error = "output region out of output size";
+        return false;
+    }
+    m_error.clear();
+    m_input = &input;
+    m_output = &output;
+    m_easu.Resize(m_outputSize.width, m_outputSize.height);
+    output.Resize(m_outputSize.width, m_outputSize.height);
+    // RCAS samples EASU neighbours, so the passes are separated by the join in RunTiles.
+    RunTiles(m_outputRegion.extent.width, m_outputRegion.extent.height, &FSRCpu::EASUTile);
+    RunTiles(m_outputRegion.extent.width, m_outputRegion.extent.height, &FSRCpu::RCASTile);
+    m_input = nullptr;
+    m_output = nullptr;
+    return true;
+}
+
+bool FSRCpu::UpscaleRGBA8(const uint8_t *input, uint32_t width, uint32_t height, std::vector<uint8_t> &output)
+{
+    Image in;
+    Image out;
+    in.FromRGBA8(input, width, height);
+    if (!Upscale(in, out)) {
+        return false;
+    }
+    out.ToRGBA8(output);
+    return true;
+}
+
+void FSRCpu::RunTiles(uint32_t width, uint32_t height,
+    void (FSRCpu::*kernel)(uint32_t, uint32_t, uint32_t, uint32_t))
+{
+    uint32_t tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    uint32_t tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    uint32_t tileCount = tilesX * tilesY;
+    std::atomic<uint32_t> next(0);
+    auto worker = [&]() {
+        for (uint32_t tile = next++; tile < tileCount; tile = next++) {
+            uint32_t x0 = (tile % tilesX) * TILE_SIZE;
+            uint32_t y0 = (tile / tilesX) * TILE_SIZE;
+            (this->*kernel)(x0, y0, std::min(x0 + TILE_SIZE, width), std::min(y0 + TILE_SIZE, height));
+        }
+    };
+    // Each thread pulls tiles until none are left, so slow cores simply take fewer tiles
+    uint32_t threads = std::min(m_threadCount, tileCount);
+    std::vector<std::thread> helpers;
+    for (uint32_t i = 1; i < threads; i++) {
+        helpers.emplace_back(worker);
+    }
+    worker();
+    for (std::thread &helper : helpers) {
+        helper.join();
+    }
+}
+
+void FSRCpu::EASUTile(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1)
+{
+    const Image &in = *m_input;
+    const float scaleX = static_cast<float>(m_inputRegion.extent.width) / m_outputRegion.extent.width;
+    const float scaleY = static_cast<float>(m_inputRegion.extent.height) / m_outputRegion.extent.height;
+    const int32_t minX = m_inputRegion.offset.x;
+    const int32_t minY = m_inputRegion.offset.y;
+    // Texels around the region are real neighbours, the shader's clamp-to-edge sampler only stops at the image
+    const int32_t maxX = static_cast<int32_t>(in.width) - 1;
+    const int32_t maxY = static_cast<int32_t>(in.height) - 1;
+    auto fetch = [&](int32_t x, int32_t y) {
+        return in.At(std::min(std::max(x, 0), maxX), std::min(std::max(y, 0), maxY));
+    };
+
+    for (uint32_t y = y0; y < y1; y++) {
+        for (uint32_t x = x0; x < x1; x++) {
+            float ppX = (x + 0.5f) * scaleX - 0.5f;
+            float ppY = (y + 0.5f) * scaleY - 0.5f;
+            float fpX = std::floor(ppX);
+            float fpY = std::floor(ppY);
+            ppX -= fpX;
+            ppY -= fpY;
+            int32_t ix = minX + static_cast<int32_t>(fpX);
+            int32_t iy = minY + static_cast<int32_t>(fpY);
+
+            //    b c
+            //  e f g h
+            //  i j k l
+            //    n o
+            const float *b = fetch(ix, iy - 1);
+            const float *c = fetch(ix + 1, iy - 1);
+            const float *e = fetch(ix - 1, iy);
+            const float *f = fetch(ix, iy);
+            const float *g = fetch(ix + 1, iy);
+            const float *h = fetch(ix + 2, iy);
+            const float *i = fetch(ix - 1, iy + 1);
+            const float *j = fetch(ix, iy + 1);
+            const float *k = fetch(ix + 1, iy + 1);
+            const float *l = fetch(ix + 2, iy + 1);
+            const float *n = fetch(ix, iy + 2);
+            const float *o = fetch(ix + 1, iy + 2);
+
+            float bL = Luma(b);
+            float cL = Luma(c);
+            float eL = Luma(e);
+            float fL = Luma(f);
+            float gL = Luma(g);
+            float hL = Luma(h);
+            float iL = Luma(i);
+            float jL = Luma(j);
+            float kL = Luma(k);
+            float lL = Luma(l);
+            float nL = Luma(n);
+            float oL = Luma(o);
+
+            float dirX = 0.0f;
+            float dirY = 0.0f;
+            float len = 0.0f;
+            EasuSet(dirX, dirY, len, (1.0f - ppX) * (1.0f - ppY), bL, eL, fL, gL, jL);
+            EasuSet(dirX, dirY, len, ppX * (1.0f - ppY), cL, fL, gL, hL, kL);
+            EasuSet(dirX, dirY, len, (1.0f - ppX) * ppY, fL, iL, jL, kL, nL);
+            EasuSet(dirX, dirY, len, ppX * ppY, gL, jL, kL, lL, oL);
+
+            float dirR = dirX * dirX + dirY * dirY;
+            bool zero = dirR < EASU_DIR_EPSILON;
+            dirR = zero ? 1.0f : PrxLoRsq(dirR);
+            dirX = zero ? 1.0f : dirX;
+            dirX *= dirR;
+            dirY *= dirR;
+            len = len * 0.5f;
+            len *= len;
+            float stretch = (dirX * dirX + dirY * dirY) * PrxLoRcp(std::max(std::fabs(dirX), std::fabs(dirY)));
+            float len2X = 1.0f + (stretch - 1.0f) * len;
+            float len2Y = 1.0f - 0.5f * len;
+            float lob = 0.5f + ((1.0f / 4.0f - 0.04f) - 0.5f) * len;
+            float clp = PrxLoRcp(lob);
+
+            Vec4 aC = Vec4::Splat(0.0f);
+            float aW = 0.0f;
+            EasuTap(aC, aW, 0.0f - ppX, -1.0f - ppY, dirX, dirY, len2X, len2Y, lob, clp, b);
+            EasuTap(aC, aW, 1.0f - ppX, -1.0f - ppY, dirX, dirY, len2X, len2Y, lob, clp, c);
+            EasuTap(aC, aW, -1.0f - ppX, 1.0f - ppY, dirX, dirY, len2X, len2Y, lob, clp, i);
+            EasuTap(aC, aW, 0.0f - ppX, 1.0f - ppY, dirX, dirY, len2X, len2Y, lob, clp, j);
+            EasuTap(aC, aW, 0.0f - ppX, 0.0f - ppY, dirX, dirY, len2X, len2Y, lob, clp, f);
+            EasuTap(aC, aW, -1.0f - ppX, 0.0f - ppY, dirX, dirY, len2X, len2Y, lob, clp, e);
+            EasuTap(aC, aW, 1.0f - ppX, 1.0f - ppY, dirX, dirY, len2X, len2Y, lob, clp, k);
+            EasuTap(aC, aW, 2.0f - ppX, 1.0f - ppY, dirX, dirY, len2X, len2Y, lob, clp, l);
+            EasuTap(aC, aW, 2.0f - ppX, 0.0f - ppY, dirX, dirY, len2X, len2Y, lob, clp, h);
+            EasuTap(aC, aW, 1.0f - ppX, 0.0f - ppY, dirX, dirY, len2X, len2Y, lob, clp, g);
+            EasuTap(aC, aW, 1.0f - ppX, 2.0f - ppY, dirX, dirY, len2X, len2Y, lob, clp, o);
+            EasuTap(aC, aW, 0.0f - ppX, 2.0f - ppY, dirX, dirY, len2X, len2Y, lob, clp, n);
+
+            // Dering against the four nearest texels.
+            Vec4 vf = Vec4::Load(f);
+            Vec4 vg = Vec4::Load(g);
+            Vec4 vj = Vec4::Load(j);
+            Vec4 vk = Vec4::Load(k);
+            Vec4 min4 = Vec4::Min(Vec4::Min(vf, vg), Vec4::Min(vj, vk));
+            Vec4 max4 = Vec4::Max(Vec4::Max(vf, vg), Vec4::Max(vj, vk));
+            Vec4 result = Vec4::Min(max4, Vec4::Max(min4, aC * Vec4::Splat(Rcp(aW))));
+            result.Store(m_easu.At(m_outputRegion.offset.x + x, m_outputRegion.offset.y + y));
+        }
+    }
+}
+
+void FSRCpu::RCASTile(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1)
+{
+    // FSR hands sharpness to the shader as the lobe scale itself, not in stops like FsrRcasCon
+    const float con = m_sharpness;
+    const int32_t minX = m_outputRegion.offset.x;
+    const int32_t minY = m_outputRegion.offset.y;
+    const int32_t maxX = minX + static_cast<int32_t>(m_outputRegion.extent.width) - 1;
+    const int32_t maxY = minY + static_cast<int32_t>(m_outputRegion.extent.height) - 1;
+    auto fetch = [&](int32_t x, int32_t y) {
+        return Vec4::Load(m_easu.At(std::min(std::max(x, minX), maxX), std::min(std::max(y, minY), maxY)));
+    };
+    auto luma = [](const Vec4 &c) { return c.Lane(2) * 0.5f + (c.Lane(0) * 0.5f + c.Lane(1)); };
+
+    for (uint32_t y = y0; y < y1; y++) {
+        for (uint32_t x = x0; x < x1; x++) {
+            int32_t px = minX + static_cast<int32_t>(x);
+            int32_t py = minY + static_cast<int32_t>(y);
+            //    b
+            //  d e f
+            //    h
+            Vec4 b = fetch(px, py - 1);
+            Vec4 d = fetch(px - 1, py);
+            Vec4 e = fetch(px, py);
+            Vec4 f = fetch(px + 1, py);
+            Vec4 h = fetch(px, py + 1);
+
+            // Noise detection, see FSR_RCAS_DENOISE
+            float bL = luma(b);
+            float dL = luma(d);
+            float eL = luma(e);
+            float fL = luma(f);
+            float hL = luma(h);
+            float nz = 0.25f * bL + 0.25f * dL + 0.25f * fL + 0.25f * hL - eL;
+            float rangeL = std::max(std::max(std::max(bL, dL), std::max(eL, fL)), hL) -
+                std::min(std::min(std::min(bL, dL), std::min(eL, fL)), hL);
+            nz = -0.5f * Saturate(std::fabs(nz) * PrxMedRcp(rangeL)) + 1.0f;
+
+            Vec4 mn4 = Vec4::Min(Vec4::Min(b, d), Vec4::Min(f, h));
+            Vec4 mx4 = Vec4::Max(Vec4::Max(b, d), Vec4::Max(f, h));
+            float lobeRGB = -1.0f;
+            for (int ch = 0; ch < 3; ch++) {
+                float hitMin = mn4.Lane(ch) * Rcp(4.0f * mx4.Lane(ch));
+                float hitMax = (1.0f - mx4.Lane(ch)) * Rcp(4.0f * mn4.Lane(ch) - 4.0f);
+                lobeRGB = std::max(lobeRGB, std::max(-hitMin, hitMax));
+            }
+            float lobe = std::max(-RCAS_LIMIT, std::min(lobeRGB, 0.0f)) * con * nz;
+            float rcpL = PrxMedRcp(4.0f * lobe + 1.0f);
+            Vec4 l = Vec4::Splat(lobe);
+            Vec4 sum = l * b + l * d + l * h + l * f + e;
+            Vec4 result = sum * Vec4::Splat(rcpL);
+            float *dst = m_output->At(px, py);
+            result.Store(dst);
+            dst[3] = e.Lane(3);
+        }
+    }
+}
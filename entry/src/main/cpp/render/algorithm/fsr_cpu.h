@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RENDER_ALGORITHM_FSR_CPU_H
+#define RENDER_ALGORITHM_FSR_CPU_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// CPU reference of the EASU + RCAS passes run by FSR. It takes the same region/size/sharpness contract as
+// FSR::InitParams so a GPU readback can be compared against it. It depends on neither Vulkan nor the app
+// runtime, so it also builds as a standalone library for offline upscaling.
+class FSRCpu {
+public:
+    // Same layout as VkOffset2D, VkExtent2D and VkRect2D
+    struct Offset {
+        int32_t x = 0;
+        int32_t y = 0;
+    };
+    struct Extent {
+        uint32_t width = 0;
+        uint32_t height = 0;
+    };
+    struct Rect {
+        Offset offset;
+        Extent extent;
+    };
+
+    struct InitParams {
+        Rect inputRegion;
+        Extent outputSize;
+        Rect outputRegion;
+        float sharpness = 0.0f; // RCAS lobe scale passed to rcas.frag as is, 0 disables sharpening
+        uint32_t threadCount = 0; // concurrent threads, 0 means one per hardware thread
+    };
+
+    // Linear RGBA float image, row major, 4 floats per pixel.
+    struct Image {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<float> pixels;
+        void Resize(uint32_t w, uint32_t h)
+        {
+            width = w;
+            height = h;
+            pixels.assign(static_cast<size_t>(w) * h * 4, 0.0f);
+        }
+        float *At(uint32_t x, uint32_t y)
+        {
+            return pixels.data() + (static_cast<size_t>(y) * width + x) * 4;
+        }
+        const float *At(uint32_t x, uint32_t y) const
+        {
+            return pixels.data() + (static_cast<size_t>(y) * width + x) * 4;
+        }
+        void FromRGBA8(const uint8_t *data, uint32_t w, uint32_t h);
+        void ToRGBA8(std::vector<uint8_t> &data) const;
+    };
+
+    FSRCpu() {}
+    ~FSRCpu() {}
+
+    void Init(const InitParams &initParams);
+    // Runs EASU into an intermediate image of outputSize, then RCAS into output.
+    bool Upscale(const Image &input, Image &output);
+    bool UpscaleRGBA8(const uint8_t *input, uint32_t width, uint32_t height, std::vector<uint8_t> &output);
+
+    const Image &GetEASUResult() const { return m_easu; }
+    // Why the last Upscale returned false, empty after a successful one.
+    const std::string &GetError() const { return m_error; }
+
+private:
+    void RunTiles(uint32_t width, uint32_t height, void (FSRCpu::*kernel)(uint32_t, uint32_t, uint32_t, uint32_t));
+    void EASUTile(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1);
+    void RCASTile(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1);
+
+    Rect m_inputRegion = {};
+    Extent m_outputSize = {};
+    Rect m_outputRegion = {};
+    float m_sharpness = 0.0f;
+    uint32_t m_threadCount = 1;
+
+    const Image *m_input = nullptr;
+    Image *m_output = nullptr;
+    Image m_easu;
+    std::string m_error;
+};
+#endif // RENDER_ALGORITHM_FSR_CPU_H
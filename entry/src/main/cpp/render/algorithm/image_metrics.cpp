@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "image_metrics.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include "simd_vec4.h"
+
+namespace {
+using simd::Vec4;
+
+constexpr uint32_t SSIM_WINDOW = 8;
+constexpr uint32_t SSIM_STRIDE = 4;
+constexpr double SSIM_C1 = 0.01 * 0.01;
+constexpr double SSIM_C2 = 0.03 * 0.03;
+constexpr double PSNR_MAX = 100.0;
+
+inline float SrgbToLinear(float c)
+{
+    return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+inline float LabF(float t)
+{
+    const float delta = 6.0f / 29.0f;
+    return t > delta * delta * delta ? std::cbrt(t) : t / (3.0f * delta * delta) + 4.0f / 29.0f;
+}
+
+// D65 white point.
+inline void RgbToLab(const float *rgb, float *lab)
+{
+    float r = SrgbToLinear(rgb[0]);
+    float g = SrgbToLinear(rgb[1]);
+    float b = SrgbToLinear(rgb[2]);
+    float x = (0.4124f * r + 0.3576f * g + 0.1805f * b) / 0.9505f;
+    float y = 0.2126f * r + 0.7152f * g + 0.0722f * b;
+    float z = (0.0193f * r + 0.1192f * g + 0.9505f * b) / 1.089f;
+    float fx = LabF(x);
+    float fy = LabF(y);
+    float fz = LabF(z);
+    lab[0] = 116.0f * fy - 16.0f;
+    lab[1] = 500.0f * (fx - fy);
+    lab[2] = 200.0f * (fy - fz);
+}
+
+// 3x3 binomial blur standing in for the contrast sensitivity filter of perceptual metrics.
+void Prefilter(const float *src, float *dst, uint32_t width, uint32_t height, uint32_t y0, uint32_t y1)
+{
+    const float weights[3] = {0.25f, 0.5f, 0.25f};
+    for (uint32_t y = y0; y < y1; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            Vec4 acc = Vec4::Splat(0.0f);
+            for (int dy = -1; dy <= 1; dy++) {
+                uint32_t sy = static_cast<uint32_t>(std::min(std::max(static_cast<int32_t>(y) + dy, 0),
+                    static_cast<int32_t>(height) - 1));
+                for (int dx = -1; dx <= 1; dx++) {
+                    uint32_t sx = static_cast<uint32_t>(std::min(std::max(static_cast<int32_t>(x) + dx, 0),
+                        static_cast<int32_t>(width) - 1));
+                    acc = acc.MulAdd(Vec4::Load(src + (static_cast<size_t>(sy) * width + sx) * 4),
+                        weights[dy + 1] * weights[dx + 1]);
+                }
+            }
+            acc.Store(dst + (static_cast<size_t>(y) * width + x) * 4);
+        }
+    }
+}
+}
+
+ImageMetrics::ImageMetrics(uint32_t threadCount) : m_threadCount(threadCount)
+{
+    if (m_threadCount == 0) {
+        m_threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+template <typename Fn>
+double ImageMetrics::ParallelRows(uint32_t rows, Fn &&fn)
+{
+    uint32_t bands = std::max(1u, std::min(m_threadCount, rows));
+    std::vector<double> partial(bands, 0.0);
+    std::vector<std::thread> pool;
+    uint32_t step = (rows + bands - 1) / bands;
+    for (uint32_t i = 0; i < bands; i++) {
+        uint32_t begin = std::min(rows, i * step);
+        uint32_t end = std::min(rows, begin + step);
+        if (i + 1 == bands) {
+            partial[i] = fn(begin, end);
+        } else {
+            pool.emplace_back([&partial, &fn, i, begin, end]() { partial[i] = fn(begin, end); });
+        }
+    }
+    for (auto &thread : pool) {
+        thread.join();
+    }
+    double sum = 0.0;
+    for (double value : partial) {
+        sum += value;
+    }
+    return sum;
+}
+
+bool ImageMetrics::Compare(const std::vector<uint8_t> &reference, const std::vector<uint8_t> &test, uint32_t width,
+    uint32_t height, Result &result)
+{
+    size_t pixelCount = static_cast<size_t>(width) * height;
+    if (pixelCount == 0 || reference.size() < pixelCount * 4 || test.size() < pixelCount * 4) {
+        return false;
+    }
+
+    std::vector<float> ref(pixelCount * 4);
+    std::vector<float> tst(pixelCount * 4);
+    std::vector<float> refLuma(pixelCount);
+    std::vector<float> tstLuma(pixelCount);
+    ParallelRows(height, [&](uint32_t y0, uint32_t y1) {
+        const float scale = 1.0f / 255.0f;
+        for (size_t i = static_cast<size_t>(y0) * width; i < static_cast<size_t>(y1) * width; i++) {
+            for (int c = 0; c < 4; c++) {
+                ref[i * 4 + c] = reference[i * 4 + c] * scale;
+                tst[i * 4 + c] = test[i * 4 + c] * scale;
+            }
+            refLuma[i] = 0.299f * ref[i * 4] + 0.587f * ref[i * 4 + 1] + 0.114f * ref[i * 4 + 2];
+            tstLuma[i] = 0.299f * tst[i * 4] + 0.587f * tst[i * 4 + 1] + 0.114f * tst[i * 4 + 2];
+        }
+        return 0.0;
+    });
+
+    result.psnr = PSNR(ref.data(), tst.data(), width, height);
+    result.ssim = SSIM(refLuma.data(), tstLuma.data(), width, height);
+    result.perceptual = Perceptual(ref.data(), tst.data(), width, height);
+    return true;
+}
+
+double ImageMetrics::PSNR(const float *ref, const float *test, uint32_t width, uint32_t height)
+{
+    // Alpha is masked out so only RGB contributes to the error.
+    const float rgbMask[4] = {1.0f, 1.0f, 1.0f, 0.0f};
+    const Vec4 mask = Vec4::Load(rgbMask);
+    double sum = ParallelRows(height, [&](uint32_t y0, uint32_t y1) {
+        double bandSum = 0.0;
+        for (uint32_t y = y0; y < y1; y++) {
+            Vec4 acc = Vec4::Splat(0.0f);
+            const float *r = ref + static_cast<size_t>(y) * width * 4;
+            const float *t = test + static_cast<size_t>(y) * width * 4;
+            for (uint32_t x = 0; x < width; x++) {
+                Vec4 d = (Vec4::Load(r + x * 4) - Vec4::Load(t + x * 4)) * mask;
+                acc = acc + d * d;
+            }
+            bandSum += acc.Sum();
+        }
+        return bandSum;
+    });
+    double mse = sum / (static_cast<double>(width) * height * 3.0);
+    if (mse <= 0.0) {
+        return PSNR_MAX;
+    }
+    return std::min(PSNR_MAX, 10.0 * std::log10(1.0 / mse));
+}
+
+double ImageMetrics::SSIM(const float *refLuma, const float *testLuma, uint32_t width, uint32_t height)
+{
+    if (width < SSIM_WINDOW || height < SSIM_WINDOW) {
+        return 0.0;
+    }
+    uint32_t windowsX = (width - SSIM_WINDOW) / SSIM_STRIDE + 1;
+    uint32_t windowsY = (height - SSIM_WINDOW) / SSIM_STRIDE + 1;
+    const double n = SSIM_WINDOW * SSIM_WINDOW;
+    double sum = ParallelRows(windowsY, [&](uint32_t wy0, uint32_t wy1) {
+        double bandSum = 0.0;
+        for (uint32_t wy = wy0; wy < wy1; wy++) {
+            for (uint32_t wx = 0; wx < windowsX; wx++) {
+                Vec4 sa = Vec4::Splat(0.0f);
+                Vec4 sb = Vec4::Splat(0.0f);
+                Vec4 saa = Vec4::Splat(0.0f);
+                Vec4 sbb = Vec4::Splat(0.0f);
+                Vec4 sab = Vec4::Splat(0.0f);
+                for (uint32_t row = 0; row < SSIM_WINDOW; row++) {
+                    size_t offset = static_cast<size_t>(wy * SSIM_STRIDE + row) * width + wx * SSIM_STRIDE;
+                    for (uint32_t col = 0; col < SSIM_WINDOW; col += 4) {
+                        Vec4 a = Vec4::Load(refLuma + offset + col);
+                        Vec4 b = Vec4::Load(testLuma + offset + col);
+                        sa = sa + a;
+                        sb = sb + b;
+                        saa = saa + a * a;
+                        sbb = sbb + b * b;
+                        sab = sab + a * b;
+                    }
+                }
+                double muA = sa.Sum() / n;
+                double muB = sb.Sum() / n;
+                double varA = saa.Sum() / n - muA * muA;
+                double varB = sbb.Sum() / n - muB * muB;
+                double cov = sab.Sum() / n - muA * muB;
+                bandSum += ((2.0 * muA * muB + SSIM_C1) * (2.0 * cov + SSIM_C2)) /
+                    ((muA * muA + muB * muB + SSIM_C1) * (varA + varB + SSIM_C2));
+            }
+        }
+        return bandSum;
+    });
+    return sum / (static_cast<double>(windowsX) * windowsY);
+}
+
+double ImageMetrics::Perceptual(const float *ref, const float *test, uint32_t width, uint32_t height)
+{
+    size_t count = static_cast<size_t>(width) * height * 4;
+    std::vector<float> refFiltered(count);
+    std::vector<float> testFiltered(count);
+    ParallelRows(height, [&](uint32_t y0, uint32_t y1) {
+        Prefilter(ref, refFiltered.data(), width, height, y0, y1);
+        Prefilter(test, testFiltered.data(), width, height, y0, y1);
+        return 0.0;
+    });
+
+    double sum = ParallelRows(height, [&](uint32_t y0, uint32_t y1) {
+        double bandSum = 0.0;
+        float labA[3];
+        float labB[3];
+        for (size_t i = static_cast<size_t>(y0) * width; i < static_cast<size_t>(y1) * width; i++) {
+            RgbToLab(refFiltered.data() + i * 4, labA);
+            RgbToLab(testFiltered.data() + i * 4, labB);
+            float dl = labA[0] - labB[0];
+            float da = labA[1] - labB[1];
+            float db = labA[2] - labB[2];
+            bandSum += std::sqrt(dl * dl + da * da + db * db);
+        }
+        return bandSum;
+    });
+    return sum / (static_cast<double>(width) * height);
+}
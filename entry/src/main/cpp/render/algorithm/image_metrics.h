@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RENDER_ALGORITHM_IMAGE_METRICS_H
+#define RENDER_ALGORITHM_IMAGE_METRICS_H
+
+#include <cstdint>
+#include <vector>
+
+// Full-reference quality metrics between two RGBA8 images of the same size.
+class ImageMetrics {
+public:
+    struct Result {
+        double psnr = 0.0;       // dB over RGB, higher is better
+        double ssim = 0.0;       // mean SSIM of luma over 8x8 windows, 1.0 is identical
+        double perceptual = 0.0; // mean CIELAB delta E after a CSF-like prefilter, lower is better
+    };
+
+    // threadCount 0 means std::thread::hardware_concurrency()
+    explicit ImageMetrics(uint32_t threadCount = 0);
+
+    // Returns false when either image is empty or smaller than width x height
+    bool Compare(const std::vector<uint8_t> &reference, const std::vector<uint8_t> &test, uint32_t width,
+        uint32_t height, Result &result);
+
+    double PSNR(const float *ref, const float *test, uint32_t width, uint32_t height);
+    double SSIM(const float *refLuma, const float *testLuma, uint32_t width, uint32_t height);
+    double Perceptual(const float *ref, const float *test, uint32_t width, uint32_t height);
+
+private:
+    // Splits [0, rows) into one band per thread and returns the sum of fn(begin, end) over the bands.
+    template <typename Fn>
+    double ParallelRows(uint32_t rows, Fn &&fn);
+    uint32_t m_threadCount;
+};
+#endif // RENDER_ALGORITHM_IMAGE_METRICS_H
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "shading_rate_stats.h"
+#include "adaptive_vrs_cpu.h"
+
+void ShadingRateStats::Compute(const uint8_t *rates, uint32_t rateWidth, uint32_t rateHeight)
+{
+    width = rateWidth;
+    height = rateHeight;
+    tiles = rateWidth * rateHeight;
+    for (uint32_t i = 0; i < SHADING_RATE_COUNT; i++) {
+        histogram[i] = 0;
+    }
+    for (uint32_t i = 0; i < tiles; i++) {
+        histogram[rates[i] & (SHADING_RATE_COUNT - 1)]++;
+    }
+
+    // A tile shaded at w x h runs one invocation per w * h pixels
+    double invocations = 0.0;
+    for (uint32_t rate = 0; rate < SHADING_RATE_COUNT; rate++) {
+        uint32_t fragmentWidth;
+        uint32_t fragmentHeight;
+        AdaptiveVRSCpu::DecodeRate(static_cast<uint8_t>(rate), fragmentWidth, fragmentHeight);
+        invocations += static_cast<double>(histogram[rate]) / (fragmentWidth * fragmentHeight);
+    }
+    estimatedSavings = tiles > 0 ? 1.0 - invocations / tiles : 0.0;
+}
+
+std::string ShadingRateStats::RateName(uint32_t rate)
+{
+    uint32_t fragmentWidth;
+    uint32_t fragmentHeight;
+    AdaptiveVRSCpu::DecodeRate(static_cast<uint8_t>(rate), fragmentWidth, fragmentHeight);
+    return std::to_string(fragmentWidth) + "x" + std::to_string(fragmentHeight);
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RENDER_ALGORITHM_SHADING_RATE_STATS_H
+#define RENDER_ALGORITHM_SHADING_RATE_STATS_H
+
+#include <cstdint>
+#include <string>
+
+#define SHADING_RATE_COUNT 16 // every (log2 width << 2) | log2 height value of an R8_UINT shading rate texel
+
+// Rate histogram of a shading rate image and the fragment work it saves compared to shading every pixel.
+struct ShadingRateStats {
+    uint64_t frame = 0;
+    uint32_t width = 0;  // shading rate image texels
+    uint32_t height = 0;
+    uint32_t tiles = 0;
+    uint32_t histogram[SHADING_RATE_COUNT] = {};
+    // Fraction of fragment invocations saved, assuming every tile is fully covered
+    double estimatedSavings = 0.0;
+    // Fragment shader invocations of the G-Buffer and light passes from a pipeline statistics query, 0 if
+    // the device does not support it
+    uint64_t gBufferInvocations = 0;
+    uint64_t lightInvocations = 0;
+
+    // Replaces the histogram and estimate with those of rates, tightly packed rows of width texels
+    void Compute(const uint8_t *rates, uint32_t rateWidth, uint32_t rateHeight);
+    // "1x1", "2x4", ... for a histogram index
+    static std::string RateName(uint32_t rate);
+};
+#endif // RENDER_ALGORITHM_SHADING_RATE_STATS_H
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RENDER_ALGORITHM_SIMD_VEC4_H
+#define RENDER_ALGORITHM_SIMD_VEC4_H
+
+#include <algorithm>
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SIMD_VEC4_NEON 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SIMD_VEC4_SSE 1
+#endif
+
+namespace simd {
+// Four float lanes; the CPU image kernels go through it so NEON, SSE2 and the scalar path stay identical.
+struct Vec4 {
+#if defined(SIMD_VEC4_NEON)
+    float32x4_t v;
+    static Vec4 Load(const float *p) { return {vld1q_f32(p)}; }
+    static Vec4 Splat(float s) { return {vdupq_n_f32(s)}; }
+    void Store(float *p) const { vst1q_f32(p, v); }
+    Vec4 operator+(Vec4 o) const { return {vaddq_f32(v, o.v)}; }
+    Vec4 operator-(Vec4 o) const { return {vsubq_f32(v, o.v)}; }
+    Vec4 operator*(Vec4 o) const { return {vmulq_f32(v, o.v)}; }
+    Vec4 MulAdd(Vec4 a, float s) const { return {vmlaq_n_f32(v, a.v, s)}; }
+    static Vec4 Min(Vec4 a, Vec4 b) { return {vminq_f32(a.v, b.v)}; }
+    static Vec4 Max(Vec4 a, Vec4 b) { return {vmaxq_f32(a.v, b.v)}; }
+#elif defined(SIMD_VEC4_SSE)
+    __m128 v;
+    static Vec4 Load(const float *p) { return {_mm_loadu_ps(p)}; }
+    static Vec4 Splat(float s) { return {_mm_set1_ps(s)}; }
+    void Store(float *p) const { _mm_storeu_ps(p, v); }
+    Vec4 operator+(Vec4 o) const { return {_mm_add_ps(v, o.v)}; }
+    Vec4 operator-(Vec4 o) const { return {_mm_sub_ps(v, o.v)}; }
+    Vec4 operator*(Vec4 o) const { return {_mm_mul_ps(v, o.v)}; }
+    Vec4 MulAdd(Vec4 a, float s) const { return {_mm_add_ps(v, _mm_mul_ps(a.v, _mm_set1_ps(s)))}; }
+    static Vec4 Min(Vec4 a, Vec4 b) { return {_mm_min_ps(a.v, b.v)}; }
+    static Vec4 Max(Vec4 a, Vec4 b) { return {_mm_max_ps(a.v, b.v)}; }
+#else
+    float v[4];
+    static Vec4 Load(const float *p) { return {{p[0], p[1], p[2], p[3]}}; }
+    static Vec4 Splat(float s) { return {{s, s, s, s}}; }
+    void Store(float *p) const { std::copy(v, v + 4, p); }
+    Vec4 operator+(Vec4 o) const { return {{v[0] + o.v[0], v[1] + o.v[1], v[2] + o.v[2], v[3] + o.v[3]}}; }
+    Vec4 operator-(Vec4 o) const { return {{v[0] - o.v[0], v[1] - o.v[1], v[2] - o.v[2], v[3] - o.v[3]}}; }
+    Vec4 operator*(Vec4 o) const { return {{v[0] * o.v[0], v[1] * o.v[1], v[2] * o.v[2], v[3] * o.v[3]}}; }
+    Vec4 MulAdd(Vec4 a, float s) const
+    {
+        return {{v[0] + a.v[0] * s, v[1] + a.v[1] * s, v[2] + a.v[2] * s, v[3] + a.v[3] * s}};
+    }
+    static Vec4 Min(Vec4 a, Vec4 b)
+    {
+        return {{std::min(a.v[0], b.v[0]), std::min(a.v[1], b.v[1]), std::min(a.v[2], b.v[2]),
+            std::min(a.v[3], b.v[3])}};
+    }
+    static Vec4 Max(Vec4 a, Vec4 b)
+    {
+        return {{std::max(a.v[0], b.v[0]), std::max(a.v[1], b.v[1]), std::max(a.v[2], b.v[2]),
+            std::max(a.v[3], b.v[3])}};
+    }
+#endif
+    float Lane(int i) const
+    {
+        float tmp[4];
+        Store(tmp);
+        return tmp[i];
+    }
+    float Sum() const
+    {
+        float tmp[4];
+        Store(tmp);
+        return (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+    }
+};
+}
+#endif // RENDER_ALGORITHM_SIMD_VEC4_H
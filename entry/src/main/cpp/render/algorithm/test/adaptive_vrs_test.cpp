@@ -0,0 +1,328 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <set>
+#include <vector>
+#include <gtest/gtest.h>
+#include "adaptive_vrs_cpu.h"
+#ifdef ALGORITHM_TEST_VULKAN
+#include "vulkan_test_device.h"
+#endif
+
+namespace {
+constexpr uint32_t WIDTH = 512;
+constexpr uint32_t HEIGHT = 384;
+constexpr uint32_t TILE_SIZE = 16;
+constexpr float SENSITIVITY = 0.5f;
+
+AdaptiveVRSCpu MakeGenerator(uint32_t maxFragmentSize)
+{
+    AdaptiveVRSCpu generator;
+    AdaptiveVRSCpu::InitParams params = { WIDTH, HEIGHT, TILE_SIZE, SENSITIVITY, maxFragmentSize, maxFragmentSize };
+    generator.Init(params);
+    return generator;
+}
+}
+
+TEST(AdaptiveVRSCpuTest, EncodeDecodeRoundTrip)
+{
+    for (uint32_t w = 1; w <= 4; w *= 2) {
+        for (uint32_t h = 1; h <= 4; h *= 2) {
+            uint32_t width = 0;
+            uint32_t height = 0;
+            AdaptiveVRSCpu::DecodeRate(AdaptiveVRSCpu::EncodeRate(w, h), width, height);
+            EXPECT_EQ(width, w);
+            EXPECT_EQ(height, h);
+        }
+    }
+    EXPECT_EQ(AdaptiveVRSCpu::EncodeRate(2, 4), 6);
+}
+
+TEST(AdaptiveVRSCpuTest, FlatImageUsesCoarsestAllowedRate)
+{
+    std::vector<uint8_t> color(static_cast<size_t>(WIDTH) * HEIGHT * 4, 128);
+    std::vector<float> depth(static_cast<size_t>(WIDTH) * HEIGHT, 0.5f);
+    std::vector<uint8_t> rates;
+    AdaptiveVRSCpu generator = MakeGenerator(2);
+    ASSERT_TRUE(generator.Generate(color.data(), depth.data(), nullptr, rates));
+    ASSERT_EQ(rates.size(), static_cast<size_t>(generator.GetRateWidth()) * generator.GetRateHeight());
+    for (uint8_t rate : rates) {
+        EXPECT_EQ(rate, AdaptiveVRSCpu::EncodeRate(2, 2));
+    }
+}
+
+TEST(AdaptiveVRSCpuTest, StripesKeepFullRateAcrossThem)
+{
+    // Vertical stripes change along x only
+    std::vector<uint8_t> color(static_cast<size_t>(WIDTH) * HEIGHT * 4);
+    for (size_t i = 0; i < color.size() / 4; i++) {
+        uint8_t v = ((i % WIDTH) % 2 == 0) ? 220 : 30;
+        color[i * 4] = v;
+        color[i * 4 + 1] = v;
+        color[i * 4 + 2] = v;
+        color[i * 4 + 3] = 255;
+    }
+    std::vector<float> depth(static_cast<size_t>(WIDTH) * HEIGHT, 0.5f);
+    AdaptiveVRSCpu generator = MakeGenerator(4);
+    AdaptiveVRSCpu::TileStats stats = generator.GatherTile(color.data(), depth.data(), nullptr, 1, 1);
+    EXPECT_GT(stats.errorX, 0.5f);
+    EXPECT_FLOAT_EQ(stats.errorY, 0.0f);
+    // 1x4 is optional, the generator keeps the aspect within 2:1
+    EXPECT_EQ(generator.SelectRate(stats), AdaptiveVRSCpu::EncodeRate(1, 2));
+}
+
+TEST(AdaptiveVRSCpuTest, MotionRaisesThreshold)
+{
+    AdaptiveVRSCpu generator = MakeGenerator(4);
+    AdaptiveVRSCpu::TileStats stats = { 0.5f, 0.01f, 0.06f, 0.06f, 0.0f };
+    uint8_t still = generator.SelectRate(stats);
+    stats.motion = 8.0f;
+    uint8_t moving = generator.SelectRate(stats);
+    uint32_t stillW;
+    uint32_t stillH;
+    uint32_t movingW;
+    uint32_t movingH;
+    AdaptiveVRSCpu::DecodeRate(still, stillW, stillH);
+    AdaptiveVRSCpu::DecodeRate(moving, movingW, movingH);
+    EXPECT_GT(movingW * movingH, stillW * stillH);
+}
+
+TEST(AdaptiveVRSCpuTest, RejectsImagesSmallerThanATile)
+{
+    AdaptiveVRSCpu generator;
+    AdaptiveVRSCpu::InitParams params = { 8, 8, TILE_SIZE, SENSITIVITY, 4, 4 };
+    generator.Init(params);
+    std::vector<uint8_t> color(8 * 8 * 4);
+    std::vector<float> depth(8 * 8);
+    std::vector<uint8_t> rates;
+    EXPECT_FALSE(generator.Generate(color.data(), depth.data(), nullptr, rates));
+}
+
+#ifdef ALGORITHM_TEST_VULKAN
+namespace {
+// The shader reduces in a tree and the CPU in scan order, tiles sitting on a threshold may round differently
+constexpr double MAX_MISMATCH_RATIO = 0.01;
+
+struct Scene {
+    std::vector<uint8_t> color;
+    std::vector<float> depth;
+};
+
+uint8_t ToByte(float v)
+{
+    return static_cast<uint8_t>(std::min(255.0f, std::max(0.0f, v * 255.0f + 0.5f)));
+}
+
+uint32_t Hash(uint32_t v)
+{
+    v ^= v >> 16;
+    v *= 0x7feb352du;
+    v ^= v >> 15;
+    v *= 0x846ca68bu;
+    v ^= v >> 16;
+    return v;
+}
+
+float Unit(uint32_t v)
+{
+    return static_cast<float>(v >> 8) / static_cast<float>(1u << 24);
+}
+
+// Every tile gets its own pattern, brightness, contrast and depth, so the tile errors and the motion boost
+// sweep across the rate thresholds instead of sitting far away from them.
+Scene MakeScene()
+{
+    Scene scene;
+    scene.color.resize(static_cast<size_t>(WIDTH) * HEIGHT * 4);
+    scene.depth.resize(static_cast<size_t>(WIDTH) * HEIGHT);
+    for (uint32_t y = 0; y < HEIGHT; y++) {
+        for (uint32_t x = 0; x < WIDTH; x++) {
+            uint32_t tile = (y / TILE_SIZE) * (WIDTH / TILE_SIZE) + x / TILE_SIZE;
+            uint32_t h = Hash(tile);
+            float mean = 0.1f + 0.7f * Unit(Hash(h));
+            // Up to a tenth of the mean, well past the quarter rate threshold at the top
+            float contrast = mean * 0.1f * Unit(Hash(h + 1));
+            float v;
+            switch (h % 5) {
+                case 0:
+                    v = mean;
+                    break;
+                case 1:
+                    v = mean + contrast * (((x % 2) == 0) ? 1.0f : -1.0f);
+                    break;
+                case 2:
+                    v = mean + contrast * (((y % 2) == 0) ? 1.0f : -1.0f);
+                    break;
+                case 3:
+                    v = mean + contrast * ((((x + y) % 2) == 0) ? 1.0f : -1.0f) * 0.5f;
+                    break;
+                default:
+                    v = mean + contrast * (Unit(Hash(y * WIDTH + x)) * 2.0f - 1.0f);
+                    break;
+            }
+            uint8_t *texel = &scene.color[(static_cast<size_t>(y) * WIDTH + x) * 4];
+            texel[0] = ToByte(v);
+            texel[1] = ToByte(v);
+            texel[2] = ToByte(v);
+            texel[3] = 255;
+            scene.depth[static_cast<size_t>(y) * WIDTH + x] = Unit(Hash(h + 2));
+        }
+    }
+    return scene;
+}
+
+// Column-major transform shifting the previous frame right by up to 12 pixels, further for deeper texels.
+std::vector<float> MakeReprojection()
+{
+    std::vector<float> m(16, 0.0f);
+    m[0] = 1.0f;
+    m[5] = 1.0f;
+    m[10] = 1.0f;
+    m[15] = 1.0f;
+    m[8] = 2.0f * 12.0f / WIDTH;
+    return m;
+}
+
+// Mirrors the push constant block of adaptive_vrs.comp and AdaptiveVRS::PushConstants
+struct PushConstants {
+    float reprojection[16];
+    int32_t inputSize[2];
+    uint32_t tileSize;
+    float errorSensitivity;
+    uint32_t useReprojection;
+    uint32_t maxFragmentWidth;
+    uint32_t maxFragmentHeight;
+};
+static_assert(sizeof(PushConstants) == 92, "push constant layout must match adaptive_vrs.comp");
+
+class AdaptiveVRSShaderTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        if (!m_device.Init()) {
+            GTEST_SKIP() << "no Vulkan device";
+        }
+        if (!m_device.SupportsFormat(VK_FORMAT_R8_UINT, VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT)) {
+            GTEST_SKIP() << "R8_UINT storage images are not supported";
+        }
+    }
+
+    bool Dispatch(const Scene &scene, const float *reprojection, uint32_t maxFragmentSize,
+        std::vector<uint8_t> &rates)
+    {
+        const uint32_t rateWidth = WIDTH / TILE_SIZE;
+        const uint32_t rateHeight = HEIGHT / TILE_SIZE;
+        VulkanTestDevice::Image color = m_device.CreateImage(WIDTH, HEIGHT, VK_FORMAT_R8G8B8A8_UNORM, 4,
+            VK_IMAGE_USAGE_SAMPLED_BIT);
+        VulkanTestDevice::Image depth = m_device.CreateImage(WIDTH, HEIGHT, VK_FORMAT_R32_SFLOAT, 4,
+            VK_IMAGE_USAGE_SAMPLED_BIT);
+        VulkanTestDevice::Image output = m_device.CreateImage(rateWidth, rateHeight, VK_FORMAT_R8_UINT, 1,
+            VK_IMAGE_USAGE_STORAGE_BIT);
+        if (color.image == VK_NULL_HANDLE || depth.image == VK_NULL_HANDLE || output.image == VK_NULL_HANDLE ||
+            !m_device.Upload(color, scene.color.data(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) ||
+            !m_device.Upload(depth, scene.depth.data(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)) {
+            return false;
+        }
+
+        VkShaderModule shader = m_device.LoadShader("algorithm/adaptive_vrs.comp.spv");
+        VkSampler sampler = m_device.CreateSampler(VK_FILTER_NEAREST);
+        VkDescriptorSetLayout setLayout = m_device.CreateDescriptorSetLayout({
+            { 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+            { 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+            { 2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+        });
+        VkPipelineLayout layout =
+            m_device.CreatePipelineLayout(setLayout, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants));
+        if (shader == VK_NULL_HANDLE || layout == VK_NULL_HANDLE) {
+            return false;
+        }
+        VkPipeline pipeline = m_device.CreateComputePipeline(layout, shader);
+        VkDescriptorSet set = m_device.AllocateDescriptorSet(setLayout);
+        if (pipeline == VK_NULL_HANDLE || set == VK_NULL_HANDLE) {
+            return false;
+        }
+        m_device.WriteImage(set, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, sampler, color,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        m_device.WriteImage(set, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, sampler, depth,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        m_device.WriteImage(set, 2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_NULL_HANDLE, output,
+            VK_IMAGE_LAYOUT_GENERAL);
+
+        PushConstants constants = {};
+        if (reprojection != nullptr) {
+            memcpy(constants.reprojection, reprojection, sizeof(constants.reprojection));
+        }
+        constants.inputSize[0] = static_cast<int32_t>(WIDTH);
+        constants.inputSize[1] = static_cast<int32_t>(HEIGHT);
+        constants.tileSize = TILE_SIZE;
+        constants.errorSensitivity = SENSITIVITY;
+        constants.useReprojection = reprojection != nullptr ? 1 : 0;
+        constants.maxFragmentWidth = maxFragmentSize;
+        constants.maxFragmentHeight = maxFragmentSize;
+        bool submitted = m_device.Submit([&](VkCommandBuffer cmdBuffer) {
+            VulkanTestDevice::Transition(cmdBuffer, output, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+            vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+            vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &set, 0, nullptr);
+            vkCmdPushConstants(cmdBuffer, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+            vkCmdDispatch(cmdBuffer, rateWidth, rateHeight, 1);
+        });
+        return submitted && m_device.Download(output, VK_IMAGE_LAYOUT_GENERAL, rates);
+    }
+
+    void Compare(const float *reprojection, uint32_t maxFragmentSize)
+    {
+        Scene scene = MakeScene();
+        std::vector<uint8_t> expected;
+        AdaptiveVRSCpu generator = MakeGenerator(maxFragmentSize);
+        ASSERT_TRUE(generator.Generate(scene.color.data(), scene.depth.data(), reprojection, expected));
+        std::vector<uint8_t> actual;
+        ASSERT_TRUE(Dispatch(scene, reprojection, maxFragmentSize, actual));
+        ASSERT_EQ(actual.size(), expected.size());
+
+        size_t mismatches = 0;
+        for (size_t i = 0; i < expected.size(); i++) {
+            if (actual[i] != expected[i]) {
+                mismatches++;
+            }
+        }
+        EXPECT_LE(mismatches, static_cast<size_t>(expected.size() * MAX_MISMATCH_RATIO))
+            << mismatches << " of " << expected.size() << " tiles differ";
+        // A scene that collapses to one rate would compare equal without exercising the selection
+        std::set<uint8_t> distinct(expected.begin(), expected.end());
+        EXPECT_GE(distinct.size(), 3u);
+    }
+
+    VulkanTestDevice m_device;
+};
+}
+
+TEST_F(AdaptiveVRSShaderTest, MatchesCpuReference)
+{
+    Compare(nullptr, 4);
+}
+
+TEST_F(AdaptiveVRSShaderTest, MatchesCpuReferenceWithMotion)
+{
+    std::vector<float> reprojection = MakeReprojection();
+    Compare(reprojection.data(), 4);
+}
+
+TEST_F(AdaptiveVRSShaderTest, MatchesCpuReferenceWithClampedRates)
+{
+    Compare(nullptr, 2);
+}
+#endif
@@ -0,0 +1,375 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <gtest/gtest.h>
+#include "fsr_cpu.h"
+#ifdef ALGORITHM_TEST_VULKAN
+#include "vulkan_test_device.h"
+#endif
+
+namespace {
+constexpr uint32_t INPUT_WIDTH = 160;
+constexpr uint32_t INPUT_HEIGHT = 120;
+constexpr uint32_t OUTPUT_WIDTH = 240;
+constexpr uint32_t OUTPUT_HEIGHT = 180;
+// What the app passes to FSR
+constexpr float SHARPNESS = 0.4f;
+
+// Hard edges, a diagonal, a soft gradient and fine noise, the cases EASU and RCAS treat differently.
+FSRCpu::Image MakeScene(uint32_t width, uint32_t height)
+{
+    FSRCpu::Image image;
+    image.Resize(width, height);
+    uint32_t seed = 12345;
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            seed = seed * 1664525u + 1013904223u;
+            float noise = static_cast<float>(seed >> 8) / static_cast<float>(1u << 24);
+            float u = static_cast<float>(x) / width;
+            float v = static_cast<float>(y) / height;
+            float *texel = image.At(x, y);
+            texel[0] = (x / 12 + y / 12) % 2 == 0 ? 0.85f : 0.15f;
+            texel[1] = std::fabs(u - v) < 0.04f ? 0.9f : 0.2f + 0.6f * u;
+            texel[2] = v < 0.5f ? 0.3f + 0.4f * v : 0.2f + 0.6f * noise;
+            texel[3] = 1.0f;
+        }
+    }
+    return image;
+}
+
+FSRCpu::InitParams MakeParams(uint32_t inputWidth, uint32_t inputHeight, uint32_t outputWidth,
+    uint32_t outputHeight)
+{
+    FSRCpu::InitParams params;
+    params.inputRegion.extent = { inputWidth, inputHeight };
+    params.outputSize = { outputWidth, outputHeight };
+    params.outputRegion.extent = params.outputSize;
+    params.sharpness = SHARPNESS;
+    params.threadCount = 1;
+    return params;
+}
+}
+
+TEST(FSRCpuTest, FlatImageStaysFlat)
+{
+    FSRCpu::Image input;
+    input.Resize(32, 32);
+    for (size_t i = 0; i < input.pixels.size(); i += 4) {
+        input.pixels[i] = 0.25f;
+        input.pixels[i + 1] = 0.5f;
+        input.pixels[i + 2] = 0.75f;
+        input.pixels[i + 3] = 1.0f;
+    }
+    FSRCpu fsr;
+    fsr.Init(MakeParams(32, 32, 48, 48));
+    FSRCpu::Image output;
+    ASSERT_TRUE(fsr.Upscale(input, output));
+    ASSERT_EQ(output.width, 48u);
+    ASSERT_EQ(output.height, 48u);
+    // RCAS normalizes with the approximate reciprocal of rcas.frag, which is off by up to 0.2%
+    const float tolerance = 0.002f;
+    for (size_t i = 0; i < output.pixels.size(); i += 4) {
+        EXPECT_NEAR(output.pixels[i], 0.25f, tolerance);
+        EXPECT_NEAR(output.pixels[i + 1], 0.5f, tolerance);
+        EXPECT_NEAR(output.pixels[i + 2], 0.75f, tolerance);
+        EXPECT_NEAR(output.pixels[i + 3], 1.0f, tolerance);
+    }
+}
+
+TEST(FSRCpuTest, ThreadCountDoesNotChangeResult)
+{
+    FSRCpu::Image input = MakeScene(INPUT_WIDTH, INPUT_HEIGHT);
+    FSRCpu::InitParams params = MakeParams(INPUT_WIDTH, INPUT_HEIGHT, OUTPUT_WIDTH, OUTPUT_HEIGHT);
+    FSRCpu single;
+    single.Init(params);
+    FSRCpu::Image expected;
+    ASSERT_TRUE(single.Upscale(input, expected));
+
+    params.threadCount = 0;
+    FSRCpu threaded;
+    threaded.Init(params);
+    FSRCpu::Image actual;
+    ASSERT_TRUE(threaded.Upscale(input, actual));
+    EXPECT_EQ(actual.pixels, expected.pixels);
+}
+
+TEST(FSRCpuTest, OnlyWritesOutputRegion)
+{
+    FSRCpu::Image input = MakeScene(INPUT_WIDTH, INPUT_HEIGHT);
+    FSRCpu::InitParams params = MakeParams(INPUT_WIDTH, INPUT_HEIGHT, OUTPUT_WIDTH, OUTPUT_HEIGHT);
+    params.outputRegion = { { 20, 10 }, { 200, 150 } };
+    FSRCpu fsr;
+    fsr.Init(params);
+    FSRCpu::Image output;
+    ASSERT_TRUE(fsr.Upscale(input, output));
+    for (uint32_t y = 0; y < OUTPUT_HEIGHT; y++) {
+        for (uint32_t x = 0; x < OUTPUT_WIDTH; x++) {
+            bool inside = x >= 20 && x < 220 && y >= 10 && y < 160;
+            EXPECT_EQ(output.At(x, y)[3] != 0.0f, inside) << x << ", " << y;
+        }
+    }
+}
+
+TEST(FSRCpuTest, HigherSharpnessSharpensMore)
+{
+    // A vertical edge, RCAS pushes the texels next to it further apart the sharper it is
+    FSRCpu::Image input;
+    input.Resize(32, 8);
+    for (uint32_t y = 0; y < 8; y++) {
+        for (uint32_t x = 0; x < 32; x++) {
+            float v = x < 16 ? 0.3f : 0.7f;
+            float *texel = input.At(x, y);
+            texel[0] = v;
+            texel[1] = v;
+            texel[2] = v;
+            texel[3] = 1.0f;
+        }
+    }
+    auto edgeContrast = [&input](float sharpness) {
+        FSRCpu::InitParams params = MakeParams(32, 8, 64, 16);
+        params.sharpness = sharpness;
+        FSRCpu fsr;
+        fsr.Init(params);
+        FSRCpu::Image output;
+        EXPECT_TRUE(fsr.Upscale(input, output));
+        return output.At(33, 8)[0] - output.At(30, 8)[0];
+    };
+    EXPECT_GT(edgeContrast(1.0f), edgeContrast(0.0f));
+}
+
+TEST(FSRCpuTest, RejectsRegionOutsideImage)
+{
+    FSRCpu::Image input = MakeScene(32, 32);
+    FSRCpu::InitParams params = MakeParams(32, 32, 48, 48);
+    params.inputRegion.offset = { 8, 0 };
+    FSRCpu fsr;
+    fsr.Init(params);
+    FSRCpu::Image output;
+    EXPECT_FALSE(fsr.Upscale(input, output));
+    EXPECT_FALSE(fsr.GetError().empty());
+
+    FSRCpu uninitialized;
+    EXPECT_FALSE(uninitialized.Upscale(input, output));
+}
+
+#ifdef ALGORITHM_TEST_VULKAN
+namespace {
+// Both sides use the same approximations in fp32, the tolerance only covers interpolated texture coordinates
+// and the order of operations. Exact reciprocals instead of the approximate ones already miss it by far.
+constexpr float MAX_CHANNEL_ERROR = 1.0f / 255.0f;
+constexpr float MAX_MEAN_ERROR = 0.02f / 255.0f;
+
+// Mirrors FSR::PushConstants
+struct EASUConstants {
+    uint32_t extentwidth;
+    uint32_t extentheight;
+    uint32_t offsetx;
+    uint32_t offsety;
+};
+
+// Runs easu.frag.spv and rcas.frag.spv the way FSR::BuildCommandBuffers does and reads both results back.
+class FSRShaderTest : public ::testing::Test {
+protected:
+    static constexpr VkFormat FORMAT = VK_FORMAT_R32G32B32A32_SFLOAT;
+    static constexpr uint32_t TEXEL_SIZE = 16;
+
+    void SetUp() override
+    {
+        if (!m_device.Init()) {
+            GTEST_SKIP() << "no Vulkan device";
+        }
+    }
+
+    bool Render(const FSRCpu::Image &input, const FSRCpu::InitParams &params, FSRCpu::Image &easu,
+        FSRCpu::Image &rcas)
+    {
+        const uint32_t outWidth = params.outputSize.width;
+        const uint32_t outHeight = params.outputSize.height;
+        const VkImageUsageFlags targetUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        VulkanTestDevice::Image source = m_device.CreateImage(input.width, input.height, FORMAT, TEXEL_SIZE,
+            VK_IMAGE_USAGE_SAMPLED_BIT);
+        VulkanTestDevice::Image easuTarget = m_device.CreateImage(outWidth, outHeight, FORMAT, TEXEL_SIZE,
+            targetUsage);
+        VulkanTestDevice::Image rcasTarget = m_device.CreateImage(outWidth, outHeight, FORMAT, TEXEL_SIZE,
+            targetUsage);
+        if (source.image == VK_NULL_HANDLE || easuTarget.image == VK_NULL_HANDLE ||
+            rcasTarget.image == VK_NULL_HANDLE ||
+            !m_device.Upload(source, input.pixels.data(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)) {
+            return false;
+        }
+
+        VkShaderModule vert = m_device.LoadShader("algorithm/fullscreen.vert.spv");
+        VkShaderModule easuFrag = m_device.LoadShader("algorithm/easu.frag.spv");
+        VkShaderModule rcasFrag = m_device.LoadShader("algorithm/rcas.frag.spv");
+        VkSampler sampler = m_device.CreateSampler(VK_FILTER_NEAREST);
+        VkDescriptorSetLayout easuSetLayout = m_device.CreateDescriptorSetLayout({
+            { 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr },
+        });
+        VkDescriptorSetLayout rcasSetLayout = m_device.CreateDescriptorSetLayout({
+            { 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr },
+            { 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr },
+        });
+        VkPipelineLayout easuLayout =
+            m_device.CreatePipelineLayout(easuSetLayout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(EASUConstants));
+        VkPipelineLayout rcasLayout = m_device.CreatePipelineLayout(rcasSetLayout, 0, 0);
+        VkRenderPass renderPass = m_device.CreateRenderPass(FORMAT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        if (vert == VK_NULL_HANDLE || easuFrag == VK_NULL_HANDLE || rcasFrag == VK_NULL_HANDLE ||
+            easuLayout == VK_NULL_HANDLE || rcasLayout == VK_NULL_HANDLE || renderPass == VK_NULL_HANDLE) {
+            return false;
+        }
+        VkPipeline easuPipeline =
+            m_device.CreateGraphicsPipeline(renderPass, easuLayout, vert, easuFrag, nullptr, false);
+        VkPipeline rcasPipeline =
+            m_device.CreateGraphicsPipeline(renderPass, rcasLayout, vert, rcasFrag, nullptr, false);
+        VkFramebuffer easuFramebuffer = m_device.CreateFramebuffer(renderPass, easuTarget);
+        VkFramebuffer rcasFramebuffer = m_device.CreateFramebuffer(renderPass, rcasTarget);
+        VkDescriptorSet easuSet = m_device.AllocateDescriptorSet(easuSetLayout);
+        VkDescriptorSet rcasSet = m_device.AllocateDescriptorSet(rcasSetLayout);
+        VulkanTestDevice::Buffer sharpness = m_device.CreateBuffer(sizeof(float),
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &params.sharpness);
+        if (easuPipeline == VK_NULL_HANDLE || rcasPipeline == VK_NULL_HANDLE ||
+            easuFramebuffer == VK_NULL_HANDLE || rcasFramebuffer == VK_NULL_HANDLE || easuSet == VK_NULL_HANDLE ||
+            rcasSet == VK_NULL_HANDLE || sharpness.buffer == VK_NULL_HANDLE) {
+            return false;
+        }
+        m_device.WriteImage(easuSet, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, sampler, source,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        m_device.WriteBuffer(rcasSet, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, sharpness);
+        m_device.WriteImage(rcasSet, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, sampler, easuTarget,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+        EASUConstants constants = {};
+        constants.extentwidth = params.inputRegion.extent.width;
+        constants.extentheight = params.inputRegion.extent.height;
+        constants.offsetx = static_cast<uint32_t>(params.inputRegion.offset.x);
+        constants.offsety = static_cast<uint32_t>(params.inputRegion.offset.y);
+        bool submitted = m_device.Submit([&](VkCommandBuffer cmdBuffer) {
+            VkClearValue clear = {};
+            VkRenderPassBeginInfo beginInfo = {};
+            beginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            beginInfo.renderPass = renderPass;
+            beginInfo.framebuffer = easuFramebuffer;
+            beginInfo.renderArea.extent = { outWidth, outHeight };
+            beginInfo.clearValueCount = 1;
+            beginInfo.pClearValues = &clear;
+            VkViewport viewport = { 0.0f, 0.0f, static_cast<float>(outWidth), static_cast<float>(outHeight),
+                0.0f, 1.0f };
+            VkRect2D scissor = { { 0, 0 }, { outWidth, outHeight } };
+            vkCmdBeginRenderPass(cmdBuffer, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+            vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+            vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+            vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, easuPipeline);
+            vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, easuLayout, 0, 1, &easuSet, 0,
+                nullptr);
+            vkCmdPushConstants(cmdBuffer, easuLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(constants),
+                &constants);
+            vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
+            vkCmdEndRenderPass(cmdBuffer);
+
+            // RCAS covers only the output region, like FSR does with its dynamic viewport
+            beginInfo.framebuffer = rcasFramebuffer;
+            viewport = { static_cast<float>(params.outputRegion.offset.x),
+                static_cast<float>(params.outputRegion.offset.y),
+                static_cast<float>(params.outputRegion.extent.width),
+                static_cast<float>(params.outputRegion.extent.height), 0.0f, 1.0f };
+            vkCmdBeginRenderPass(cmdBuffer, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+            vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+            vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+            vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, rcasPipeline);
+            vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, rcasLayout, 0, 1, &rcasSet, 0,
+                nullptr);
+            vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
+            vkCmdEndRenderPass(cmdBuffer);
+        });
+        return submitted && Download(easuTarget, easu) && Download(rcasTarget, rcas);
+    }
+
+    bool Download(const VulkanTestDevice::Image &image, FSRCpu::Image &result)
+    {
+        std::vector<uint8_t> texels;
+        if (!m_device.Download(image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, texels)) {
+            return false;
+        }
+        result.Resize(image.width, image.height);
+        memcpy(result.pixels.data(), texels.data(), std::min(texels.size(), result.pixels.size() * sizeof(float)));
+        return true;
+    }
+
+    // Compares the color channels inside the output region, FSR leaves the rest of the target cleared.
+    static void ExpectNear(const FSRCpu::Image &expected, const FSRCpu::Image &actual,
+        const FSRCpu::Rect &region, const char *pass)
+    {
+        ASSERT_EQ(actual.width, expected.width);
+        ASSERT_EQ(actual.height, expected.height);
+        float maxError = 0.0f;
+        double sumError = 0.0;
+        size_t count = 0;
+        for (uint32_t y = 0; y < region.extent.height; y++) {
+            for (uint32_t x = 0; x < region.extent.width; x++) {
+                const float *e = expected.At(region.offset.x + x, region.offset.y + y);
+                const float *a = actual.At(region.offset.x + x, region.offset.y + y);
+                for (int ch = 0; ch < 3; ch++) {
+                    float error = std::fabs(e[ch] - a[ch]);
+                    maxError = std::max(maxError, error);
+                    sumError += error;
+                    count++;
+                }
+            }
+        }
+        EXPECT_LE(maxError, MAX_CHANNEL_ERROR) << pass;
+        EXPECT_LE(sumError / count, MAX_MEAN_ERROR) << pass;
+    }
+
+    void Compare(const FSRCpu::InitParams &params)
+    {
+        FSRCpu::Image input = MakeScene(INPUT_WIDTH, INPUT_HEIGHT);
+        FSRCpu fsr;
+        fsr.Init(params);
+        FSRCpu::Image expected;
+        ASSERT_TRUE(fsr.Upscale(input, expected));
+        FSRCpu::Image easu;
+        FSRCpu::Image rcas;
+        ASSERT_TRUE(Render(input, params, easu, rcas));
+        ExpectNear(fsr.GetEASUResult(), easu, params.outputRegion, "EASU");
+        ExpectNear(expected, rcas, params.outputRegion, "RCAS");
+    }
+
+    VulkanTestDevice m_device;
+};
+}
+
+TEST_F(FSRShaderTest, MatchesCpuReference)
+{
+    Compare(MakeParams(INPUT_WIDTH, INPUT_HEIGHT, OUTPUT_WIDTH, OUTPUT_HEIGHT));
+}
+
+TEST_F(FSRShaderTest, MatchesCpuReferenceWithInputRegion)
+{
+    FSRCpu::InitParams params = MakeParams(INPUT_WIDTH, INPUT_HEIGHT, OUTPUT_WIDTH, OUTPUT_HEIGHT);
+    params.inputRegion = { { 16, 8 }, { 128, 96 } };
+    Compare(params);
+}
+
+TEST_F(FSRShaderTest, MatchesCpuReferenceWithFullSharpening)
+{
+    FSRCpu::InitParams params = MakeParams(INPUT_WIDTH, INPUT_HEIGHT, OUTPUT_WIDTH, OUTPUT_HEIGHT);
+    params.sharpness = 1.0f;
+    Compare(params);
+}
+#endif
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cmath>
+#include <vector>
+#include <gtest/gtest.h>
+#include "image_metrics.h"
+
+namespace {
+constexpr uint32_t WIDTH = 64;
+constexpr uint32_t HEIGHT = 64;
+constexpr double PSNR_MAX = 100.0;
+// The metrics run in float, the expected values are computed in double
+constexpr double TOLERANCE = 1e-4;
+
+std::vector<uint8_t> MakeGrey(uint8_t value)
+{
+    std::vector<uint8_t> image(static_cast<size_t>(WIDTH) * HEIGHT * 4, value);
+    for (size_t i = 3; i < image.size(); i += 4) {
+        image[i] = 255;
+    }
+    return image;
+}
+
+void SetPixel(std::vector<uint8_t> &image, uint32_t x, uint32_t y, uint8_t value)
+{
+    uint8_t *texel = &image[(static_cast<size_t>(y) * WIDTH + x) * 4];
+    texel[0] = value;
+    texel[1] = value;
+    texel[2] = value;
+}
+
+// SSIM of an 8x8 window of constant a where one texel of the test image is a + d
+double SingleTexelWindowSSIM(double a, double d)
+{
+    const double c1 = 0.01 * 0.01;
+    const double c2 = 0.03 * 0.03;
+    const double n = 64.0;
+    double muB = a + d / n;
+    double varB = (a + d) * (a + d) / n + a * a * (n - 1.0) / n - muB * muB;
+    return ((2.0 * a * muB + c1) * c2) / ((a * a + muB * muB + c1) * (varB + c2));
+}
+}
+
+TEST(ImageMetricsTest, IdenticalImages)
+{
+    std::vector<uint8_t> image = MakeGrey(128);
+    SetPixel(image, 5, 7, 30);
+    ImageMetrics metrics(1);
+    ImageMetrics::Result result;
+    ASSERT_TRUE(metrics.Compare(image, image, WIDTH, HEIGHT, result));
+    EXPECT_EQ(result.psnr, PSNR_MAX);
+    EXPECT_NEAR(result.ssim, 1.0, TOLERANCE);
+    EXPECT_EQ(result.perceptual, 0.0);
+}
+
+TEST(ImageMetricsTest, ConstantOffset)
+{
+    ImageMetrics metrics(1);
+    ImageMetrics::Result result;
+    ASSERT_TRUE(metrics.Compare(MakeGrey(100), MakeGrey(110), WIDTH, HEIGHT, result));
+    // 20 * log10(255 / 10)
+    EXPECT_NEAR(result.psnr, 28.1308036, TOLERANCE);
+    // Flat windows only keep the luminance term
+    double a = 100.0 / 255.0;
+    double b = 110.0 / 255.0;
+    EXPECT_NEAR(result.ssim, (2.0 * a * b + 0.01 * 0.01) / (a * a + b * b + 0.01 * 0.01), TOLERANCE);
+    // Greys only differ in L*, 42.3746 against 46.4355
+    EXPECT_NEAR(result.perceptual, 4.0608495, 1e-3);
+}
+
+TEST(ImageMetricsTest, SinglePixelError)
+{
+    std::vector<uint8_t> reference = MakeGrey(128);
+    std::vector<uint8_t> center = reference;
+    SetPixel(center, 20, 20, 255);
+    std::vector<uint8_t> corner = reference;
+    SetPixel(corner, 0, 0, 255);
+
+    ImageMetrics metrics(1);
+    ImageMetrics::Result centerResult;
+    ImageMetrics::Result cornerResult;
+    ASSERT_TRUE(metrics.Compare(reference, center, WIDTH, HEIGHT, centerResult));
+    ASSERT_TRUE(metrics.Compare(reference, corner, WIDTH, HEIGHT, cornerResult));
+
+    // 10 * log10(64 * 64 / (127 / 255)^2), the error does not depend on where it is
+    EXPECT_NEAR(centerResult.psnr, 42.1783287, TOLERANCE);
+    EXPECT_NEAR(cornerResult.psnr, centerResult.psnr, TOLERANCE);
+
+    // 8x8 windows every 4 texels, 15 x 15 of them. (20, 20) lies in 2 x 2 windows, (0, 0) only in the first.
+    const double windowCount = 15.0 * 15.0;
+    double windowSSIM = SingleTexelWindowSSIM(128.0 / 255.0, 127.0 / 255.0);
+    EXPECT_NEAR(centerResult.ssim, (windowCount - 4.0 + 4.0 * windowSSIM) / windowCount, TOLERANCE);
+    EXPECT_NEAR(cornerResult.ssim, (windowCount - 1.0 + windowSSIM) / windowCount, TOLERANCE);
+
+    // The prefilter spreads the texel over its neighbours, the mean error is small but not zero
+    EXPECT_GT(centerResult.perceptual, 0.0);
+    EXPECT_LT(centerResult.perceptual, 0.1);
+}
+
+TEST(ImageMetricsTest, ThreadCountDoesNotChangeResult)
+{
+    std::vector<uint8_t> reference = MakeGrey(90);
+    std::vector<uint8_t> test = reference;
+    for (uint32_t i = 0; i < WIDTH; i++) {
+        SetPixel(test, i, (i * 7) % HEIGHT, static_cast<uint8_t>(i * 4));
+    }
+    ImageMetrics single(1);
+    ImageMetrics banded(5);
+    ImageMetrics::Result singleResult;
+    ImageMetrics::Result bandedResult;
+    ASSERT_TRUE(single.Compare(reference, test, WIDTH, HEIGHT, singleResult));
+    ASSERT_TRUE(banded.Compare(reference, test, WIDTH, HEIGHT, bandedResult));
+    EXPECT_NEAR(singleResult.psnr, bandedResult.psnr, 1e-9);
+    EXPECT_NEAR(singleResult.ssim, bandedResult.ssim, 1e-9);
+    EXPECT_NEAR(singleResult.perceptual, bandedResult.perceptual, 1e-9);
+}
+
+TEST(ImageMetricsTest, RejectsImagesSmallerThanTheSize)
+{
+    ImageMetrics metrics(1);
+    ImageMetrics::Result result;
+    std::vector<uint8_t> image = MakeGrey(128);
+    std::vector<uint8_t> truncated(image.begin(), image.end() - 4);
+    EXPECT_FALSE(metrics.Compare(image, truncated, WIDTH, HEIGHT, result));
+    EXPECT_FALSE(metrics.Compare(image, image, 0, HEIGHT, result));
+}
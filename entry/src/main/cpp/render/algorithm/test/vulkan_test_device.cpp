@@ -0,0 +1,633 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vulkan_test_device.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+constexpr uint32_t MAX_DESCRIPTOR_SETS = 16;
+constexpr uint32_t MAX_DESCRIPTORS_PER_TYPE = 32;
+
+void LayoutAccess(VkImageLayout layout, VkAccessFlags &access, VkPipelineStageFlags &stage)
+{
+    switch (layout) {
+        case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+            access = VK_ACCESS_TRANSFER_WRITE_BIT;
+            stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            break;
+        case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+            access = VK_ACCESS_TRANSFER_READ_BIT;
+            stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            break;
+        case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+            access = VK_ACCESS_SHADER_READ_BIT;
+            stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+            break;
+        case VK_IMAGE_LAYOUT_GENERAL:
+            access = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+            break;
+        case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+            access = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            break;
+        default:
+            access = 0;
+            stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+            break;
+    }
+}
+}
+
+VulkanTestDevice::~VulkanTestDevice()
+{
+    if (m_device != VK_NULL_HANDLE) {
+        vkDeviceWaitIdle(m_device);
+        for (auto it = m_cleanup.rbegin(); it != m_cleanup.rend(); ++it) {
+            (*it)();
+        }
+        if (m_descriptorPool != VK_NULL_HANDLE) {
+            vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+        }
+        if (m_commandPool != VK_NULL_HANDLE) {
+            vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+        }
+        vkDestroyDevice(m_device, nullptr);
+    }
+    if (m_instance != VK_NULL_HANDLE) {
+        vkDestroyInstance(m_instance, nullptr);
+    }
+}
+
+bool VulkanTestDevice::Init()
+{
+    VkApplicationInfo appInfo = {};
+    appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    appInfo.pApplicationName = "algorithm_test";
+    appInfo.apiVersion = VK_API_VERSION_1_0;
+    VkInstanceCreateInfo instanceInfo = {};
+    instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    instanceInfo.pApplicationInfo = &appInfo;
+    if (vkCreateInstance(&instanceInfo, nullptr, &m_instance) != VK_SUCCESS) {
+        m_instance = VK_NULL_HANDLE;
+        return false;
+    }
+
+    uint32_t deviceCount = 0;
+    vkEnumeratePhysicalDevices(m_instance, &deviceCount, nullptr);
+    std::vector<VkPhysicalDevice> devices(deviceCount);
+    vkEnumeratePhysicalDevices(m_instance, &deviceCount, devices.data());
+    const VkQueueFlags wanted = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+    for (VkPhysicalDevice candidate : devices) {
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(candidate, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(candidate, &familyCount, families.data());
+        for (uint32_t i = 0; i < familyCount; i++) {
+            if ((families[i].queueFlags & wanted) == wanted) {
+                m_physicalDevice = candidate;
+                m_queueFamily = i;
+                break;
+            }
+        }
+        if (m_physicalDevice != VK_NULL_HANDLE) {
+            break;
+        }
+    }
+    if (m_physicalDevice == VK_NULL_HANDLE) {
+        return false;
+    }
+    vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &m_memoryProperties);
+
+    float priority = 1.0f;
+    VkDeviceQueueCreateInfo queueInfo = {};
+    queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queueInfo.queueFamilyIndex = m_queueFamily;
+    queueInfo.queueCount = 1;
+    queueInfo.pQueuePriorities = &priority;
+    VkDeviceCreateInfo deviceInfo = {};
+    deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    deviceInfo.queueCreateInfoCount = 1;
+    deviceInfo.pQueueCreateInfos = &queueInfo;
+    if (vkCreateDevice(m_physicalDevice, &deviceInfo, nullptr, &m_device) != VK_SUCCESS) {
+        m_device = VK_NULL_HANDLE;
+        return false;
+    }
+    vkGetDeviceQueue(m_device, m_queueFamily, 0, &m_queue);
+
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = m_queueFamily;
+    if (vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_commandPool) != VK_SUCCESS) {
+        return false;
+    }
+
+    std::vector<VkDescriptorPoolSize> poolSizes = {
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_DESCRIPTORS_PER_TYPE },
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, MAX_DESCRIPTORS_PER_TYPE },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, MAX_DESCRIPTORS_PER_TYPE },
+    };
+    VkDescriptorPoolCreateInfo descriptorPoolInfo = {};
+    descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptorPoolInfo.maxSets = MAX_DESCRIPTOR_SETS;
+    descriptorPoolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    descriptorPoolInfo.pPoolSizes = poolSizes.data();
+    return vkCreateDescriptorPool(m_device, &descriptorPoolInfo, nullptr, &m_descriptorPool) == VK_SUCCESS;
+}
+
+bool VulkanTestDevice::SupportsFormat(VkFormat format, VkFormatFeatureFlags features) const
+{
+    VkFormatProperties properties = {};
+    vkGetPhysicalDeviceFormatProperties(m_physicalDevice, format, &properties);
+    return (properties.optimalTilingFeatures & features) == features;
+}
+
+bool VulkanTestDevice::FindMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties, uint32_t &index) const
+{
+    for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++) {
+        if ((typeBits & (1u << i)) != 0 &&
+            (m_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+VkDeviceMemory VulkanTestDevice::Allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties)
+{
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = requirements.size;
+    if (!FindMemoryType(requirements.memoryTypeBits, properties, allocInfo.memoryTypeIndex)) {
+        return VK_NULL_HANDLE;
+    }
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    if (vkAllocateMemory(m_device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+        return VK_NULL_HANDLE;
+    }
+    VkDevice device = m_device;
+    m_cleanup.push_back([device, memory]() { vkFreeMemory(device, memory, nullptr); });
+    return memory;
+}
+
+VulkanTestDevice::Image VulkanTestDevice::CreateImage(uint32_t width, uint32_t height, VkFormat format,
+    uint32_t texelSize, VkImageUsageFlags usage)
+{
+    Image image;
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = format;
+    imageInfo.extent = { width, height, 1 };
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = usage | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkImage handle = VK_NULL_HANDLE;
+    if (vkCreateImage(m_device, &imageInfo, nullptr, &handle) != VK_SUCCESS) {
+        return image;
+    }
+    VkDevice device = m_device;
+    m_cleanup.push_back([device, handle]() { vkDestroyImage(device, handle, nullptr); });
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(m_device, handle, &requirements);
+    VkDeviceMemory memory = Allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (memory == VK_NULL_HANDLE || vkBindImageMemory(m_device, handle, memory, 0) != VK_SUCCESS) {
+        return image;
+    }
+
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = handle;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    VkImageView view = VK_NULL_HANDLE;
+    if (vkCreateImageView(m_device, &viewInfo, nullptr, &view) != VK_SUCCESS) {
+        return image;
+    }
+    m_cleanup.push_back([device, view]() { vkDestroyImageView(device, view, nullptr); });
+
+    image.image = handle;
+    image.view = view;
+    image.format = format;
+    image.width = width;
+    image.height = height;
+    image.texelSize = texelSize;
+    return image;
+}
+
+VulkanTestDevice::Buffer VulkanTestDevice::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+    const void *data)
+{
+    Buffer buffer;
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkBuffer handle = VK_NULL_HANDLE;
+    if (vkCreateBuffer(m_device, &bufferInfo, nullptr, &handle) != VK_SUCCESS) {
+        return buffer;
+    }
+    VkDevice device = m_device;
+    m_cleanup.push_back([device, handle]() { vkDestroyBuffer(device, handle, nullptr); });
+
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(m_device, handle, &requirements);
+    VkDeviceMemory memory =
+        Allocate(requirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    void *mapped = nullptr;
+    if (memory == VK_NULL_HANDLE || vkBindBufferMemory(m_device, handle, memory, 0) != VK_SUCCESS ||
+        vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS) {
+        return buffer;
+    }
+    if (data != nullptr) {
+        memcpy(mapped, data, static_cast<size_t>(size));
+    }
+    buffer.buffer = handle;
+    buffer.size = size;
+    buffer.mapped = mapped;
+    return buffer;
+}
+
+bool VulkanTestDevice::Upload(const Image &image, const void *texels, VkImageLayout layout)
+{
+    VkDeviceSize size = static_cast<VkDeviceSize>(image.width) * image.height * image.texelSize;
+    Buffer staging = CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, texels);
+    if (staging.buffer == VK_NULL_HANDLE) {
+        return false;
+    }
+    return Submit([&](VkCommandBuffer cmdBuffer) {
+        Transition(cmdBuffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        VkBufferImageCopy region = {};
+        region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        region.imageExtent = { image.width, image.height, 1 };
+        vkCmdCopyBufferToImage(cmdBuffer, staging.buffer, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+            &region);
+        Transition(cmdBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, layout);
+    });
+}
+
+bool VulkanTestDevice::Download(const Image &image, VkImageLayout layout, std::vector<uint8_t> &texels)
+{
+    VkDeviceSize size = static_cast<VkDeviceSize>(image.width) * image.height * image.texelSize;
+    Buffer staging = CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, nullptr);
+    if (staging.buffer == VK_NULL_HANDLE) {
+        return false;
+    }
+    bool submitted = Submit([&](VkCommandBuffer cmdBuffer) {
+        Transition(cmdBuffer, image, layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+        VkBufferImageCopy region = {};
+        region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        region.imageExtent = { image.width, image.height, 1 };
+        vkCmdCopyImageToBuffer(cmdBuffer, image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, staging.buffer, 1,
+            &region);
+        Transition(cmdBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, layout);
+    });
+    if (!submitted) {
+        return false;
+    }
+    const uint8_t *data = static_cast<const uint8_t *>(staging.mapped);
+    texels.assign(data, data + size);
+    return true;
+}
+
+VkShaderModule VulkanTestDevice::LoadShader(const std::string &name)
+{
+    std::ifstream file(std::string(SHADER_DIR) + name, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        std::cerr << "VulkanTestDevice can not open shader " << name << std::endl;
+        return VK_NULL_HANDLE;
+    }
+    size_t size = static_cast<size_t>(file.tellg());
+    std::vector<uint32_t> code((size + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+    file.seekg(0);
+    file.read(reinterpret_cast<char *>(code.data()), static_cast<std::streamsize>(size));
+
+    VkShaderModuleCreateInfo moduleInfo = {};
+    moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    moduleInfo.codeSize = size;
+    moduleInfo.pCode = code.data();
+    VkShaderModule module = VK_NULL_HANDLE;
+    if (vkCreateShaderModule(m_device, &moduleInfo, nullptr, &module) != VK_SUCCESS) {
+        return VK_NULL_HANDLE;
+    }
+    VkDevice device = m_device;
+    m_cleanup.push_back([device, module]() { vkDestroyShaderModule(device, module, nullptr); });
+    return module;
+}
+
+VkSampler VulkanTestDevice::CreateSampler(VkFilter filter)
+{
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = filter;
+    samplerInfo.minFilter = filter;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxAnisotropy = 1.0f;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    VkSampler sampler = VK_NULL_HANDLE;
+    if (vkCreateSampler(m_device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+        return VK_NULL_HANDLE;
+    }
+    VkDevice device = m_device;
+    m_cleanup.push_back([device, sampler]() { vkDestroySampler(device, sampler, nullptr); });
+    return sampler;
+}
+
+VkDescriptorSetLayout VulkanTestDevice::CreateDescriptorSetLayout(
+    const std::vector<VkDescriptorSetLayoutBinding> &bindings)
+{
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+    VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+    if (vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &layout) != VK_SUCCESS) {
+        return VK_NULL_HANDLE;
+    }
+    VkDevice device = m_device;
+    m_cleanup.push_back([device, layout]() { vkDestroyDescriptorSetLayout(device, layout, nullptr); });
+    return layout;
+}
+
+VkDescriptorSet VulkanTestDevice::AllocateDescriptorSet(VkDescriptorSetLayout layout)
+{
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &layout;
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    if (vkAllocateDescriptorSets(m_device, &allocInfo, &set) != VK_SUCCESS) {
+        return VK_NULL_HANDLE;
+    }
+    return set;
+}
+
+void VulkanTestDevice::WriteImage(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkSampler sampler,
+    const Image &image, VkImageLayout layout)
+{
+    VkDescriptorImageInfo imageInfo = { sampler, image.view, layout };
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = set;
+    write.dstBinding = binding;
+    write.descriptorCount = 1;
+    write.descriptorType = type;
+    write.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+}
+
+void VulkanTestDevice::WriteBuffer(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, const Buffer &buffer)
+{
+    VkDescriptorBufferInfo bufferInfo = { buffer.buffer, 0, buffer.size };
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = set;
+    write.dstBinding = binding;
+    write.descriptorCount = 1;
+    write.descriptorType = type;
+    write.pBufferInfo = &bufferInfo;
+    vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+}
+
+VkPipelineLayout VulkanTestDevice::CreatePipelineLayout(VkDescriptorSetLayout setLayout,
+    VkShaderStageFlags pushStages, uint32_t pushSize)
+{
+    VkPushConstantRange pushRange = { pushStages, 0, pushSize };
+    VkPipelineLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &setLayout;
+    layoutInfo.pushConstantRangeCount = pushSize > 0 ? 1 : 0;
+    layoutInfo.pPushConstantRanges = pushSize > 0 ? &pushRange : nullptr;
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    if (vkCreatePipelineLayout(m_device, &layoutInfo, nullptr, &layout) != VK_SUCCESS) {
+        return VK_NULL_HANDLE;
+    }
+    VkDevice device = m_device;
+    m_cleanup.push_back([device, layout]() { vkDestroyPipelineLayout(device, layout, nullptr); });
+    return layout;
+}
+
+VkPipeline VulkanTestDevice::CreateComputePipeline(VkPipelineLayout layout, VkShaderModule module)
+{
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = module;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = layout;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    if (vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+        return VK_NULL_HANDLE;
+    }
+    VkDevice device = m_device;
+    m_cleanup.push_back([device, pipeline]() { vkDestroyPipeline(device, pipeline, nullptr); });
+    return pipeline;
+}
+
+VkRenderPass VulkanTestDevice::CreateRenderPass(VkFormat format, VkImageLayout finalLayout)
+{
+    VkAttachmentDescription attachment = {};
+    attachment.format = format;
+    attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachment.finalLayout = finalLayout;
+    VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorReference;
+    // The attachment is sampled or copied right after the pass
+    VkSubpassDependency dependency = {};
+    dependency.srcSubpass = 0;
+    dependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+    dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+    VkRenderPassCreateInfo renderPassInfo = {};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = 1;
+    renderPassInfo.pAttachments = &attachment;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = 1;
+    renderPassInfo.pDependencies = &dependency;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    if (vkCreateRenderPass(m_device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+        return VK_NULL_HANDLE;
+    }
+    VkDevice device = m_device;
+    m_cleanup.push_back([device, renderPass]() { vkDestroyRenderPass(device, renderPass, nullptr); });
+    return renderPass;
+}
+
+VkFramebuffer VulkanTestDevice::CreateFramebuffer(VkRenderPass renderPass, const Image &image)
+{
+    VkFramebufferCreateInfo framebufferInfo = {};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = renderPass;
+    framebufferInfo.attachmentCount = 1;
+    framebufferInfo.pAttachments = &image.view;
+    framebufferInfo.width = image.width;
+    framebufferInfo.height = image.height;
+    framebufferInfo.layers = 1;
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    if (vkCreateFramebuffer(m_device, &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS) {
+        return VK_NULL_HANDLE;
+    }
+    VkDevice device = m_device;
+    m_cleanup.push_back([device, framebuffer]() { vkDestroyFramebuffer(device, framebuffer, nullptr); });
+    return framebuffer;
+}
+
+VkPipeline VulkanTestDevice::CreateGraphicsPipeline(VkRenderPass renderPass, VkPipelineLayout layout,
+    VkShaderModule vert, VkShaderModule frag, const VkPipelineVertexInputStateCreateInfo *vertexInput, bool blend)
+{
+    VkPipelineShaderStageCreateInfo stages[2] = {};
+    stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = vert;
+    stages[0].pName = "main";
+    stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = frag;
+    stages[1].pName = "main";
+
+    VkPipelineVertexInputStateCreateInfo emptyVertexInput = {};
+    emptyVertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    VkPipelineViewportStateCreateInfo viewportState = {};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+    VkPipelineRasterizationStateCreateInfo rasterization = {};
+    rasterization.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterization.cullMode = VK_CULL_MODE_NONE;
+    rasterization.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterization.lineWidth = 1.0f;
+    VkPipelineMultisampleStateCreateInfo multisample = {};
+    multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    VkPipelineColorBlendAttachmentState blendAttachment = {};
+    blendAttachment.blendEnable = blend ? VK_TRUE : VK_FALSE;
+    blendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    blendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT |
+        VK_COLOR_COMPONENT_A_BIT;
+    VkPipelineColorBlendStateCreateInfo colorBlend = {};
+    colorBlend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlend.attachmentCount = 1;
+    colorBlend.pAttachments = &blendAttachment;
+    VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamicState = {};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = 2;
+    dynamicState.pDynamicStates = dynamicStates;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = stages;
+    pipelineInfo.pVertexInputState = vertexInput != nullptr ? vertexInput : &emptyVertexInput;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterization;
+    pipelineInfo.pMultisampleState = &multisample;
+    pipelineInfo.pColorBlendState = &colorBlend;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = layout;
+    pipelineInfo.renderPass = renderPass;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    if (vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+        return VK_NULL_HANDLE;
+    }
+    VkDevice device = m_device;
+    m_cleanup.push_back([device, pipeline]() { vkDestroyPipeline(device, pipeline, nullptr); });
+    return pipeline;
+}
+
+bool VulkanTestDevice::Submit(const std::function<void(VkCommandBuffer)> &record)
+{
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = m_commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+    if (vkAllocateCommandBuffers(m_device, &allocInfo, &cmdBuffer) != VK_SUCCESS) {
+        return false;
+    }
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(cmdBuffer, &beginInfo);
+    record(cmdBuffer);
+    vkEndCommandBuffer(cmdBuffer);
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &cmdBuffer;
+    bool result = vkQueueSubmit(m_queue, 1, &submitInfo, VK_NULL_HANDLE) == VK_SUCCESS &&
+        vkQueueWaitIdle(m_queue) == VK_SUCCESS;
+    vkFreeCommandBuffers(m_device, m_commandPool, 1, &cmdBuffer);
+    return result;
+}
+
+void VulkanTestDevice::Transition(VkCommandBuffer cmdBuffer, const Image &image, VkImageLayout oldLayout,
+    VkImageLayout newLayout)
+{
+    VkPipelineStageFlags srcStage;
+    VkPipelineStageFlags dstStage;
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    LayoutAccess(oldLayout, barrier.srcAccessMask, srcStage);
+    LayoutAccess(newLayout, barrier.dstAccessMask, dstStage);
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image.image;
+    barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    vkCmdPipelineBarrier(cmdBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RENDER_ALGORITHM_TEST_VULKAN_TEST_DEVICE_H
+#define RENDER_ALGORITHM_TEST_VULKAN_TEST_DEVICE_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Headless device used to run the shaders the CPU references mirror and read their results back.
+// Every object it creates is destroyed with it, Init returns false when the host has no Vulkan device.
+class VulkanTestDevice {
+public:
+    struct Image {
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t texelSize = 0;
+    };
+
+    struct Buffer {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        void *mapped = nullptr;
+    };
+
+    VulkanTestDevice() {}
+    ~VulkanTestDevice();
+
+    bool Init();
+    bool SupportsFormat(VkFormat format, VkFormatFeatureFlags features) const;
+
+    // Upload and Download take tightly packed rows of texelSize byte texels.
+    Image CreateImage(uint32_t width, uint32_t height, VkFormat format, uint32_t texelSize, VkImageUsageFlags usage);
+    bool Upload(const Image &image, const void *texels, VkImageLayout layout);
+    bool Download(const Image &image, VkImageLayout layout, std::vector<uint8_t> &texels);
+    // Host visible and coherent, stays mapped until the device is destroyed.
+    Buffer CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, const void *data);
+    // name is relative to SHADER_DIR, e.g. "algorithm/easu.frag.spv"
+    VkShaderModule LoadShader(const std::string &name);
+    VkSampler CreateSampler(VkFilter filter);
+
+    VkDescriptorSetLayout CreateDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding> &bindings);
+    VkDescriptorSet AllocateDescriptorSet(VkDescriptorSetLayout layout);
+    void WriteImage(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkSampler sampler,
+        const Image &image, VkImageLayout layout);
+    void WriteBuffer(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, const Buffer &buffer);
+    VkPipelineLayout CreatePipelineLayout(VkDescriptorSetLayout setLayout, VkShaderStageFlags pushStages,
+        uint32_t pushSize);
+    VkPipeline CreateComputePipeline(VkPipelineLayout layout, VkShaderModule module);
+
+    // Single color attachment pass that clears and leaves the attachment in finalLayout.
+    VkRenderPass CreateRenderPass(VkFormat format, VkImageLayout finalLayout);
+    VkFramebuffer CreateFramebuffer(VkRenderPass renderPass, const Image &image);
+    // Viewport and scissor are dynamic, blending is the usual source-alpha over.
+    VkPipeline CreateGraphicsPipeline(VkRenderPass renderPass, VkPipelineLayout layout, VkShaderModule vert,
+        VkShaderModule frag, const VkPipelineVertexInputStateCreateInfo *vertexInput, bool blend);
+
+    // Records into a one-shot command buffer, submits it and waits for the queue.
+    bool Submit(const std::function<void(VkCommandBuffer)> &record);
+    static void Transition(VkCommandBuffer cmdBuffer, const Image &image, VkImageLayout oldLayout,
+        VkImageLayout newLayout);
+
+    VkDevice GetDevice() const { return m_device; }
+
+private:
+    bool FindMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties, uint32_t &index) const;
+    VkDeviceMemory Allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties);
+
+    VkInstance m_instance = VK_NULL_HANDLE;
+    VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkQueue m_queue = VK_NULL_HANDLE;
+    uint32_t m_queueFamily = 0;
+    VkCommandPool m_commandPool = VK_NULL_HANDLE;
+    VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties m_memoryProperties = {};
+    // Destroyed in reverse creation order before the device
+    std::vector<std::function<void()>> m_cleanup;
+};
+#endif // RENDER_ALGORITHM_TEST_VULKAN_TEST_DEVICE_H
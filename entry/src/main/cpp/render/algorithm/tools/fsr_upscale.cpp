@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Batch upscales images with the FSR CPU reference, e.g. for thumbnails on a server:
+//   fsr_upscale --scale 1.5 --sharpness 0.4 -o out/ a.png b.jpg
+// Every input is written as <output dir>/<name>.ppm, alpha is dropped.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#ifndef STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#endif
+#include "stb_image.h"
+#include "fsr_cpu.h"
+
+namespace {
+constexpr float DEFAULT_SCALE = 1.5f;
+constexpr float DEFAULT_SHARPNESS = 0.4f;
+
+struct Options {
+    float scale = DEFAULT_SCALE;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    float sharpness = DEFAULT_SHARPNESS;
+    uint32_t threadCount = 0;
+    std::string outputDir = ".";
+    std::vector<std::string> inputs;
+};
+
+void PrintUsage(const char *program)
+{
+    fprintf(stderr,
+        "usage: %s [options] input...\n"
+        "  --scale S        output is S times the input size (default %.1f)\n"
+        "  --size WxH       fixed output size, overrides --scale\n"
+        "  --sharpness X    RCAS sharpening amount, 0 disables it (default %.1f)\n"
+        "  --threads N      worker threads, 0 is one per hardware thread (default 0)\n"
+        "  -o DIR           output directory (default .)\n",
+        program, DEFAULT_SCALE, DEFAULT_SHARPNESS);
+}
+
+bool ParseOptions(int argc, char **argv, Options &options)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--scale" && hasValue) {
+            options.scale = strtof(argv[++i], nullptr);
+            if (!(options.scale > 0.0f)) {
+                return false;
+            }
+        } else if (arg == "--size" && hasValue) {
+            unsigned width = 0;
+            unsigned height = 0;
+            if (sscanf(argv[++i], "%ux%u", &width, &height) != 2 || width == 0 || height == 0) {
+                return false;
+            }
+            options.width = width;
+            options.height = height;
+        } else if (arg == "--sharpness" && hasValue) {
+            options.sharpness = strtof(argv[++i], nullptr);
+        } else if (arg == "--threads" && hasValue) {
+            options.threadCount = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "-o" && hasValue) {
+            options.outputDir = argv[++i];
+        } else if (!arg.empty() && arg[0] == '-') {
+            return false;
+        } else {
+            options.inputs.push_back(arg);
+        }
+    }
+    return !options.inputs.empty();
+}
+
+std::string OutputPath(const std::string &outputDir, const std::string &input)
+{
+    size_t slash = input.find_last_of("/\\");
+    std::string name = slash == std::string::npos ? input : input.substr(slash + 1);
+    size_t dot = name.find_last_of('.');
+    if (dot != std::string::npos && dot != 0) {
+        name = name.substr(0, dot);
+    }
+    if (!outputDir.empty() && outputDir.back() != '/') {
+        return outputDir + "/" + name + ".ppm";
+    }
+    return outputDir + name + ".ppm";
+}
+
+bool WritePPM(const std::string &path, const std::vector<uint8_t> &rgba, uint32_t width, uint32_t height)
+{
+    FILE *file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    fprintf(file, "P6\n%u %u\n255\n", width, height);
+    std::vector<uint8_t> row(static_cast<size_t>(width) * 3);
+    bool ok = true;
+    for (uint32_t y = 0; y < height && ok; y++) {
+        const uint8_t *src = rgba.data() + static_cast<size_t>(y) * width * 4;
+        for (uint32_t x = 0; x < width; x++) {
+            memcpy(&row[x * 3], &src[x * 4], 3);
+        }
+        ok = fwrite(row.data(), 1, row.size(), file) == row.size();
+    }
+    return fclose(file) == 0 && ok;
+}
+
+bool UpscaleFile(const Options &options, const std::string &input)
+{
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    stbi_uc *pixels = stbi_load(input.c_str(), &width, &height, &channels, 4);
+    if (pixels == nullptr) {
+        fprintf(stderr, "%s: %s\n", input.c_str(), stbi_failure_reason());
+        return false;
+    }
+    FSRCpu::InitParams params;
+    params.inputRegion.extent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height) };
+    if (options.width != 0) {
+        params.outputSize = { options.width, options.height };
+    } else {
+        params.outputSize.width = std::max(1u, static_cast<uint32_t>(std::lround(width * options.scale)));
+        params.outputSize.height = std::max(1u, static_cast<uint32_t>(std::lround(height * options.scale)));
+    }
+    params.outputRegion.extent = params.outputSize;
+    params.sharpness = options.sharpness;
+    params.threadCount = options.threadCount;
+
+    FSRCpu fsr;
+    fsr.Init(params);
+    std::vector<uint8_t> output;
+    auto start = std::chrono::steady_clock::now();
+    bool upscaled = fsr.UpscaleRGBA8(pixels, width, height, output);
+    auto end = std::chrono::steady_clock::now();
+    stbi_image_free(pixels);
+    if (!upscaled) {
+        fprintf(stderr, "%s: %s\n", input.c_str(), fsr.GetError().c_str());
+        return false;
+    }
+    std::string path = OutputPath(options.outputDir, input);
+    if (!WritePPM(path, output, params.outputSize.width, params.outputSize.height)) {
+        fprintf(stderr, "%s: cannot write %s\n", input.c_str(), path.c_str());
+        return false;
+    }
+    printf("%s: %d x %d -> %u x %u in %.1f ms, %s\n", input.c_str(), width, height, params.outputSize.width,
+        params.outputSize.height, std::chrono::duration<double, std::milli>(end - start).count(), path.c_str());
+    return true;
+}
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    size_t failed = 0;
+    for (const std::string &input : options.inputs) {
+        if (!UpscaleFile(options, input)) {
+            failed++;
+        }
+    }
+    if (failed != 0) {
+        fprintf(stderr, "%zu of %zu images failed\n", failed, options.inputs.size());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "async_readback.h"
+#include <cstring>
+#include "VulkanTools.h"
+#include "common/common.h"
+#include "memory_tracker.h"
+
+AsyncReadback::~AsyncReadback()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_jobMutex);
+        m_stop = true;
+    }
+    m_jobCondition.notify_all();
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+    if (m_device == VK_NULL_HANDLE) {
+        return;
+    }
+    for (auto &slot : m_slots) {
+        if (slot.busy) {
+            vkWaitForFences(m_device, 1, &slot.fence, VK_TRUE, UINT64_MAX);
+        }
+        if (slot.mapped != nullptr) {
+            vkUnmapMemory(m_device, slot.memory);
+        }
+        vkDestroyBuffer(m_device, slot.buffer, nullptr);
+        vkFreeMemory(m_device, slot.memory, nullptr);
+        vkDestroyFence(m_device, slot.fence, nullptr);
+    }
+    vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+}
+
+bool AsyncReadback::Init(const InitParams &initParams)
+{
+    m_vulkanDevice = initParams.vulkanDevice;
+    m_device = initParams.vulkanDevice->logicalDevice;
+    m_queue = initParams.queue;
+    m_slotSize = initParams.slotSize;
+
+    VkCommandPoolCreateInfo cmdPoolInfo = {};
+    cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    cmdPoolInfo.queueFamilyIndex = m_vulkanDevice->queueFamilyIndices.graphics;
+    cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    VK_CHECK_RESULT(vkCreateCommandPool(m_device, &cmdPoolInfo, nullptr, &m_commandPool));
+
+    m_slots.resize(initParams.slotCount);
+    for (auto &slot : m_slots) {
+        if (!CreateSlot(slot)) {
+            return false;
+        }
+    }
+    m_worker = std::thread(&AsyncReadback::WorkerLoop, this);
+    return true;
+}
+
+bool AsyncReadback::CreateSlot(Slot &slot)
+{
+    VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        m_slotSize);
+    VK_CHECK_RESULT(vkCreateBuffer(m_device, &bufferCreateInfo, nullptr, &slot.buffer));
+
+    // Host cached memory makes the CPU read fast, coherent memory is the fallback every device has.
+    VkMemoryRequirements memReqs;
+    vkGetBufferMemoryRequirements(m_device, slot.buffer, &memReqs);
+    VkBool32 found = VK_FALSE;
+    uint32_t memoryType = m_vulkanDevice->getMemoryType(memReqs.memoryTypeBits,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, &found);
+    m_coherent = !found;
+    if (!found) {
+        memoryType = m_vulkanDevice->getMemoryType(memReqs.memoryTypeBits,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &found);
+    }
+    if (!found) {
+        LOGE("AsyncReadback CreateSlot: no host visible memory type");
+        return false;
+    }
+    VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+    memAlloc.allocationSize = memReqs.size;
+    memAlloc.memoryTypeIndex = memoryType;
+    MemoryCategoryScope memoryScope(MEMORY_CATEGORY_STAGING);
+    VK_CHECK_RESULT(vkAllocateMemory(m_device, &memAlloc, nullptr, &slot.memory));
+    VK_CHECK_RESULT(vkBindBufferMemory(m_device, slot.buffer, slot.memory, 0));
+    VK_CHECK_RESULT(vkMapMemory(m_device, slot.memory, 0, VK_WHOLE_SIZE, 0, &slot.mapped));
+
+    VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(0);
+    VK_CHECK_RESULT(vkCreateFence(m_device, &fenceInfo, nullptr, &slot.fence));
+
+    VkCommandBufferAllocateInfo cmdBufAllocateInfo =
+        vks::initializers::commandBufferAllocateInfo(m_commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+    VK_CHECK_RESULT(vkAllocateCommandBuffers(m_device, &cmdBufAllocateInfo, &slot.cmdBuffer));
+    return true;
+}
+
+bool AsyncReadback::RequestImage(VkImage image, VkExtent2D extent, uint32_t texelSize, VkImageLayout layout,
+    Callback callback)
+{
+    VkDeviceSize size = static_cast<VkDeviceSize>(extent.width) * extent.height * texelSize;
+    if (size > m_slotSize) {
+        LOGE("AsyncReadback RequestImage: %{public}llu bytes do not fit a slot", static_cast<unsigned long long>(size));
+        return false;
+    }
+    Slot *slot = nullptr;
+    for (auto &candidate : m_slots) {
+        if (!candidate.busy) {
+            slot = &candidate;
+            break;
+        }
+    }
+    if (slot == nullptr) {
+        LOGW("AsyncReadback RequestImage: all slots in flight, request dropped");
+        return false;
+    }
+
+    VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+    cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK_RESULT(vkBeginCommandBuffer(slot->cmdBuffer, &cmdBufInfo));
+
+    // The image was written by earlier submissions on the same queue, make those writes visible to the copy.
+    VkImageSubresourceRange subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    VkImageMemoryBarrier imageBarrier = vks::initializers::imageMemoryBarrier();
+    imageBarrier.image = image;
+    imageBarrier.subresourceRange = subresourceRange;
+    imageBarrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+    imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    imageBarrier.oldLayout = layout;
+    imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    vkCmdPipelineBarrier(slot->cmdBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+        nullptr, 0, nullptr, 1, &imageBarrier);
+
+    VkBufferImageCopy region{};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = {extent.width, extent.height, 1};
+    vkCmdCopyImageToBuffer(slot->cmdBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->buffer, 1, &region);
+
+    imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    imageBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    imageBarrier.newLayout = layout;
+    VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+    bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    bufferBarrier.buffer = slot->buffer;
+    bufferBarrier.size = size;
+    vkCmdPipelineBarrier(slot->cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 1,
+        &imageBarrier);
+    VK_CHECK_RESULT(vkEndCommandBuffer(slot->cmdBuffer));
+
+    VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &slot->cmdBuffer;
+    VkResult res;
+    {
+        std::lock_guard<std::mutex> lock(m_vulkanDevice->queueMutex);
+        res = vkQueueSubmit(m_queue, 1, &submitInfo, slot->fence);
+    }
+    if (res != VK_SUCCESS) {
+        LOGE("AsyncReadback RequestImage: vkQueueSubmit failed, result: %{public}d", res);
+        return false;
+    }
+    slot->busy = true;
+    slot->size = size;
+    slot->callback = std::move(callback);
+    return true;
+}
+
+void AsyncReadback::Poll()
+{
+    for (auto &slot : m_slots) {
+        if (!slot.busy || vkGetFenceStatus(m_device, slot.fence) != VK_SUCCESS) {
+            continue;
+        }
+        if (!m_coherent) {
+            VkMappedMemoryRange range = vks::initializers::mappedMemoryRange();
+            range.memory = slot.memory;
+            range.offset = 0;
+            range.size = VK_WHOLE_SIZE;
+            vkInvalidateMappedMemoryRanges(m_device, 1, &range);
+        }
+        Job job;
+        job.callback = std::move(slot.callback);
+        const uint8_t *bytes = static_cast<const uint8_t *>(slot.mapped);
+        job.data.assign(bytes, bytes + slot.size);
+        vkResetFences(m_device, 1, &slot.fence);
+        slot.busy = false;
+        {
+            std::lock_guard<std::mutex> lock(m_jobMutex);
+            m_jobs.push_back(std::move(job));
+        }
+        m_jobCondition.notify_one();
+    }
+}
+
+uint32_t AsyncReadback::GetPendingCount() const
+{
+    uint32_t count = 0;
+    for (auto &slot : m_slots) {
+        count += slot.busy ? 1 : 0;
+    }
+    return count;
+}
+
+void AsyncReadback::WorkerLoop()
+{
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_jobMutex);
+            m_jobCondition.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+            if (m_jobs.empty()) {
+                // Only reached when stopping, queued jobs are still written out before that.
+                return;
+            }
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+        if (job.callback) {
+            job.callback(job.data);
+        }
+    }
+}
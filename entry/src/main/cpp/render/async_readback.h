@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RENDER_ASYNC_READBACK_H
+#define RENDER_ASYNC_READBACK_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+
+// Copies images back to the host without stalling the render thread.
+// RequestImage records the copy into a free slot of a staging ring and submits it with a fence, Poll picks up
+// finished slots and hands their bytes to a worker thread, which runs the callback (e.g. writing a file).
+// All Vulkan calls happen on the thread that calls RequestImage and Poll, which must own the queue.
+class AsyncReadback {
+public:
+    using Callback = std::function<void(std::vector<uint8_t> &data)>;
+
+    struct InitParams {
+        vks::VulkanDevice *vulkanDevice;
+        VkQueue queue;
+        uint32_t slotCount;
+        VkDeviceSize slotSize;
+    };
+
+    AsyncReadback() {}
+    ~AsyncReadback();
+
+    bool Init(const InitParams &initParams);
+    // Copies mip 0 / layer 0 of a color image, tightly packed. The image is in layout before and after the copy.
+    // Returns false when every slot is still in flight or the image does not fit a slot.
+    bool RequestImage(VkImage image, VkExtent2D extent, uint32_t texelSize, VkImageLayout layout,
+        Callback callback);
+    // Never blocks on the GPU.
+    void Poll();
+    uint32_t GetPendingCount() const;
+
+private:
+    struct Slot {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void *mapped = nullptr;
+        VkFence fence = VK_NULL_HANDLE;
+        VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        bool busy = false;
+        Callback callback;
+    };
+    struct Job {
+        Callback callback;
+        std::vector<uint8_t> data;
+    };
+
+    bool CreateSlot(Slot &slot);
+    void WorkerLoop();
+
+    vks::VulkanDevice *m_vulkanDevice = nullptr;
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkQueue m_queue = VK_NULL_HANDLE;
+    VkCommandPool m_commandPool = VK_NULL_HANDLE;
+    VkDeviceSize m_slotSize = 0;
+    bool m_coherent = false;
+    std::vector<Slot> m_slots;
+
+    std::thread m_worker;
+    std::mutex m_jobMutex;
+    std::condition_variable m_jobCondition;
+    std::deque<Job> m_jobs;
+    bool m_stop = false;
+};
+#endif // RENDER_ASYNC_READBACK_H
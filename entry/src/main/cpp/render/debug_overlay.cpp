@@ -0,0 +1,468 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "debug_overlay.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include "VulkanTools.h"
+#include "common/common.h"
+#include "file/file_operator.h"
+#ifdef DEBUG_OVERLAY_FREETYPE
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#endif
+
+namespace {
+constexpr uint32_t ATLAS_COLUMNS = 16;
+constexpr uint32_t ATLAS_ROWS = 6;
+constexpr uint32_t FIRST_CHAR = 32; // the atlas covers printable ASCII, 32 to 127
+constexpr uint32_t CHAR_COUNT = ATLAS_COLUMNS * ATLAS_ROWS;
+constexpr uint32_t MODE_SOLID = 0;
+constexpr uint32_t MODE_GLYPH = 1;
+constexpr uint32_t MODE_TARGET = 2; // + View - VIEW_SHADING_RATE, see overlay.frag
+constexpr uint32_t BUILTIN_GLYPH_WIDTH = 3;
+constexpr uint32_t BUILTIN_GLYPH_HEIGHT = 5;
+
+#ifdef DEBUG_OVERLAY_FREETYPE
+constexpr uint32_t FREETYPE_PIXEL_SIZE = 24;
+const char *const FONT_PATHS[] = {
+    "/system/fonts/HarmonyOS_Sans.ttf",
+    "/system/fonts/HarmonyOS_Sans_SC_Regular.ttf",
+};
+#endif
+
+// 3x5 glyphs for characters 32 to 95, one row per entry with the leftmost pixel in bit 2.
+// Lower case letters use the upper case glyphs.
+const uint8_t BUILTIN_FONT[64][BUILTIN_GLYPH_HEIGHT] = {
+    {0, 0, 0, 0, 0}, {2, 2, 2, 0, 2}, {5, 5, 0, 0, 0}, {5, 7, 5, 7, 5}, // space ! " #
+    {3, 6, 2, 3, 6}, {5, 1, 2, 4, 5}, {2, 5, 2, 5, 3}, {2, 2, 0, 0, 0}, // $ % & '
+    {1, 2, 2, 2, 1}, {4, 2, 2, 2, 4}, {0, 5, 2, 5, 0}, {0, 2, 7, 2, 0}, // ( ) * +
+    {0, 0, 0, 2, 4}, {0, 0, 7, 0, 0}, {0, 0, 0, 0, 2}, {1, 1, 2, 4, 4}, // , - . /
+    {7, 5, 5, 5, 7}, {2, 6, 2, 2, 7}, {7, 1, 7, 4, 7}, {7, 1, 3, 1, 7}, // 0 1 2 3
+    {5, 5, 7, 1, 1}, {7, 4, 7, 1, 7}, {7, 4, 7, 5, 7}, {7, 1, 1, 1, 1}, // 4 5 6 7
+    {7, 5, 7, 5, 7}, {7, 5, 7, 1, 7}, {0, 2, 0, 2, 0}, {0, 2, 0, 2, 4}, // 8 9 : ;
+    {1, 2, 4, 2, 1}, {0, 7, 0, 7, 0}, {4, 2, 1, 2, 4}, {7, 1, 3, 0, 2}, // < = > ?
+    {7, 5, 7, 4, 7}, {2, 5, 7, 5, 5}, {6, 5, 6, 5, 6}, {3, 4, 4, 4, 3}, // @ A B C
+    {6, 5, 5, 5, 6}, {7, 4, 6, 4, 7}, {7, 4, 6, 4, 4}, {3, 4, 5, 5, 3}, // D E F G
+    {5, 5, 7, 5, 5}, {7, 2, 2, 2, 7}, {1, 1, 1, 5, 2}, {5, 5, 6, 5, 5}, // H I J K
+    {4, 4, 4, 4, 7}, {5, 7, 7, 5, 5}, {6, 5, 5, 5, 5}, {2, 5, 5, 5, 2}, // L M N O
+    {6, 5, 6, 4, 4}, {2, 5, 5, 6, 3}, {6, 5, 6, 5, 5}, {3, 4, 2, 1, 6}, // P Q R S
+    {7, 2, 2, 2, 2}, {5, 5, 5, 5, 7}, {5, 5, 5, 5, 2}, {5, 5, 7, 7, 5}, // T U V W
+    {5, 5, 2, 5, 5}, {5, 5, 2, 2, 2}, {7, 1, 2, 4, 7}, {6, 4, 4, 4, 6}, // X Y Z [
+    {4, 4, 2, 1, 1}, {3, 1, 1, 1, 3}, {2, 5, 0, 0, 0}, {0, 0, 0, 0, 7}, // \ ] ^ _
+};
+}
+
+DebugOverlay::~DebugOverlay()
+{
+    if (m_device == VK_NULL_HANDLE) {
+        return;
+    }
+    vkDestroyPipeline(m_device, m_pipeline, nullptr);
+    vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_descriptorSetLayout, nullptr);
+    vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+    vkDestroySampler(m_device, m_nearestSampler, nullptr);
+    m_vertexBuffer.destroy();
+    m_indirectBuffer.destroy();
+    m_glyphAtlas.destroy();
+}
+
+bool DebugOverlay::Init(const InitParams &initParams)
+{
+    m_vulkanDevice = initParams.vulkanDevice;
+    m_device = initParams.vulkanDevice->logicalDevice;
+    m_queue = initParams.queue;
+    m_screenSize = initParams.screenSize;
+
+    if (!CreateGlyphAtlas()) {
+        return false;
+    }
+    VK_CHECK_RESULT(m_vulkanDevice->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &m_vertexBuffer,
+        sizeof(Vertex) * 6 * DEBUG_OVERLAY_MAX_QUADS));
+    VK_CHECK_RESULT(m_vertexBuffer.map());
+    VK_CHECK_RESULT(m_vulkanDevice->createBuffer(VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &m_indirectBuffer,
+        sizeof(VkDrawIndirectCommand)));
+    VK_CHECK_RESULT(m_indirectBuffer.map());
+    m_vertices.reserve(6 * DEBUG_OVERLAY_MAX_QUADS);
+    Begin();
+    End();
+
+    SetupDescriptors(initParams);
+    return PreparePipeline(initParams.renderPass, initParams.pipelineCache);
+}
+
+const char *DebugOverlay::ViewName(uint32_t view)
+{
+    static const char *const names[VIEW_COUNT] = {"NONE", "SHADING RATE", "POSITION", "NORMAL", "ALBEDO",
+        "VIEW NORMAL"};
+    return view < VIEW_COUNT ? names[view] : "UNKNOWN";
+}
+
+bool DebugOverlay::CreateGlyphAtlas()
+{
+    std::vector<uint8_t> pixels;
+    bool freetype = RasterizeFreetype(pixels);
+    if (!freetype) {
+        RasterizeBuiltin(pixels);
+    }
+    uint32_t atlasWidth = m_cellWidth * ATLAS_COLUMNS;
+    uint32_t atlasHeight = m_cellHeight * ATLAS_ROWS;
+    m_glyphs.resize(CHAR_COUNT);
+    for (uint32_t i = 0; i < CHAR_COUNT; i++) {
+        uint32_t column = i % ATLAS_COLUMNS;
+        uint32_t row = i / ATLAS_COLUMNS;
+        m_glyphs[i].u0 = static_cast<float>(column) / ATLAS_COLUMNS;
+        m_glyphs[i].v0 = static_cast<float>(row) / ATLAS_ROWS;
+        m_glyphs[i].u1 = static_cast<float>(column + 1) / ATLAS_COLUMNS;
+        m_glyphs[i].v1 = static_cast<float>(row + 1) / ATLAS_ROWS;
+    }
+    // Pixel fonts are magnified, keep their edges sharp
+    m_glyphAtlas.fromBuffer(pixels.data(), pixels.size(), VK_FORMAT_R8_UNORM, atlasWidth, atlasHeight,
+        m_vulkanDevice, m_queue, freetype ? VK_FILTER_LINEAR : VK_FILTER_NEAREST);
+    LOGI("DebugOverlay glyph atlas %{public}ux%{public}u, %{public}s", atlasWidth, atlasHeight,
+        freetype ? "freetype" : "built-in font");
+    return true;
+}
+
+bool DebugOverlay::RasterizeFreetype(std::vector<uint8_t> &pixels)
+{
+#ifdef DEBUG_OVERLAY_FREETYPE
+    FT_Library library;
+    if (FT_Init_FreeType(&library) != 0) {
+        LOGE("DebugOverlay RasterizeFreetype: FT_Init_FreeType failed");
+        return false;
+    }
+    FT_Face face = nullptr;
+    for (const char *path : FONT_PATHS) {
+        if (FT_New_Face(library, path, 0, &face) == 0) {
+            break;
+        }
+        face = nullptr;
+    }
+    if (face == nullptr || FT_Set_Pixel_Sizes(face, 0, FREETYPE_PIXEL_SIZE) != 0) {
+        LOGW("DebugOverlay RasterizeFreetype: no usable system font, falling back to the built-in font");
+        if (face != nullptr) {
+            FT_Done_Face(face);
+        }
+        FT_Done_FreeType(library);
+        return false;
+    }
+
+    // Text is laid out on a fixed grid, the cell fits the widest advance and the full line height
+    int32_t ascender = static_cast<int32_t>(face->size->metrics.ascender >> 6);
+    int32_t descender = static_cast<int32_t>(face->size->metrics.descender >> 6);
+    uint32_t maxAdvance = 0;
+    for (uint32_t c = FIRST_CHAR; c < FIRST_CHAR + CHAR_COUNT; c++) {
+        if (FT_Load_Char(face, c, FT_LOAD_DEFAULT) == 0) {
+            maxAdvance = std::max(maxAdvance, static_cast<uint32_t>(face->glyph->advance.x >> 6));
+        }
+    }
+    m_cellWidth = std::max(maxAdvance, 1u);
+    m_cellHeight = static_cast<uint32_t>(std::max(ascender - descender, 1));
+    uint32_t atlasWidth = m_cellWidth * ATLAS_COLUMNS;
+    pixels.assign(static_cast<size_t>(atlasWidth) * m_cellHeight * ATLAS_ROWS, 0);
+
+    for (uint32_t i = 0; i < CHAR_COUNT; i++) {
+        if (FT_Load_Char(face, FIRST_CHAR + i, FT_LOAD_RENDER) != 0) {
+            continue;
+        }
+        const FT_Bitmap &bitmap = face->glyph->bitmap;
+        int32_t originX = static_cast<int32_t>((i % ATLAS_COLUMNS) * m_cellWidth) + face->glyph->bitmap_left;
+        int32_t originY = static_cast<int32_t>((i / ATLAS_COLUMNS) * m_cellHeight) + ascender - face->glyph->bitmap_top;
+        int32_t cellX = static_cast<int32_t>((i % ATLAS_COLUMNS) * m_cellWidth);
+        int32_t cellY = static_cast<int32_t>((i / ATLAS_COLUMNS) * m_cellHeight);
+        for (uint32_t y = 0; y < bitmap.rows; y++) {
+            int32_t dstY = originY + static_cast<int32_t>(y);
+            if (dstY < cellY || dstY >= cellY + static_cast<int32_t>(m_cellHeight)) {
+                continue;
+            }
+            for (uint32_t x = 0; x < bitmap.width; x++) {
+                int32_t dstX = originX + static_cast<int32_t>(x);
+                if (dstX < cellX || dstX >= cellX + static_cast<int32_t>(m_cellWidth)) {
+                    continue;
+                }
+                pixels[static_cast<size_t>(dstY) * atlasWidth + dstX] = bitmap.buffer[y * bitmap.pitch + x];
+            }
+        }
+    }
+    FT_Done_Face(face);
+    FT_Done_FreeType(library);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void DebugOverlay::RasterizeBuiltin(std::vector<uint8_t> &pixels)
+{
+    // One pixel of spacing right of and below every glyph
+    m_cellWidth = BUILTIN_GLYPH_WIDTH + 1;
+    m_cellHeight = BUILTIN_GLYPH_HEIGHT + 1;
+    uint32_t atlasWidth = m_cellWidth * ATLAS_COLUMNS;
+    pixels.assign(static_cast<size_t>(atlasWidth) * m_cellHeight * ATLAS_ROWS, 0);
+    for (uint32_t i = 0; i < CHAR_COUNT; i++) {
+        uint32_t c = FIRST_CHAR + i;
+        if (c >= 'a' && c <= 'z') {
+            c -= 'a' - 'A';
+        }
+        if (c - FIRST_CHAR >= sizeof(BUILTIN_FONT) / sizeof(BUILTIN_FONT[0])) {
+            continue;
+        }
+        const uint8_t *rows = BUILTIN_FONT[c - FIRST_CHAR];
+        uint32_t cellX = (i % ATLAS_COLUMNS) * m_cellWidth;
+        uint32_t cellY = (i / ATLAS_COLUMNS) * m_cellHeight;
+        for (uint32_t y = 0; y < BUILTIN_GLYPH_HEIGHT; y++) {
+            for (uint32_t x = 0; x < BUILTIN_GLYPH_WIDTH; x++) {
+                if (rows[y] & (1u << (BUILTIN_GLYPH_WIDTH - 1 - x))) {
+                    pixels[static_cast<size_t>(cellY + y) * atlasWidth + cellX + x] = 0xff;
+                }
+            }
+        }
+    }
+}
+
+void DebugOverlay::SetupDescriptors(const InitParams &initParams)
+{
+    // Shading rates are integers, G-Buffer targets are shown texel by texel
+    VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
+    sampler.magFilter = VK_FILTER_NEAREST;
+    sampler.minFilter = VK_FILTER_NEAREST;
+    sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler.addressModeV = sampler.addressModeU;
+    sampler.addressModeW = sampler.addressModeU;
+    sampler.maxAnisotropy = 1.0f;
+    sampler.minLod = 0.0f;
+    sampler.maxLod = 1.0f;
+    sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    VK_CHECK_RESULT(vkCreateSampler(m_device, &sampler, nullptr, &m_nearestSampler));
+
+    std::vector<VkDescriptorPoolSize> poolSizes = {
+        vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            6 * DEBUG_OVERLAY_TARGET_SETS),
+    };
+    VkDescriptorPoolCreateInfo descriptorPoolInfo =
+        vks::initializers::descriptorPoolCreateInfo(poolSizes, DEBUG_OVERLAY_TARGET_SETS);
+    VK_CHECK_RESULT(vkCreateDescriptorPool(m_device, &descriptorPoolInfo, nullptr, &m_descriptorPool));
+
+    // 0: glyph atlas, 1: shading rate image, 2-5: position, normal, albedo, view normal
+    std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings;
+    for (uint32_t binding = 0; binding < 6; binding++) {
+        setLayoutBindings.push_back(vks::initializers::descriptorSetLayoutBinding(
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, binding));
+    }
+    VkDescriptorSetLayoutCreateInfo setLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(
+        setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+    VK_CHECK_RESULT(vkCreateDescriptorSetLayout(m_device, &setLayoutCreateInfo, nullptr, &m_descriptorSetLayout));
+
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo();
+    pipelineLayoutCreateInfo.pSetLayouts = &m_descriptorSetLayout;
+    pipelineLayoutCreateInfo.setLayoutCount = 1;
+    VK_CHECK_RESULT(vkCreatePipelineLayout(m_device, &pipelineLayoutCreateInfo, nullptr, &m_pipelineLayout));
+
+    for (uint32_t i = 0; i < DEBUG_OVERLAY_TARGET_SETS; i++) {
+        VkDescriptorSetAllocateInfo descriptorAllocInfo =
+            vks::initializers::descriptorSetAllocateInfo(m_descriptorPool, &m_descriptorSetLayout, 1);
+        VK_CHECK_RESULT(vkAllocateDescriptorSets(m_device, &descriptorAllocInfo, &m_descriptorSets[i]));
+
+        const Targets &targets = initParams.targets[i];
+        std::array<VkDescriptorImageInfo, 6> imageDescriptors = {
+            m_glyphAtlas.descriptor,
+            vks::initializers::descriptorImageInfo(m_nearestSampler, targets.shadingRate,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+            vks::initializers::descriptorImageInfo(m_nearestSampler, targets.position,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+            vks::initializers::descriptorImageInfo(m_nearestSampler, targets.normal,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+            vks::initializers::descriptorImageInfo(m_nearestSampler, targets.albedo,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+            vks::initializers::descriptorImageInfo(m_nearestSampler, targets.viewNormal,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+        };
+        std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+        for (uint32_t binding = 0; binding < imageDescriptors.size(); binding++) {
+            writeDescriptorSets.push_back(vks::initializers::writeDescriptorSet(m_descriptorSets[i],
+                VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, binding, &imageDescriptors[binding]));
+        }
+        vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writeDescriptorSets.size()),
+            writeDescriptorSets.data(), 0, nullptr);
+    }
+}
+
+bool DebugOverlay::PreparePipeline(VkRenderPass renderPass, VkPipelineCache pipelineCache)
+{
+    std::string vsShader = FileOperator::GetInstance()->GetFileAbsolutePath("shader/overlay.vert.spv");
+    std::string fsShader = FileOperator::GetInstance()->GetFileAbsolutePath("shader/overlay.frag.spv");
+    std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages = {};
+    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = vks::tools::loadShader(vsShader.c_str(), m_device);
+    shaderStages[0].pName = "main";
+    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = vks::tools::loadShader(fsShader.c_str(), m_device);
+    shaderStages[1].pName = "main";
+    if (shaderStages[0].module == VK_NULL_HANDLE || shaderStages[1].module == VK_NULL_HANDLE) {
+        LOGE("DebugOverlay PreparePipeline: failed to load %{public}s or %{public}s", vsShader.c_str(),
+            fsShader.c_str());
+        vkDestroyShaderModule(m_device, shaderStages[0].module, nullptr);
+        vkDestroyShaderModule(m_device, shaderStages[1].module, nullptr);
+        return false;
+    }
+
+    VkVertexInputBindingDescription vertexInputBinding =
+        vks::initializers::vertexInputBindingDescription(0, sizeof(Vertex), VK_VERTEX_INPUT_RATE_VERTEX);
+    std::array<VkVertexInputAttributeDescription, 4> vertexInputAttributes = {
+        vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, pos)),
+        vks::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, uv)),
+        vks::initializers::vertexInputAttributeDescription(0, 2, VK_FORMAT_R8G8B8A8_UNORM, offsetof(Vertex, color)),
+        vks::initializers::vertexInputAttributeDescription(0, 3, VK_FORMAT_R32_UINT, offsetof(Vertex, mode)),
+    };
+    VkPipelineVertexInputStateCreateInfo vertexInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
+    vertexInputState.vertexBindingDescriptionCount = 1;
+    vertexInputState.pVertexBindingDescriptions = &vertexInputBinding;
+    vertexInputState.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexInputAttributes.size());
+    vertexInputState.pVertexAttributeDescriptions = vertexInputAttributes.data();
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssemblyState =
+        vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+    VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(
+        VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+    VkPipelineColorBlendAttachmentState blendAttachmentState =
+        vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_TRUE);
+    blendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    blendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
+    blendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    blendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
+    VkPipelineColorBlendStateCreateInfo colorBlendState =
+        vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
+    // Always on top of the frame
+    VkPipelineDepthStencilStateCreateInfo depthStencilState =
+        vks::initializers::pipelineDepthStencilStateCreateInfo(VK_FALSE, VK_FALSE, VK_COMPARE_OP_ALWAYS);
+    VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+    VkPipelineMultisampleStateCreateInfo multisampleState =
+        vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
+    std::vector<VkDynamicState> dynamicStateEnables = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamicState =
+        vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
+
+    VkGraphicsPipelineCreateInfo pipelineCreateInfo =
+        vks::initializers::pipelineCreateInfo(m_pipelineLayout, renderPass, 0);
+    pipelineCreateInfo.pVertexInputState = &vertexInputState;
+    pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
+    pipelineCreateInfo.pRasterizationState = &rasterizationState;
+    pipelineCreateInfo.pColorBlendState = &colorBlendState;
+    pipelineCreateInfo.pMultisampleState = &multisampleState;
+    pipelineCreateInfo.pViewportState = &viewportState;
+    pipelineCreateInfo.pDepthStencilState = &depthStencilState;
+    pipelineCreateInfo.pDynamicState = &dynamicState;
+    pipelineCreateInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+    pipelineCreateInfo.pStages = shaderStages.data();
+    VkResult res = vkCreateGraphicsPipelines(m_device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &m_pipeline);
+    vkDestroyShaderModule(m_device, shaderStages[0].module, nullptr);
+    vkDestroyShaderModule(m_device, shaderStages[1].module, nullptr);
+    if (res != VK_SUCCESS) {
+        LOGE("DebugOverlay PreparePipeline: vkCreateGraphicsPipelines failed, result: %{public}d", res);
+        m_pipeline = VK_NULL_HANDLE;
+        return false;
+    }
+    return true;
+}
+
+void DebugOverlay::Begin()
+{
+    m_vertices.clear();
+}
+
+float DebugOverlay::Text(float x, float y, float height, const std::string &text, uint32_t color)
+{
+    float scale = height / static_cast<float>(m_cellHeight);
+    float advance = static_cast<float>(m_cellWidth) * scale;
+    for (char c : text) {
+        uint32_t index = static_cast<uint8_t>(c) - FIRST_CHAR;
+        if (index < CHAR_COUNT && c != ' ') {
+            PushQuad(x, y, advance, height, m_glyphs[index], color, MODE_GLYPH);
+        }
+        x += advance;
+    }
+    return x;
+}
+
+float DebugOverlay::TextWidth(size_t length, float height) const
+{
+    return static_cast<float>(length) * height * m_cellWidth / m_cellHeight;
+}
+
+void DebugOverlay::Rect(float x, float y, float width, float height, uint32_t color)
+{
+    PushQuad(x, y, width, height, {0.0f, 0.0f, 0.0f, 0.0f}, color, MODE_SOLID);
+}
+
+void DebugOverlay::Target(uint32_t view, float alpha)
+{
+    if (view == VIEW_NONE || view >= VIEW_COUNT) {
+        return;
+    }
+    uint32_t color = static_cast<uint32_t>(std::min(std::max(alpha, 0.0f), 1.0f) * 255.0f) << 24 | 0xffffff;
+    PushQuad(0.0f, 0.0f, static_cast<float>(m_screenSize.width), static_cast<float>(m_screenSize.height),
+        {0.0f, 0.0f, 1.0f, 1.0f}, color, MODE_TARGET + view - VIEW_SHADING_RATE);
+}
+
+void DebugOverlay::End()
+{
+    // The previous frame has completed, submitFrame waits for its fence, so the buffers can be overwritten
+    if (!m_vertices.empty()) {
+        memcpy(m_vertexBuffer.mapped, m_vertices.data(), m_vertices.size() * sizeof(Vertex));
+    }
+    VkDrawIndirectCommand drawCommand = {static_cast<uint32_t>(m_vertices.size()), 1, 0, 0};
+    memcpy(m_indirectBuffer.mapped, &drawCommand, sizeof(drawCommand));
+}
+
+void DebugOverlay::PushQuad(float x, float y, float width, float height, const Glyph &uv, uint32_t color,
+    uint32_t mode)
+{
+    if (m_vertices.size() + 6 > m_vertices.capacity()) {
+        return;
+    }
+    float x0 = x / m_screenSize.width * 2.0f - 1.0f;
+    float y0 = y / m_screenSize.height * 2.0f - 1.0f;
+    float x1 = (x + width) / m_screenSize.width * 2.0f - 1.0f;
+    float y1 = (y + height) / m_screenSize.height * 2.0f - 1.0f;
+    Vertex topLeft = {{x0, y0}, {uv.u0, uv.v0}, color, mode};
+    Vertex topRight = {{x1, y0}, {uv.u1, uv.v0}, color, mode};
+    Vertex bottomLeft = {{x0, y1}, {uv.u0, uv.v1}, color, mode};
+    Vertex bottomRight = {{x1, y1}, {uv.u1, uv.v1}, color, mode};
+    m_vertices.insert(m_vertices.end(), {topLeft, bottomLeft, topRight, topRight, bottomLeft, bottomRight});
+}
+
+void DebugOverlay::Draw(VkCommandBuffer commandBuffer, uint32_t targetSet)
+{
+    if (m_pipeline == VK_NULL_HANDLE) {
+        return;
+    }
+    VkDeviceSize offset = 0;
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1,
+        &m_descriptorSets[targetSet], 0, nullptr);
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_vertexBuffer.buffer, &offset);
+    vkCmdDrawIndirect(commandBuffer, m_indirectBuffer.buffer, 0, 1, sizeof(VkDrawIndirectCommand));
+}
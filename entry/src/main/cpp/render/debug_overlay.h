@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RENDER_DEBUG_OVERLAY_H
+#define RENDER_DEBUG_OVERLAY_H
+
+#include <string>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "VulkanBuffer.h"
+#include "VulkanDevice.h"
+#include "VulkanTexture.h"
+
+#define DEBUG_OVERLAY_MAX_QUADS 4096
+#define DEBUG_OVERLAY_TARGET_SETS 2 // native and upscale G-Buffer targets
+
+// Screen space debug overlay drawn at the end of the swapchain pass.
+// Text and bars are batched into a host visible vertex buffer every frame and drawn with one indirect draw, so the
+// recorded command buffers stay valid while the content changes. Glyphs come from an R8 atlas rasterized with
+// freetype when DEBUG_OVERLAY_FREETYPE is defined, or from a built-in 3x5 font otherwise. Besides text the overlay
+// can blend a heatmap of the shading rate image over the frame or show one of the G-Buffer targets.
+class DebugOverlay {
+public:
+    enum View : uint32_t {
+        VIEW_NONE = 0,
+        VIEW_SHADING_RATE,
+        VIEW_POSITION,
+        VIEW_NORMAL,
+        VIEW_ALBEDO,
+        VIEW_VIEW_NORMAL,
+        VIEW_COUNT
+    };
+
+    // Image views sampled by the target views in SHADER_READ_ONLY_OPTIMAL, the frame graph transitions the
+    // shading rate image around the swapchain pass while the overlay is on
+    struct Targets {
+        VkImageView shadingRate;
+        VkImageView position;
+        VkImageView normal;
+        VkImageView albedo;
+        VkImageView viewNormal;
+    };
+
+    struct InitParams {
+        vks::VulkanDevice *vulkanDevice;
+        VkQueue queue;
+        VkRenderPass renderPass; // swapchain pass
+        VkPipelineCache pipelineCache;
+        VkExtent2D screenSize;
+        Targets targets[DEBUG_OVERLAY_TARGET_SETS];
+    };
+
+    DebugOverlay() {}
+    ~DebugOverlay();
+
+    bool Init(const InitParams &initParams);
+    static const char *ViewName(uint32_t view);
+
+    // Content of the next frame, positions and sizes in pixels from the top left corner
+    void Begin();
+    // Colors are 0xAABBGGRR. Text is monospaced, Text returns the x coordinate after the last glyph.
+    float Text(float x, float y, float height, const std::string &text, uint32_t color);
+    float TextWidth(size_t length, float height) const;
+    void Rect(float x, float y, float width, float height, uint32_t color);
+    void Target(uint32_t view, float alpha);
+    void End();
+
+    // Recorded once into the command buffers
+    void Draw(VkCommandBuffer commandBuffer, uint32_t targetSet);
+
+private:
+    struct Vertex {
+        float pos[2];
+        float uv[2];
+        uint32_t color;
+        uint32_t mode;
+    };
+    struct Glyph {
+        float u0, v0, u1, v1;
+    };
+
+    bool CreateGlyphAtlas();
+    bool RasterizeFreetype(std::vector<uint8_t> &pixels);
+    void RasterizeBuiltin(std::vector<uint8_t> &pixels);
+    void SetupDescriptors(const InitParams &initParams);
+    bool PreparePipeline(VkRenderPass renderPass, VkPipelineCache pipelineCache);
+    void PushQuad(float x, float y, float width, float height, const Glyph &uv, uint32_t color, uint32_t mode);
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    vks::VulkanDevice *m_vulkanDevice = nullptr;
+    VkQueue m_queue = VK_NULL_HANDLE;
+    VkExtent2D m_screenSize = {0, 0};
+
+    vks::Texture2D m_glyphAtlas;
+    uint32_t m_cellWidth = 0;
+    uint32_t m_cellHeight = 0;
+    std::vector<Glyph> m_glyphs;
+
+    vks::Buffer m_vertexBuffer;
+    vks::Buffer m_indirectBuffer;
+    std::vector<Vertex> m_vertices;
+    VkSampler m_nearestSampler = VK_NULL_HANDLE;
+    VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSet m_descriptorSets[DEBUG_OVERLAY_TARGET_SETS] = {};
+    VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline m_pipeline = VK_NULL_HANDLE;
+};
+#endif // RENDER_DEBUG_OVERLAY_H
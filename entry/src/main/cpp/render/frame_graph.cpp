@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "frame_graph.h"
+#include "VulkanTools.h"
+#include "common/common.h"
+
+uint32_t FrameGraph::AddImage(const std::string &name, VkImage image, VkImageAspectFlags aspectMask,
+    VkImageLayout layout)
+{
+    m_images.push_back({name, image, aspectMask, layout});
+    return static_cast<uint32_t>(m_images.size() - 1);
+}
+
+uint32_t FrameGraph::AddPass(const std::string &name, uint32_t flags, const RecordFunc &record)
+{
+    Pass pass;
+    pass.name = name;
+    pass.flags = flags;
+    pass.record = record;
+    m_passes.push_back(pass);
+    return static_cast<uint32_t>(m_passes.size() - 1);
+}
+
+void FrameGraph::Read(uint32_t pass, uint32_t image, VkPipelineStageFlags stages, VkAccessFlags access,
+    VkImageLayout layout, VkImageLayout finalLayout)
+{
+    m_passes[pass].accesses.push_back({image, stages, access, layout, finalLayout, false, false});
+}
+
+void FrameGraph::Write(uint32_t pass, uint32_t image, VkPipelineStageFlags stages, VkAccessFlags access,
+    VkImageLayout layout, VkImageLayout finalLayout, bool discard)
+{
+    m_passes[pass].accesses.push_back({image, stages, access, layout, finalLayout, true, discard});
+}
+
+bool FrameGraph::Compile()
+{
+    Cull();
+
+    // The first walk finds the state a frame leaves the images in, the second one starts from it
+    std::vector<State> states(m_images.size());
+    for (size_t i = 0; i < m_images.size(); i++) {
+        states[i].layout = m_images[i].layout;
+    }
+    Simulate(states, false);
+
+    // First users of the images in a frame
+    std::vector<VkPipelineStageFlags> firstStages(m_images.size(), 0);
+    std::vector<VkAccessFlags> firstAccess(m_images.size(), 0);
+    for (const Pass &pass : m_passes) {
+        for (const Access &access : pass.accesses) {
+            if (!pass.culled && firstStages[access.image] == 0) {
+                firstStages[access.image] = access.stages;
+                firstAccess[access.image] = access.access;
+            }
+        }
+    }
+
+    m_endBarrier = Barrier();
+    for (size_t i = 0; i < m_images.size(); i++) {
+        const Image &image = m_images[i];
+        State &state = states[i];
+        if (image.layout == VK_IMAGE_LAYOUT_UNDEFINED) {
+            // The first writer of the next frame discards the content, it still waits for the last users
+            state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            continue;
+        }
+        if (state.layout == image.layout) {
+            continue;
+        }
+        // Back to the layout it rests in, made visible to its first user of the next frame. Users outside the
+        // graph, e.g. readbacks, wait for all commands of the frame.
+        AddTransition(m_endBarrier, image, state.layout, image.layout, state.writeAccess, firstAccess[i]);
+        m_endBarrier.srcStages |= state.writeStages | state.readStages;
+        m_endBarrier.dstStages |= firstStages[i];
+        state = State();
+        state.layout = image.layout;
+    }
+    bool valid = Simulate(states, true);
+
+    uint32_t culled = 0;
+    uint32_t imageBarriers = static_cast<uint32_t>(m_endBarrier.imageBarriers.size());
+    for (const Pass &pass : m_passes) {
+        culled += pass.culled ? 1 : 0;
+        imageBarriers += static_cast<uint32_t>(pass.barrier.imageBarriers.size());
+    }
+    LOGD("FrameGraph %{public}zu passes, %{public}u culled, %{public}u barriers with %{public}u image barriers",
+        m_passes.size(), culled, GetBarrierCount(), imageBarriers);
+    return valid;
+}
+
+uint32_t FrameGraph::GetBarrierCount() const
+{
+    uint32_t count = m_endBarrier.IsEmpty() ? 0 : 1;
+    for (const Pass &pass : m_passes) {
+        count += (pass.culled || pass.barrier.IsEmpty()) ? 0 : 1;
+    }
+    return count;
+}
+
+void FrameGraph::Execute(VkCommandBuffer commandBuffer, uint32_t index, const PassEndFunc &passEnd) const
+{
+    for (uint32_t i = 0; i < static_cast<uint32_t>(m_passes.size()); i++) {
+        const Pass &pass = m_passes[i];
+        if (!pass.culled) {
+            pass.barrier.Record(commandBuffer);
+            pass.record(commandBuffer, index);
+        }
+        if (passEnd) {
+            passEnd(commandBuffer, index, i);
+        }
+    }
+    m_endBarrier.Record(commandBuffer);
+}
+
+void FrameGraph::Cull()
+{
+    // Walk backwards, a pass is kept when it writes content a kept pass after it or the next frame reads
+    std::vector<bool> needed(m_images.size());
+    for (size_t i = 0; i < m_images.size(); i++) {
+        needed[i] = m_images[i].layout != VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+    for (auto pass = m_passes.rbegin(); pass != m_passes.rend(); pass++) {
+        bool used = (pass->flags & PASS_SIDE_EFFECTS) != 0;
+        for (const Access &access : pass->accesses) {
+            used = used || (access.write && needed[access.image]);
+        }
+        pass->culled = (pass->flags & PASS_DISABLED) != 0 || !used;
+        if (pass->culled) {
+            LOGD("FrameGraph pass %{public}s culled", pass->name.c_str());
+            continue;
+        }
+        for (const Access &access : pass->accesses) {
+            if (access.write && access.discard) {
+                needed[access.image] = false;
+            }
+        }
+        for (const Access &access : pass->accesses) {
+            if (!access.write || !access.discard) {
+                needed[access.image] = true;
+            }
+        }
+    }
+}
+
+bool FrameGraph::Simulate(std::vector<State> &states, bool record)
+{
+    bool valid = true;
+    for (Pass &pass : m_passes) {
+        if (pass.culled) {
+            continue;
+        }
+        Barrier barrier;
+        for (const Access &access : pass.accesses) {
+            const Image &image = m_images[access.image];
+            State &state = states[access.image];
+            if (!access.write && state.layout == VK_IMAGE_LAYOUT_UNDEFINED) {
+                if (record) {
+                    LOGE("FrameGraph pass %{public}s reads %{public}s before it is written", pass.name.c_str(),
+                        image.name.c_str());
+                }
+                valid = false;
+            }
+            bool transition = access.layout != VK_IMAGE_LAYOUT_UNDEFINED && access.layout != state.layout;
+            VkPipelineStageFlags srcStages = 0;
+            VkAccessFlags srcAccess = 0;
+            if (access.write || transition) {
+                // Writes and transitions wait for the last write and every read since
+                srcStages = state.writeStages | state.readStages;
+                srcAccess = state.writeAccess;
+            } else if ((access.stages & ~state.readStages) != 0) {
+                // Reads wait for the last write unless their stages already did
+                srcStages = state.writeStages;
+                srcAccess = state.writeAccess;
+            }
+            if (transition) {
+                VkImageLayout oldLayout = access.discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout;
+                AddTransition(barrier, image, oldLayout, access.layout, srcAccess, access.access);
+                barrier.srcStages |= srcStages;
+                barrier.dstStages |= access.stages;
+                state.writeStages = access.stages;
+                state.writeAccess = 0;
+                state.readStages = 0;
+            } else if (srcStages != 0) {
+                barrier.srcStages |= srcStages;
+                barrier.dstStages |= access.stages;
+                if (srcAccess != 0) {
+                    barrier.srcAccess |= srcAccess;
+                    barrier.dstAccess |= access.access;
+                }
+            }
+
+            if (access.write) {
+                state.writeStages = access.stages;
+                state.writeAccess = access.access;
+                state.readStages = 0;
+            } else {
+                state.readStages |= access.stages;
+            }
+            if (access.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED) {
+                state.layout = access.finalLayout;
+            } else if (access.layout != VK_IMAGE_LAYOUT_UNDEFINED) {
+                state.layout = access.layout;
+            }
+        }
+        if (record) {
+            pass.barrier = barrier;
+        }
+    }
+    return valid;
+}
+
+void FrameGraph::AddTransition(Barrier &barrier, const Image &image, VkImageLayout oldLayout, VkImageLayout newLayout,
+    VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+{
+    VkImageMemoryBarrier imageBarrier = vks::initializers::imageMemoryBarrier();
+    imageBarrier.image = image.image;
+    imageBarrier.subresourceRange = {image.aspectMask, 0, 1, 0, 1};
+    imageBarrier.srcAccessMask = srcAccess;
+    imageBarrier.dstAccessMask = dstAccess;
+    imageBarrier.oldLayout = oldLayout;
+    imageBarrier.newLayout = newLayout;
+    barrier.imageBarriers.push_back(imageBarrier);
+}
+
+void FrameGraph::Barrier::Record(VkCommandBuffer commandBuffer) const
+{
+    if (IsEmpty()) {
+        return;
+    }
+    VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+    memoryBarrier.srcAccessMask = srcAccess;
+    memoryBarrier.dstAccessMask = dstAccess;
+    vkCmdPipelineBarrier(commandBuffer, srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStages, 0,
+        srcAccess != 0 ? 1 : 0, &memoryBarrier, 0, nullptr, static_cast<uint32_t>(imageBarriers.size()),
+        imageBarriers.data());
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RENDER_FRAME_GRAPH_H
+#define RENDER_FRAME_GRAPH_H
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "vulkan/vulkan.h"
+
+// Declarative description of the passes of a frame and the images they read and write.
+// Passes are added in execution order, each declares the stage, access and layout of every image it uses. Compile
+// culls disabled passes and passes whose writes no kept pass or the next frame reads, then computes the barriers in
+// front of every kept pass: one vkCmdPipelineBarrier with a global memory barrier for the hazards and an image
+// barrier per layout transition, nothing between passes that only read. The frame is recorded once and submitted
+// again and again, so the hazards against the previous frame are part of the barriers in front of the first users.
+// A pass using a render pass declares the render pass initialLayout as layout (UNDEFINED when the render pass
+// transitions from UNDEFINED itself) and its finalLayout. The render pass external dependencies only have to chain
+// with the barriers of the graph: src stages of the incoming one and dst stages of the outgoing one are the stages the
+// pass declares, the graph takes care of the rest.
+// Not thread safe, built and compiled when command buffers are recorded.
+class FrameGraph {
+public:
+    // Records the pass into commandBuffer, index is the one given to Execute
+    using RecordFunc = std::function<void(VkCommandBuffer commandBuffer, uint32_t index)>;
+    // Called after every pass in execution order, culled passes included
+    using PassEndFunc = std::function<void(VkCommandBuffer commandBuffer, uint32_t index, uint32_t pass)>;
+
+    enum PassFlags : uint32_t {
+        PASS_DISABLED = 0x1,     // culled, its readers see the content of the previous frame
+        PASS_SIDE_EFFECTS = 0x2, // never culled, e.g. writes the swapchain image
+    };
+
+    FrameGraph() {}
+    ~FrameGraph() {}
+
+    // layout is the one the image rests in between frames. Images with VK_IMAGE_LAYOUT_UNDEFINED are transient,
+    // their content does not outlive the frame and the first access of a frame has to discard it.
+    uint32_t AddImage(const std::string &name, VkImage image, VkImageAspectFlags aspectMask, VkImageLayout layout);
+    uint32_t AddPass(const std::string &name, uint32_t flags, const RecordFunc &record);
+    // finalLayout UNDEFINED means the pass leaves the image in layout
+    void Read(uint32_t pass, uint32_t image, VkPipelineStageFlags stages, VkAccessFlags access, VkImageLayout layout,
+        VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED);
+    // discard: the pass overwrites every texel, e.g. clears, the previous content is dropped on a transition
+    void Write(uint32_t pass, uint32_t image, VkPipelineStageFlags stages, VkAccessFlags access, VkImageLayout layout,
+        VkImageLayout finalLayout, bool discard);
+
+    // Returns false when a kept pass reads a transient image before it is written
+    bool Compile();
+    bool IsCulled(uint32_t pass) const { return m_passes[pass].culled; }
+    // vkCmdPipelineBarrier calls recorded per frame
+    uint32_t GetBarrierCount() const;
+    // Records the kept passes with their barriers and transitions images back to the layout they rest in
+    void Execute(VkCommandBuffer commandBuffer, uint32_t index, const PassEndFunc &passEnd) const;
+
+private:
+    struct Image {
+        std::string name;
+        VkImage image;
+        VkImageAspectFlags aspectMask;
+        VkImageLayout layout;
+    };
+    struct Access {
+        uint32_t image;
+        VkPipelineStageFlags stages;
+        VkAccessFlags access;
+        VkImageLayout layout;
+        VkImageLayout finalLayout;
+        bool write;
+        bool discard;
+    };
+    struct Barrier {
+        VkPipelineStageFlags srcStages = 0;
+        VkPipelineStageFlags dstStages = 0;
+        VkAccessFlags srcAccess = 0; // global memory barrier
+        VkAccessFlags dstAccess = 0;
+        std::vector<VkImageMemoryBarrier> imageBarriers;
+        bool IsEmpty() const { return dstStages == 0; }
+        void Record(VkCommandBuffer commandBuffer) const;
+    };
+    struct Pass {
+        std::string name;
+        uint32_t flags;
+        RecordFunc record;
+        std::vector<Access> accesses;
+        bool culled = false;
+        Barrier barrier;
+    };
+    // Hazard tracking of an image while walking the passes
+    struct State {
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags writeStages = 0; // of the last write, or of the last transition
+        VkAccessFlags writeAccess = 0;
+        VkPipelineStageFlags readStages = 0;  // reads since then, already synchronized with it
+    };
+
+    void Cull();
+    bool Simulate(std::vector<State> &states, bool record);
+    static void AddTransition(Barrier &barrier, const Image &image, VkImageLayout oldLayout,
+        VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess);
+
+    std::vector<Image> m_images;
+    std::vector<Pass> m_passes;
+    Barrier m_endBarrier; // back to the layouts the images rest in
+};
+#endif // RENDER_FRAME_GRAPH_H
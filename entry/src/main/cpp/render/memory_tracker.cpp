@@ -0,0 +1,307 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "memory_tracker.h"
+#include <algorithm>
+#include "VulkanTools.h"
+#include "common/common.h"
+
+MemoryTracker MemoryTracker::m_memoryTracker;
+thread_local MemoryCategory MemoryTracker::m_threadCategory = MEMORY_CATEGORY_OTHER;
+
+const char *MemoryTracker::GetCategoryName(uint32_t category)
+{
+    static const char *const names[MEMORY_CATEGORY_COUNT] = {"other", "gbuffer", "upscale", "textures", "meshes",
+        "staging", "shadingRate"};
+    return category < MEMORY_CATEGORY_COUNT ? names[category] : "unknown";
+}
+
+MemoryCategory MemoryTracker::SetThreadCategory(MemoryCategory category)
+{
+    MemoryCategory previous = m_threadCategory;
+    m_threadCategory = category;
+    return previous;
+}
+
+void MemoryTracker::Init(VkPhysicalDevice physicalDevice, bool driverBudget)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // Loading the function pointers again puts the driver functions back in place
+    if (vkAllocateMemory != &MemoryTracker::AllocateMemory) {
+        m_allocateMemory = vkAllocateMemory;
+        vkAllocateMemory = &MemoryTracker::AllocateMemory;
+    }
+    if (vkFreeMemory != &MemoryTracker::FreeMemory) {
+        m_freeMemory = vkFreeMemory;
+        vkFreeMemory = &MemoryTracker::FreeMemory;
+    }
+    // Another render instance on the same device, its allocations add to those already accounted
+    if (m_users > 0 && m_physicalDevice == physicalDevice) {
+        m_users++;
+        return;
+    }
+    m_users = 1;
+    m_physicalDevice = physicalDevice;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_memoryProperties);
+    m_driverBudget = driverBudget && vkGetPhysicalDeviceMemoryProperties2 != nullptr;
+    m_allocations.clear();
+    for (uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+        VkDeviceSize budgetBytes = m_categories[i].budgetBytes;
+        m_categories[i] = CategoryStats();
+        m_categories[i].budgetBytes = budgetBytes;
+        m_categoryOver[i] = false;
+    }
+    std::fill(std::begin(m_heapBytes), std::end(m_heapBytes), 0);
+    std::fill(std::begin(m_heapOver), std::end(m_heapOver), false);
+    m_totalBytes = 0;
+    m_peakBytes = 0;
+    m_totalOver = false;
+    LOGI("MemoryTracker Init: %{public}u heaps, driver budget %{public}d", m_memoryProperties.memoryHeapCount,
+        m_driverBudget);
+}
+
+void MemoryTracker::Shutdown()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_users > 1) {
+        m_users--;
+        return;
+    }
+    m_users = 0;
+    m_physicalDevice = VK_NULL_HANDLE;
+    m_driverBudget = false;
+}
+
+void MemoryTracker::SetBudget(uint32_t category, VkDeviceSize budgetBytes)
+{
+    if (category >= MEMORY_CATEGORY_COUNT) {
+        LOGE("MemoryTracker SetBudget: invalid category %{public}u", category);
+        return;
+    }
+    std::vector<LowMemoryEvent> events;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_categories[category].budgetBytes = budgetBytes;
+        CheckBudgets(events);
+    }
+    Notify(events);
+}
+
+void MemoryTracker::SetTotalBudget(VkDeviceSize budgetBytes)
+{
+    std::vector<LowMemoryEvent> events;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_totalBudgetBytes = budgetBytes;
+        CheckBudgets(events);
+    }
+    Notify(events);
+}
+
+void MemoryTracker::SetLowMemoryCallback(const LowMemoryFunc &callback)
+{
+    std::lock_guard<std::mutex> lock(m_callbackMutex);
+    m_lowMemoryCallback = callback;
+}
+
+void MemoryTracker::CheckHeapBudgets()
+{
+    std::vector<LowMemoryEvent> events;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        VkDeviceSize usage[VK_MAX_MEMORY_HEAPS];
+        VkDeviceSize budget[VK_MAX_MEMORY_HEAPS];
+        if (!QueryHeapBudgets(usage, budget)) {
+            return;
+        }
+        for (uint32_t heap = 0; heap < m_memoryProperties.memoryHeapCount; heap++) {
+            VkDeviceSize limit = static_cast<VkDeviceSize>(static_cast<double>(budget[heap]) *
+                MEMORY_HEAP_BUDGET_RATIO);
+            bool over = budget[heap] > 0 && usage[heap] > limit;
+            if (over && !m_heapOver[heap]) {
+                events.push_back({LowMemoryEvent::SOURCE_HEAP, heap, usage[heap], limit});
+            }
+            m_heapOver[heap] = over;
+        }
+    }
+    Notify(events);
+}
+
+bool MemoryTracker::IsOverBudget()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    bool over = m_totalOver;
+    for (uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+        over = over || m_categoryOver[i];
+    }
+    for (uint32_t heap = 0; heap < VK_MAX_MEMORY_HEAPS; heap++) {
+        over = over || m_heapOver[heap];
+    }
+    return over;
+}
+
+void MemoryTracker::GetStats(Stats &stats)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    stats.totalBytes = m_totalBytes;
+    stats.peakBytes = m_peakBytes;
+    stats.totalBudgetBytes = m_totalBudgetBytes;
+    stats.allocations = static_cast<uint32_t>(m_allocations.size());
+    std::copy(std::begin(m_categories), std::end(m_categories), std::begin(stats.categories));
+    VkDeviceSize usage[VK_MAX_MEMORY_HEAPS] = {};
+    VkDeviceSize budget[VK_MAX_MEMORY_HEAPS] = {};
+    stats.driverBudget = QueryHeapBudgets(usage, budget);
+    stats.heaps.resize(m_memoryProperties.memoryHeapCount);
+    for (uint32_t heap = 0; heap < m_memoryProperties.memoryHeapCount; heap++) {
+        HeapStats &heapStats = stats.heaps[heap];
+        heapStats.size = m_memoryProperties.memoryHeaps[heap].size;
+        heapStats.deviceLocal = (m_memoryProperties.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+        heapStats.trackedBytes = m_heapBytes[heap];
+        heapStats.usageBytes = usage[heap];
+        heapStats.budgetBytes = budget[heap];
+    }
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL MemoryTracker::AllocateMemory(VkDevice device,
+    const VkMemoryAllocateInfo *pAllocateInfo, const VkAllocationCallbacks *pAllocator, VkDeviceMemory *pMemory)
+{
+    MemoryTracker *tracker = GetInstance();
+    VkResult res = tracker->m_allocateMemory(device, pAllocateInfo, pAllocator, pMemory);
+    if (res == VK_SUCCESS) {
+        tracker->OnAllocate(*pMemory, pAllocateInfo->allocationSize, pAllocateInfo->memoryTypeIndex,
+            m_threadCategory);
+    } else if (res == VK_ERROR_OUT_OF_DEVICE_MEMORY || res == VK_ERROR_OUT_OF_HOST_MEMORY) {
+        tracker->OnAllocateFailed(pAllocateInfo->allocationSize, m_threadCategory);
+    }
+    return res;
+}
+
+VKAPI_ATTR void VKAPI_CALL MemoryTracker::FreeMemory(VkDevice device, VkDeviceMemory memory,
+    const VkAllocationCallbacks *pAllocator)
+{
+    MemoryTracker *tracker = GetInstance();
+    if (memory != VK_NULL_HANDLE) {
+        tracker->OnFree(memory);
+    }
+    tracker->m_freeMemory(device, memory, pAllocator);
+}
+
+void MemoryTracker::OnAllocate(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex,
+    MemoryCategory category)
+{
+    std::vector<LowMemoryEvent> events;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        uint32_t heap = memoryTypeIndex < m_memoryProperties.memoryTypeCount ?
+            m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex : 0;
+        m_allocations[memory] = {size, heap, category};
+        CategoryStats &stats = m_categories[category];
+        stats.bytes += size;
+        stats.peakBytes = std::max(stats.peakBytes, stats.bytes);
+        stats.allocations++;
+        m_heapBytes[heap] += size;
+        m_totalBytes += size;
+        m_peakBytes = std::max(m_peakBytes, m_totalBytes);
+        CheckBudgets(events);
+    }
+    Notify(events);
+}
+
+void MemoryTracker::OnAllocateFailed(VkDeviceSize size, MemoryCategory category)
+{
+    LOGE("MemoryTracker %{public}s allocation of %{public}llu bytes failed", GetCategoryName(category),
+        static_cast<unsigned long long>(size));
+    LowMemoryEvent event;
+    event.source = LowMemoryEvent::SOURCE_ALLOCATION;
+    event.index = category;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        event.usedBytes = m_totalBytes;
+        event.budgetBytes = m_totalBudgetBytes;
+    }
+    Notify({event});
+}
+
+void MemoryTracker::OnFree(VkDeviceMemory memory)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_allocations.find(memory);
+    // Allocated before Init, e.g. by a previous device
+    if (it == m_allocations.end()) {
+        return;
+    }
+    const Allocation &allocation = it->second;
+    CategoryStats &stats = m_categories[allocation.category];
+    stats.bytes -= allocation.size;
+    stats.allocations--;
+    m_heapBytes[allocation.heap] -= allocation.size;
+    m_totalBytes -= allocation.size;
+    m_allocations.erase(it);
+    // Freeing only re-arms the budgets, nothing to report
+    std::vector<LowMemoryEvent> events;
+    CheckBudgets(events);
+}
+
+void MemoryTracker::CheckBudgets(std::vector<LowMemoryEvent> &events)
+{
+    for (uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+        const CategoryStats &stats = m_categories[i];
+        bool over = stats.budgetBytes > 0 && stats.bytes > stats.budgetBytes;
+        if (over && !m_categoryOver[i]) {
+            events.push_back({LowMemoryEvent::SOURCE_CATEGORY, i, stats.bytes, stats.budgetBytes});
+        }
+        m_categoryOver[i] = over;
+    }
+    bool over = m_totalBudgetBytes > 0 && m_totalBytes > m_totalBudgetBytes;
+    if (over && !m_totalOver) {
+        events.push_back({LowMemoryEvent::SOURCE_TOTAL, 0, m_totalBytes, m_totalBudgetBytes});
+    }
+    m_totalOver = over;
+}
+
+bool MemoryTracker::QueryHeapBudgets(VkDeviceSize usage[VK_MAX_MEMORY_HEAPS],
+    VkDeviceSize budget[VK_MAX_MEMORY_HEAPS])
+{
+    if (!m_driverBudget || m_physicalDevice == VK_NULL_HANDLE) {
+        return false;
+    }
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+    budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    VkPhysicalDeviceMemoryProperties2 memoryProperties2{};
+    memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    memoryProperties2.pNext = &budgetProperties;
+    vkGetPhysicalDeviceMemoryProperties2(m_physicalDevice, &memoryProperties2);
+    for (uint32_t heap = 0; heap < VK_MAX_MEMORY_HEAPS; heap++) {
+        usage[heap] = budgetProperties.heapUsage[heap];
+        budget[heap] = budgetProperties.heapBudget[heap];
+    }
+    return true;
+}
+
+void MemoryTracker::Notify(const std::vector<LowMemoryEvent> &events)
+{
+    if (events.empty()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_callbackMutex);
+    for (const LowMemoryEvent &event : events) {
+        LOGW("MemoryTracker low memory: source %{public}u, index %{public}u, %{public}llu of %{public}llu bytes",
+            event.source, event.index, static_cast<unsigned long long>(event.usedBytes),
+            static_cast<unsigned long long>(event.budgetBytes));
+        if (m_lowMemoryCallback) {
+            m_lowMemoryCallback(event);
+        }
+    }
+}
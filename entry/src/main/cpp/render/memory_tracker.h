@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RENDER_MEMORY_TRACKER_H
+#define RENDER_MEMORY_TRACKER_H
+
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "vulkan/vulkan.h"
+
+#define MEMORY_HEAP_BUDGET_RATIO 0.9 // driver reported heap usage above this share of the heap budget is low memory
+
+enum MemoryCategory : uint32_t {
+    MEMORY_CATEGORY_OTHER = 0,
+    MEMORY_CATEGORY_GBUFFER,      // G-Buffer and native light targets
+    MEMORY_CATEGORY_UPSCALE,      // low resolution light target and upscale intermediates
+    MEMORY_CATEGORY_TEXTURES,
+    MEMORY_CATEGORY_MESHES,
+    MEMORY_CATEGORY_STAGING,      // upload ring, one-off staging buffers and readback slots
+    MEMORY_CATEGORY_SHADING_RATE, // shading rate images
+    MEMORY_CATEGORY_COUNT
+};
+
+// Accounts every device memory allocation of the process by category and heap.
+// Init puts tracking wrappers in place of vkAllocateMemory and vkFreeMemory, so allocations need no changes besides
+// a MemoryCategoryScope naming what they are for, unscoped ones count as MEMORY_CATEGORY_OTHER. With
+// VK_EXT_memory_budget the driver view of every heap is reported too, it includes memory of other processes and of
+// the driver itself. Crossing a budget calls the low memory callback once, it is called again after usage went back
+// below the budget and crossed it again. Thread safe.
+class MemoryTracker {
+public:
+    struct CategoryStats {
+        VkDeviceSize bytes = 0;
+        VkDeviceSize peakBytes = 0;
+        VkDeviceSize budgetBytes = 0; // 0 without a budget
+        uint32_t allocations = 0;     // live
+    };
+    struct HeapStats {
+        VkDeviceSize size = 0;
+        bool deviceLocal = false;
+        VkDeviceSize trackedBytes = 0;
+        VkDeviceSize usageBytes = 0;  // driver reported, 0 without VK_EXT_memory_budget
+        VkDeviceSize budgetBytes = 0;
+    };
+    struct Stats {
+        VkDeviceSize totalBytes = 0;
+        VkDeviceSize peakBytes = 0;
+        VkDeviceSize totalBudgetBytes = 0;
+        uint32_t allocations = 0;
+        bool driverBudget = false; // heaps report usageBytes and budgetBytes
+        CategoryStats categories[MEMORY_CATEGORY_COUNT];
+        std::vector<HeapStats> heaps;
+    };
+    struct LowMemoryEvent {
+        enum Source : uint32_t {
+            SOURCE_CATEGORY = 0, // index is the category
+            SOURCE_TOTAL,
+            SOURCE_HEAP,         // index is the heap, the driver budget scaled by MEMORY_HEAP_BUDGET_RATIO
+            SOURCE_ALLOCATION,   // vkAllocateMemory ran out of memory, index is the category
+        };
+        Source source = SOURCE_TOTAL;
+        uint32_t index = 0;
+        VkDeviceSize usedBytes = 0;
+        VkDeviceSize budgetBytes = 0;
+    };
+    using LowMemoryFunc = std::function<void(const LowMemoryEvent &event)>;
+
+    static MemoryTracker *GetInstance() { return &MemoryTracker::m_memoryTracker; }
+    static const char *GetCategoryName(uint32_t category);
+    // Category of the allocations of the calling thread, returns the previous one
+    static MemoryCategory SetThreadCategory(MemoryCategory category);
+
+    // Before the first allocation of every render instance. The first one on a device starts the accounting from zero,
+    // budgets and the callback are kept. Call again whenever the Vulkan function pointers were loaded again.
+    void Init(VkPhysicalDevice physicalDevice, bool driverBudget);
+    // Once per Init, after the last one the physical device is gone, allocations freed afterwards are still accounted
+    void Shutdown();
+    // budgetBytes 0 removes the budget
+    void SetBudget(uint32_t category, VkDeviceSize budgetBytes);
+    void SetTotalBudget(VkDeviceSize budgetBytes);
+    // Called on the thread crossing the budget. Once SetLowMemoryCallback returns the previous callback is not
+    // running and is not called again.
+    void SetLowMemoryCallback(const LowMemoryFunc &callback);
+    // Queries the driver budgets of the heaps, memory of other processes moves them too
+    void CheckHeapBudgets();
+    bool IsOverBudget();
+    void GetStats(Stats &stats);
+
+private:
+    struct Allocation {
+        VkDeviceSize size;
+        uint32_t heap;
+        MemoryCategory category;
+    };
+
+    MemoryTracker() {}
+    static VKAPI_ATTR VkResult VKAPI_CALL AllocateMemory(VkDevice device, const VkMemoryAllocateInfo *pAllocateInfo,
+        const VkAllocationCallbacks *pAllocator, VkDeviceMemory *pMemory);
+    static VKAPI_ATTR void VKAPI_CALL FreeMemory(VkDevice device, VkDeviceMemory memory,
+        const VkAllocationCallbacks *pAllocator);
+    void OnAllocate(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex, MemoryCategory category);
+    void OnAllocateFailed(VkDeviceSize size, MemoryCategory category);
+    void OnFree(VkDeviceMemory memory);
+    // m_mutex held, appends the budgets crossed since the last check
+    void CheckBudgets(std::vector<LowMemoryEvent> &events);
+    // m_mutex held, false without VK_EXT_memory_budget
+    bool QueryHeapBudgets(VkDeviceSize usage[VK_MAX_MEMORY_HEAPS], VkDeviceSize budget[VK_MAX_MEMORY_HEAPS]);
+    void Notify(const std::vector<LowMemoryEvent> &events);
+
+    static MemoryTracker m_memoryTracker;
+    static thread_local MemoryCategory m_threadCategory;
+    PFN_vkAllocateMemory m_allocateMemory = nullptr; // of the driver
+    PFN_vkFreeMemory m_freeMemory = nullptr;
+
+    std::mutex m_mutex;
+    VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+    uint32_t m_users = 0; // Init calls without their Shutdown
+    VkPhysicalDeviceMemoryProperties m_memoryProperties{};
+    bool m_driverBudget = false;
+    std::unordered_map<VkDeviceMemory, Allocation> m_allocations;
+    CategoryStats m_categories[MEMORY_CATEGORY_COUNT];
+    VkDeviceSize m_heapBytes[VK_MAX_MEMORY_HEAPS] = {};
+    VkDeviceSize m_totalBytes = 0;
+    VkDeviceSize m_peakBytes = 0;
+    VkDeviceSize m_totalBudgetBytes = 0;
+    // Budgets currently exceeded, the callback only fires when one of them becomes set
+    bool m_categoryOver[MEMORY_CATEGORY_COUNT] = {};
+    bool m_totalOver = false;
+    bool m_heapOver[VK_MAX_MEMORY_HEAPS] = {};
+
+    // Held while the callback runs
+    std::mutex m_callbackMutex;
+    LowMemoryFunc m_lowMemoryCallback;
+};
+
+// Allocations of the calling thread count as category until the scope ends
+class MemoryCategoryScope {
+public:
+    explicit MemoryCategoryScope(MemoryCategory category) : m_previous(MemoryTracker::SetThreadCategory(category)) {}
+    ~MemoryCategoryScope() { MemoryTracker::SetThreadCategory(m_previous); }
+    MemoryCategoryScope(const MemoryCategoryScope &) = delete;
+    MemoryCategoryScope &operator=(const MemoryCategoryScope &) = delete;
+
+private:
+    MemoryCategory m_previous;
+};
+#endif // RENDER_MEMORY_TRACKER_H
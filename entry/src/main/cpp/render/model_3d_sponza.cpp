@@ -15,28 +15,26 @@
 
 #include "model_3d_sponza.h"
 #include <dlfcn.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include "common/jobs/job_system.h"
+#include "common/trace.h"
+
+ShadingRateCache VulkanExample::m_shadingRateCache;
+std::mutex VulkanExample::m_shadingRateFileMutex;
 
 VulkanExample::~VulkanExample()
 {
     LOGI("Start VulkanExample Destructor.");
-    frameBuffers.gBufferLight.position.Destroy(device);
-    frameBuffers.gBufferLight.normal.Destroy(device);
-    frameBuffers.gBufferLight.viewNormal.Destroy(device);
-    frameBuffers.gBufferLight.albedo.Destroy(device);
-    frameBuffers.gBufferLight.depth.Destroy(device);
-    frameBuffers.light.color.Destroy(device);
+    // The memory goes back to m_renderTargets, which frees it after this destructor
+    DestroyOffscreenTargets();
     frameBuffers.gBufferLight.destroy(device);
-    frameBuffers.light.destroy(device);
-
-    upscaleFrameBuffers.gBufferLight.position.Destroy(device);
-    upscaleFrameBuffers.gBufferLight.normal.Destroy(device);
-    upscaleFrameBuffers.gBufferLight.viewNormal.Destroy(device);
-    upscaleFrameBuffers.gBufferLight.albedo.Destroy(device);
-    upscaleFrameBuffers.gBufferLight.depth.Destroy(device);
-    upscaleFrameBuffers.light.color.Destroy(device);
-    upscaleFrameBuffers.upscale.color.Destroy(device);
+    frameBuffers.shadingRate.destroy(device);
     upscaleFrameBuffers.gBufferLight.destroy(device);
-    upscaleFrameBuffers.light.destroy(device);
+    upscaleFrameBuffers.shadingRate.destroy(device);
+    vkDestroySampler(device, colorSampler, nullptr);
 
     vkDestroyPipeline(device, pipelines.gBufferLight, nullptr);
     vkDestroyPipeline(device, pipelines.light, nullptr);
@@ -54,24 +52,33 @@ VulkanExample::~VulkanExample()
     vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.light, nullptr);
     vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.swap, nullptr);
 
-    if (xegSpatialUpscale) {
-        HMS_XEG_DestroySpatialUpscale(xegSpatialUpscale);
-    }
-
-    if (xeg_adaptiveVRS) {
-        HMS_XEG_DestroyAdaptiveVRS(xeg_adaptiveVRS);
-    }
-
-    if (xeg_adaptiveVRS4Upscale) {
-        HMS_XEG_DestroyAdaptiveVRS(xeg_adaptiveVRS4Upscale);
-    }
+    DestroyUpscaleAndVRS();
 
+    // Waits for the uploads into the scene resources
     m_scene.Destory();
+    delete m_uploadManager;
 
     uniformBuffers.sceneParams.destroy();
 
-    if (fsr != nullptr) {
-        delete fsr;
+    if (m_timestampQueryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(device, m_timestampQueryPool, nullptr);
+    }
+    if (m_pipelineStatsQueryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(device, m_pipelineStatsQueryPool, nullptr);
+    }
+
+    for (auto &variant : m_commandVariants) {
+        FreeCommandVariant(*variant);
+    }
+
+    delete m_debugOverlay;
+    for (auto &secondaries : m_gBufferSecondaries) {
+        delete secondaries.recorder;
+    }
+    // Waits for in-flight copies and pending file writes
+    delete m_readback;
+    if (m_memoryTracked) {
+        MemoryTracker::GetInstance()->Shutdown();
     }
 }
 
@@ -79,20 +86,103 @@ void VulkanExample::getEnabledFeatures()
 {
     LOGI("VulkanExample Enable Features.");
     enabledFeatures.samplerAnisotropy = deviceFeatures.samplerAnisotropy;
+    // Optional, counts fragment shader invocations for the shading rate statistics
+    enabledFeatures.pipelineStatisticsQuery = deviceFeatures.pipelineStatisticsQuery;
+    // Optional, keeps the statistics query active while the G-Buffer secondaries execute
+    enabledFeatures.inheritedQueries = deviceFeatures.inheritedQueries;
     enabledPhysicalDeviceShadingRateImageFeaturesKHR.sType =
         VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FRAGMENT_SHADING_RATE_FEATURES_KHR;
     enabledPhysicalDeviceShadingRateImageFeaturesKHR.attachmentFragmentShadingRate = VK_TRUE;
     enabledPhysicalDeviceShadingRateImageFeaturesKHR.pipelineFragmentShadingRate = VK_TRUE;
     enabledPhysicalDeviceShadingRateImageFeaturesKHR.primitiveFragmentShadingRate = VK_FALSE;
+    // Optional, the upload manager tracks its batches with a timeline semaphore
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures{};
+    timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    VkPhysicalDeviceFeatures2 deviceFeatures2{};
+    deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    deviceFeatures2.pNext = &timelineSemaphoreFeatures;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &deviceFeatures2);
+    enabledTimelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    enabledTimelineSemaphoreFeatures.timelineSemaphore = timelineSemaphoreFeatures.timelineSemaphore;
+    enabledPhysicalDeviceShadingRateImageFeaturesKHR.pNext = &enabledTimelineSemaphoreFeatures;
     deviceCreatepNextChain = &enabledPhysicalDeviceShadingRateImageFeaturesKHR;
+    // Optional, places the GPU passes exactly on the trace timeline
+    m_calibratedTimestamps = SupportsCalibratedTimestamps();
+    if (m_calibratedTimestamps) {
+        enabledDeviceExtensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+    }
+    // Optional, reports the heap usage of the whole device next to the memory tracked by this process
+    m_memoryBudgetSupported = IsDeviceExtensionSupported(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (m_memoryBudgetSupported) {
+        enabledDeviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    } else {
+        LOGW("VulkanExample memory budget not supported, only memory allocated by the demo is tracked");
+    }
 }
 
-void VulkanExample::CreateAttachment(VkFormat format, VkImageUsageFlagBits usage, FrameBufferAttachment *attachment,
-    uint32_t width, uint32_t height)
+bool VulkanExample::IsDeviceExtensionSupported(const char *extensionName)
 {
-    VkImageAspectFlags aspectMask = 0;
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+    for (const auto &extension : extensions) {
+        if (strcmp(extension.extensionName, extensionName) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
 
-    attachment->format = format;
+bool VulkanExample::SupportsCalibratedTimestamps()
+{
+    if (vkGetPhysicalDeviceCalibrateableTimeDomainsEXT == nullptr) {
+        return false;
+    }
+    if (!IsDeviceExtensionSupported(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME)) {
+        LOGW("VulkanExample calibrated timestamps not supported, gpu trace events are approximate");
+        return false;
+    }
+    uint32_t domainCount = 0;
+    vkGetPhysicalDeviceCalibrateableTimeDomainsEXT(physicalDevice, &domainCount, nullptr);
+    std::vector<VkTimeDomainEXT> domains(domainCount);
+    vkGetPhysicalDeviceCalibrateableTimeDomainsEXT(physicalDevice, &domainCount, domains.data());
+    bool device = false;
+    bool monotonic = false;
+    for (VkTimeDomainEXT domain : domains) {
+        device = device || domain == VK_TIME_DOMAIN_DEVICE_EXT;
+        monotonic = monotonic || domain == VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+    }
+    if (!device || !monotonic) {
+        LOGW("VulkanExample CLOCK_MONOTONIC can not be calibrated, gpu trace events are approximate");
+        return false;
+    }
+    return true;
+}
+
+void VulkanExample::PrepareUploadManager()
+{
+    if (!enabledTimelineSemaphoreFeatures.timelineSemaphore) {
+        LOGW("VulkanExample timeline semaphores are not supported, assets are uploaded synchronously");
+        return;
+    }
+    UploadManager::InitParams initParams;
+    initParams.vulkanDevice = vulkanDevice;
+    initParams.transferQueue = transferQueue;
+    initParams.graphicsQueue = queue;
+    initParams.ringSize = UPLOAD_RING_SIZE;
+    m_uploadManager = new UploadManager();
+    if (!m_uploadManager->Init(initParams)) {
+        LOGE("VulkanExample upload manager create failed, assets are uploaded synchronously");
+        delete m_uploadManager;
+        m_uploadManager = nullptr;
+    }
+}
+
+VkImageAspectFlags VulkanExample::GetAttachmentInfo(VkFormat format, VkImageUsageFlags usage, uint32_t width,
+    uint32_t height, VkImageCreateInfo &image)
+{
+    VkImageAspectFlags aspectMask = 0;
 
     if (usage & VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT) {
         aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -106,7 +196,7 @@ void VulkanExample::CreateAttachment(VkFormat format, VkImageUsageFlagBits usage
 
     assert(aspectMask > 0);
 
-    VkImageCreateInfo image = vks::initializers::imageCreateInfo();
+    image = vks::initializers::imageCreateInfo();
     image.imageType = VK_IMAGE_TYPE_2D;
     image.format = format;
     image.extent.width = width;
@@ -117,28 +207,23 @@ void VulkanExample::CreateAttachment(VkFormat format, VkImageUsageFlagBits usage
     image.samples = VK_SAMPLE_COUNT_1_BIT;
     image.tiling = VK_IMAGE_TILING_OPTIMAL;
     image.usage = usage | VK_IMAGE_USAGE_SAMPLED_BIT;
+    return aspectMask;
+}
+
+void VulkanExample::CreateAttachment(VkFormat format, VkImageUsageFlags usage, FrameBufferAttachment *attachment,
+    uint32_t width, uint32_t height)
+{
+    attachment->format = format;
+    VkImageCreateInfo image;
+    VkImageAspectFlags aspectMask = GetAttachmentInfo(format, usage, width, height, image);
+    if (!m_renderTargets.Acquire(image, aspectMask, attachment->image, attachment->view, attachment->mem)) {
+        LOGE("VulkanExample CreateAttachment: %{public}ux%{public}u target create failed", width, height);
+    }
+}
 
-    VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
-    VkMemoryRequirements memReqs;
-
-    VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &attachment->image));
-    vkGetImageMemoryRequirements(device, attachment->image, &memReqs);
-    memAlloc.allocationSize = memReqs.size;
-    memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &attachment->mem));
-    VK_CHECK_RESULT(vkBindImageMemory(device, attachment->image, attachment->mem, 0));
-
-    VkImageViewCreateInfo imageView = vks::initializers::imageViewCreateInfo();
-    imageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    imageView.format = format;
-    imageView.subresourceRange = {};
-    imageView.subresourceRange.aspectMask = aspectMask;
-    imageView.subresourceRange.baseMipLevel = 0;
-    imageView.subresourceRange.levelCount = 1;
-    imageView.subresourceRange.baseArrayLayer = 0;
-    imageView.subresourceRange.layerCount = 1;
-    imageView.image = attachment->image;
-    VK_CHECK_RESULT(vkCreateImageView(device, &imageView, nullptr, &attachment->view));
+void VulkanExample::ReleaseAttachment(FrameBufferAttachment &attachment)
+{
+    m_renderTargets.Release(attachment.image, attachment.view, attachment.mem);
 }
 
 void VulkanExample::PrepareShadingRateImage(uint32_t sriWidth, uint32_t sriHeight, FrameBufferAttachment *attachment)
@@ -167,36 +252,35 @@ void VulkanExample::PrepareShadingRateImage(uint32_t sriWidth, uint32_t sriHeigh
     imageCI.mipLevels = 1;
     imageCI.arrayLayers = 1;
     imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
-    imageCI.tiling = VK_IMAGE_TILING_LINEAR;
+    imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
     imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     imageCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     imageCI.usage = VK_IMAGE_USAGE_FRAGMENT_SHADING_RATE_ATTACHMENT_BIT_KHR | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
-                    VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
-
-    VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &attachment->image));
-    VkMemoryRequirements memReqs{};
-    vkGetImageMemoryRequirements(device, attachment->image, &memReqs);
-    VkMemoryAllocateInfo memAllloc{};
-    memAllloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    memAllloc.allocationSize = memReqs.size;
-    memAllloc.memoryTypeIndex =
-        vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    VK_CHECK_RESULT(vkAllocateMemory(device, &memAllloc, nullptr, &attachment->mem));
-    VK_CHECK_RESULT(vkBindImageMemory(device, attachment->image, attachment->mem, 0));
-    VkImageViewCreateInfo imageViewCI{};
-    imageViewCI.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    imageViewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    imageViewCI.image = attachment->image;
-    imageViewCI.format = imageFormat;
-    imageViewCI.subresourceRange.baseMipLevel = 0;
-    imageViewCI.subresourceRange.levelCount = 1;
-    imageViewCI.subresourceRange.baseArrayLayer = 0;
-    imageViewCI.subresourceRange.layerCount = 1;
-    imageViewCI.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    VK_CHECK_RESULT(vkCreateImageView(device, &imageViewCI, nullptr, &attachment->view));
+                    VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+
+    attachment->format = imageFormat;
+    MemoryCategoryScope memoryScope(MEMORY_CATEGORY_SHADING_RATE);
+    if (!m_renderTargets.Acquire(imageCI, VK_IMAGE_ASPECT_COLOR_BIT, attachment->image, attachment->view,
+        attachment->mem)) {
+        LOGE("VulkanExample PrepareShadingRateImage: %{public}ux%{public}u image create failed", sriWidth, sriHeight);
+        return;
+    }
+
+    // Every frame starts from FRAGMENT_SHADING_RATE_ATTACHMENT_OPTIMAL, the light pass finalLayout, see
+    // BuildFrameGraph. Clear to 1x1 so frames that never dispatched shade at full rate.
+    VkImageSubresourceRange subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    VkCommandBuffer layoutCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+    vks::tools::setImageLayout(layoutCmd, attachment->image, VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+    VkClearColorValue clearColor = {};
+    vkCmdClearColorImage(layoutCmd, attachment->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1,
+        &subresourceRange);
+    vks::tools::setImageLayout(layoutCmd, attachment->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_IMAGE_LAYOUT_FRAGMENT_SHADING_RATE_ATTACHMENT_OPTIMAL_KHR, subresourceRange);
+    vulkanDevice->flushCommandBuffer(layoutCmd, queue, true);
 }
 
-void VulkanExample::PrepareOffscreenFramebuffers()
+void VulkanExample::CreateOffscreenTargets()
 {
     frameBuffers.gBufferLight.setSize(highResWidth, highResHeight);
     frameBuffers.light.setSize(highResWidth, highResHeight);
@@ -211,39 +295,79 @@ void VulkanExample::PrepareOffscreenFramebuffers()
     VkBool32 validDepthFormat = vks::tools::getSupportedDepthFormat(physicalDevice, &attDepthFormat);
     assert(validDepthFormat);
 
+    // Only one of the native and the upscale path runs in a frame. The G-Buffer targets are cleared by the G-Buffer
+    // pass and the upscale output is fully written by the upscale, none of them carries content into the next frame,
+    // so both paths share their memory.
+    std::vector<RenderTargetPool::AliasedTarget> aliased;
+    std::vector<FrameBufferAttachment *> aliasedAttachments;
+    auto addAliased = [this, &aliased, &aliasedAttachments](VkFormat format, VkImageUsageFlags usage,
+        FrameBufferAttachment *attachment, uint32_t width, uint32_t height, uint32_t lifetime) {
+        RenderTargetPool::AliasedTarget target;
+        target.aspectMask = GetAttachmentInfo(format, usage, width, height, target.imageInfo);
+        target.lifetime = lifetime;
+        attachment->format = format;
+        aliased.push_back(target);
+        aliasedAttachments.push_back(attachment);
+    };
+
     // G-Buffer Attachment
-    CreateAttachment(VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-                     &frameBuffers.gBufferLight.position, highResWidth, highResHeight);
-    CreateAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.gBufferLight.normal,
-                     highResWidth, highResHeight);
-    CreateAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-                     &frameBuffers.gBufferLight.viewNormal, highResWidth, highResHeight);
-    CreateAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.gBufferLight.albedo,
-                     highResWidth, highResHeight);
-    CreateAttachment(attDepthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, &frameBuffers.gBufferLight.depth,
-                     highResWidth, highResHeight);
-
-    CreateAttachment(VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-                     &upscaleFrameBuffers.gBufferLight.position, lowResWidth, lowResHeight);
-    CreateAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-                     &upscaleFrameBuffers.gBufferLight.normal, lowResWidth, lowResHeight);
-    CreateAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-                     &upscaleFrameBuffers.gBufferLight.viewNormal, lowResWidth, lowResHeight);
-    CreateAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-                     &upscaleFrameBuffers.gBufferLight.albedo, lowResWidth, lowResHeight);
-    CreateAttachment(attDepthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-                     &upscaleFrameBuffers.gBufferLight.depth, lowResWidth, lowResHeight);
-
-    // Light Attachment
-    CreateAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.light.color,
-                     highResWidth, highResHeight);
-    CreateAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &upscaleFrameBuffers.light.color,
-                     lowResWidth, lowResHeight);
+    addAliased(VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+               &frameBuffers.gBufferLight.position, highResWidth, highResHeight, TARGET_LIFETIME_NATIVE);
+    addAliased(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.gBufferLight.normal,
+               highResWidth, highResHeight, TARGET_LIFETIME_NATIVE);
+    addAliased(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.gBufferLight.viewNormal,
+               highResWidth, highResHeight, TARGET_LIFETIME_NATIVE);
+    addAliased(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &frameBuffers.gBufferLight.albedo,
+               highResWidth, highResHeight, TARGET_LIFETIME_NATIVE);
+    addAliased(attDepthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, &frameBuffers.gBufferLight.depth,
+               highResWidth, highResHeight, TARGET_LIFETIME_NATIVE);
+
+    addAliased(VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+               &upscaleFrameBuffers.gBufferLight.position, lowResWidth, lowResHeight, TARGET_LIFETIME_UPSCALE);
+    addAliased(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+               &upscaleFrameBuffers.gBufferLight.normal, lowResWidth, lowResHeight, TARGET_LIFETIME_UPSCALE);
+    addAliased(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+               &upscaleFrameBuffers.gBufferLight.viewNormal, lowResWidth, lowResHeight, TARGET_LIFETIME_UPSCALE);
+    addAliased(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+               &upscaleFrameBuffers.gBufferLight.albedo, lowResWidth, lowResHeight, TARGET_LIFETIME_UPSCALE);
+    addAliased(attDepthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+               &upscaleFrameBuffers.gBufferLight.depth, lowResWidth, lowResHeight, TARGET_LIFETIME_UPSCALE);
 
     // Upscale Attachment
-    CreateAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &upscaleFrameBuffers.upscale.color,
-                     highResWidth, highResHeight);
+    addAliased(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+               &upscaleFrameBuffers.upscale.color, highResWidth, highResHeight, TARGET_LIFETIME_UPSCALE);
+
+    // The pool reuses memory across resizes, it stays in the category it was allocated for
+    MemoryCategoryScope memoryScope(MEMORY_CATEGORY_GBUFFER);
+    if (m_renderTargets.AcquireAliased(aliased)) {
+        for (size_t i = 0; i < aliased.size(); i++) {
+            aliasedAttachments[i]->image = aliased[i].image;
+            aliasedAttachments[i]->view = aliased[i].view;
+            aliasedAttachments[i]->mem = aliased[i].memory;
+        }
+    } else {
+        LOGE("VulkanExample CreateOffscreenTargets: aliased targets create failed");
+    }
 
+    // Light Attachment, transfer src for the quality benchmark readback. Not aliased: the VRS dispatch reads the
+    // light color of the previous frame before the light pass writes it again.
+    CreateAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                     &frameBuffers.light.color, highResWidth, highResHeight);
+    {
+        MemoryCategoryScope upscaleScope(MEMORY_CATEGORY_UPSCALE);
+        CreateAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                         &upscaleFrameBuffers.light.color, lowResWidth, lowResHeight);
+    }
+    // They rest in SHADER_READ_ONLY_OPTIMAL between frames, see BuildFrameGraph. The first dispatch reads them
+    // before any light pass wrote them.
+    VkCommandBuffer layoutCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+    vks::tools::setImageLayout(layoutCmd, frameBuffers.light.color.image, VK_IMAGE_ASPECT_COLOR_BIT,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    vks::tools::setImageLayout(layoutCmd, upscaleFrameBuffers.light.color.image, VK_IMAGE_ASPECT_COLOR_BIT,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    vulkanDevice->flushCommandBuffer(layoutCmd, queue, true);
+
+    // Not aliased either, the shading rate images are reused across frames and kept in their attachment layout
     PrepareShadingRateImage((uint32_t)lowResWidth / VRS_TILE_SIZE, (uint32_t)lowResHeight / VRS_TILE_SIZE,
                             &upscaleFrameBuffers.shadingRate.color);
     PrepareShadingRateImage((uint32_t)highResWidth / VRS_TILE_SIZE, (uint32_t)highResHeight / VRS_TILE_SIZE,
@@ -251,11 +375,112 @@ void VulkanExample::PrepareOffscreenFramebuffers()
 
     LOGI("VulkanExample Before UpScale Size: %{public}d, %{public}d", lowResWidth, lowResHeight);
     LOGI("VulkanExample After UpScale Size: %{public}d, %{public}d", highResWidth, highResHeight);
+    RenderTargetPool::Stats stats;
+    m_renderTargets.GetStats(stats);
+    LOGI("VulkanExample render targets: %{public}llu bytes used, %{public}llu saved by aliasing, "
+        "%{public}llu free, %{public}u allocations, %{public}u reuses",
+        static_cast<unsigned long long>(stats.usedBytes), static_cast<unsigned long long>(stats.aliasedBytes),
+        static_cast<unsigned long long>(stats.freeBytes), stats.allocations, stats.reuses);
+}
+
+void VulkanExample::CreateOffscreenFramebuffers()
+{
+    // G-Buffer
+    {
+        std::array<VkImageView, 6> attachments;
+        attachments[0] = frameBuffers.gBufferLight.position.view;
+        attachments[1] = frameBuffers.gBufferLight.normal.view;
+        attachments[2] = frameBuffers.gBufferLight.albedo.view;
+        attachments[3] = frameBuffers.gBufferLight.depth.view;
+        attachments[4] = frameBuffers.gBufferLight.viewNormal.view;
+        attachments[5] = frameBuffers.shadingRate.color.view;
+
+        VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
+        fbufCreateInfo.renderPass = frameBuffers.gBufferLight.renderPass;
+        fbufCreateInfo.pAttachments = attachments.data();
+        fbufCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+        fbufCreateInfo.width = frameBuffers.gBufferLight.width;
+        fbufCreateInfo.height = frameBuffers.gBufferLight.height;
+        fbufCreateInfo.layers = 1;
+        VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &frameBuffers.gBufferLight.frameBuffer));
+
+        attachments[0] = upscaleFrameBuffers.gBufferLight.position.view;
+        attachments[1] = upscaleFrameBuffers.gBufferLight.normal.view;
+        attachments[2] = upscaleFrameBuffers.gBufferLight.albedo.view;
+        attachments[3] = upscaleFrameBuffers.gBufferLight.depth.view;
+        attachments[4] = upscaleFrameBuffers.gBufferLight.viewNormal.view;
+        attachments[5] = upscaleFrameBuffers.shadingRate.color.view;
+
+        fbufCreateInfo.renderPass = upscaleFrameBuffers.gBufferLight.renderPass;
+        fbufCreateInfo.width = upscaleFrameBuffers.gBufferLight.width;
+        fbufCreateInfo.height = upscaleFrameBuffers.gBufferLight.height;
+        VK_CHECK_RESULT(
+            vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &upscaleFrameBuffers.gBufferLight.frameBuffer));
+    }
+
+    // Light, the color attachment and the shading rate image
+    {
+        VkImageView attachmentsView[2];
+        attachmentsView[0] = frameBuffers.light.color.view;
+        attachmentsView[1] = frameBuffers.shadingRate.color.view;
+
+        VkFramebufferCreateInfo frameBufferCreateInfo{};
+        frameBufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        frameBufferCreateInfo.renderPass = frameBuffers.shadingRate.renderPass;
+        frameBufferCreateInfo.attachmentCount = 2;
+        frameBufferCreateInfo.pAttachments = attachmentsView;
+        frameBufferCreateInfo.width = frameBuffers.light.width;
+        frameBufferCreateInfo.height = frameBuffers.light.height;
+        frameBufferCreateInfo.layers = 1;
+        VK_CHECK_RESULT(
+            vkCreateFramebuffer(device, &frameBufferCreateInfo, nullptr, &frameBuffers.shadingRate.frameBuffer));
+
+        attachmentsView[0] = upscaleFrameBuffers.light.color.view;
+        attachmentsView[1] = upscaleFrameBuffers.shadingRate.color.view;
+        frameBufferCreateInfo.renderPass = upscaleFrameBuffers.shadingRate.renderPass;
+        frameBufferCreateInfo.width = upscaleFrameBuffers.light.width;
+        frameBufferCreateInfo.height = upscaleFrameBuffers.light.height;
+        VK_CHECK_RESULT(
+            vkCreateFramebuffer(device, &frameBufferCreateInfo, nullptr, &upscaleFrameBuffers.shadingRate.frameBuffer));
+    }
+}
+
+void VulkanExample::DestroyOffscreenTargets()
+{
+    frameBuffers.gBufferLight.destroyFrameBuffer(device);
+    frameBuffers.shadingRate.destroyFrameBuffer(device);
+    upscaleFrameBuffers.gBufferLight.destroyFrameBuffer(device);
+    upscaleFrameBuffers.shadingRate.destroyFrameBuffer(device);
+
+    ReleaseAttachment(frameBuffers.gBufferLight.position);
+    ReleaseAttachment(frameBuffers.gBufferLight.normal);
+    ReleaseAttachment(frameBuffers.gBufferLight.viewNormal);
+    ReleaseAttachment(frameBuffers.gBufferLight.albedo);
+    ReleaseAttachment(frameBuffers.gBufferLight.depth);
+    ReleaseAttachment(frameBuffers.light.color);
+    ReleaseAttachment(frameBuffers.shadingRate.color);
+
+    ReleaseAttachment(upscaleFrameBuffers.gBufferLight.position);
+    ReleaseAttachment(upscaleFrameBuffers.gBufferLight.normal);
+    ReleaseAttachment(upscaleFrameBuffers.gBufferLight.viewNormal);
+    ReleaseAttachment(upscaleFrameBuffers.gBufferLight.albedo);
+    ReleaseAttachment(upscaleFrameBuffers.gBufferLight.depth);
+    ReleaseAttachment(upscaleFrameBuffers.light.color);
+    ReleaseAttachment(upscaleFrameBuffers.upscale.color);
+    ReleaseAttachment(upscaleFrameBuffers.shadingRate.color);
+}
+
+void VulkanExample::PrepareOffscreenFramebuffers()
+{
+    CreateOffscreenTargets();
 
-    // G-Buffer Render Pass
+    // G-Buffer Render Pass, Support VRS
+    // Runs before this frame's VRS dispatch, so it shades with the shading rate image of the previous frame.
     {
-        std::array<VkAttachmentDescription, 5> attachmentDescs = {};
-        for (uint32_t i = 0; i < static_cast<uint32_t>(attachmentDescs.size()); i++) {
+        // 5 G-Buffer attachments and the shading rate image
+        std::array<VkAttachmentDescription2KHR, 6> attachmentDescs = {};
+        for (uint32_t i = 0; i < 5; i++) {
+            attachmentDescs[i].sType = VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2;
             attachmentDescs[i].samples = VK_SAMPLE_COUNT_1_BIT;
             attachmentDescs[i].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
             attachmentDescs[i].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
@@ -264,6 +489,16 @@ void VulkanExample::PrepareOffscreenFramebuffers()
             attachmentDescs[i].finalLayout =
                 (i == 3) ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
         }
+        // Only read here and left in the layout it rests in between frames, see BuildFrameGraph
+        attachmentDescs[5].sType = VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2;
+        attachmentDescs[5].format = VK_FORMAT_R8_UINT;
+        attachmentDescs[5].samples = VK_SAMPLE_COUNT_1_BIT;
+        attachmentDescs[5].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        attachmentDescs[5].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        attachmentDescs[5].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachmentDescs[5].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachmentDescs[5].initialLayout = VK_IMAGE_LAYOUT_FRAGMENT_SHADING_RATE_ATTACHMENT_OPTIMAL_KHR;
+        attachmentDescs[5].finalLayout = VK_IMAGE_LAYOUT_FRAGMENT_SHADING_RATE_ATTACHMENT_OPTIMAL_KHR;
 
         attachmentDescs[0].format = frameBuffers.gBufferLight.position.format;
         attachmentDescs[1].format = frameBuffers.gBufferLight.normal.format;
@@ -271,65 +506,75 @@ void VulkanExample::PrepareOffscreenFramebuffers()
         attachmentDescs[3].format = frameBuffers.gBufferLight.depth.format;
         attachmentDescs[4].format = frameBuffers.gBufferLight.viewNormal.format;
 
-        std::vector<VkAttachmentReference> colorReferences;
-        colorReferences.push_back({0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
-        colorReferences.push_back({1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
-        colorReferences.push_back({2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
-        colorReferences.push_back({4, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+        std::array<VkAttachmentReference2KHR, 4> colorReferences = {};
+        const uint32_t colorAttachments[] = {0, 1, 2, 4};
+        for (uint32_t i = 0; i < static_cast<uint32_t>(colorReferences.size()); i++) {
+            colorReferences[i].sType = VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2;
+            colorReferences[i].attachment = colorAttachments[i];
+            colorReferences[i].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            colorReferences[i].aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        }
 
-        VkAttachmentReference depthReference = {};
+        VkAttachmentReference2KHR depthReference = {};
+        depthReference.sType = VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2;
         depthReference.attachment = 3;
         depthReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depthReference.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+
+        VkAttachmentReference2 fragmentShadingRateReference{};
+        fragmentShadingRateReference.sType = VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2;
+        fragmentShadingRateReference.attachment = 5;
+        fragmentShadingRateReference.layout = VK_IMAGE_LAYOUT_FRAGMENT_SHADING_RATE_ATTACHMENT_OPTIMAL_KHR;
+
+        VkFragmentShadingRateAttachmentInfoKHR fragmentShadingRateAttachmentInfo{};
+        fragmentShadingRateAttachmentInfo.sType = VK_STRUCTURE_TYPE_FRAGMENT_SHADING_RATE_ATTACHMENT_INFO_KHR;
+        fragmentShadingRateAttachmentInfo.pFragmentShadingRateAttachment = &fragmentShadingRateReference;
+        fragmentShadingRateAttachmentInfo.shadingRateAttachmentTexelSize.width = VRS_TILE_SIZE;
+        fragmentShadingRateAttachmentInfo.shadingRateAttachmentTexelSize.height = VRS_TILE_SIZE;
 
-        VkSubpassDescription subpass = {};
+        VkSubpassDescription2KHR subpass = {};
+        subpass.sType = VK_STRUCTURE_TYPE_SUBPASS_DESCRIPTION_2;
         subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
         subpass.pColorAttachments = colorReferences.data();
         subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
         subpass.pDepthStencilAttachment = &depthReference;
+        subpass.pNext = &fragmentShadingRateAttachmentInfo;
 
-        std::array<VkSubpassDependency, 2> dependencies;
+        // The frame graph orders the pass against the passes around it, see BuildFrameGraph. The external
+        // dependencies only chain its barriers with the layout transitions of the attachments.
+        std::array<VkSubpassDependency2KHR, 2> dependencies = {};
+        const VkPipelineStageFlags attachmentStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
 
+        dependencies[0].sType = VK_STRUCTURE_TYPE_SUBPASS_DEPENDENCY_2;
         dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
         dependencies[0].dstSubpass = 0;
-        dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-        dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-        dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+        dependencies[0].srcStageMask = attachmentStages;
+        dependencies[0].dstStageMask = attachmentStages;
+        dependencies[0].srcAccessMask = 0;
+        dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
+        dependencies[1].sType = VK_STRUCTURE_TYPE_SUBPASS_DEPENDENCY_2;
         dependencies[1].srcSubpass = 0;
         dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-        dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-        dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-        dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+        dependencies[1].srcStageMask = attachmentStages;
+        dependencies[1].dstStageMask = attachmentStages;
+        dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependencies[1].dstAccessMask = 0;
 
-        VkRenderPassCreateInfo renderPassInfo = {};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        VkRenderPassCreateInfo2KHR renderPassInfo = {};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO_2;
         renderPassInfo.pAttachments = attachmentDescs.data();
         renderPassInfo.attachmentCount = static_cast<uint32_t>(attachmentDescs.size());
         renderPassInfo.subpassCount = 1;
         renderPassInfo.pSubpasses = &subpass;
-        renderPassInfo.dependencyCount = 2;
+        renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
         renderPassInfo.pDependencies = dependencies.data();
-        VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &frameBuffers.gBufferLight.renderPass));
-
-        std::array<VkImageView, 5> attachments;
-        attachments[0] = frameBuffers.gBufferLight.position.view;
-        attachments[1] = frameBuffers.gBufferLight.normal.view;
-        attachments[2] = frameBuffers.gBufferLight.albedo.view;
-        attachments[3] = frameBuffers.gBufferLight.depth.view;
-        attachments[4] = frameBuffers.gBufferLight.viewNormal.view;
-
-        VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
-        fbufCreateInfo.renderPass = frameBuffers.gBufferLight.renderPass;
-        fbufCreateInfo.pAttachments = attachments.data();
-        fbufCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-        fbufCreateInfo.width = frameBuffers.gBufferLight.width;
-        fbufCreateInfo.height = frameBuffers.gBufferLight.height;
-        fbufCreateInfo.layers = 1;
-        VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &frameBuffers.gBufferLight.frameBuffer));
+        VK_CHECK_RESULT(
+            vkCreateRenderPass2KHR(device, &renderPassInfo, nullptr, &frameBuffers.gBufferLight.renderPass));
 
         attachmentDescs[0].format = upscaleFrameBuffers.gBufferLight.position.format;
         attachmentDescs[1].format = upscaleFrameBuffers.gBufferLight.normal.format;
@@ -337,33 +582,11 @@ void VulkanExample::PrepareOffscreenFramebuffers()
         attachmentDescs[3].format = upscaleFrameBuffers.gBufferLight.depth.format;
         attachmentDescs[4].format = upscaleFrameBuffers.gBufferLight.viewNormal.format;
 
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-        renderPassInfo.pAttachments = attachmentDescs.data();
-        renderPassInfo.attachmentCount = static_cast<uint32_t>(attachmentDescs.size());
-        renderPassInfo.subpassCount = 1;
-        renderPassInfo.pSubpasses = &subpass;
-        renderPassInfo.dependencyCount = 2;
-        renderPassInfo.pDependencies = dependencies.data();
-        VK_CHECK_RESULT(
-            vkCreateRenderPass(device, &renderPassInfo, nullptr, &upscaleFrameBuffers.gBufferLight.renderPass));
-
-        attachments[0] = upscaleFrameBuffers.gBufferLight.position.view;
-        attachments[1] = upscaleFrameBuffers.gBufferLight.normal.view;
-        attachments[2] = upscaleFrameBuffers.gBufferLight.albedo.view;
-        attachments[3] = upscaleFrameBuffers.gBufferLight.depth.view;
-        attachments[4] = upscaleFrameBuffers.gBufferLight.viewNormal.view;
-
-        fbufCreateInfo.renderPass = upscaleFrameBuffers.gBufferLight.renderPass;
-        fbufCreateInfo.pAttachments = attachments.data();
-        fbufCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-        fbufCreateInfo.width = upscaleFrameBuffers.gBufferLight.width;
-        fbufCreateInfo.height = upscaleFrameBuffers.gBufferLight.height;
-        fbufCreateInfo.layers = 1;
         VK_CHECK_RESULT(
-            vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &upscaleFrameBuffers.gBufferLight.frameBuffer));
+            vkCreateRenderPass2KHR(device, &renderPassInfo, nullptr, &upscaleFrameBuffers.gBufferLight.renderPass));
     }
 
-    // Light Render Pass And FrameBuffer, Support VRS
+    // Light Render Pass, Support VRS
     {
         // need 2 attachment, light and shading rate image
         std::array<VkAttachmentDescription2KHR, 2> attachments = {};
@@ -381,10 +604,12 @@ void VulkanExample::PrepareOffscreenFramebuffers()
         attachments[1].format = VK_FORMAT_R8_UINT;
         attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
         attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
-        attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        // Stored, the next frame's G-Buffer pass and the reuse path read it again. The frame graph transitions it
+        // from GENERAL after a VRS dispatch, without one it stays in its attachment layout.
+        attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
         attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
         attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        attachments[1].initialLayout = VK_IMAGE_LAYOUT_GENERAL;
+        attachments[1].initialLayout = VK_IMAGE_LAYOUT_FRAGMENT_SHADING_RATE_ATTACHMENT_OPTIMAL_KHR;
         attachments[1].finalLayout = VK_IMAGE_LAYOUT_FRAGMENT_SHADING_RATE_ATTACHMENT_OPTIMAL_KHR;
 
         VkAttachmentReference2KHR colorReference = {};
@@ -416,33 +641,24 @@ void VulkanExample::PrepareOffscreenFramebuffers()
         subpassDescription.pResolveAttachments = nullptr;
         subpassDescription.pNext = &fragmentShadingRateAttachmentInfo;
 
+        // Ordered by the frame graph, the dependencies chain its barriers with the color layout transitions
         std::array<VkSubpassDependency2KHR, 2> dependencies = {};
 
         dependencies[0].sType = VK_STRUCTURE_TYPE_SUBPASS_DEPENDENCY_2;
         dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
         dependencies[0].dstSubpass = 0;
-        dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-        dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-                                       VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
-                                       VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-        dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-        dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
-                                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
-                                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-        dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+        dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[0].srcAccessMask = 0;
+        dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
         dependencies[1].sType = VK_STRUCTURE_TYPE_SUBPASS_DEPENDENCY_2;
         dependencies[1].srcSubpass = 0;
         dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-        dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-                                       VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
-                                       VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-        dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-        dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
-                                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
-                                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-        dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-        dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+        dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependencies[1].dstAccessMask = 0;
 
         VkRenderPassCreateInfo2KHR renderPassCI = {};
         renderPassCI.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO_2;
@@ -457,21 +673,6 @@ void VulkanExample::PrepareOffscreenFramebuffers()
         }
 
         vkCreateRenderPass2KHR(device, &renderPassCI, nullptr, &frameBuffers.shadingRate.renderPass);
-
-        VkImageView attachmentsView[2];
-        attachmentsView[0] = frameBuffers.light.color.view;
-        attachmentsView[1] = frameBuffers.shadingRate.color.view;
-
-        VkFramebufferCreateInfo frameBufferCreateInfo{};
-        frameBufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        frameBufferCreateInfo.renderPass = frameBuffers.shadingRate.renderPass;
-        frameBufferCreateInfo.attachmentCount = 2;
-        frameBufferCreateInfo.pAttachments = attachmentsView;
-        frameBufferCreateInfo.width = frameBuffers.light.width;
-        frameBufferCreateInfo.height = frameBuffers.light.height;
-        frameBufferCreateInfo.layers = 1;
-        VK_CHECK_RESULT(
-            vkCreateFramebuffer(device, &frameBufferCreateInfo, nullptr, &frameBuffers.shadingRate.frameBuffer));
     }
 
     {
@@ -490,10 +691,12 @@ void VulkanExample::PrepareOffscreenFramebuffers()
         attachments[1].format = VK_FORMAT_R8_UINT;
         attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
         attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
-        attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        // Stored, the next frame's G-Buffer pass and the reuse path read it again. The frame graph transitions it
+        // from GENERAL after a VRS dispatch, without one it stays in its attachment layout.
+        attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
         attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
         attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        attachments[1].initialLayout = VK_IMAGE_LAYOUT_GENERAL;
+        attachments[1].initialLayout = VK_IMAGE_LAYOUT_FRAGMENT_SHADING_RATE_ATTACHMENT_OPTIMAL_KHR;
         attachments[1].finalLayout = VK_IMAGE_LAYOUT_FRAGMENT_SHADING_RATE_ATTACHMENT_OPTIMAL_KHR;
 
         VkAttachmentReference2KHR colorReference = {};
@@ -525,33 +728,24 @@ void VulkanExample::PrepareOffscreenFramebuffers()
         subpassDescription.pResolveAttachments = nullptr;
         subpassDescription.pNext = &fragmentShadingRateAttachmentInfo;
 
+        // Ordered by the frame graph, the dependencies chain its barriers with the color layout transitions
         std::array<VkSubpassDependency2KHR, 2> dependencies = {};
 
         dependencies[0].sType = VK_STRUCTURE_TYPE_SUBPASS_DEPENDENCY_2;
         dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
         dependencies[0].dstSubpass = 0;
-        dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-        dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-                                       VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
-                                       VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-        dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-        dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
-                                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
-                                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-        dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+        dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[0].srcAccessMask = 0;
+        dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
         dependencies[1].sType = VK_STRUCTURE_TYPE_SUBPASS_DEPENDENCY_2;
         dependencies[1].srcSubpass = 0;
         dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-        dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-                                       VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
-                                       VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-        dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-        dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
-                                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
-                                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-        dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-        dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+        dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependencies[1].dstAccessMask = 0;
 
         VkRenderPassCreateInfo2KHR renderPassCI = {};
         renderPassCI.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO_2;
@@ -563,23 +757,10 @@ void VulkanExample::PrepareOffscreenFramebuffers()
         renderPassCI.pDependencies = dependencies.data();
         VK_CHECK_RESULT(
             vkCreateRenderPass2KHR(device, &renderPassCI, nullptr, &upscaleFrameBuffers.shadingRate.renderPass));
-
-        VkImageView attachmentsView[2];
-        attachmentsView[0] = upscaleFrameBuffers.light.color.view;
-        attachmentsView[1] = upscaleFrameBuffers.shadingRate.color.view;
-
-        VkFramebufferCreateInfo frameBufferCreateInfo{};
-        frameBufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        frameBufferCreateInfo.renderPass = upscaleFrameBuffers.shadingRate.renderPass;
-        frameBufferCreateInfo.attachmentCount = 2;
-        frameBufferCreateInfo.pAttachments = attachmentsView;
-        frameBufferCreateInfo.width = upscaleFrameBuffers.light.width;
-        frameBufferCreateInfo.height = upscaleFrameBuffers.light.height;
-        frameBufferCreateInfo.layers = 1;
-        VK_CHECK_RESULT(
-            vkCreateFramebuffer(device, &frameBufferCreateInfo, nullptr, &upscaleFrameBuffers.shadingRate.frameBuffer));
     }
 
+    CreateOffscreenFramebuffers();
+
     // Sampler
     VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
     sampler.magFilter = VK_FILTER_NEAREST;
@@ -598,257 +779,486 @@ void VulkanExample::PrepareOffscreenFramebuffers()
 
 void VulkanExample::LoadAssets()
 {
-    std::string modelPath = FileOperator::GetInstance()->GetFileAbsolutePath("Sponza/sponza.obj");
-    m_scene.LoadFromFile(modelPath, vulkanDevice, queue);
+    std::string modelPath = "Sponza/sponza.obj";
+    m_scene.EnableStreaming(TEXTURE_STREAMING_BUDGET);
+    m_scene.LoadFromFile(modelPath, vulkanDevice, queue, m_uploadManager);
+    // Cached shading rates are only valid for the scene they were generated from
+    m_sceneHash = ShadingRateCache::HashScene(modelPath,
+        static_cast<uint64_t>(FileOperator::GetInstance()->GetAssetSize(modelPath)));
 }
 
+vkOBJ::StreamingView VulkanExample::GetStreamingView() const
+{
+    // The streamer works in model space, the scene is drawn with the scaled model matrix
+    glm::mat4 modelView = uboSceneParams.view * uboSceneParams.model;
+    vkOBJ::StreamingView view;
+    view.position = glm::vec3(glm::inverse(modelView)[3]);
+    // Projection is scale invariant, pixels per unit at distance 1 are the same in model and world space
+    uint32_t height = cur_method != 0 ? lowResHeight : highResHeight;
+    view.pixelsPerUnit = std::abs(camera.matrices.perspective[1][1]) * 0.5f * static_cast<float>(height);
+    return view;
+}
 
 void VulkanExample::buildCommandBuffers()
 {
-    if (use_method != 0) {
-        BuildUpscaleCommandBuffers();
-        return;
-    }
-
-    VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
-    VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-    VkViewport viewport;
-    VkRect2D scissor;
-    VkExtent2D fragmentSize = {1, 1};
-    VkFragmentShadingRateCombinerOpKHR combinerOps[2];
-
-    for (int32_t i = 0; i < drawCmdBuffers.size(); ++i) {
-        LOGI("VulkanExample Do not use Upscale.");
-        VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
-
-        // First Pass: GBuffer
-        std::vector<VkClearValue> clearValues(5);
-        clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
-        clearValues[1].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
-        clearValues[2].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
-        clearValues[3].depthStencil = {1.0f, 0};
-        clearValues[4].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+    TRACE_SCOPE("buildCommandBuffers");
+    // Resources referenced by every recorded variant changed, the one in use is recorded now, the others when they
+    // are switched to
+    InvalidateCommandVariants();
+    ActivateCommandVariant();
+}
 
-        renderPassBeginInfo.renderPass = frameBuffers.gBufferLight.renderPass;
-        renderPassBeginInfo.framebuffer = frameBuffers.gBufferLight.frameBuffer;
-        renderPassBeginInfo.renderArea.extent.width = frameBuffers.gBufferLight.width;
-        renderPassBeginInfo.renderArea.extent.height = frameBuffers.gBufferLight.height;
-        renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-        renderPassBeginInfo.pClearValues = clearValues.data();
+uint32_t VulkanExample::GetCommandVariantKey() const
+{
+    // The pass selection only matters with VRS on
+    uint32_t vrsPasses = use_vrs ? use_vrsPasses : 0;
+    return (static_cast<uint32_t>(use_method) & 0xff) | (use_vrs ? 0x100 : 0) | (vrsPasses << 9) |
+        (use_overlay ? 0x800 : 0);
+}
 
-        vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-        viewport = vks::initializers::viewport((float)frameBuffers.gBufferLight.width,
-                                               (float)frameBuffers.gBufferLight.height, 0.0f, 1.0f);
-        vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-        scissor = vks::initializers::rect2D(frameBuffers.gBufferLight.width, frameBuffers.gBufferLight.height, 0, 0);
-        vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-        vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.gBufferLight);
-        vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.gBufferLight, 0, 1,
-                                &descriptorSets.gBufferLight, 0, NULL);
-        m_scene.Draw(drawCmdBuffers[i], 0x00000001, pipelineLayouts.gBufferLight, 1);
-
-        vkCmdEndRenderPass(drawCmdBuffers[i]);
-
-        // When use vrs, Dispatch vrs to compute sri
-        if (use_vrs) {
-            DispatchVRS(false, drawCmdBuffers[i]);
-            // Save frameBuffers.shadingRate.color to file after DispatchVRS
-            saveShadingRateImage();
-        } else {
-            LOGI("VulkanExample do not use vrs.");
+void VulkanExample::ActivateCommandVariant()
+{
+    uint32_t key = GetCommandVariantKey();
+    CommandVariant *variant = nullptr;
+    for (auto &candidate : m_commandVariants) {
+        if (candidate->key == key) {
+            variant = candidate.get();
+            break;
         }
-
-        // Second Pass: Light Pass, Support VRS
-        clearValues[0].color = defaultClearColor;
-        clearValues[1].depthStencil = {1.0f, 0};
-
-        renderPassBeginInfo.renderPass = frameBuffers.shadingRate.renderPass;
-        renderPassBeginInfo.framebuffer = frameBuffers.shadingRate.frameBuffer;
-        renderPassBeginInfo.renderArea.extent.width = frameBuffers.shadingRate.width;
-        renderPassBeginInfo.renderArea.extent.height = frameBuffers.shadingRate.height;
-        renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-        renderPassBeginInfo.pClearValues = clearValues.data();
-
-        vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-        if (use_vrs) {
-            // If shading rate from attachment is enabled, we set the combiner, so that the values from the attachment
-            // are used Combiner for pipeline (A) and primitive (B) - Not used in this sample
-            combinerOps[0] = VK_FRAGMENT_SHADING_RATE_COMBINER_OP_KEEP_KHR;
-            // Combiner for pipeline (A) and attachment (B), replace the pipeline default value (fragment_size) with the
-            // fragment sizes stored in the attachment
-            combinerOps[1] = VK_FRAGMENT_SHADING_RATE_COMBINER_OP_REPLACE_KHR;
-        } else {
-            // If shading rate from attachment is disabled, we keep the value set via the dynamic state
-            combinerOps[0] = VK_FRAGMENT_SHADING_RATE_COMBINER_OP_KEEP_KHR;
-            combinerOps[1] = VK_FRAGMENT_SHADING_RATE_COMBINER_OP_KEEP_KHR;
+    }
+    if (variant == nullptr) {
+        if (m_commandVariants.size() >= COMMAND_VARIANT_CACHE_SIZE) {
+            auto oldest = m_commandVariants.end();
+            for (auto it = m_commandVariants.begin(); it != m_commandVariants.end(); it++) {
+                if (it->get() != m_activeVariant && (oldest == m_commandVariants.end() ||
+                    (*it)->lastUsed < (*oldest)->lastUsed)) {
+                    oldest = it;
+                }
+            }
+            if (oldest != m_commandVariants.end()) {
+                // Its buffers may have been submitted by one of the last frames
+                WaitForSubmittedFrames();
+                FreeCommandVariant(**oldest);
+                m_commandVariants.erase(oldest);
+            }
         }
-        vkCmdSetFragmentShadingRateKHR(drawCmdBuffers[i], &fragmentSize, combinerOps);
-
-        viewport =
-            vks::initializers::viewport((float)frameBuffers.light.width, (float)frameBuffers.light.height, 0.0f, 1.0f);
-        vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-        scissor = vks::initializers::rect2D(frameBuffers.light.width, frameBuffers.light.height, 0, 0);
-        vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-        vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.light, 0, 1,
-                                &descriptorSets.light, 0, nullptr);
-        vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.light);
-        vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-        vkCmdEndRenderPass(drawCmdBuffers[i]);
-
-        // Final Pass: To Full Screen
-        clearValues[0].color = defaultClearColor;
-        clearValues[1].depthStencil = {1.0f, 0};
-        VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-        VkViewport viewport;
-        VkRect2D scissor;
-        renderPassBeginInfo.renderPass = renderPass;
-        renderPassBeginInfo.framebuffer = VulkanExampleBase::frameBuffers[i];
-        renderPassBeginInfo.renderArea.extent.width = screenWidth;
-        renderPassBeginInfo.renderArea.extent.height = screenHeight;
-        renderPassBeginInfo.clearValueCount = 2;
-        renderPassBeginInfo.pClearValues = clearValues.data();
+        m_commandVariants.push_back(std::make_unique<CommandVariant>());
+        variant = m_commandVariants.back().get();
+        variant->key = key;
+    }
+    bool recorded = false;
+    if (!variant->recorded || variant->drawCmdBuffers.size() != drawCmdBuffers.size()) {
+        RecordCommandVariant(*variant);
+        recorded = true;
+    }
+    variant->lastUsed = m_frameIndex;
+    if (recorded || variant != m_activeVariant) {
+        // The shading rate image of the previous variant may have another size or come from other passes
+        m_vrsReuseRecorded = use_vrs;
+        m_vrsHistoryValid = false;
+    }
+    m_activeVariant = variant;
+}
 
-        vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+void VulkanExample::RecordCommandVariant(CommandVariant &variant)
+{
+    // A stale variant may still be executing from before it was invalidated
+    WaitForSubmittedFrames();
+    uint32_t count = static_cast<uint32_t>(drawCmdBuffers.size());
+    if (variant.drawCmdBuffers.size() != count) {
+        // drawCmdBuffers are recreated with the swapchain, follow their count
+        FreeCommandVariant(variant);
+        variant.drawCmdBuffers.resize(count);
+        VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(cmdPool,
+            VK_COMMAND_BUFFER_LEVEL_PRIMARY, count);
+        VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, variant.drawCmdBuffers.data()));
+    }
+    if (use_vrs && variant.reuseCmdBuffers.size() != count) {
+        variant.reuseCmdBuffers.resize(count);
+        VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(cmdPool,
+            VK_COMMAND_BUFFER_LEVEL_PRIMARY, count);
+        VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, variant.reuseCmdBuffers.data()));
+    }
 
-        viewport = vks::initializers::viewport((float)screenWidth, (float)screenHeight, 0.0f, 1.0f);
-        vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-        scissor = vks::initializers::rect2D(screenWidth, screenHeight, 0, 0);
-        vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+    // With VRS on, the reuse buffers skip the dispatch and keep the shading rate image of an earlier frame,
+    // Draw picks one of the two per frame, see ShouldDispatchVRS. The G-Buffer pass runs before the dispatch and
+    // only follows the kept image in the reuse buffers: Draw dispatches when the view moved too far from the one
+    // the image was generated for, the G-Buffer pass of those frames shades at full rate.
+    bool upscale = use_method != 0;
+    RecordGBufferSecondaries(upscale, false);
+    BuildFrameCommandBuffers(variant.drawCmdBuffers, upscale, use_vrs);
+    if (use_vrs) {
+        RecordGBufferSecondaries(upscale, (use_vrsPasses & VRS_PASS_GBUFFER) != 0);
+        BuildFrameCommandBuffers(variant.reuseCmdBuffers, upscale, false);
+    }
+    variant.recorded = true;
+    LOGD("VulkanExample recorded command variant 0x%{public}x", variant.key);
+}
 
-        vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.swap, 0, 1,
-                                &descriptorSets.swap, 0, NULL);
-        vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.swap);
-        vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-        vkCmdEndRenderPass(drawCmdBuffers[i]);
+void VulkanExample::InvalidateCommandVariants()
+{
+    for (auto &variant : m_commandVariants) {
+        variant->recorded = false;
+    }
+    for (auto &secondaries : m_gBufferSecondaries) {
+        secondaries.recorded = false;
+    }
+}
 
-        VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+void VulkanExample::FreeCommandVariant(CommandVariant &variant)
+{
+    if (!variant.drawCmdBuffers.empty()) {
+        vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(variant.drawCmdBuffers.size()),
+            variant.drawCmdBuffers.data());
+        variant.drawCmdBuffers.clear();
+    }
+    if (!variant.reuseCmdBuffers.empty()) {
+        vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(variant.reuseCmdBuffers.size()),
+            variant.reuseCmdBuffers.data());
+        variant.reuseCmdBuffers.clear();
     }
+    variant.recorded = false;
 }
 
-void VulkanExample::BuildUpscaleCommandBuffers()
+void VulkanExample::WaitForSubmittedFrames()
 {
-    VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
-    VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-    VkViewport viewport;
-    VkRect2D scissor;
-    VkExtent2D fragmentSize = {1, 1};
-    VkFragmentShadingRateCombinerOpKHR combinerOps[2];
-    for (int32_t i = 0; i < drawCmdBuffers.size(); ++i) {
-        VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+    if (!waitFences.empty()) {
+        VK_CHECK_RESULT(vkWaitForFences(device, static_cast<uint32_t>(waitFences.size()), waitFences.data(), VK_TRUE,
+            UINT64_MAX));
+    }
+}
 
-        // First Pass: GBuffer
+void VulkanExample::BuildFrameGraph(FrameGraph &graph, bool upscale, bool dispatchVRS)
+{
+    Offscreen &gBuffer = upscale ? upscaleFrameBuffers.gBufferLight : frameBuffers.gBufferLight;
+    Render &light = upscale ? upscaleFrameBuffers.light : frameBuffers.light;
+    Render &shadingRate = upscale ? upscaleFrameBuffers.shadingRate : frameBuffers.shadingRate;
+    bool spatialUpscale = upscale && use_method == 1 && m_xegSpatialUpscaleSupported;
+    bool overlay = use_overlay && m_debugOverlay != nullptr;
+    VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    if (gBuffer.depth.format >= VK_FORMAT_D16_UNORM_S8_UINT) {
+        depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+
+    // The G-Buffer and the upscale output are rewritten every frame. The light color is read by the VRS dispatch
+    // of the next frame and the shading rate image is kept across frames, both rest in the layout their readers
+    // outside the graph (readbacks, the reuse path) expect.
+    const FrameBufferAttachment *gBufferColors[] = {&gBuffer.position, &gBuffer.normal, &gBuffer.albedo,
+        &gBuffer.viewNormal};
+    const char *const gBufferNames[] = {"position", "normal", "albedo", "viewNormal"};
+    uint32_t gBufferImages[4];
+    for (uint32_t i = 0; i < 4; i++) {
+        gBufferImages[i] = graph.AddImage(gBufferNames[i], gBufferColors[i]->image, VK_IMAGE_ASPECT_COLOR_BIT,
+            VK_IMAGE_LAYOUT_UNDEFINED);
+    }
+    uint32_t depthImage = graph.AddImage("depth", gBuffer.depth.image, depthAspect, VK_IMAGE_LAYOUT_UNDEFINED);
+    uint32_t lightImage = graph.AddImage("light", light.color.image, VK_IMAGE_ASPECT_COLOR_BIT,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    uint32_t shadingRateImage = graph.AddImage("shadingRate", shadingRate.color.image, VK_IMAGE_ASPECT_COLOR_BIT,
+        VK_IMAGE_LAYOUT_FRAGMENT_SHADING_RATE_ATTACHMENT_OPTIMAL_KHR);
+    uint32_t upscaleImage = graph.AddImage("upscale", upscaleFrameBuffers.upscale.color.image,
+        VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+
+    // First Pass: GBuffer
+    uint32_t pass = graph.AddPass("gbuffer", 0, [this, upscale, &gBuffer](VkCommandBuffer cmd, uint32_t index) {
         std::vector<VkClearValue> clearValues(5);
         clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
         clearValues[1].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
         clearValues[2].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
         clearValues[3].depthStencil = {1.0f, 0};
         clearValues[4].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
-
-        renderPassBeginInfo.renderPass = upscaleFrameBuffers.gBufferLight.renderPass;
-        renderPassBeginInfo.framebuffer = upscaleFrameBuffers.gBufferLight.frameBuffer;
-        renderPassBeginInfo.renderArea.extent.width = upscaleFrameBuffers.gBufferLight.width;
-        renderPassBeginInfo.renderArea.extent.height = upscaleFrameBuffers.gBufferLight.height;
+        VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+        renderPassBeginInfo.renderPass = gBuffer.renderPass;
+        renderPassBeginInfo.framebuffer = gBuffer.frameBuffer;
+        renderPassBeginInfo.renderArea.extent.width = gBuffer.width;
+        renderPassBeginInfo.renderArea.extent.height = gBuffer.height;
         renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
         renderPassBeginInfo.pClearValues = clearValues.data();
-
-        vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-        viewport = vks::initializers::viewport((float)upscaleFrameBuffers.gBufferLight.width,
-                                               (float)upscaleFrameBuffers.gBufferLight.height, 0.0f, 1.0f);
-        vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-        scissor = vks::initializers::rect2D(upscaleFrameBuffers.gBufferLight.width,
-                                            upscaleFrameBuffers.gBufferLight.height, 0, 0);
-        vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-        vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, upscalePipelines.gBufferLight);
-        vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.gBufferLight, 0, 1,
-                                &descriptorSets.gBufferLight, 0, NULL);
-        m_scene.Draw(drawCmdBuffers[i], 0x00000001, pipelineLayouts.gBufferLight, 1);
-
-        vkCmdEndRenderPass(drawCmdBuffers[i]);
-
-        // when use vrs, dispatchvrs to compute sri
-        if (use_vrs) {
-            DispatchVRS(true, drawCmdBuffers[i]);
-            // Save frameBuffers.shadingRate.color to file after DispatchVRS
-            saveShadingRateImage();
-        } else {
-            LOGI("VulkanExample not use vrs");
+        RecordGBufferPass(cmd, index, renderPassBeginInfo, upscale);
+    });
+    for (uint32_t image : gBufferImages) {
+        graph.Write(pass, image, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, true);
+    }
+    graph.Write(pass, depthImage,
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, true);
+    graph.Read(pass, shadingRateImage, VK_PIPELINE_STAGE_FRAGMENT_SHADING_RATE_ATTACHMENT_BIT_KHR,
+        VK_ACCESS_FRAGMENT_SHADING_RATE_ATTACHMENT_READ_BIT_KHR,
+        VK_IMAGE_LAYOUT_FRAGMENT_SHADING_RATE_ATTACHMENT_OPTIMAL_KHR);
+
+    // When use vrs, Dispatch vrs to compute sri from this frame's depth and the previous frame's light color.
+    // Every texel is rewritten, the reuse buffers cull the pass and keep the content.
+    pass = graph.AddPass("vrs", dispatchVRS ? 0 : FrameGraph::PASS_DISABLED,
+        [this, upscale](VkCommandBuffer cmd, uint32_t index) { DispatchVRS(upscale, cmd); });
+    graph.Read(pass, depthImage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+    graph.Read(pass, lightImage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    graph.Write(pass, shadingRateImage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_UNDEFINED, true);
+
+    // Second Pass: Light Pass, Support VRS
+    pass = graph.AddPass("light", 0,
+        [this, upscale](VkCommandBuffer cmd, uint32_t index) { RecordLightPass(cmd, index, upscale); });
+    for (uint32_t i = 0; i < 3; i++) {
+        graph.Read(pass, gBufferImages[i], VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+    graph.Read(pass, shadingRateImage, VK_PIPELINE_STAGE_FRAGMENT_SHADING_RATE_ATTACHMENT_BIT_KHR,
+        VK_ACCESS_FRAGMENT_SHADING_RATE_ATTACHMENT_READ_BIT_KHR,
+        VK_IMAGE_LAYOUT_FRAGMENT_SHADING_RATE_ATTACHMENT_OPTIMAL_KHR);
+    graph.Write(pass, lightImage, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, true);
+
+    // The XEngine upscale is opaque, declared with every stage it may use and left for sampling
+    const VkPipelineStageFlags spatialUpscaleStages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    pass = graph.AddPass("spatialUpscale", spatialUpscale ? 0 : FrameGraph::PASS_DISABLED,
+        [this](VkCommandBuffer cmd, uint32_t index) {
+            XEG_SpatialUpscaleDescription xegDescription{0};
+            xegDescription.inputImage = upscaleFrameBuffers.light.color.view;
+            xegDescription.outputImage = upscaleFrameBuffers.upscale.color.view;
+            HMS_XEG_CmdRenderSpatialUpscale(cmd, xegSpatialUpscale, &xegDescription);
+        });
+    graph.Read(pass, lightImage, spatialUpscaleStages, VK_ACCESS_SHADER_READ_BIT,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    graph.Write(pass, upscaleImage, spatialUpscaleStages,
+        VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, true);
+
+    pass = graph.AddPass("fsr", (upscale && !spatialUpscale) ? 0 : FrameGraph::PASS_DISABLED,
+        [this](VkCommandBuffer cmd, uint32_t index) { fsr->Render(cmd); });
+    graph.Read(pass, lightImage, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    graph.Write(pass, upscaleImage, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        true);
+
+    // Final Pass: To Full Screen, the overlay samples the G-Buffer and the shading rate image
+    pass = graph.AddPass("swap", FrameGraph::PASS_SIDE_EFFECTS,
+        [this, upscale](VkCommandBuffer cmd, uint32_t index) { RecordSwapPass(cmd, index, upscale); });
+    graph.Read(pass, upscale ? upscaleImage : lightImage, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    if (overlay) {
+        for (uint32_t image : gBufferImages) {
+            graph.Read(pass, image, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
         }
-        
-        // Second Pass: Light Pass, Support VRS
-        clearValues[0].color = defaultClearColor;
-        clearValues[1].depthStencil = {1.0f, 0};
-
-        renderPassBeginInfo.renderPass = upscaleFrameBuffers.shadingRate.renderPass;
-        renderPassBeginInfo.framebuffer = upscaleFrameBuffers.shadingRate.frameBuffer;
-        renderPassBeginInfo.renderArea.extent.width = upscaleFrameBuffers.shadingRate.width;
-        renderPassBeginInfo.renderArea.extent.height = upscaleFrameBuffers.shadingRate.height;
-        renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-        renderPassBeginInfo.pClearValues = clearValues.data();
+        graph.Read(pass, shadingRateImage, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+}
 
-        vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-        if (use_vrs) {
-            // If shading rate from attachment is enabled, we set the combiner, so that the values from the attachment
-            // are used Combiner for pipeline (A) and primitive (B) - Not used in this sample
-            combinerOps[0] = VK_FRAGMENT_SHADING_RATE_COMBINER_OP_KEEP_KHR;
-            // Combiner for pipeline (A) and attachment (B), replace the pipeline default value (fragment_size) with the
-            // fragment sizes stored in the attachment
-            combinerOps[1] = VK_FRAGMENT_SHADING_RATE_COMBINER_OP_REPLACE_KHR;
-        } else {
-            // If shading rate from attachment is disabled, we keep the value set via the dynamic state
-            combinerOps[0] = VK_FRAGMENT_SHADING_RATE_COMBINER_OP_KEEP_KHR;
-            combinerOps[1] = VK_FRAGMENT_SHADING_RATE_COMBINER_OP_KEEP_KHR;
+void VulkanExample::BuildFrameCommandBuffers(const std::vector<VkCommandBuffer> &cmdBuffers, bool upscale,
+    bool dispatchVRS)
+{
+    FrameGraph graph;
+    BuildFrameGraph(graph, upscale, dispatchVRS);
+    if (!graph.Compile()) {
+        LOGE("VulkanExample frame graph is invalid, upscale %{public}d", upscale);
+    }
+    LOGD("VulkanExample record command buffers, upscale %{public}s",
+        !upscale ? "none" : (graph.IsCulled(FRAME_PASS_FSR) ? "spatial" : "fsr"));
+
+    // Culled passes still write their timestamp, the pass times stay comparable across the variants
+    static const uint32_t passTimestamps[FRAME_PASS_COUNT] = {TIMESTAMP_GBUFFER, TIMESTAMP_VRS, TIMESTAMP_LIGHT,
+        TIMESTAMP_COUNT, TIMESTAMP_UPSCALE, TIMESTAMP_COUNT};
+    auto passEnd = [this](VkCommandBuffer cmd, uint32_t index, uint32_t pass) {
+        if (passTimestamps[pass] != TIMESTAMP_COUNT) {
+            WriteTimestamp(cmd, index, passTimestamps[pass]);
         }
+    };
 
-        vkCmdSetFragmentShadingRateKHR(drawCmdBuffers[i], &fragmentSize, combinerOps);
-        viewport = vks::initializers::viewport((float)upscaleFrameBuffers.light.width,
-                                               (float)upscaleFrameBuffers.light.height, 0.0f, 1.0f);
-        vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-        scissor = vks::initializers::rect2D(upscaleFrameBuffers.light.width, upscaleFrameBuffers.light.height, 0, 0);
-        vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-        vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.light, 0, 1,
-                                &upscaleDescriptorSets.light, 0, nullptr);
-        vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, upscalePipelines.light);
-        vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-        vkCmdEndRenderPass(drawCmdBuffers[i]);
-
-        if (use_method == 1) {
-            LOGI("VulkanExample example use spatial upscale.");
-            XEG_SpatialUpscaleDescription xegDescription{0};
-            xegDescription.inputImage = upscaleFrameBuffers.light.color.view;
-            xegDescription.outputImage = upscaleFrameBuffers.upscale.color.view;
-            HMS_XEG_CmdRenderSpatialUpscale(drawCmdBuffers[i], xegSpatialUpscale, &xegDescription);
-        } else {
-            LOGI("VulkanExample example use fsr upscale.");
-            fsr->Render(drawCmdBuffers[i]);
+    VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+    for (uint32_t i = 0; i < static_cast<uint32_t>(cmdBuffers.size()); ++i) {
+        VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffers[i], &cmdBufInfo));
+        WriteTimestamp(cmdBuffers[i], i, TIMESTAMP_BEGIN);
+        ResetPipelineStatistics(cmdBuffers[i], i);
+        graph.Execute(cmdBuffers[i], i, passEnd);
+        WriteTimestamp(cmdBuffers[i], i, TIMESTAMP_END);
+        VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffers[i]));
+    }
+}
+
+void VulkanExample::RecordLightPass(VkCommandBuffer commandBuffer, uint32_t index, bool upscale)
+{
+    const Render &target = upscale ? upscaleFrameBuffers.shadingRate : frameBuffers.shadingRate;
+    const Render &light = upscale ? upscaleFrameBuffers.light : frameBuffers.light;
+    std::array<VkClearValue, 2> clearValues;
+    clearValues[0].color = defaultClearColor;
+    clearValues[1].depthStencil = {1.0f, 0};
+
+    VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+    renderPassBeginInfo.renderPass = target.renderPass;
+    renderPassBeginInfo.framebuffer = target.frameBuffer;
+    renderPassBeginInfo.renderArea.extent.width = target.width;
+    renderPassBeginInfo.renderArea.extent.height = target.height;
+    renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+    renderPassBeginInfo.pClearValues = clearValues.data();
+
+    WritePipelineStatistics(commandBuffer, index * 2 + 1, true);
+    vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    VkExtent2D fragmentSize = {1, 1};
+    VkFragmentShadingRateCombinerOpKHR combinerOps[2];
+    if (use_vrs && (use_vrsPasses & VRS_PASS_LIGHT)) {
+        // If shading rate from attachment is enabled, we set the combiner, so that the values from the attachment
+        // are used Combiner for pipeline (A) and primitive (B) - Not used in this sample
+        combinerOps[0] = VK_FRAGMENT_SHADING_RATE_COMBINER_OP_KEEP_KHR;
+        // Combiner for pipeline (A) and attachment (B), replace the pipeline default value (fragment_size) with the
+        // fragment sizes stored in the attachment
+        combinerOps[1] = VK_FRAGMENT_SHADING_RATE_COMBINER_OP_REPLACE_KHR;
+    } else {
+        // If shading rate from attachment is disabled, we keep the value set via the dynamic state
+        combinerOps[0] = VK_FRAGMENT_SHADING_RATE_COMBINER_OP_KEEP_KHR;
+        combinerOps[1] = VK_FRAGMENT_SHADING_RATE_COMBINER_OP_KEEP_KHR;
+    }
+    vkCmdSetFragmentShadingRateKHR(commandBuffer, &fragmentSize, combinerOps);
+
+    VkViewport viewport = vks::initializers::viewport((float)light.width, (float)light.height, 0.0f, 1.0f);
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    VkRect2D scissor = vks::initializers::rect2D(light.width, light.height, 0, 0);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.light, 0, 1,
+                            upscale ? &upscaleDescriptorSets.light : &descriptorSets.light, 0, nullptr);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      upscale ? upscalePipelines.light : pipelines.light);
+    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+    vkCmdEndRenderPass(commandBuffer);
+    WritePipelineStatistics(commandBuffer, index * 2 + 1, false);
+}
+
+void VulkanExample::RecordSwapPass(VkCommandBuffer commandBuffer, uint32_t index, bool upscale)
+{
+    std::array<VkClearValue, 2> clearValues;
+    clearValues[0].color = defaultClearColor;
+    clearValues[1].depthStencil = {1.0f, 0};
+
+    VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+    renderPassBeginInfo.renderPass = renderPass;
+    renderPassBeginInfo.framebuffer = VulkanExampleBase::frameBuffers[index];
+    renderPassBeginInfo.renderArea.extent.width = screenWidth;
+    renderPassBeginInfo.renderArea.extent.height = screenHeight;
+    renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+    renderPassBeginInfo.pClearValues = clearValues.data();
+    vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    VkViewport viewport = vks::initializers::viewport((float)screenWidth, (float)screenHeight, 0.0f, 1.0f);
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    VkRect2D scissor = vks::initializers::rect2D(screenWidth, screenHeight, 0, 0);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.swap, 0, 1,
+                            upscale ? &upscaleDescriptorSets.swapUpscale : &descriptorSets.swap, 0, NULL);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      upscale ? upscalePipelines.swapUpscale : pipelines.swap);
+    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+    drawUI(commandBuffer);
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+void VulkanExample::PrepareParallelRecording()
+{
+    ParallelRecorder::InitParams initParams;
+    initParams.device = device;
+    initParams.queueFamilyIndex = vulkanDevice->queueFamilyIndices.graphics;
+    initParams.rangeCount = std::min(JobSystem::GetInstance()->GetWorkerCount() + 1, GBUFFER_RECORD_RANGES);
+    for (auto &secondaries : m_gBufferSecondaries) {
+        secondaries.recorder = new ParallelRecorder();
+        if (!secondaries.recorder->Init(initParams)) {
+            LOGE("VulkanExample parallel recorder create failed, the G-Buffer pass is recorded inline");
+            delete secondaries.recorder;
+            secondaries.recorder = nullptr;
         }
+    }
+}
 
-        clearValues[0].color = defaultClearColor;
-        clearValues[1].depthStencil = {1.0f, 0};
-        renderPassBeginInfo.renderPass = renderPass;
-        renderPassBeginInfo.framebuffer = VulkanExampleBase::frameBuffers[i];
-        renderPassBeginInfo.renderArea.extent.width = screenWidth;
-        renderPassBeginInfo.renderArea.extent.height = screenHeight;
-        renderPassBeginInfo.clearValueCount = 2;
-        renderPassBeginInfo.pClearValues = clearValues.data();
-        vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-        viewport = vks::initializers::viewport((float)screenWidth, (float)screenHeight, 0.0f, 1.0f);
-        vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-        scissor = vks::initializers::rect2D(screenWidth, screenHeight, 0, 0);
-        vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+void VulkanExample::RecordGBufferSecondaries(bool upscale, bool vrs)
+{
+    // The target and the shading rate combiner are the only variant state the G-Buffer pass records
+    m_gBufferSet = (upscale ? 1 : 0) | (vrs ? 2 : 0);
+    GBufferSecondaries &secondaries = m_gBufferSecondaries[m_gBufferSet];
+    if (secondaries.recorded) {
+        return;
+    }
+    secondaries.commandBuffers.clear();
+    if (secondaries.recorder == nullptr) {
+        return;
+    }
+    const FrameBuffer &target = upscale ? static_cast<const FrameBuffer &>(upscaleFrameBuffers.gBufferLight) :
+        static_cast<const FrameBuffer &>(frameBuffers.gBufferLight);
+    VkCommandBufferInheritanceInfo inheritanceInfo = {};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = target.renderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = target.frameBuffer;
+    if (m_pipelineStatsQueryPool != VK_NULL_HANDLE && enabledFeatures.inheritedQueries) {
+        inheritanceInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+    }
+    // The G-Buffer pass is identical in every primary command buffer, one set of secondaries serves them all
+    secondaries.recorded = secondaries.recorder->Record(inheritanceInfo, m_scene.GetMeshCount(),
+        [this, upscale, vrs](VkCommandBuffer commandBuffer, uint32_t first, uint32_t count) {
+            RecordGBufferDraws(commandBuffer, upscale, vrs, first, count);
+        }, secondaries.commandBuffers);
+    if (!secondaries.recorded) {
+        LOGE("VulkanExample G-Buffer secondaries recording failed, the G-Buffer pass is recorded inline");
+    }
+}
 
-        vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.swap, 0, 1,
-                                &upscaleDescriptorSets.swapUpscale, 0, NULL);
-        vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, upscalePipelines.swapUpscale);
-        vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-        vkCmdEndRenderPass(drawCmdBuffers[i]);
-        VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+void VulkanExample::RecordGBufferPass(VkCommandBuffer commandBuffer, uint32_t index,
+    const VkRenderPassBeginInfo &renderPassBeginInfo, bool upscale)
+{
+    const std::vector<VkCommandBuffer> &secondaries = m_gBufferSecondaries[m_gBufferSet].commandBuffers;
+    if (secondaries.empty()) {
+        WritePipelineStatistics(commandBuffer, index * 2, true);
+        vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+        RecordGBufferDraws(commandBuffer, upscale, (m_gBufferSet & 2) != 0, 0, m_scene.GetMeshCount());
+        vkCmdEndRenderPass(commandBuffer);
+        WritePipelineStatistics(commandBuffer, index * 2, false);
+        return;
+    }
+    // A query can only stay active across vkCmdExecuteCommands with inheritedQueries, otherwise it is closed
+    // before the pass and the G-Buffer invocation count reads 0
+    bool inheritQuery = enabledFeatures.inheritedQueries == VK_TRUE;
+    WritePipelineStatistics(commandBuffer, index * 2, true);
+    if (!inheritQuery) {
+        WritePipelineStatistics(commandBuffer, index * 2, false);
+    }
+    vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaries.size()), secondaries.data());
+    vkCmdEndRenderPass(commandBuffer);
+    if (inheritQuery) {
+        WritePipelineStatistics(commandBuffer, index * 2, false);
     }
 }
 
+void VulkanExample::RecordGBufferDraws(VkCommandBuffer commandBuffer, bool upscale, bool vrs, uint32_t firstMesh,
+    uint32_t meshCount)
+{
+    // Dynamic state is not inherited by secondaries, every range sets it again
+    // With vrs the G-Buffer pass follows the shading rate image kept from an earlier frame
+    VkExtent2D fragmentSize = {1, 1};
+    VkFragmentShadingRateCombinerOpKHR combinerOps[2];
+    combinerOps[0] = VK_FRAGMENT_SHADING_RATE_COMBINER_OP_KEEP_KHR;
+    combinerOps[1] = vrs ? VK_FRAGMENT_SHADING_RATE_COMBINER_OP_REPLACE_KHR :
+        VK_FRAGMENT_SHADING_RATE_COMBINER_OP_KEEP_KHR;
+    vkCmdSetFragmentShadingRateKHR(commandBuffer, &fragmentSize, combinerOps);
+
+    const FrameBuffer &target = upscale ? static_cast<const FrameBuffer &>(upscaleFrameBuffers.gBufferLight) :
+        static_cast<const FrameBuffer &>(frameBuffers.gBufferLight);
+    VkViewport viewport = vks::initializers::viewport((float)target.width, (float)target.height, 0.0f, 1.0f);
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    VkRect2D scissor = vks::initializers::rect2D(target.width, target.height, 0, 0);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+        upscale ? upscalePipelines.gBufferLight : pipelines.gBufferLight);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.gBufferLight, 0, 1,
+        &descriptorSets.gBufferLight, 0, nullptr);
+    m_scene.DrawRange(commandBuffer, 0x00000001, pipelineLayouts.gBufferLight, 1, firstMesh, meshCount);
+}
+
 void VulkanExample::SetupDescriptorPool()
 {
     std::vector<VkDescriptorPoolSize> poolSizes = {
@@ -1216,13 +1626,44 @@ void VulkanExample::UpdateUniformBufferMatrices()
 void VulkanExample::Draw()
 {
     VulkanExampleBase::prepareFrame();
+    {
+        TRACE_SCOPE("vkWaitForFences");
+        // The fence tells WaitForSubmittedFrames when the command buffers of this image can be recorded again
+        VK_CHECK_RESULT(vkWaitForFences(device, 1, &waitFences[currentBuffer], VK_TRUE, UINT64_MAX));
+    }
+    VK_CHECK_RESULT(vkResetFences(device, 1, &waitFences[currentBuffer]));
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-    VkResult res = vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+    submitInfo.pCommandBuffers = ShouldDispatchVRS() ? &m_activeVariant->drawCmdBuffers[currentBuffer] :
+        &m_activeVariant->reuseCmdBuffers[currentBuffer];
+    m_submitNs = Tracer::NowNs();
+    VkResult res;
+    {
+        TRACE_SCOPE("vkQueueSubmit");
+        std::lock_guard<std::mutex> lock(vulkanDevice->queueMutex);
+        res = vkQueueSubmit(queue, 1, &submitInfo, waitFences[currentBuffer]);
+    }
     if (res != VK_SUCCESS) {
         LOGE("VulkanExample Fatal : VkResult is %s", vks::tools::errorString(res).c_str());
+        // The fence was reset above, submitFrame and WaitForSubmittedFrames would wait for it forever. An empty
+        // batch still consumes the acquire semaphore and signals the present semaphore and the fence.
+        submitInfo.commandBufferCount = 0;
+        {
+            std::lock_guard<std::mutex> lock(vulkanDevice->queueMutex);
+            res = vkQueueSubmit(queue, 1, &submitInfo, waitFences[currentBuffer]);
+        }
+        if (res != VK_SUCCESS) {
+            // Most likely VK_ERROR_DEVICE_LOST, nothing signals the fence any more, end the render loop
+            LOGE("VulkanExample Fatal : empty submit failed, VkResult is %s", vks::tools::errorString(res).c_str());
+            prepared = false;
+            return;
+        }
     }
     VulkanExampleBase::submitFrame();
+#if TRACE_ENABLED
+    if (Tracer::GetInstance()->IsEnabled()) {
+        TraceGpuFrame(currentBuffer);
+    }
+#endif
 }
 
 void VulkanExample::InitFSR()
@@ -1242,12 +1683,17 @@ void VulkanExample::InitFSR()
     params.outputRegion = outputRegion;
     params.sharpness = 0.4f;
     params.vulkanDevice = vulkanDevice;
+    MemoryCategoryScope memoryScope(MEMORY_CATEGORY_UPSCALE);
     fsr = new FSR();
     fsr->Init(params);
 }
 
 void VulkanExample::InitSpatialUpscale()
 {
+    if (!m_xegSpatialUpscaleSupported) {
+        LOGW("VulkanExample XEG spatial upscale not supported, spatial upscale falls back to fsr");
+        return;
+    }
     VkRect2D srcRect2D;
     srcRect2D.offset.x = 0;
     srcRect2D.offset.y = 0;
@@ -1272,6 +1718,11 @@ void VulkanExample::InitSpatialUpscale()
 
 void VulkanExample::InitXEGVRS()
 {
+    if (!m_xegAdaptiveVRSSupported) {
+        LOGW("VulkanExample XEG adaptive vrs not supported, use built-in adaptive vrs");
+        InitBuiltinVRS();
+        return;
+    }
     VkExtent2D inputSize;
     VkRect2D inputRegion{};
 
@@ -1310,36 +1761,712 @@ void VulkanExample::InitXEGVRS()
     }
 }
 
+void VulkanExample::InitBuiltinVRS()
+{
+    VkExtent2D maxFragmentSize = physicalDeviceShadingRateImageProperties.maxFragmentSize;
+    AdaptiveVRS::InitParams initParams;
+    initParams.device = device;
+    initParams.inputColorView = frameBuffers.light.color.view;
+    initParams.inputDepthImage = frameBuffers.gBufferLight.depth.image;
+    initParams.inputDepthFormat = frameBuffers.gBufferLight.depth.format;
+    initParams.outputShadingRateView = frameBuffers.shadingRate.color.view;
+    initParams.inputSize = {highResWidth, highResHeight};
+    initParams.tileSize = VRS_TILE_SIZE;
+    initParams.errorSensitivity = SENSITIVITY;
+    initParams.maxFragmentSize = maxFragmentSize;
+    initParams.vulkanDevice = vulkanDevice;
+    MemoryCategoryScope memoryScope(MEMORY_CATEGORY_SHADING_RATE);
+    m_adaptiveVRS = new AdaptiveVRS();
+    if (!m_adaptiveVRS->Init(initParams)) {
+        LOGE("VulkanExample built-in adaptive vrs create failed");
+        delete m_adaptiveVRS;
+        m_adaptiveVRS = nullptr;
+    }
+
+    initParams.inputColorView = upscaleFrameBuffers.light.color.view;
+    initParams.inputDepthImage = upscaleFrameBuffers.gBufferLight.depth.image;
+    initParams.inputDepthFormat = upscaleFrameBuffers.gBufferLight.depth.format;
+    initParams.outputShadingRateView = upscaleFrameBuffers.shadingRate.color.view;
+    initParams.inputSize = {lowResWidth, lowResHeight};
+    m_adaptiveVRS4Upscale = new AdaptiveVRS();
+    if (!m_adaptiveVRS4Upscale->Init(initParams)) {
+        LOGE("VulkanExample built-in adaptive vrs for upscale create failed");
+        delete m_adaptiveVRS4Upscale;
+        m_adaptiveVRS4Upscale = nullptr;
+    }
+}
+
+void VulkanExample::DestroyUpscaleAndVRS()
+{
+    delete fsr;
+    fsr = nullptr;
+    if (xegSpatialUpscale) {
+        HMS_XEG_DestroySpatialUpscale(xegSpatialUpscale);
+        xegSpatialUpscale = {};
+    }
+    if (xeg_adaptiveVRS) {
+        HMS_XEG_DestroyAdaptiveVRS(xeg_adaptiveVRS);
+        xeg_adaptiveVRS = {};
+    }
+    if (xeg_adaptiveVRS4Upscale) {
+        HMS_XEG_DestroyAdaptiveVRS(xeg_adaptiveVRS4Upscale);
+        xeg_adaptiveVRS4Upscale = {};
+    }
+    delete m_adaptiveVRS;
+    m_adaptiveVRS = nullptr;
+    delete m_adaptiveVRS4Upscale;
+    m_adaptiveVRS4Upscale = nullptr;
+}
+
+void VulkanExample::ResizeOffscreenTargets()
+{
+    LOGI("VulkanExample resize offscreen targets %{public}ux%{public}u -> %{public}ux%{public}u",
+        frameBuffers.gBufferLight.width, frameBuffers.gBufferLight.height, highResWidth, highResHeight);
+    // Everything below references the old views or was created for the old extents
+    DestroyUpscaleAndVRS();
+    DestroyOffscreenTargets();
+    CreateOffscreenTargets();
+    // Memory released by the old targets and not reused by the new ones, keeps rotating back allocation free
+    m_renderTargets.Trim(RENDER_TARGET_MAX_FREE_BYTES);
+    CreateOffscreenFramebuffers();
+    // Rewrites the sets in place, the pipelines and layouts stay
+    SetupDescriptors();
+    InitFSR();
+    InitSpatialUpscale();
+    InitXEGVRS();
+    // Its slots are sized for the shading rate image, deleting waits for the pending copies
+    delete m_readback;
+    m_readback = nullptr;
+    PrepareShadingRateReadback();
+}
+
+void VulkanExample::CheckMemoryBudget()
+{
+    MemoryTracker *tracker = MemoryTracker::GetInstance();
+    tracker->CheckHeapBudgets();
+    if (!tracker->IsOverBudget()) {
+        return;
+    }
+    // Released targets are not referenced by any recorded command buffer, freeing them needs no idle device
+    RenderTargetPool::Stats stats;
+    m_renderTargets.GetStats(stats);
+    if (stats.freeBytes > 0) {
+        LOGW("VulkanExample over memory budget, freeing %{public}llu bytes of released render targets",
+            static_cast<unsigned long long>(stats.freeBytes));
+        m_renderTargets.Trim(0);
+    }
+}
+
+void VulkanExample::windowResized()
+{
+    // windowResize recreated the swapchain with the device idle, highRes and lowRes follow the new extent
+    if (static_cast<uint32_t>(frameBuffers.gBufferLight.width) != highResWidth ||
+        static_cast<uint32_t>(frameBuffers.gBufferLight.height) != highResHeight ||
+        static_cast<uint32_t>(upscaleFrameBuffers.gBufferLight.width) != lowResWidth ||
+        static_cast<uint32_t>(upscaleFrameBuffers.gBufferLight.height) != lowResHeight) {
+        ResizeOffscreenTargets();
+        // The overlay samples the targets
+        m_screenExtent = {0, 0};
+    }
+    if (m_screenExtent.width != screenWidth || m_screenExtent.height != screenHeight) {
+        delete m_debugOverlay;
+        m_debugOverlay = nullptr;
+        PrepareDebugOverlay();
+        m_screenExtent = {screenWidth, screenHeight};
+    }
+    // The queries are indexed by swapchain image, their count may change with the swapchain
+    if (m_queryImageCount != static_cast<uint32_t>(drawCmdBuffers.size())) {
+        if (m_timestampQueryPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(device, m_timestampQueryPool, nullptr);
+            m_timestampQueryPool = VK_NULL_HANDLE;
+        }
+        if (m_pipelineStatsQueryPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(device, m_pipelineStatsQueryPool, nullptr);
+            m_pipelineStatsQueryPool = VK_NULL_HANDLE;
+        }
+        PrepareTimestampQueries();
+        PreparePipelineStatisticsQueries();
+        m_queryImageCount = static_cast<uint32_t>(drawCmdBuffers.size());
+    }
+    // buildCommandBuffers follows and records every variant again
+}
+
 void VulkanExample::DispatchVRS(bool upscale, VkCommandBuffer commandBuffer)
 {
-    LOGI("dispatch vrs, is upscale %{public}d", upscale);
+    LOGD_RATE(1000, "VulkanExample dispatch vrs, is upscale %{public}d", upscale);
     XEG_AdaptiveVRSDescription xeg_description;
     xeg_description.inputColorImage = upscale ? upscaleFrameBuffers.light.color.view : frameBuffers.light.color.view;
     xeg_description.inputDepthImage =
         upscale ? upscaleFrameBuffers.gBufferLight.depth.view : frameBuffers.gBufferLight.depth.view;
     xeg_description.outputShadingRateImage =
         upscale ? upscaleFrameBuffers.shadingRate.color.view : frameBuffers.shadingRate.color.view;
+    // Must outlive the dispatch below, reprojectionMatrix points into it
+    glm::mat4 reproject(0);
     if (use_reprojectionMatrix) {
-        if (camera.curVP.perspective == glm::mat4(0)) {
-            xeg_description.reprojectionMatrix = (float *)glm::value_ptr(glm::mat4(0));
-        } else {
+        if (camera.curVP.perspective != glm::mat4(0)) {
             glm::mat4 currVP = camera.curVP.perspective * camera.curVP.view;
             glm::mat4 inv = glm::inverse(currVP);
             glm::mat4 preVP = camera.preVP.perspective * camera.preVP.view;
-            glm::mat4 reproject = preVP * inv;
-            xeg_description.reprojectionMatrix = (float *)glm::value_ptr(reproject);
+            reproject = preVP * inv;
         }
+        xeg_description.reprojectionMatrix = (float *)glm::value_ptr(reproject);
     } else {
         xeg_description.reprojectionMatrix = nullptr;
     }
 
-    if (upscale) {
+    if (!m_xegAdaptiveVRSSupported) {
+        // Without a generator the shading rate image keeps its last content, e.g. a loaded one
+        AdaptiveVRS *adaptiveVRS = upscale ? m_adaptiveVRS4Upscale : m_adaptiveVRS;
+        if (adaptiveVRS != nullptr) {
+            adaptiveVRS->Dispatch(commandBuffer, xeg_description.reprojectionMatrix);
+        }
+    } else if (upscale) {
         HMS_XEG_CmdDispatchAdaptiveVRS(commandBuffer, xeg_adaptiveVRS4Upscale, &xeg_description);
     } else {
         HMS_XEG_CmdDispatchAdaptiveVRS(commandBuffer, xeg_adaptiveVRS, &xeg_description);
     }
 }
 
+float VulkanExample::GetVRSReprojectionError(const glm::mat4 &currVP) const
+{
+    // Reproject a grid of screen points at a few view distances into the view of the last dispatch and
+    // return the largest screen space offset in pixels of the current render resolution.
+    const float distances[] = {1.0f, 4.0f, 16.0f};
+    const float gridPoints[] = {-0.8f, 0.0f, 0.8f};
+    bool upscale = cur_method != 0;
+    float width = static_cast<float>(upscale ? lowResWidth : highResWidth);
+    float height = static_cast<float>(upscale ? lowResHeight : highResHeight);
+    glm::mat4 reproject = m_vrsDispatchVP * glm::inverse(currVP);
+    float maxError = 0.0f;
+    for (float distance : distances) {
+        glm::vec4 clip = camera.matrices.perspective * glm::vec4(0.0f, 0.0f, -distance, 1.0f);
+        float depth = clip.z / clip.w;
+        for (float y : gridPoints) {
+            for (float x : gridPoints) {
+                glm::vec4 previous = reproject * glm::vec4(x, y, depth, 1.0f);
+                if (previous.w <= 0.0f) {
+                    // Behind the previous camera, the old rates are meaningless
+                    return std::numeric_limits<float>::max();
+                }
+                float dx = (previous.x / previous.w - x) * 0.5f * width;
+                float dy = (previous.y / previous.w - y) * 0.5f * height;
+                maxError = std::max(maxError, std::sqrt(dx * dx + dy * dy));
+            }
+        }
+    }
+    return maxError;
+}
+
+bool VulkanExample::ShouldDispatchVRS()
+{
+    if (!m_vrsReuseRecorded) {
+        return true;
+    }
+    // Refresh periodically so slow drifts and animated lighting are picked up, and whenever the view moved far
+    // enough that the old rates would land on the wrong tiles.
+    glm::mat4 currVP = camera.matrices.perspective * camera.matrices.view;
+    m_vrsReusedFrames++;
+    if (m_vrsHistoryValid && m_vrsReusedFrames < VRS_REUSE_MAX_FRAMES &&
+        GetVRSReprojectionError(currVP) <= VRS_REUSE_MAX_ERROR) {
+        return false;
+    }
+    m_vrsHistoryValid = true;
+    m_vrsReusedFrames = 0;
+    m_vrsDispatchVP = currVP;
+    return true;
+}
+
+void VulkanExample::PrepareTimestampQueries()
+{
+    if (!deviceProperties.limits.timestampComputeAndGraphics) {
+        LOGW("VulkanExample timestamps not supported, gpu time will not be reported");
+        return;
+    }
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = static_cast<uint32_t>(drawCmdBuffers.size()) * TIMESTAMP_COUNT;
+    VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &m_timestampQueryPool));
+}
+
+void VulkanExample::WriteTimestamp(VkCommandBuffer commandBuffer, uint32_t index, uint32_t slot)
+{
+    if (m_timestampQueryPool == VK_NULL_HANDLE) {
+        return;
+    }
+    uint32_t query = index * TIMESTAMP_COUNT + slot;
+    if (slot == TIMESTAMP_BEGIN) {
+        vkCmdResetQueryPool(commandBuffer, m_timestampQueryPool, query, TIMESTAMP_COUNT);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_timestampQueryPool, query);
+    } else {
+        // Written once all earlier commands have completed
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_timestampQueryPool, query);
+    }
+}
+
+void VulkanExample::PreparePipelineStatisticsQueries()
+{
+    if (!enabledFeatures.pipelineStatisticsQuery) {
+        LOGW("VulkanExample pipeline statistics not supported, fragment invocations will not be reported");
+        return;
+    }
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    queryPoolInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+    queryPoolInfo.queryCount = static_cast<uint32_t>(drawCmdBuffers.size()) * 2;
+    VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &m_pipelineStatsQueryPool));
+}
+
+void VulkanExample::ResetPipelineStatistics(VkCommandBuffer commandBuffer, uint32_t index)
+{
+    if (m_pipelineStatsQueryPool == VK_NULL_HANDLE) {
+        return;
+    }
+    vkCmdResetQueryPool(commandBuffer, m_pipelineStatsQueryPool, index * 2, 2);
+}
+
+void VulkanExample::WritePipelineStatistics(VkCommandBuffer commandBuffer, uint32_t query, bool begin)
+{
+    if (m_pipelineStatsQueryPool == VK_NULL_HANDLE) {
+        return;
+    }
+    if (begin) {
+        vkCmdBeginQuery(commandBuffer, m_pipelineStatsQueryPool, query, 0);
+    } else {
+        vkCmdEndQuery(commandBuffer, m_pipelineStatsQueryPool, query);
+    }
+}
+
+bool VulkanExample::GetPipelineStatistics(uint32_t index, uint64_t &gBufferInvocations, uint64_t &lightInvocations)
+{
+    if (m_pipelineStatsQueryPool == VK_NULL_HANDLE) {
+        return false;
+    }
+    uint64_t invocations[2] = {0, 0};
+    VkResult res = vkGetQueryPoolResults(device, m_pipelineStatsQueryPool, index * 2, 2, sizeof(invocations),
+        invocations, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (res != VK_SUCCESS) {
+        return false;
+    }
+    gBufferInvocations = invocations[0];
+    lightInvocations = invocations[1];
+    return true;
+}
+
+void VulkanExample::SampleShadingRateStats()
+{
+    if (m_readback == nullptr) {
+        return;
+    }
+    bool upscale = cur_method != 0;
+    const FrameBufferAttachment &attachment =
+        upscale ? upscaleFrameBuffers.shadingRate.color : frameBuffers.shadingRate.color;
+    VkExtent2D extent = GetShadingRateExtent(upscale);
+    ShadingRateStats stats;
+    stats.frame = m_frameIndex;
+    // The frame has completed, submitFrame waits for its fence
+    GetPipelineStatistics(currentBuffer, stats.gBufferInvocations, stats.lightInvocations);
+    bool requested = m_readback->RequestImage(attachment.image, extent, 1,
+        VK_IMAGE_LAYOUT_FRAGMENT_SHADING_RATE_ATTACHMENT_OPTIMAL_KHR,
+        [this, stats, extent](std::vector<uint8_t> &data) mutable {
+            stats.Compute(data.data(), extent.width, extent.height);
+            LOGD("VulkanExample shading rate stats: frame %{public}llu, savings %{public}.3f",
+                static_cast<unsigned long long>(stats.frame), stats.estimatedSavings);
+            std::lock_guard<std::mutex> lock(m_shadingRateStatsMutex);
+            m_shadingRateStats = stats;
+            m_shadingRateStatsValid = true;
+        });
+    if (!requested) {
+        LOGW("VulkanExample SampleShadingRateStats: readback request failed, sample skipped");
+    }
+}
+
+bool VulkanExample::GetGpuTimeMs(uint32_t index, double &gpuMs)
+{
+    double passMs[TIMESTAMP_COUNT - 1];
+    if (!GetPassTimesMs(index, passMs)) {
+        return false;
+    }
+    gpuMs = 0.0;
+    for (double ms : passMs) {
+        gpuMs += ms;
+    }
+    return true;
+}
+
+bool VulkanExample::GetPassTimesMs(uint32_t index, double passMs[TIMESTAMP_COUNT - 1])
+{
+    if (m_timestampQueryPool == VK_NULL_HANDLE) {
+        return false;
+    }
+    uint64_t timestamps[TIMESTAMP_COUNT] = {};
+    VkResult res = vkGetQueryPoolResults(device, m_timestampQueryPool, index * TIMESTAMP_COUNT, TIMESTAMP_COUNT,
+        sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (res != VK_SUCCESS) {
+        return false;
+    }
+    for (uint32_t i = 0; i + 1 < TIMESTAMP_COUNT; i++) {
+        passMs[i] = static_cast<double>(timestamps[i + 1] - timestamps[i]) * deviceProperties.limits.timestampPeriod /
+            1e6;
+    }
+    return true;
+}
+
+void VulkanExample::CalibrateGpuClock()
+{
+    VkCalibratedTimestampInfoEXT infos[2] = {};
+    infos[0].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+    infos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+    infos[1].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+    infos[1].timeDomain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+    uint64_t timestamps[2] = {};
+    uint64_t maxDeviation = 0;
+    VkResult res = vkGetCalibratedTimestampsEXT(device, 2, infos, timestamps, &maxDeviation);
+    if (res != VK_SUCCESS) {
+        LOGE("VulkanExample CalibrateGpuClock: vkGetCalibratedTimestampsEXT failed, %{public}d", res);
+        return;
+    }
+    m_gpuClockOffsetNs = static_cast<double>(timestamps[1]) -
+        static_cast<double>(timestamps[0]) * deviceProperties.limits.timestampPeriod;
+    m_gpuClockCalibrated = true;
+    m_calibrationFrame = m_frameIndex;
+    LOGD("VulkanExample CalibrateGpuClock: max deviation %{public}llu ns",
+        static_cast<unsigned long long>(maxDeviation));
+}
+
+void VulkanExample::TraceGpuFrame(uint32_t index)
+{
+    static const char *const passNames[TIMESTAMP_COUNT - 1] = {"GBUFFER", "VRS", "LIGHT", "UPSCALE", "FINAL"};
+    if (m_timestampQueryPool == VK_NULL_HANDLE) {
+        return;
+    }
+    // The frame has completed, submitFrame waits for its fence
+    uint64_t timestamps[TIMESTAMP_COUNT] = {};
+    VkResult res = vkGetQueryPoolResults(device, m_timestampQueryPool, index * TIMESTAMP_COUNT, TIMESTAMP_COUNT,
+        sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (res != VK_SUCCESS) {
+        return;
+    }
+    double period = deviceProperties.limits.timestampPeriod;
+    double offsetNs;
+    if (m_calibratedTimestamps && vkGetCalibratedTimestampsEXT != nullptr) {
+        if (!m_gpuClockCalibrated || m_frameIndex - m_calibrationFrame >= TRACE_CALIBRATION_INTERVAL) {
+            CalibrateGpuClock();
+        }
+        offsetNs = m_gpuClockOffsetNs;
+    } else {
+        offsetNs = static_cast<double>(m_submitNs) - static_cast<double>(timestamps[TIMESTAMP_BEGIN]) * period;
+    }
+    auto toCpuNs = [offsetNs, period](uint64_t ticks) {
+        return static_cast<uint64_t>(static_cast<double>(ticks) * period + offsetNs);
+    };
+    Tracer *tracer = Tracer::GetInstance();
+    tracer->AddGpuEvent("frame", toCpuNs(timestamps[TIMESTAMP_BEGIN]), toCpuNs(timestamps[TIMESTAMP_END]));
+    for (uint32_t i = 0; i + 1 < TIMESTAMP_COUNT; i++) {
+        // Passes a variant does not run take no time, e.g. UPSCALE when rendering natively
+        if (timestamps[i + 1] > timestamps[i]) {
+            tracer->AddGpuEvent(passNames[i], toCpuNs(timestamps[i]), toCpuNs(timestamps[i + 1]));
+        }
+    }
+}
+
+void VulkanExample::PrepareDebugOverlay()
+{
+    DebugOverlay::InitParams initParams;
+    initParams.vulkanDevice = vulkanDevice;
+    initParams.queue = queue;
+    initParams.renderPass = renderPass;
+    initParams.pipelineCache = pipelineCache;
+    initParams.screenSize = {static_cast<uint32_t>(screenWidth), static_cast<uint32_t>(screenHeight)};
+    initParams.targets[0] = {frameBuffers.shadingRate.color.view, frameBuffers.gBufferLight.position.view,
+        frameBuffers.gBufferLight.normal.view, frameBuffers.gBufferLight.albedo.view,
+        frameBuffers.gBufferLight.viewNormal.view};
+    initParams.targets[1] = {upscaleFrameBuffers.shadingRate.color.view, upscaleFrameBuffers.gBufferLight.position.view,
+        upscaleFrameBuffers.gBufferLight.normal.view, upscaleFrameBuffers.gBufferLight.albedo.view,
+        upscaleFrameBuffers.gBufferLight.viewNormal.view};
+    m_debugOverlay = new DebugOverlay();
+    if (!m_debugOverlay->Init(initParams)) {
+        LOGE("VulkanExample debug overlay create failed");
+        delete m_debugOverlay;
+        m_debugOverlay = nullptr;
+    }
+}
+
+void VulkanExample::drawUI(const VkCommandBuffer commandBuffer)
+{
+    if (!use_overlay || m_debugOverlay == nullptr) {
+        return;
+    }
+    m_debugOverlay->Draw(commandBuffer, use_method != 0 ? 1 : 0);
+}
+
+void VulkanExample::UpdateDebugOverlay()
+{
+    if (m_debugOverlay == nullptr) {
+        return;
+    }
+    static const char *const passNames[TIMESTAMP_COUNT - 1] = {"GBUFFER", "VRS", "LIGHT", "UPSCALE", "FINAL"};
+    // Same colors as the heatmap in overlay.frag, indexed by log2 of the pixels per invocation
+    static const uint32_t rateColors[5] = {0xffff0000, 0xff00ff00, 0xff00ffff, 0xff0080ff, 0xff0000ff};
+    const uint32_t white = 0xffffffff;
+    const uint32_t grey = 0xffb0b0b0;
+    const float frameBudgetMs = 1000.0f / 60.0f;
+    float textHeight = std::max(std::floor(static_cast<float>(screenHeight) / DEBUG_OVERLAY_LINES), 6.0f);
+    float lineHeight = textHeight * 1.5f;
+    float margin = textHeight;
+    float barWidth = m_debugOverlay->TextWidth(16, textHeight);
+    char line[128];
+
+    m_debugOverlay->Begin();
+    uint32_t view = m_overlayView.load();
+    m_debugOverlay->Target(view, view == DebugOverlay::VIEW_SHADING_RATE ? 0.45f : 1.0f);
+
+    ShadingRateStats stats;
+    bool statsValid = cur_vrs && GetShadingRateStats(stats);
+    // Results of the frame that has just completed, submitFrame waits for its fence
+    double passMs[TIMESTAMP_COUNT - 1] = {};
+    bool timed = GetPassTimesMs(currentBuffer, passMs);
+    vkOBJ::StreamingStats streamingStats;
+    bool streaming = m_scene.GetStreamingStats(streamingStats);
+    uint32_t lineCount = 5 + (timed ? TIMESTAMP_COUNT - 1 : 0) + (statsValid ? 2 : 0) + (streaming ? 1 : 0);
+    m_debugOverlay->Rect(margin * 0.5f, margin * 0.5f, m_debugOverlay->TextWidth(34, textHeight) + margin,
+        lineCount * lineHeight + margin, 0xa0000000);
+
+    float y = margin;
+    double gpuMs = 0.0;
+    for (double ms : passMs) {
+        gpuMs += ms;
+    }
+    snprintf(line, sizeof(line), "FPS %u  CPU %.1f MS  GPU %.2f MS", lastFPS, frameTimer * 1000.0f, gpuMs);
+    m_debugOverlay->Text(margin, y, textHeight, line, white);
+    y += lineHeight;
+    for (uint32_t i = 0; timed && i + 1 < TIMESTAMP_COUNT; i++) {
+        snprintf(line, sizeof(line), "%-8s%6.2f", passNames[i], passMs[i]);
+        float x = m_debugOverlay->Text(margin, y, textHeight, line, grey) + textHeight;
+        float fill = std::min(static_cast<float>(passMs[i]) / frameBudgetMs, 1.0f);
+        m_debugOverlay->Rect(x, y, barWidth, textHeight, 0x60ffffff);
+        m_debugOverlay->Rect(x, y, barWidth * fill, textHeight, fill < 0.5f ? 0xff00c000 : 0xff0000ff);
+        y += lineHeight;
+    }
+
+    const char *method = "NATIVE";
+    if (cur_method != 0) {
+        method = (cur_method == 1 && m_xegSpatialUpscaleSupported) ? "XEG SPATIAL UPSCALE" : "FSR";
+    }
+    snprintf(line, sizeof(line), "METHOD %s", method);
+    m_debugOverlay->Text(margin, y, textHeight, line, white);
+    y += lineHeight;
+    snprintf(line, sizeof(line), "VRS %s  PASSES%s%s", cur_vrs ? "ON" : "OFF",
+        (cur_vrsPasses & VRS_PASS_GBUFFER) ? " GBUFFER" : "", (cur_vrsPasses & VRS_PASS_LIGHT) ? " LIGHT" : "");
+    m_debugOverlay->Text(margin, y, textHeight, line, white);
+    y += lineHeight;
+    snprintf(line, sizeof(line), "SRI %s  REUSED %u FRAMES", m_xegAdaptiveVRSSupported ? "XEG" : "BUILT-IN",
+        m_vrsReusedFrames);
+    m_debugOverlay->Text(margin, y, textHeight, line, white);
+    y += lineHeight;
+    if (streaming) {
+        const double mb = 1024.0 * 1024.0;
+        snprintf(line, sizeof(line), "TEX %.0f/%.0f MB  %u/%u SHARP", streamingStats.residentBytes / mb,
+            streamingStats.budgetBytes / mb, streamingStats.sharpCount, streamingStats.textureCount);
+        m_debugOverlay->Text(margin, y, textHeight, line, white);
+        y += lineHeight;
+    }
+
+    if (statsValid) {
+        snprintf(line, sizeof(line), "SAVED %.0f%%  SAMPLE FRAME %llu", stats.estimatedSavings * 100.0,
+            static_cast<unsigned long long>(stats.frame));
+        m_debugOverlay->Text(margin, y, textHeight, line, white);
+        y += lineHeight;
+        // One swatch and share per rate in use
+        float x = margin;
+        for (uint32_t rate = 0; rate < SHADING_RATE_COUNT && stats.tiles > 0; rate++) {
+            if (stats.histogram[rate] == 0) {
+                continue;
+            }
+            uint32_t log2Pixels = ((rate >> 2) & 3) + (rate & 3);
+            m_debugOverlay->Rect(x, y, textHeight, textHeight, rateColors[std::min(log2Pixels, 4u)]);
+            snprintf(line, sizeof(line), "%s %.0f%%", ShadingRateStats::RateName(rate).c_str(),
+                100.0 * stats.histogram[rate] / stats.tiles);
+            x = m_debugOverlay->Text(x + textHeight * 1.5f, y, textHeight, line, grey) + textHeight;
+        }
+        y += lineHeight;
+    }
+    snprintf(line, sizeof(line), "VIEW %s", DebugOverlay::ViewName(view));
+    m_debugOverlay->Text(margin, y, textHeight, line, white);
+    m_debugOverlay->End();
+}
+
+bool VulkanExample::ReadbackColorImage(const FrameBufferAttachment &attachment, uint32_t width, uint32_t height,
+    std::vector<uint8_t> &pixels)
+{
+    if (attachment.format != VK_FORMAT_R8G8B8A8_UNORM) {
+        LOGE("VulkanExample ReadbackColorImage: unsupported format %{public}d", attachment.format);
+        return false;
+    }
+    VkDeviceSize size = static_cast<VkDeviceSize>(width) * height * 4;
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingMemory;
+    {
+        MemoryCategoryScope memoryScope(MEMORY_CATEGORY_STAGING);
+        VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, size, &stagingBuffer,
+            &stagingMemory));
+    }
+
+    VkImageSubresourceRange subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+    vks::tools::setImageLayout(copyCmd, attachment.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, subresourceRange);
+
+    VkBufferImageCopy region{};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = {width, height, 1};
+    vkCmdCopyImageToBuffer(copyCmd, attachment.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, stagingBuffer, 1,
+        &region);
+
+    vks::tools::setImageLayout(copyCmd, attachment.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
+    vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+
+    void *data = nullptr;
+    VkResult res = vkMapMemory(device, stagingMemory, 0, size, 0, &data);
+    if (res == VK_SUCCESS) {
+        pixels.resize(size);
+        memcpy(pixels.data(), data, size);
+        vkUnmapMemory(device, stagingMemory);
+    } else {
+        LOGE("VulkanExample ReadbackColorImage: map failed, result: %{public}d", res);
+    }
+    vkDestroyBuffer(device, stagingBuffer, nullptr);
+    vkFreeMemory(device, stagingMemory, nullptr);
+    return res == VK_SUCCESS;
+}
+
+void VulkanExample::RunQualityBenchmark()
+{
+    LOGI("VulkanExample RunQualityBenchmark start");
+    // Native without VRS must stay first, it is the reference for the other combinations.
+    const std::vector<std::pair<int, bool>> configs = {{0, false}, {0, true}, {1, false}, {1, true}, {2, false},
+                                                       {2, true}};
+    // Deterministic camera poses through the sponza atrium: {position, rotation}
+    const std::vector<std::pair<glm::vec3, glm::vec3>> poses = {
+        {glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -90.0f, 0.0f)},
+        {glm::vec3(-6.0f, 1.5f, 0.5f), glm::vec3(10.0f, -60.0f, 0.0f)},
+        {glm::vec3(6.0f, 4.0f, -1.0f), glm::vec3(-15.0f, 120.0f, 0.0f)},
+    };
+
+    glm::vec3 savedPosition = camera.position;
+    glm::vec3 savedRotation = camera.rotation;
+    int savedMethod = use_method;
+    bool savedVRS = use_vrs;
+
+    ImageMetrics imageMetrics;
+    std::vector<QualityEntry> entries;
+    for (auto &config : configs) {
+        entries.push_back({config.first, config.second, {}, 0.0, 0, 0});
+    }
+
+    for (auto &pose : poses) {
+        camera.setPosition(pose.first);
+        camera.setRotation(pose.second);
+        UpdateUniformBufferMatrices();
+        std::vector<uint8_t> reference;
+        for (size_t i = 0; i < configs.size(); i++) {
+            use_method = configs[i].first;
+            use_vrs = configs[i].second;
+            vulkanDevice->waitIdle();
+            ActivateCommandVariant();
+            // A few frames so the adaptive VRS history settles on this pose.
+            for (uint32_t frame = 0; frame < QUALITY_BENCHMARK_WARMUP_FRAMES; frame++) {
+                Draw();
+                vulkanDevice->waitIdle();
+                camera.update(0.0f);
+            }
+            double gpuMs = 0.0;
+            bool timed = GetGpuTimeMs(currentBuffer, gpuMs);
+
+            std::vector<uint8_t> pixels;
+            const FrameBufferAttachment &output =
+                use_method == 0 ? frameBuffers.light.color : upscaleFrameBuffers.upscale.color;
+            if (!ReadbackColorImage(output, highResWidth, highResHeight, pixels)) {
+                continue;
+            }
+            if (i == 0) {
+                reference = pixels;
+            }
+            ImageMetrics::Result result;
+            if (!imageMetrics.Compare(reference, pixels, highResWidth, highResHeight, result)) {
+                LOGE("VulkanExample RunQualityBenchmark: method %{public}d vrs %{public}d not scored",
+                    use_method, use_vrs);
+                continue;
+            }
+            entries[i].metrics.psnr += result.psnr;
+            entries[i].metrics.ssim += result.ssim;
+            entries[i].metrics.perceptual += result.perceptual;
+            entries[i].samples++;
+            if (timed) {
+                entries[i].gpuMs += gpuMs;
+                entries[i].timedSamples++;
+            }
+        }
+    }
+
+    // Averaged over the poses that were scored, a failed readback does not pull an entry down
+    for (auto &entry : entries) {
+        if (entry.samples > 0) {
+            entry.metrics.psnr /= entry.samples;
+            entry.metrics.ssim /= entry.samples;
+            entry.metrics.perceptual /= entry.samples;
+        }
+        if (entry.timedSamples > 0) {
+            entry.gpuMs /= entry.timedSamples;
+        }
+    }
+    for (auto &entry : entries) {
+        LOGI("VulkanExample quality method %{public}d vrs %{public}d: psnr %{public}.2f ssim %{public}.4f "
+             "deltaE %{public}.3f gpu %{public}.3f ms", entry.method, entry.vrs, entry.metrics.psnr,
+             entry.metrics.ssim, entry.metrics.perceptual, entry.gpuMs);
+    }
+    WriteQualityReport(entries);
+
+    camera.setPosition(savedPosition);
+    camera.setRotation(savedRotation);
+    UpdateUniformBufferMatrices();
+    use_method = savedMethod;
+    use_vrs = savedVRS;
+    ActivateCommandVariant();
+    cur_method = use_method;
+    cur_vrs = use_vrs;
+    LOGI("VulkanExample RunQualityBenchmark finish");
+}
+
+void VulkanExample::WriteQualityReport(const std::vector<QualityEntry> &entries)
+{
+    std::string filePath = "/data/storage/el2/base/haps/entry/cache/quality_report.csv";
+    File file;
+    if (!file.Open(filePath, File::FILE_CREATE) || !file.Truncate(0)) {
+        LOGE("VulkanExample WriteQualityReport: Failed to create file: %{public}s", filePath.c_str());
+        return;
+    }
+    std::string report = "method,vrs,psnr,ssim,delta_e,gpu_ms,ssim_per_ms,poses\n";
+    char line[256];
+    for (auto &entry : entries) {
+        double ssimPerMs = entry.gpuMs > 0.0 ? entry.metrics.ssim / entry.gpuMs : 0.0;
+        int len = snprintf(line, sizeof(line), "%d,%d,%.3f,%.5f,%.4f,%.4f,%.5f,%u\n", entry.method,
+            entry.vrs ? 1 : 0, entry.metrics.psnr, entry.metrics.ssim, entry.metrics.perceptual, entry.gpuMs, ssimPerMs,
+            entry.samples);
+        if (len > 0) {
+            report.append(line, std::min<size_t>(len, sizeof(line) - 1));
+        }
+    }
+    if (file.Write(report.data(), report.size()) != report.size()) {
+        LOGE("VulkanExample WriteQualityReport: Failed to write report");
+    }
+    file.Close();
+}
+
 std::array<VkVertexInputAttributeDescription, 3> VulkanExample::GetAttributeDescriptions()
 {
     std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions = {};
@@ -1361,7 +2488,7 @@ std::array<VkVertexInputAttributeDescription, 3> VulkanExample::GetAttributeDesc
     return attributeDescriptions;
 }
 
-bool VulkanExample::CheckXEngine()
+void VulkanExample::CheckXEngine()
 {
     std::vector<std::string> supportedExtensions;
     uint32_t pPropertyCount;
@@ -1376,18 +2503,17 @@ bool VulkanExample::CheckXEngine()
         }
     }
 
-    if (std::find(supportedExtensions.begin(), supportedExtensions.end(), XEG_SPATIAL_UPSCALE_EXTENSION_NAME) ==
-        supportedExtensions.end()) {
+    m_xegSpatialUpscaleSupported = std::find(supportedExtensions.begin(), supportedExtensions.end(),
+        XEG_SPATIAL_UPSCALE_EXTENSION_NAME) != supportedExtensions.end();
+    if (!m_xegSpatialUpscaleSupported) {
         LOGE("XEG_spatial_upscale not support");
-        return false;
     }
 
-    if (std::find(supportedExtensions.begin(), supportedExtensions.end(), XEG_ADAPTIVE_VRS_EXTENSION_NAME) ==
-        supportedExtensions.end()) {
+    m_xegAdaptiveVRSSupported = std::find(supportedExtensions.begin(), supportedExtensions.end(),
+        XEG_ADAPTIVE_VRS_EXTENSION_NAME) != supportedExtensions.end();
+    if (!m_xegAdaptiveVRSSupported) {
         LOGE("XEG_adaptive_vrs not support");
-        return false;
     }
-    return true;
 }
 
 bool VulkanExample::prepare()
@@ -1395,175 +2521,192 @@ bool VulkanExample::prepare()
     if (prepared) {
         return true;
     }
-    VulkanExampleBase::prepare();
-    if (!CheckXEngine()) {
-        return false;
+    TRACE_SCOPE("VulkanExample::prepare");
+    // Before the first allocation on the device, the swapchain depth buffer included
+    if (!m_memoryTracked) {
+        MemoryTracker::GetInstance()->Init(physicalDevice, m_memoryBudgetSupported);
+        m_memoryTracked = true;
     }
+    VulkanExampleBase::prepare();
+    CheckXEngine();
 	camera.setPerspective(60.0f, (float)screenWidth / (float)screenHeight, m_zNear, m_zFar);
+    PrepareUploadManager();
     LoadAssets();
+    m_renderTargets.Init(vulkanDevice);
     PrepareOffscreenFramebuffers();
-    // Try to load previously saved shading rate image
-    loadShadingRateImage();
+    PrepareShadingRateReadback();
     PrepareUniformBuffers();
     SetupDescriptorPool();
     SetupLayouts();
     SetupDescriptors();
     PreparePipelines();
+    PrepareDebugOverlay();
+    m_screenExtent = {screenWidth, screenHeight};
     InitFSR();
     InitSpatialUpscale();
     InitXEGVRS();
+    PrepareTimestampQueries();
+    PreparePipelineStatisticsQueries();
+    m_queryImageCount = static_cast<uint32_t>(drawCmdBuffers.size());
+    PrepareParallelRecording();
     buildCommandBuffers();
+    // Try to load previously saved shading rate image, once the variant is active since activating one drops the
+    // VRS history the load sets up
+    loadShadingRateImage();
     prepared = true;
     return prepared;
 }
 
-void VulkanExample::saveShadingRateImage()
+VkExtent2D VulkanExample::GetShadingRateExtent(bool upscale) const
+{
+    if (upscale) {
+        return {lowResWidth / VRS_TILE_SIZE, lowResHeight / VRS_TILE_SIZE};
+    }
+    return {highResWidth / VRS_TILE_SIZE, highResHeight / VRS_TILE_SIZE};
+}
+
+void VulkanExample::PrepareShadingRateReadback()
+{
+    VkExtent2D extent = GetShadingRateExtent(false);
+    AsyncReadback::InitParams initParams;
+    initParams.vulkanDevice = vulkanDevice;
+    initParams.queue = queue;
+    initParams.slotCount = SHADING_RATE_READBACK_SLOTS;
+    // R8_UINT, the highRes image is the larger one
+    initParams.slotSize = static_cast<VkDeviceSize>(extent.width) * extent.height;
+    m_readback = new AsyncReadback();
+    if (!m_readback->Init(initParams)) {
+        LOGE("VulkanExample PrepareShadingRateReadback: init failed, shading rate image can not be saved");
+        delete m_readback;
+        m_readback = nullptr;
+    }
+}
+
+ShadingRateCache::Key VulkanExample::GetShadingRateKey(bool upscale, VkFormat format) const
+{
+    ShadingRateCache::Key key;
+    VkExtent2D extent = GetShadingRateExtent(upscale);
+    key.width = extent.width;
+    key.height = extent.height;
+    key.tileSize = VRS_TILE_SIZE;
+    key.format = static_cast<uint32_t>(format);
+    key.sceneHash = m_sceneHash;
+    ShadingRateCache::QuantizePose(&camera.position.x, &camera.rotation.x, key.pose);
+    return key;
+}
+
+void VulkanExample::SaveShadingRateImageAsync()
 {
-    LOGI("VulkanExample saveShadingRateImage: Saving shading rate image to file");
-    
     // Only proceed if VRS is enabled and the image exists
-    if (!use_vrs || frameBuffers.shadingRate.color.image == VK_NULL_HANDLE) {
-        LOGI("VulkanExample saveShadingRateImage: VRS not enabled or image not available, skipping save");
+    if (!use_vrs || m_readback == nullptr) {
+        LOGW("VulkanExample saveShadingRateImage: VRS not enabled or readback not available, skipping save");
         return;
     }
-    
-    // Get image info
-    VkImageSubresource subResource = {};
-    subResource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    subResource.mipLevel = 0;
-    subResource.arrayLayer = 0;
-    
-    VkSubresourceLayout subResourceLayout;
-    vkGetImageSubresourceLayout(device, frameBuffers.shadingRate.color.image, &subResource, &subResourceLayout);
-    
-    // Map the image memory (assuming it's host-visible)
-    void* data = nullptr;
-    VkResult result = vkMapMemory(device, frameBuffers.shadingRate.color.mem, 0, VK_WHOLE_SIZE, 0, &data);
-    if (result != VK_SUCCESS) {
-        LOGE("VulkanExample saveShadingRateImage: Failed to map memory, result: %{public}d", result);
-        return;
+    bool upscale = cur_method != 0;
+    const FrameBufferAttachment &attachment =
+        upscale ? upscaleFrameBuffers.shadingRate.color : frameBuffers.shadingRate.color;
+    VkExtent2D extent = GetShadingRateExtent(upscale);
+    // The key takes the camera pose of the frame being read back, not of the frame the copy finishes in
+    ShadingRateCache::Key key = GetShadingRateKey(upscale, attachment.format);
+    // The light pass leaves the shading rate image in its finalLayout
+    bool requested = m_readback->RequestImage(attachment.image, extent, 1,
+        VK_IMAGE_LAYOUT_FRAGMENT_SHADING_RATE_ATTACHMENT_OPTIMAL_KHR,
+        [this, key](std::vector<uint8_t> &data) { WriteShadingRateFile(data, key); });
+    if (!requested) {
+        LOGE("VulkanExample saveShadingRateImage: readback request failed");
     }
-    
-    // Create file for saving
-    File file;
-    std::string filePath = "/data/storage/el2/base/haps/entry/cache/shading_rate_image.dat";
-    if (!file.Open(filePath, File::FILE_CREATE)) {
-        LOGE("VulkanExample saveShadingRateImage: Failed to create file: %{public}s", filePath.c_str());
-        vkUnmapMemory(device, frameBuffers.shadingRate.color.mem);
+}
+
+void VulkanExample::WriteShadingRateFile(const std::vector<uint8_t> &data, const ShadingRateCache::Key &key)
+{
+    std::lock_guard<std::mutex> lock(m_shadingRateFileMutex);
+    m_shadingRateCache.Store(key, data);
+    if (!m_shadingRateCache.Save(SHADING_RATE_CACHE_PATH)) {
+        LOGE("VulkanExample saveShadingRateImage: Failed to save shading rate cache");
         return;
     }
-    
-    // Write image metadata
-    uint32_t width = frameBuffers.shadingRate.width;
-    uint32_t height = frameBuffers.shadingRate.height;
-    VkFormat format = frameBuffers.shadingRate.color.format;
-    
-    if (file.Write(&width, sizeof(uint32_t)) != sizeof(uint32_t) ||
-        file.Write(&height, sizeof(uint32_t)) != sizeof(uint32_t) ||
-        file.Write(&format, sizeof(VkFormat)) != sizeof(VkFormat) ||
-        file.Write(&subResourceLayout.size, sizeof(VkDeviceSize)) != sizeof(VkDeviceSize)) {
-        LOGE("VulkanExample saveShadingRateImage: Failed to write metadata");
-        file.Close();
-        vkUnmapMemory(device, frameBuffers.shadingRate.color.mem);
-        return;
+    LOGI("VulkanExample saveShadingRateImage: Stored %{public}ux%{public}u image, %{public}zu cache entries",
+        key.width, key.height, m_shadingRateCache.GetEntryCount());
+}
+
+bool VulkanExample::UploadShadingRateImage(const FrameBufferAttachment &attachment, VkExtent2D extent,
+    const std::vector<uint8_t> &data)
+{
+    if (attachment.image == VK_NULL_HANDLE) {
+        return false;
     }
-    
-    // Write image data
-    char* imageData = (char*)data + subResourceLayout.offset;
-    if (file.Write(imageData, subResourceLayout.size) != subResourceLayout.size) {
-        LOGE("VulkanExample saveShadingRateImage: Failed to write image data");
-    } else {
-        LOGI("VulkanExample saveShadingRateImage: Successfully saved %{public}llu bytes", subResourceLayout.size);
+    // Upload through a staging buffer, the image uses optimal tiling
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingMemory;
+    {
+        MemoryCategoryScope memoryScope(MEMORY_CATEGORY_STAGING);
+        VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, data.size(), &stagingBuffer,
+            &stagingMemory, const_cast<uint8_t *>(data.data())));
     }
-    
-    file.Close();
-    vkUnmapMemory(device, frameBuffers.shadingRate.color.mem);
-    
-    LOGI("VulkanExample saveShadingRateImage: Successfully saved shading rate image");
+
+    VkImageSubresourceRange subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+    vks::tools::setImageLayout(copyCmd, attachment.image, VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+    VkBufferImageCopy region{};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = {extent.width, extent.height, 1};
+    vkCmdCopyBufferToImage(copyCmd, stagingBuffer, attachment.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+        &region);
+    // Leave it in the layout it rests in between frames, see BuildFrameGraph.
+    vks::tools::setImageLayout(copyCmd, attachment.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_IMAGE_LAYOUT_FRAGMENT_SHADING_RATE_ATTACHMENT_OPTIMAL_KHR, subresourceRange);
+    vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+
+    vkDestroyBuffer(device, stagingBuffer, nullptr);
+    vkFreeMemory(device, stagingMemory, nullptr);
+    return true;
 }
 
 void VulkanExample::loadShadingRateImage()
 {
-    LOGI("VulkanExample loadShadingRateImage: Loading shading rate image from file");
-    
-    std::string filePath = "/data/storage/el2/base/haps/entry/cache/shading_rate_image.dat";
-    if (!File::IsFileExist(filePath)) {
-        LOGI("VulkanExample loadShadingRateImage: File does not exist, skipping load");
+    if (!File::IsFileExist(SHADING_RATE_CACHE_PATH)) {
+        LOGD("VulkanExample loadShadingRateImage: File does not exist, skipping load");
         return;
     }
-    
+
     // Only proceed if the image exists
     if (frameBuffers.shadingRate.color.image == VK_NULL_HANDLE) {
-        LOGI("VulkanExample loadShadingRateImage: Shading rate image not created yet, skipping load");
-        return;
-    }
-    
-    File file;
-    if (!file.Open(filePath, File::FILE_READ)) {
-        LOGE("VulkanExample loadShadingRateImage: Failed to open file: %{public}s", filePath.c_str());
-        return;
-    }
-    
-    // Read metadata
-    uint32_t savedWidth, savedHeight;
-    VkFormat savedFormat;
-    VkDeviceSize savedSize;
-    
-    if (file.Read(&savedWidth, sizeof(uint32_t)) != sizeof(uint32_t) ||
-        file.Read(&savedHeight, sizeof(uint32_t)) != sizeof(uint32_t) ||
-        file.Read(&savedFormat, sizeof(VkFormat)) != sizeof(VkFormat) ||
-        file.Read(&savedSize, sizeof(VkDeviceSize)) != sizeof(VkDeviceSize)) {
-        LOGE("VulkanExample loadShadingRateImage: Failed to read metadata");
-        file.Close();
+        LOGD("VulkanExample loadShadingRateImage: Shading rate image not created yet, skipping load");
         return;
     }
-    
-    // Verify compatibility
-    if (savedWidth != frameBuffers.shadingRate.width || 
-        savedHeight != frameBuffers.shadingRate.height ||
-        savedFormat != frameBuffers.shadingRate.color.format) {
-        LOGE("VulkanExample loadShadingRateImage: Image format mismatch - saved: %{public}dx%{public}d fmt:%{public}d, current: %{public}dx%{public}d fmt:%{public}d", 
-             savedWidth, savedHeight, savedFormat, frameBuffers.shadingRate.width, frameBuffers.shadingRate.height, frameBuffers.shadingRate.color.format);
-        file.Close();
-        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_shadingRateFileMutex);
+        if (!m_shadingRateCache.Load(SHADING_RATE_CACHE_PATH)) {
+            LOGE("VulkanExample loadShadingRateImage: Failed to load %{public}s", SHADING_RATE_CACHE_PATH);
+            return;
+        }
     }
-    
-    // Map current image memory
-    void* data = nullptr;
-    VkResult result = vkMapMemory(device, frameBuffers.shadingRate.color.mem, 0, VK_WHOLE_SIZE, 0, &data);
-    if (result != VK_SUCCESS) {
-        LOGE("VulkanExample loadShadingRateImage: Failed to map memory, result: %{public}d", result);
-        file.Close();
-        return;
+
+    // Fill both paths, an entry saved at another resolution is resampled to the current one
+    const bool upscalePaths[] = {false, true};
+    bool activeLoaded = false;
+    for (bool upscale : upscalePaths) {
+        const FrameBufferAttachment &attachment =
+            upscale ? upscaleFrameBuffers.shadingRate.color : frameBuffers.shadingRate.color;
+        ShadingRateCache::Key key = GetShadingRateKey(upscale, attachment.format);
+        std::vector<uint8_t> data;
+        bool loaded = m_shadingRateCache.Find(key, data) &&
+            UploadShadingRateImage(attachment, {key.width, key.height}, data);
+        LOGI("VulkanExample loadShadingRateImage: %{public}ux%{public}u image %{public}s", key.width, key.height,
+            loaded ? "loaded" : "not loaded");
+        if (upscale == (use_method != 0)) {
+            activeLoaded = loaded;
+        }
     }
-    
-    // Get layout info
-    VkImageSubresource subResource = {};
-    subResource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    subResource.mipLevel = 0;
-    subResource.arrayLayer = 0;
-    
-    VkSubresourceLayout subResourceLayout;
-    vkGetImageSubresourceLayout(device, frameBuffers.shadingRate.color.image, &subResource, &subResourceLayout);
-    
-    // Verify size compatibility
-    if (savedSize != subResourceLayout.size) {
-        LOGE("VulkanExample loadShadingRateImage: Size mismatch - saved: %{public}llu, current: %{public}llu", savedSize, subResourceLayout.size);
-        file.Close();
-        vkUnmapMemory(device, frameBuffers.shadingRate.color.mem);
+    if (!activeLoaded) {
         return;
     }
-    
-    // Read image data
-    char* imageData = (char*)data + subResourceLayout.offset;
-    if (file.Read(imageData, savedSize) != savedSize) {
-        LOGE("VulkanExample loadShadingRateImage: Failed to read image data");
-    } else {
-        LOGI("VulkanExample loadShadingRateImage: Successfully loaded %{public}llu bytes", savedSize);
-    }
-    
-    file.Close();
-    vkUnmapMemory(device, frameBuffers.shadingRate.color.mem);
-    
-    LOGI("VulkanExample loadShadingRateImage: Successfully loaded shading rate image");
+    // Keep the loaded rates until the view moves away from the pose they were loaded for
+    m_vrsHistoryValid = true;
+    m_vrsReusedFrames = 0;
+    m_vrsDispatchVP = camera.matrices.perspective * camera.matrices.view;
 }
@@ -16,9 +16,22 @@
 #ifndef RENDER_MODEL_3D_SPONZA_H
 #define RENDER_MODEL_3D_SPONZA_H
 
+#include <atomic>
+#include <memory>
 #include "vulkanexamplebase.h"
 #include "vulkan_obj_model.h"
 #include "algorithm/fsr.h"
+#include "algorithm/adaptive_vrs.h"
+#include "algorithm/image_metrics.h"
+#include "algorithm/shading_rate_stats.h"
+#include "async_readback.h"
+#include "debug_overlay.h"
+#include "frame_graph.h"
+#include "memory_tracker.h"
+#include "parallel_recorder.h"
+#include "render_target_pool.h"
+#include "upload_manager.h"
+#include "shading_rate_cache.h"
 #include "xengine/xeg_vulkan_adaptive_vrs.h"
 #include "xengine/xeg_vulkan_spatial_upscale.h"
 #include "xengine/xeg_vulkan_extension.h"
@@ -28,7 +41,24 @@
 #define ENABLE_VALIDATION false
 #define VRS_TILE_SIZE 8
 #define SENSITIVITY 0.4
+#define VRS_PASS_GBUFFER 0x1 // passes that read the shading rate image, see SetVRSPasses
+#define VRS_PASS_LIGHT 0x2
+#define VRS_REUSE_MAX_FRAMES 30   // the shading rate image is regenerated at least this often
+#define VRS_REUSE_MAX_ERROR 4.0f  // pixels of reprojection offset before it is regenerated, half a tile
+#define UPLOAD_RING_SIZE (32 * 1024 * 1024)
+#define TEXTURE_STREAMING_BUDGET (128 * 1024 * 1024) // device memory of the scene textures
+#define TEXTURE_STREAMING_INTERVAL 4 // frames between texture residency updates
+#define GBUFFER_RECORD_RANGES 4u // upper bound of the secondaries recording the G-Buffer pass
+#define GBUFFER_SECONDARY_SETS 4  // G-Buffer secondaries per (upscale, G-Buffer pass shading rate)
+#define COMMAND_VARIANT_CACHE_SIZE 6 // recorded combinations of the render settings kept around
 #define LIGHT_NUM 40
+#define QUALITY_BENCHMARK_WARMUP_FRAMES 3
+#define SHADING_RATE_READBACK_SLOTS 3
+#define SHADING_RATE_STATS_INTERVAL 60 // frames between shading rate statistics samples
+#define DEBUG_OVERLAY_LINES 48 // overlay text height is the screen height divided by this
+#define SHADING_RATE_CACHE_PATH "/data/storage/el2/base/haps/entry/cache/shading_rate_cache.bin"
+#define TRACE_CALIBRATION_INTERVAL 300 // frames between GPU clock calibrations, absorbs the drift of the two clocks
+#define MEMORY_BUDGET_CHECK_INTERVAL 60 // frames between driver heap budget queries
 
 class VulkanExample : public VulkanExampleBase {
 public:
@@ -56,23 +86,51 @@ public:
     int cur_method = 0;
     bool use_vrs = false;
     bool cur_vrs = false;
+    uint32_t use_vrsPasses = VRS_PASS_GBUFFER | VRS_PASS_LIGHT;
+    uint32_t cur_vrsPasses = VRS_PASS_GBUFFER | VRS_PASS_LIGHT;
+    bool use_overlay = false;
+    bool cur_overlay = false;
     bool use_reprojectionMatrix = true;
     bool load_shading_image = false;
     
+    // The setters below run on the render thread between two frames, PluginRender queues them from ArkTS.
     void UseVRS(bool useVRS)
     {
         use_vrs = useVRS;
         LOGI("VulkanExample curr use vrs: %{public}d", use_vrs);
     }
     
+    // Selects which passes shade at the rates of the shading rate image when VRS is on, VRS_PASS_* bits.
+    void SetVRSPasses(uint32_t passes)
+    {
+        use_vrsPasses = passes & (VRS_PASS_GBUFFER | VRS_PASS_LIGHT);
+        LOGI("VulkanExample curr vrs passes: %{public}u", use_vrsPasses);
+    }
+
+    // Shows frame and pass timings, view is a DebugOverlay::View drawn below the text. Only toggling the overlay
+    // rebuilds the command buffers, the view and the text are updated every frame.
+    void SetDebugOverlay(bool enabled, uint32_t view)
+    {
+        use_overlay = enabled;
+        m_overlayView = view < DebugOverlay::VIEW_COUNT ? view : DebugOverlay::VIEW_NONE;
+        LOGI("VulkanExample curr debug overlay: %{public}d, view %{public}u", use_overlay, m_overlayView.load());
+    }
+
+    // The upload happens before the next frame.
     void SetLoadShadingImage(bool loadShadingImage)
     {
         load_shading_image = loadShadingImage;
         LOGI("VulkanExample set load_shading_image: %{public}d", load_shading_image);
         if (load_shading_image) {
-            loadShadingRateImage();
+            m_loadShadingRateRequested = true;
         }
     }
+
+    // The shading rate image of the next frame is read back asynchronously.
+    void saveShadingRateImage()
+    {
+        m_saveShadingRateRequested = true;
+    }
     
     void SetMethod(int method)
     {
@@ -80,11 +138,30 @@ public:
         LOGI("VulkanExample curr set method: %{public}d", use_method);
     }
 
-    FSR *fsr;
-    XEG_SpatialUpscale xegSpatialUpscale;
-    XEG_AdaptiveVRS xeg_adaptiveVRS;
-    XEG_AdaptiveVRS xeg_adaptiveVRS4Upscale;
+    // Latest shading rate statistics, sampled every SHADING_RATE_STATS_INTERVAL frames while VRS is on.
+    // Returns false until the first sample has been read back. Callable from any thread.
+    bool GetShadingRateStats(ShadingRateStats &stats)
+    {
+        std::lock_guard<std::mutex> lock(m_shadingRateStatsMutex);
+        stats = m_shadingRateStats;
+        return m_shadingRateStatsValid;
+    }
+
+    // Runs the quality benchmark on the render thread before the next frame.
+    void RequestQualityBenchmark()
+    {
+        m_qualityBenchmarkRequested = true;
+        LOGI("VulkanExample quality benchmark requested");
+    }
+
+    FSR *fsr = nullptr;
+    XEG_SpatialUpscale xegSpatialUpscale{};
+    XEG_AdaptiveVRS xeg_adaptiveVRS{};
+    XEG_AdaptiveVRS xeg_adaptiveVRS4Upscale{};
     XEG_AdaptiveVRSCreateInfo xeg_createInfo;
+    // Built-in adaptive VRS, replaces xeg_adaptiveVRS when the XEngine extension is not supported
+    AdaptiveVRS *m_adaptiveVRS = nullptr;
+    AdaptiveVRS *m_adaptiveVRS4Upscale = nullptr;
 
     struct UBOSceneParams {
         glm::mat4 projection;
@@ -199,31 +276,29 @@ public:
         vks::Buffer lightParams;
     } uniformBuffers;
     
+    // The memory belongs to m_renderTargets, see ReleaseAttachment
     struct FrameBufferAttachment {
-        VkImage image;
-        VkDeviceMemory mem;
-        VkImageView view;
-        VkFormat format;
-        void Destroy(VkDevice device)
-        {
-            vkDestroyImage(device, image, nullptr);
-            vkDestroyImageView(device, view, nullptr);
-            vkFreeMemory(device, mem, nullptr);
-            image = VK_NULL_HANDLE;
-            view = VK_NULL_HANDLE;
-            mem = VK_NULL_HANDLE;
-        }
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory mem = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkFormat format = VK_FORMAT_UNDEFINED;
     };
     
     struct FrameBuffer {
-        int32_t width, height;
-        VkFramebuffer frameBuffer;
-        VkRenderPass renderPass;
+        int32_t width = 0, height = 0;
+        VkFramebuffer frameBuffer = VK_NULL_HANDLE;
+        VkRenderPass renderPass = VK_NULL_HANDLE;
         void setSize(int32_t w, int32_t h)
         {
             this->width = w;
             this->height = h;
         }
+        // The render pass only depends on the formats and outlives resizes
+        void destroyFrameBuffer(VkDevice device)
+        {
+            vkDestroyFramebuffer(device, frameBuffer, nullptr);
+            frameBuffer = VK_NULL_HANDLE;
+        }
         void destroy(VkDevice device)
         {
             vkDestroyFramebuffer(device, frameBuffer, nullptr);
@@ -233,25 +308,24 @@ public:
         }
     };
 
+    struct Offscreen : public FrameBuffer {
+        FrameBufferAttachment position, normal, viewNormal, albedo, depth;
+    };
+    struct Render : public FrameBuffer {
+        FrameBufferAttachment color;
+    };
+
     struct {
-        struct Offscreen : public FrameBuffer {
-            FrameBufferAttachment position, normal, viewNormal, albedo, depth;
-        } gBufferLight;
-        struct Render : public FrameBuffer {
-            FrameBufferAttachment color;
-        } light, shadingRate;
+        Offscreen gBufferLight;
+        Render light, shadingRate;
     } frameBuffers;
     
     struct {
-        struct Offscreen : public FrameBuffer {
-            FrameBufferAttachment position, normal, viewNormal, albedo, depth;
-        } gBufferLight;
-        struct Render : public FrameBuffer {
-            FrameBufferAttachment color;
-        } light, upscale, shadingRate;
+        Offscreen gBufferLight;
+        Render light, upscale, shadingRate;
     } upscaleFrameBuffers;
     
-    VkSampler colorSampler;
+    VkSampler colorSampler = VK_NULL_HANDLE;
 
 public:
     
@@ -260,14 +334,46 @@ public:
         if (!prepared) {
             return;
         }
-        if (cur_method != use_method || cur_vrs != use_vrs) {
+        if (m_qualityBenchmarkRequested.exchange(false)) {
+            RunQualityBenchmark();
+        }
+        // Streamed textures rewrite the descriptor sets, every recorded variant is stale. A settings change only
+        // switches variants, the command buffers of a combination are recorded the first time it is used.
+        bool texturesChanged = m_frameIndex % TEXTURE_STREAMING_INTERVAL == 0 &&
+            m_scene.UpdateStreaming(GetStreamingView(), m_frameIndex);
+        if (texturesChanged) {
             buildCommandBuffers();
-            LOGI("VulkanExample rebuild command buffers");
-            cur_method = use_method;
-            cur_vrs = use_vrs;
+            LOGD("VulkanExample rebuild command buffers");
+        } else if (cur_method != use_method || cur_vrs != use_vrs || cur_vrsPasses != use_vrsPasses ||
+            cur_overlay != use_overlay) {
+            ActivateCommandVariant();
+        }
+        // After the variant switch, which drops the VRS history the load sets up
+        if (m_loadShadingRateRequested.exchange(false)) {
+            loadShadingRateImage();
+        }
+        cur_method = use_method;
+        cur_vrs = use_vrs;
+        cur_vrsPasses = use_vrsPasses;
+        cur_overlay = use_overlay;
+        if (cur_overlay) {
+            UpdateDebugOverlay();
         }
 
         Draw();
+        m_frameIndex++;
+        if (m_saveShadingRateRequested.exchange(false)) {
+            SaveShadingRateImageAsync();
+        }
+        if (cur_vrs && m_frameIndex % SHADING_RATE_STATS_INTERVAL == 0) {
+            SampleShadingRateStats();
+        }
+        if (m_readback != nullptr) {
+            m_readback->Poll();
+        }
+        if (m_frameIndex % MEMORY_BUDGET_CHECK_INTERVAL == 0) {
+            CheckMemoryBudget();
+        }
         if (camera.updated) {
             UpdateUniformBufferMatrices();
         }
@@ -281,18 +387,106 @@ public:
     bool prepare();
     void getEnabledFeatures();
     void buildCommandBuffers();
+    void windowResized() override;
+    void drawUI(const VkCommandBuffer commandBuffer) override;
 
 private:
     VkPhysicalDeviceFragmentShadingRatePropertiesKHR physicalDeviceShadingRateImageProperties{};
     VkPhysicalDeviceFragmentShadingRateFeaturesKHR enabledPhysicalDeviceShadingRateImageFeaturesKHR{};
+    VkPhysicalDeviceTimelineSemaphoreFeatures enabledTimelineSemaphoreFeatures{};
+    // Scene assets are streamed through the transfer queue, null when timeline semaphores are not supported
+    UploadManager *m_uploadManager = nullptr;
+    void PrepareUploadManager();
+    vkOBJ::StreamingView GetStreamingView() const;
     void InitXEGVRS();
+    void InitBuiltinVRS();
     void DispatchVRS(bool upscale, VkCommandBuffer commandBuffer);
+    // Primary command buffers of one combination of the render settings, one per swapchain image. Recorded
+    // variants are cached so switching back and forth submits existing command buffers, everything is recorded
+    // again only when resources they reference change (resize, streamed textures).
+    struct CommandVariant {
+        uint32_t key = 0;
+        bool recorded = false;
+        uint64_t lastUsed = 0;
+        std::vector<VkCommandBuffer> drawCmdBuffers;  // dispatch the VRS compute pass when VRS is on
+        std::vector<VkCommandBuffer> reuseCmdBuffers; // keep the shading rate image of an earlier frame, VRS only
+    };
+    std::vector<std::unique_ptr<CommandVariant>> m_commandVariants;
+    CommandVariant *m_activeVariant = nullptr;
+    uint32_t GetCommandVariantKey() const;
+    // Switches to the variant of the use_* settings, recording it when needed
+    void ActivateCommandVariant();
+    void RecordCommandVariant(CommandVariant &variant);
+    void InvalidateCommandVariants();
+    void FreeCommandVariant(CommandVariant &variant);
+    // Blocks until no submitted frame executes recorded command buffers any more
+    void WaitForSubmittedFrames();
+    // Temporal reuse of the shading rate image, static and slow views skip the VRS dispatch
+    bool m_vrsReuseRecorded = false;
+    bool m_vrsHistoryValid = false;
+    uint32_t m_vrsReusedFrames = 0;
+    glm::mat4 m_vrsDispatchVP = glm::mat4(1.0f);
+    float GetVRSReprojectionError(const glm::mat4 &currVP) const;
+    bool ShouldDispatchVRS();
     void PrepareShadingRateImage(uint32_t sriWidth, uint32_t sriHeight, FrameBufferAttachment *attachment);
-    void CreateAttachment(VkFormat format, VkImageUsageFlagBits usage,
+    // Phases of a frame an offscreen target is live in, targets without a common phase share memory
+    enum TargetLifetime : uint32_t {
+        TARGET_LIFETIME_NATIVE = 0x1,  // native rendering at highRes
+        TARGET_LIFETIME_UPSCALE = 0x2, // rendering at lowRes and the upscale to highRes
+    };
+    VkImageAspectFlags GetAttachmentInfo(VkFormat format, VkImageUsageFlags usage, uint32_t width, uint32_t height,
+        VkImageCreateInfo &image);
+    void CreateAttachment(VkFormat format, VkImageUsageFlags usage,
         FrameBufferAttachment *attachment, uint32_t width, uint32_t height);
+    void ReleaseAttachment(FrameBufferAttachment &attachment);
     void PrepareOffscreenFramebuffers();
+    // Size dependent part of the offscreen passes: the attachments at highRes / lowRes and the framebuffers using
+    // them. A resize releases them into the pool and creates them again, the render passes are kept.
+    RenderTargetPool m_renderTargets;
+    VkExtent2D m_screenExtent = {0, 0}; // the debug overlay was laid out for
+    void CreateOffscreenTargets();
+    void CreateOffscreenFramebuffers();
+    void DestroyOffscreenTargets();
+    // Recreates the offscreen targets and everything sized by or referencing them, the device is idle
+    void ResizeOffscreenTargets();
+    // Device memory accounting, VK_EXT_memory_budget adds the driver view of the heaps
+    bool m_memoryBudgetSupported = false;
+    bool m_memoryTracked = false; // MemoryTracker Init ran, Shutdown is due
+    // Over a budget the render targets released by earlier resizes are freed
+    void CheckMemoryBudget();
+    void DestroyUpscaleAndVRS();
     void LoadAssets();
-    void BuildUpscaleCommandBuffers();
+    // One description drives native and upscale rendering, they only differ in the targets and the upscale passes.
+    // The graph orders the passes and places the barriers between them, see FrameGraph.
+    enum FramePass : uint32_t {
+        FRAME_PASS_GBUFFER = 0,
+        FRAME_PASS_VRS,
+        FRAME_PASS_LIGHT,
+        FRAME_PASS_SPATIAL_UPSCALE,
+        FRAME_PASS_FSR,
+        FRAME_PASS_SWAP,
+        FRAME_PASS_COUNT
+    };
+    void BuildFrameGraph(FrameGraph &graph, bool upscale, bool dispatchVRS);
+    void BuildFrameCommandBuffers(const std::vector<VkCommandBuffer> &cmdBuffers, bool upscale, bool dispatchVRS);
+    void RecordLightPass(VkCommandBuffer commandBuffer, uint32_t index, bool upscale);
+    void RecordSwapPass(VkCommandBuffer commandBuffer, uint32_t index, bool upscale);
+    // The G-Buffer pass is recorded into secondary command buffers by mesh range on the job system, inline when
+    // the recorder is unavailable. Variants with the same target and G-Buffer shading rate share one set, it is
+    // recorded once and only again together with the variants executing it.
+    struct GBufferSecondaries {
+        ParallelRecorder *recorder = nullptr;
+        std::vector<VkCommandBuffer> commandBuffers;
+        bool recorded = false;
+    };
+    GBufferSecondaries m_gBufferSecondaries[GBUFFER_SECONDARY_SETS];
+    uint32_t m_gBufferSet = 0; // set of the command buffers being recorded
+    void PrepareParallelRecording();
+    void RecordGBufferSecondaries(bool upscale, bool vrs);
+    void RecordGBufferPass(VkCommandBuffer commandBuffer, uint32_t index,
+        const VkRenderPassBeginInfo &renderPassBeginInfo, bool upscale);
+    void RecordGBufferDraws(VkCommandBuffer commandBuffer, bool upscale, bool vrs, uint32_t firstMesh,
+        uint32_t meshCount);
     void SetupDescriptorPool();
     void SetupLayouts();
     void SetupDescriptors();
@@ -304,14 +498,99 @@ private:
     void Draw();
     void InitFSR();
     void InitSpatialUpscale();
-    bool CheckXEngine();
+    void CheckXEngine();
+    bool m_xegSpatialUpscaleSupported = false;
+    bool m_xegAdaptiveVRSSupported = false;
     std::array<VkVertexInputAttributeDescription, 3> GetAttributeDescriptions();
     VkPipelineVertexInputStateCreateInfo m_pipelineVertexInputStateCreateInfo = {};
     VkVertexInputBindingDescription m_vertexInputBindingDescription = {};
     std::vector<VkVertexInputAttributeDescription> m_vertexInputAttributeDescriptions;
     
-    // Methods for saving and loading shading rate image data
-    void saveShadingRateImage();
+    // GPU timestamps at the start of each draw command buffer and after each pass, TIMESTAMP_COUNT queries per
+    // swapchain image. Native rendering writes TIMESTAMP_UPSCALE right after TIMESTAMP_LIGHT.
+    enum TimestampSlot : uint32_t {
+        TIMESTAMP_BEGIN = 0,
+        TIMESTAMP_GBUFFER,
+        TIMESTAMP_VRS,
+        TIMESTAMP_LIGHT,
+        TIMESTAMP_UPSCALE,
+        TIMESTAMP_END,
+        TIMESTAMP_COUNT
+    };
+    VkQueryPool m_timestampQueryPool = VK_NULL_HANDLE;
+    uint32_t m_queryImageCount = 0; // swapchain images the query pools were created for
+    void PrepareTimestampQueries();
+    void WriteTimestamp(VkCommandBuffer commandBuffer, uint32_t index, uint32_t slot);
+    bool GetGpuTimeMs(uint32_t index, double &gpuMs);
+    // passMs[i] is the time between slot i and slot i + 1
+    bool GetPassTimesMs(uint32_t index, double passMs[TIMESTAMP_COUNT - 1]);
+
+    // GPU passes on the trace timeline. VK_EXT_calibrated_timestamps maps the GPU clock to CLOCK_MONOTONIC, without
+    // it the start of a frame is pinned to its vkQueueSubmit and the passes show late by the submit latency.
+    bool m_calibratedTimestamps = false;
+    bool m_gpuClockCalibrated = false;
+    double m_gpuClockOffsetNs = 0.0; // CLOCK_MONOTONIC minus the GPU clock
+    uint64_t m_calibrationFrame = 0;
+    uint64_t m_submitNs = 0;
+    bool SupportsCalibratedTimestamps();
+    // The logical device does not exist yet when the extensions are chosen, asks the physical device
+    bool IsDeviceExtensionSupported(const char *extensionName);
+    void CalibrateGpuClock();
+    void TraceGpuFrame(uint32_t index);
+
+    // Debug overlay, see SetDebugOverlay
+    DebugOverlay *m_debugOverlay = nullptr;
+    std::atomic<uint32_t> m_overlayView{DebugOverlay::VIEW_NONE};
+    void PrepareDebugOverlay();
+    void UpdateDebugOverlay();
+
+    // Quality benchmark: native highRes without VRS is the reference for every other method/VRS combination
+    struct QualityEntry {
+        int method;
+        bool vrs;
+        ImageMetrics::Result metrics;
+        double gpuMs;
+        uint32_t samples; // poses that were read back and scored
+        uint32_t timedSamples; // scored poses with GPU timestamps
+    };
+    std::atomic<bool> m_qualityBenchmarkRequested{false};
+    bool ReadbackColorImage(const FrameBufferAttachment &attachment, uint32_t width, uint32_t height,
+        std::vector<uint8_t> &pixels);
+    void RunQualityBenchmark();
+    void WriteQualityReport(const std::vector<QualityEntry> &entries);
+
+    // Methods for saving and loading shading rate image data. The image is read back through a staging ring and
+    // stored into the shading rate cache on the readback worker thread, so it can stay in optimal tiling.
+    // The cache keeps one entry per resolution and camera pose bucket, loading fills both the native and the
+    // upscale shading rate image from the entry nearest to the current pose.
+    // The cache and its file are shared by every instance, the entries of one are kept when another one saves.
+    AsyncReadback *m_readback = nullptr;
+    static ShadingRateCache m_shadingRateCache;
+    uint64_t m_sceneHash = 0;
+    std::atomic<bool> m_saveShadingRateRequested{false};
+    std::atomic<bool> m_loadShadingRateRequested{false};
+    // Held around loading and saving SHADING_RATE_CACHE_PATH
+    static std::mutex m_shadingRateFileMutex;
+    VkExtent2D GetShadingRateExtent(bool upscale) const;
+    ShadingRateCache::Key GetShadingRateKey(bool upscale, VkFormat format) const;
+    void PrepareShadingRateReadback();
+    void SaveShadingRateImageAsync();
+    void WriteShadingRateFile(const std::vector<uint8_t> &data, const ShadingRateCache::Key &key);
+    bool UploadShadingRateImage(const FrameBufferAttachment &attachment, VkExtent2D extent,
+        const std::vector<uint8_t> &data);
     void loadShadingRateImage();
+
+    // Shading rate statistics, the histogram is computed on the readback worker thread
+    uint64_t m_frameIndex = 0;
+    std::mutex m_shadingRateStatsMutex;
+    ShadingRateStats m_shadingRateStats;
+    bool m_shadingRateStatsValid = false;
+    VkQueryPool m_pipelineStatsQueryPool = VK_NULL_HANDLE;
+    void PreparePipelineStatisticsQueries();
+    void ResetPipelineStatistics(VkCommandBuffer commandBuffer, uint32_t index);
+    // query is index * 2 for the G-Buffer pass and index * 2 + 1 for the light pass
+    void WritePipelineStatistics(VkCommandBuffer commandBuffer, uint32_t query, bool begin);
+    bool GetPipelineStatistics(uint32_t index, uint64_t &gBufferInvocations, uint64_t &lightInvocations);
+    void SampleShadingRateStats();
 };
 #endif // RENDER_MODEL_3D_SPONZA_H
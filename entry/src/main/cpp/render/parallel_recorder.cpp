@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "parallel_recorder.h"
+#include <algorithm>
+#include "VulkanTools.h"
+#include "common/common.h"
+#include "common/jobs/job_system.h"
+
+ParallelRecorder::~ParallelRecorder()
+{
+    // Destroying the pool frees its command buffer
+    for (auto &range : m_ranges) {
+        if (range.commandPool != VK_NULL_HANDLE) {
+            vkDestroyCommandPool(m_device, range.commandPool, nullptr);
+        }
+    }
+}
+
+bool ParallelRecorder::Init(const InitParams &initParams)
+{
+    m_device = initParams.device;
+    uint32_t rangeCount = initParams.rangeCount;
+    if (rangeCount == 0) {
+        rangeCount = JobSystem::GetInstance()->GetWorkerCount() + 1;
+    }
+    m_ranges = std::vector<Range>(rangeCount);
+
+    // Command pools are externally synchronized, one per range lets the jobs record without locking
+    VkCommandPoolCreateInfo cmdPoolInfo = {};
+    cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    cmdPoolInfo.queueFamilyIndex = initParams.queueFamilyIndex;
+    cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    for (auto &range : m_ranges) {
+        VkResult res = vkCreateCommandPool(m_device, &cmdPoolInfo, nullptr, &range.commandPool);
+        if (res != VK_SUCCESS) {
+            LOGE("ParallelRecorder Init: vkCreateCommandPool failed, result: %{public}d", res);
+            return false;
+        }
+        VkCommandBufferAllocateInfo cmdBufAllocateInfo =
+            vks::initializers::commandBufferAllocateInfo(range.commandPool, VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1);
+        VK_CHECK_RESULT(vkAllocateCommandBuffers(m_device, &cmdBufAllocateInfo, &range.commandBuffer));
+    }
+    LOGI("ParallelRecorder Init: %{public}u ranges", rangeCount);
+    return true;
+}
+
+bool ParallelRecorder::Record(const VkCommandBufferInheritanceInfo &inheritanceInfo, uint32_t itemCount,
+    const RecordFunc &record, std::vector<VkCommandBuffer> &commandBuffers)
+{
+    commandBuffers.clear();
+    if (m_ranges.empty()) {
+        return false;
+    }
+    uint32_t rangeCount = static_cast<uint32_t>(m_ranges.size());
+    for (uint32_t i = 0; i < rangeCount; i++) {
+        uint32_t first = static_cast<uint32_t>(static_cast<uint64_t>(itemCount) * i / rangeCount);
+        uint32_t last = static_cast<uint32_t>(static_cast<uint64_t>(itemCount) * (i + 1) / rangeCount);
+        m_ranges[i].first = first;
+        m_ranges[i].count = last - first;
+        m_ranges[i].result = VK_SUCCESS;
+    }
+    JobSystem::GetInstance()->ParallelFor(rangeCount, 1, [this, &inheritanceInfo, &record](uint32_t first,
+        uint32_t count) {
+        for (uint32_t i = first; i < first + count; i++) {
+            RecordRange(m_ranges[i], inheritanceInfo, record);
+        }
+    }, JobSystem::PRIORITY_HIGH);
+
+    bool succeeded = true;
+    for (auto &range : m_ranges) {
+        if (range.result != VK_SUCCESS) {
+            LOGE("ParallelRecorder Record: recording failed, result: %{public}d", range.result);
+            succeeded = false;
+        } else if (range.count > 0) {
+            commandBuffers.push_back(range.commandBuffer);
+        }
+    }
+    if (!succeeded) {
+        commandBuffers.clear();
+    }
+    return succeeded;
+}
+
+void ParallelRecorder::RecordRange(Range &range, const VkCommandBufferInheritanceInfo &inheritanceInfo,
+    const RecordFunc &record)
+{
+    if (range.count == 0) {
+        return;
+    }
+    // Beginning the buffer implicitly resets it, the pool was created with RESET_COMMAND_BUFFER
+    VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+    cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+    cmdBufInfo.pInheritanceInfo = &inheritanceInfo;
+    range.result = vkBeginCommandBuffer(range.commandBuffer, &cmdBufInfo);
+    if (range.result != VK_SUCCESS) {
+        return;
+    }
+    record(range.commandBuffer, range.first, range.count);
+    range.result = vkEndCommandBuffer(range.commandBuffer);
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RENDER_PARALLEL_RECORDER_H
+#define RENDER_PARALLEL_RECORDER_H
+
+#include <functional>
+#include <vector>
+#include "vulkan/vulkan.h"
+
+// Records one render pass worth of draws into secondary command buffers on the job system.
+// Every range owns a command pool and one secondary command buffer, Record splits the items (e.g. meshes) into one
+// contiguous range each, records them as high priority jobs and blocks until all ranges are recorded. A pool is only
+// used by the job recording its range, so no locking is needed. The secondaries are recorded with SIMULTANEOUS_USE
+// so the same set can be executed from every primary command buffer of a frame variant.
+class ParallelRecorder {
+public:
+    // Records items [first, first + count) into commandBuffer, called on a job worker or the calling thread
+    using RecordFunc = std::function<void(VkCommandBuffer commandBuffer, uint32_t first, uint32_t count)>;
+
+    struct InitParams {
+        VkDevice device;
+        uint32_t queueFamilyIndex;
+        uint32_t rangeCount; // 0 means one per job worker plus the calling thread
+    };
+
+    ParallelRecorder() {}
+    ~ParallelRecorder();
+
+    bool Init(const InitParams &initParams);
+    uint32_t GetRangeCount() const { return static_cast<uint32_t>(m_ranges.size()); }
+
+    // Re-records the secondaries, the caller must make sure the GPU no longer executes the previous ones.
+    // commandBuffers receives one secondary per non-empty range, in item order.
+    bool Record(const VkCommandBufferInheritanceInfo &inheritanceInfo, uint32_t itemCount, const RecordFunc &record,
+        std::vector<VkCommandBuffer> &commandBuffers);
+
+private:
+    struct Range {
+        VkCommandPool commandPool = VK_NULL_HANDLE;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        uint32_t first = 0;
+        uint32_t count = 0;
+        VkResult result = VK_SUCCESS;
+    };
+    void RecordRange(Range &range, const VkCommandBufferInheritanceInfo &inheritanceInfo, const RecordFunc &record);
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    std::vector<Range> m_ranges;
+};
+#endif // RENDER_PARALLEL_RECORDER_H
@@ -14,17 +14,18 @@
  */
 
 #include <cstdint>
+#include <cstring>
+#include <memory>
 #include <string>
 #include <unistd.h>
 #include "common/common.h"
+#include "common/trace.h"
 #include "file/file_operator.h"
 #include "plugin_render.h"
 
-std::mutex PluginRender::m_mutex;
-std::condition_variable PluginRender::m_con;
-bool PluginRender::stop = false;
 std::unordered_map<std::string, PluginRender *> PluginRender::m_instance;
 OH_NativeXComponent_Callback PluginRender::m_callback;
+PluginRender *PluginRender::m_lowMemoryOwner = nullptr;
 
 void OnSurfaceCreatedCB(OH_NativeXComponent *component, void *window)
 {
@@ -52,35 +53,230 @@ void PluginRender::RenderCreated(OH_NativeXComponent *component, void *window)
     uint64_t height;
     int32_t ret = OH_NativeXComponent_GetXComponentSize(component, window, &width, &height);
     LOGD("PluginRender OnSurfaceCreated ret is %{public}d, w:%{public}lu, d:%{public}lu", ret, width, height);
+    if (m_renderThread.joinable()) {
+        LOGE("PluginRender OnSurfaceCreated %{public}s : already rendering", m_id.c_str());
+        return;
+    }
+    // The example of a previous surface was deleted by Release, the Vulkan device is shared and stays
+    if (m_vulkanexample == nullptr) {
+        m_vulkanexample = new VulkanExample();
+    }
     if (!m_vulkanexample->initVulkan()) {
         LOGE("PluginRender OnSurfaceCreated vulkanExample initVulkan FALSE");
         return;
     }
     m_vulkanexample->setupWindow(static_cast<OHNativeWindow *>(window));
 
+    m_stop = false;
     m_renderThread = std::thread(std::bind(&PluginRender::RenderThread, this));
 }
 
+void PluginRender::RenderChanged(OH_NativeXComponent *component, void *window)
+{
+    uint64_t width;
+    uint64_t height;
+    if (OH_NATIVEXCOMPONENT_RESULT_SUCCESS != OH_NativeXComponent_GetXComponentSize(component, window, &width,
+        &height)) {
+        LOGE("PluginRender OnSurfaceChanged : Unable to get XComponent size");
+        return;
+    }
+    LOGI("PluginRender OnSurfaceChanged w:%{public}lu, h:%{public}lu", width, height);
+    // Same thread as the NAPI calls, the only producer of the queue
+    Command command;
+    command.type = Command::SURFACE_CHANGED;
+    command.uintValue = static_cast<uint32_t>(width);
+    command.intValue = static_cast<int32_t>(height);
+    if (!m_commands.Push(std::move(command))) {
+        LOGE("PluginRender OnSurfaceChanged : queue full, the swapchain follows on its next out of date present");
+    }
+}
+
 void PluginRender::RenderThread()
 {
-    while (true) {
-        std::unique_lock<std::mutex> locker(m_mutex);
-        if (!stop) {
-            bool prepared = m_vulkanexample->prepare();
-            if (!prepared) {
-                LOGE("vulkan example is not prepared");
+    Tracer::GetInstance()->SetThreadName("render " + m_id);
+    if (!m_vulkanexample->prepare()) {
+        LOGE("vulkan example is not prepared");
+        // The device is shared and outlives this thread, its command pool does not
+        m_vulkanexample->vulkanDevice->destroyThreadCommandPool();
+        return;
+    }
+    // Commands are applied between two frames, the loop paces the frames itself
+    m_vulkanexample->renderLoop([this]() {
+        if (m_stop) {
+            return false;
+        }
+        ExecuteCommands();
+        return true;
+    });
+    m_vulkanexample->vulkanDevice->destroyThreadCommandPool();
+    LOGI("PluginRender Render Thread stop ");
+}
+
+napi_value PluginRender::PostCommand(napi_env env, Command &command)
+{
+    napi_value promise = nullptr;
+    if (m_completion != nullptr && napi_ok != napi_create_promise(env, &command.deferred, &promise)) {
+        LOGE("PluginRender PostCommand : napi_create_promise fail");
+        command.deferred = nullptr;
+        promise = nullptr;
+    }
+    Command::Type type = command.type;
+    napi_deferred deferred = command.deferred;
+    if (!m_commands.Push(std::move(command))) {
+        LOGE("PluginRender PostCommand : queue full, command %{public}u dropped", type);
+        if (deferred != nullptr) {
+            napi_value message;
+            napi_value error;
+            napi_create_string_utf8(env, "render command queue full", NAPI_AUTO_LENGTH, &message);
+            napi_create_error(env, nullptr, message, &error);
+            napi_reject_deferred(env, deferred, error);
+        }
+    }
+    return promise;
+}
+
+void PluginRender::ExecuteCommands()
+{
+    Command command;
+    while (m_commands.Pop(command)) {
+        switch (command.type) {
+            case Command::SET_UPSCALE_METHOD:
+                m_vulkanexample->SetMethod(command.intValue);
+                break;
+            case Command::SET_VRS_USED:
+                m_vulkanexample->UseVRS(command.boolValue);
+                break;
+            case Command::SET_VRS_PASSES:
+                m_vulkanexample->SetVRSPasses(command.uintValue);
                 break;
-            }
-            m_vulkanexample->SetMethod(m_mode);
-            m_vulkanexample->renderLoop();
-        } else {
-            LOGI("PluginRender Render Thread stop ");
-            break;
+            case Command::SET_DEBUG_OVERLAY:
+                m_vulkanexample->SetDebugOverlay(command.boolValue, command.uintValue);
+                break;
+            case Command::SET_LOAD_SHADING_IMAGE:
+                m_vulkanexample->SetLoadShadingImage(command.boolValue);
+                break;
+            case Command::SAVE_SHADING_RATE_IMAGE:
+                m_vulkanexample->saveShadingRateImage();
+                break;
+            case Command::RUN_QUALITY_BENCHMARK:
+                m_vulkanexample->RequestQualityBenchmark();
+                break;
+            case Command::SET_PRESENT_MODE:
+                m_vulkanexample->setPresentMode(static_cast<VkPresentModeKHR>(command.uintValue));
+                break;
+            case Command::SET_FRAME_RATE:
+                m_vulkanexample->setFrameRateLimit(command.uintValue, command.floatValue);
+                break;
+            case Command::DUMP_TRACE:
+                // Between two frames, the hitch of the dump itself shows in the next trace
+                Tracer::GetInstance()->Dump(TRACE_DUMP_PATH);
+                break;
+            case Command::SURFACE_CHANGED:
+                m_vulkanexample->surfaceChanged(command.uintValue, static_cast<uint32_t>(command.intValue));
+                break;
+            default:
+                LOGE("PluginRender unknown command %{public}u", command.type);
+                break;
+        }
+        // The deferred goes back to the JS thread as is, nothing is allocated here
+        if (command.deferred != nullptr &&
+            napi_ok != napi_call_threadsafe_function(m_completion, command.deferred, napi_tsfn_nonblocking)) {
+            LOGE("PluginRender command %{public}u completion not delivered", command.type);
+        }
+    }
+}
+
+void PluginRender::RejectCommands(const char *reason)
+{
+    // JS thread, after the render thread stopped consuming
+    Command command;
+    while (m_commands.Pop(command)) {
+        if (command.deferred == nullptr || m_env == nullptr) {
+            continue;
         }
+        napi_value message;
+        napi_value error;
+        napi_create_string_utf8(m_env, reason, NAPI_AUTO_LENGTH, &message);
+        napi_create_error(m_env, nullptr, message, &error);
+        napi_reject_deferred(m_env, command.deferred, error);
+    }
+}
+
+void PluginRender::CompleteCommand(napi_env env, napi_value jsCallback, void *context, void *data)
+{
+    // env is null when the function is finalized with completions still queued, the promise is dropped
+    if (env == nullptr) {
+        return;
+    }
+    napi_value undefined;
+    napi_get_undefined(env, &undefined);
+    napi_resolve_deferred(env, static_cast<napi_deferred>(data), undefined);
+}
+
+void PluginRender::CallLowMemory(napi_env env, napi_value jsCallback, void *context, void *data)
+{
+    std::unique_ptr<MemoryTracker::LowMemoryEvent> event(static_cast<MemoryTracker::LowMemoryEvent *>(data));
+    // env is null when the function is finalized with events still queued
+    if (env == nullptr || jsCallback == nullptr) {
+        return;
+    }
+    static const char *const sources[] = {"category", "total", "heap", "allocation"};
+    // { source, category | heap, usedBytes, budgetBytes }
+    napi_value result;
+    napi_create_object(env, &result);
+    napi_value value;
+    napi_create_string_utf8(env, sources[event->source], NAPI_AUTO_LENGTH, &value);
+    napi_set_named_property(env, result, "source", value);
+    if (event->source == MemoryTracker::LowMemoryEvent::SOURCE_HEAP) {
+        napi_create_uint32(env, event->index, &value);
+        napi_set_named_property(env, result, "heap", value);
+    } else if (event->source != MemoryTracker::LowMemoryEvent::SOURCE_TOTAL) {
+        napi_create_string_utf8(env, MemoryTracker::GetCategoryName(event->index), NAPI_AUTO_LENGTH, &value);
+        napi_set_named_property(env, result, "category", value);
     }
+    napi_create_double(env, static_cast<double>(event->usedBytes), &value);
+    napi_set_named_property(env, result, "usedBytes", value);
+    napi_create_double(env, static_cast<double>(event->budgetBytes), &value);
+    napi_set_named_property(env, result, "budgetBytes", value);
+    napi_value undefined;
+    napi_get_undefined(env, &undefined);
+    napi_call_function(env, undefined, jsCallback, 1, &result, nullptr);
 }
 
-void OnSurfaceChangedCB(OH_NativeXComponent *component, void *window) {}
+void PluginRender::ReleaseLowMemory()
+{
+    if (m_lowMemory == nullptr) {
+        return;
+    }
+    // The tracker has one callback for the process, the one of another instance registered later stays
+    if (m_lowMemoryOwner == this) {
+        // Once unregistered the tracker does not call into the function any more
+        MemoryTracker::GetInstance()->SetLowMemoryCallback(nullptr);
+        m_lowMemoryOwner = nullptr;
+    }
+    napi_release_threadsafe_function(m_lowMemory, napi_tsfn_release);
+    m_lowMemory = nullptr;
+}
+
+void OnSurfaceChangedCB(OH_NativeXComponent *component, void *window)
+{
+    LOGI("PluginRender OnSurfaceChangedCB");
+    if ((nullptr == component) || (nullptr == window)) {
+        LOGE("PluginRender OnSurfaceChangedCB : component or window is null");
+        return;
+    }
+
+    char idStr[OH_XCOMPONENT_ID_LEN_MAX + 1] = { '\0' };
+    uint64_t idSize = OH_XCOMPONENT_ID_LEN_MAX + 1;
+    if (OH_NATIVEXCOMPONENT_RESULT_SUCCESS != OH_NativeXComponent_GetXComponentId(component, idStr, &idSize)) {
+        LOGE("PluginRender OnSurfaceChangedCB : Unable to get XComponent id");
+        return;
+    }
+
+    std::string id(idStr);
+    auto render = PluginRender::GetInstance(id);
+    render->RenderChanged(component, window);
+}
 
 void OnSurfaceDestroyedCB(OH_NativeXComponent *component, void *window)
 {
@@ -103,11 +299,6 @@ void OnSurfaceDestroyedCB(OH_NativeXComponent *component, void *window)
 
 void DispatchTouchEventCB(OH_NativeXComponent *component, void *window) {}
 
-void PluginRender::SetMode(int mode)
-{
-    m_mode = mode;
-}
-
 napi_value PluginRender::SetUpscaleMethod(napi_env env, napi_callback_info info)
 {
     size_t argc = 1;
@@ -148,10 +339,13 @@ napi_value PluginRender::SetUpscaleMethod(napi_env env, napi_callback_info info)
     }
     std::string id(idStr);
     PluginRender *render = PluginRender::GetInstance(id);
-    if (render) {
-        render->SetMode(upscaleMode);
+    if (render == nullptr) {
+        return nullptr;
     }
-    return nullptr;
+    Command command;
+    command.type = Command::SET_UPSCALE_METHOD;
+    command.intValue = upscaleMode;
+    return render->PostCommand(env, command);
 }
 
 napi_value PluginRender::SetVRSUsed(napi_env env, napi_callback_info info)
@@ -194,10 +388,120 @@ napi_value PluginRender::SetVRSUsed(napi_env env, napi_callback_info info)
     }
     std::string id(idStr);
     PluginRender *render = PluginRender::GetInstance(id);
-    if (render) {
-        render->m_vulkanexample->UseVRS(useVRS);
+    if (render == nullptr) {
+        return nullptr;
     }
-    return nullptr;
+    Command command;
+    command.type = Command::SET_VRS_USED;
+    command.boolValue = useVRS;
+    return render->PostCommand(env, command);
+}
+
+napi_value PluginRender::SetVRSPasses(napi_env env, napi_callback_info info)
+{
+    if ((nullptr == env) || (nullptr == info)) {
+        LOGE("PluginRender SetVRSPasses : env or info is null");
+        return nullptr;
+    }
+
+    size_t argc = 1;
+    napi_value args[1] = {nullptr};
+    napi_value thisArg;
+    if (napi_ok != napi_get_cb_info(env, info, &argc, args, &thisArg, nullptr)) {
+        LOGE("PluginRender SetVRSPasses : napi_get_cb_info fail");
+        return nullptr;
+    }
+    uint32_t passes = 0;
+    if (argc < 1 || napi_ok != napi_get_value_uint32(env, args[0], &passes)) {
+        LOGE("PluginRender SetVRSPasses : expects a pass mask");
+        return nullptr;
+    }
+    LOGI("PluginRender::SetVRSPasses get params is %{public}u", passes);
+
+    napi_value exportInstance;
+    if (napi_ok != napi_get_named_property(env, thisArg, OH_NATIVE_XCOMPONENT_OBJ, &exportInstance)) {
+        LOGE("PluginRender SetVRSPasses : napi_get_named_property fail");
+        return nullptr;
+    }
+
+    OH_NativeXComponent *nativeXComponent = nullptr;
+    if (napi_ok != napi_unwrap(env, exportInstance, reinterpret_cast<void **>(&nativeXComponent))) {
+        LOGE("PluginRender SetVRSPasses : napi_unwrap fail");
+        return nullptr;
+    }
+
+    char idStr[OH_XCOMPONENT_ID_LEN_MAX + 1] = {'\0'};
+    uint64_t idSize = OH_XCOMPONENT_ID_LEN_MAX + 1;
+    if (OH_NATIVEXCOMPONENT_RESULT_SUCCESS != OH_NativeXComponent_GetXComponentId(nativeXComponent, idStr, &idSize)) {
+        LOGE("PluginRender SetVRSPasses : Unable to get XComponent id");
+        return nullptr;
+    }
+    std::string id(idStr);
+    PluginRender *render = PluginRender::GetInstance(id);
+    if (render == nullptr || render->m_vulkanexample == nullptr) {
+        return nullptr;
+    }
+    Command command;
+    command.type = Command::SET_VRS_PASSES;
+    command.uintValue = passes;
+    return render->PostCommand(env, command);
+}
+
+napi_value PluginRender::SetDebugOverlay(napi_env env, napi_callback_info info)
+{
+    if ((nullptr == env) || (nullptr == info)) {
+        LOGE("PluginRender SetDebugOverlay : env or info is null");
+        return nullptr;
+    }
+
+    size_t argc = 2;
+    napi_value args[2] = {nullptr};
+    napi_value thisArg;
+    if (napi_ok != napi_get_cb_info(env, info, &argc, args, &thisArg, nullptr)) {
+        LOGE("PluginRender SetDebugOverlay : napi_get_cb_info fail");
+        return nullptr;
+    }
+    bool enabled = false;
+    if (argc < 1 || napi_ok != napi_get_value_bool(env, args[0], &enabled)) {
+        LOGE("PluginRender SetDebugOverlay : expects an enabled flag");
+        return nullptr;
+    }
+    // The view is optional and defaults to text only
+    uint32_t view = 0;
+    if (argc > 1 && napi_ok != napi_get_value_uint32(env, args[1], &view)) {
+        LOGE("PluginRender SetDebugOverlay : view must be a number");
+        return nullptr;
+    }
+    LOGI("PluginRender::SetDebugOverlay get params is %{public}d, %{public}u", enabled, view);
+
+    napi_value exportInstance;
+    if (napi_ok != napi_get_named_property(env, thisArg, OH_NATIVE_XCOMPONENT_OBJ, &exportInstance)) {
+        LOGE("PluginRender SetDebugOverlay : napi_get_named_property fail");
+        return nullptr;
+    }
+
+    OH_NativeXComponent *nativeXComponent = nullptr;
+    if (napi_ok != napi_unwrap(env, exportInstance, reinterpret_cast<void **>(&nativeXComponent))) {
+        LOGE("PluginRender SetDebugOverlay : napi_unwrap fail");
+        return nullptr;
+    }
+
+    char idStr[OH_XCOMPONENT_ID_LEN_MAX + 1] = {'\0'};
+    uint64_t idSize = OH_XCOMPONENT_ID_LEN_MAX + 1;
+    if (OH_NATIVEXCOMPONENT_RESULT_SUCCESS != OH_NativeXComponent_GetXComponentId(nativeXComponent, idStr, &idSize)) {
+        LOGE("PluginRender SetDebugOverlay : Unable to get XComponent id");
+        return nullptr;
+    }
+    std::string id(idStr);
+    PluginRender *render = PluginRender::GetInstance(id);
+    if (render == nullptr || render->m_vulkanexample == nullptr) {
+        return nullptr;
+    }
+    Command command;
+    command.type = Command::SET_DEBUG_OVERLAY;
+    command.boolValue = enabled;
+    command.uintValue = view;
+    return render->PostCommand(env, command);
 }
 
 napi_value PluginRender::SaveShadingRateImage(napi_env env, napi_callback_info info)
@@ -235,10 +539,131 @@ napi_value PluginRender::SaveShadingRateImage(napi_env env, napi_callback_info i
     }
     std::string id(idStr);
     PluginRender *render = PluginRender::GetInstance(id);
-    if (render && render->m_vulkanexample) {
-        render->m_vulkanexample->saveShadingRateImage();
+    if (render == nullptr || render->m_vulkanexample == nullptr) {
+        return nullptr;
+    }
+    Command command;
+    command.type = Command::SAVE_SHADING_RATE_IMAGE;
+    return render->PostCommand(env, command);
+}
+
+napi_value PluginRender::RunQualityBenchmark(napi_env env, napi_callback_info info)
+{
+    LOGI("PluginRender::RunQualityBenchmark called");
+
+    if ((nullptr == env) || (nullptr == info)) {
+        LOGE("PluginRender RunQualityBenchmark : env or info is null");
+        return nullptr;
+    }
+
+    napi_value thisArg;
+    if (napi_ok != napi_get_cb_info(env, info, nullptr, nullptr, &thisArg, nullptr)) {
+        LOGE("PluginRender RunQualityBenchmark : napi_get_cb_info fail");
+        return nullptr;
+    }
+
+    napi_value exportInstance;
+    if (napi_ok != napi_get_named_property(env, thisArg, OH_NATIVE_XCOMPONENT_OBJ, &exportInstance)) {
+        LOGE("PluginRender RunQualityBenchmark : napi_get_named_property fail");
+        return nullptr;
+    }
+
+    OH_NativeXComponent *nativeXComponent = nullptr;
+    if (napi_ok != napi_unwrap(env, exportInstance, reinterpret_cast<void **>(&nativeXComponent))) {
+        LOGE("PluginRender RunQualityBenchmark : napi_unwrap fail");
+        return nullptr;
+    }
+
+    char idStr[OH_XCOMPONENT_ID_LEN_MAX + 1] = {'\0'};
+    uint64_t idSize = OH_XCOMPONENT_ID_LEN_MAX + 1;
+    if (OH_NATIVEXCOMPONENT_RESULT_SUCCESS != OH_NativeXComponent_GetXComponentId(nativeXComponent, idStr, &idSize)) {
+        LOGE("PluginRender RunQualityBenchmark : Unable to get XComponent id");
+        return nullptr;
+    }
+    std::string id(idStr);
+    PluginRender *render = PluginRender::GetInstance(id);
+    if (render == nullptr || render->m_vulkanexample == nullptr) {
+        return nullptr;
     }
-    return nullptr;
+    Command command;
+    command.type = Command::RUN_QUALITY_BENCHMARK;
+    return render->PostCommand(env, command);
+}
+
+napi_value PluginRender::GetShadingRateStats(napi_env env, napi_callback_info info)
+{
+    if ((nullptr == env) || (nullptr == info)) {
+        LOGE("PluginRender GetShadingRateStats : env or info is null");
+        return nullptr;
+    }
+
+    napi_value thisArg;
+    if (napi_ok != napi_get_cb_info(env, info, nullptr, nullptr, &thisArg, nullptr)) {
+        LOGE("PluginRender GetShadingRateStats : napi_get_cb_info fail");
+        return nullptr;
+    }
+
+    napi_value exportInstance;
+    if (napi_ok != napi_get_named_property(env, thisArg, OH_NATIVE_XCOMPONENT_OBJ, &exportInstance)) {
+        LOGE("PluginRender GetShadingRateStats : napi_get_named_property fail");
+        return nullptr;
+    }
+
+    OH_NativeXComponent *nativeXComponent = nullptr;
+    if (napi_ok != napi_unwrap(env, exportInstance, reinterpret_cast<void **>(&nativeXComponent))) {
+        LOGE("PluginRender GetShadingRateStats : napi_unwrap fail");
+        return nullptr;
+    }
+
+    char idStr[OH_XCOMPONENT_ID_LEN_MAX + 1] = {'\0'};
+    uint64_t idSize = OH_XCOMPONENT_ID_LEN_MAX + 1;
+    if (OH_NATIVEXCOMPONENT_RESULT_SUCCESS != OH_NativeXComponent_GetXComponentId(nativeXComponent, idStr, &idSize)) {
+        LOGE("PluginRender GetShadingRateStats : Unable to get XComponent id");
+        return nullptr;
+    }
+    std::string id(idStr);
+    PluginRender *render = PluginRender::GetInstance(id);
+    ShadingRateStats stats;
+    if (render == nullptr || render->m_vulkanexample == nullptr ||
+        !render->m_vulkanexample->GetShadingRateStats(stats)) {
+        // No sample yet, e.g. VRS is off
+        napi_value undefined;
+        napi_get_undefined(env, &undefined);
+        return undefined;
+    }
+
+    // { frame, width, height, tiles, estimatedSavings, gBufferInvocations, lightInvocations,
+    //   histogram: { "1x1": tiles, "1x2": tiles, ... } }
+    napi_value result;
+    napi_create_object(env, &result);
+    napi_value value;
+    napi_create_int64(env, static_cast<int64_t>(stats.frame), &value);
+    napi_set_named_property(env, result, "frame", value);
+    napi_create_uint32(env, stats.width, &value);
+    napi_set_named_property(env, result, "width", value);
+    napi_create_uint32(env, stats.height, &value);
+    napi_set_named_property(env, result, "height", value);
+    napi_create_uint32(env, stats.tiles, &value);
+    napi_set_named_property(env, result, "tiles", value);
+    napi_create_double(env, stats.estimatedSavings, &value);
+    napi_set_named_property(env, result, "estimatedSavings", value);
+    napi_create_int64(env, static_cast<int64_t>(stats.gBufferInvocations), &value);
+    napi_set_named_property(env, result, "gBufferInvocations", value);
+    napi_create_int64(env, static_cast<int64_t>(stats.lightInvocations), &value);
+    napi_set_named_property(env, result, "lightInvocations", value);
+
+    napi_value histogram;
+    napi_create_object(env, &histogram);
+    for (uint32_t rate = 0; rate < SHADING_RATE_COUNT; rate++) {
+        // Fragment sizes above 4 are not defined by VK_KHR_fragment_shading_rate
+        if ((rate >> 2) > 2 || (rate & 3) > 2) {
+            continue;
+        }
+        napi_create_uint32(env, stats.histogram[rate], &value);
+        napi_set_named_property(env, histogram, ShadingRateStats::RateName(rate).c_str(), value);
+    }
+    napi_set_named_property(env, result, "histogram", histogram);
+    return result;
 }
 
 napi_value PluginRender::SetLoadShadingImage(napi_env env, napi_callback_info info)
@@ -281,9 +706,344 @@ napi_value PluginRender::SetLoadShadingImage(napi_env env, napi_callback_info in
     }
     std::string id(idStr);
     PluginRender *render = PluginRender::GetInstance(id);
-    if (render && render->m_vulkanexample) {
-        render->m_vulkanexample->SetLoadShadingImage(loadShadingImage);
+    if (render == nullptr || render->m_vulkanexample == nullptr) {
+        return nullptr;
+    }
+    Command command;
+    command.type = Command::SET_LOAD_SHADING_IMAGE;
+    command.boolValue = loadShadingImage;
+    return render->PostCommand(env, command);
+}
+
+napi_value PluginRender::SetPresentMode(napi_env env, napi_callback_info info)
+{
+    if ((nullptr == env) || (nullptr == info)) {
+        LOGE("PluginRender SetPresentMode : env or info is null");
+        return nullptr;
+    }
+
+    size_t argc = 1;
+    napi_value args[1] = {nullptr};
+    napi_value thisArg;
+    if (napi_ok != napi_get_cb_info(env, info, &argc, args, &thisArg, nullptr)) {
+        LOGE("PluginRender SetPresentMode : napi_get_cb_info fail");
+        return nullptr;
+    }
+    // VkPresentModeKHR: 0 immediate, 1 mailbox, 2 fifo, 3 fifo relaxed
+    uint32_t presentMode = 0;
+    if (argc < 1 || napi_ok != napi_get_value_uint32(env, args[0], &presentMode) ||
+        presentMode > VK_PRESENT_MODE_FIFO_RELAXED_KHR) {
+        LOGE("PluginRender SetPresentMode : expects a VkPresentModeKHR");
+        return nullptr;
+    }
+    LOGI("PluginRender::SetPresentMode get params is %{public}u", presentMode);
+
+    napi_value exportInstance;
+    if (napi_ok != napi_get_named_property(env, thisArg, OH_NATIVE_XCOMPONENT_OBJ, &exportInstance)) {
+        LOGE("PluginRender SetPresentMode : napi_get_named_property fail");
+        return nullptr;
+    }
+
+    OH_NativeXComponent *nativeXComponent = nullptr;
+    if (napi_ok != napi_unwrap(env, exportInstance, reinterpret_cast<void **>(&nativeXComponent))) {
+        LOGE("PluginRender SetPresentMode : napi_unwrap fail");
+        return nullptr;
+    }
+
+    char idStr[OH_XCOMPONENT_ID_LEN_MAX + 1] = {'\0'};
+    uint64_t idSize = OH_XCOMPONENT_ID_LEN_MAX + 1;
+    if (OH_NATIVEXCOMPONENT_RESULT_SUCCESS != OH_NativeXComponent_GetXComponentId(nativeXComponent, idStr, &idSize)) {
+        LOGE("PluginRender SetPresentMode : Unable to get XComponent id");
+        return nullptr;
+    }
+    std::string id(idStr);
+    PluginRender *render = PluginRender::GetInstance(id);
+    if (render == nullptr || render->m_vulkanexample == nullptr) {
+        return nullptr;
+    }
+    Command command;
+    command.type = Command::SET_PRESENT_MODE;
+    command.uintValue = presentMode;
+    return render->PostCommand(env, command);
+}
+
+napi_value PluginRender::SetFrameRate(napi_env env, napi_callback_info info)
+{
+    if ((nullptr == env) || (nullptr == info)) {
+        LOGE("PluginRender SetFrameRate : env or info is null");
+        return nullptr;
+    }
+
+    size_t argc = 2;
+    napi_value args[2] = {nullptr};
+    napi_value thisArg;
+    if (napi_ok != napi_get_cb_info(env, info, &argc, args, &thisArg, nullptr)) {
+        LOGE("PluginRender SetFrameRate : napi_get_cb_info fail");
+        return nullptr;
+    }
+    uint32_t targetFps = 0;
+    if (argc < 1 || napi_ok != napi_get_value_uint32(env, args[0], &targetFps)) {
+        LOGE("PluginRender SetFrameRate : expects a target frame rate");
+        return nullptr;
+    }
+    // The refresh rate of the display is optional, e.g. display.getDefaultDisplaySync().refreshRate
+    double refreshRate = 0.0;
+    if (argc > 1 && napi_ok != napi_get_value_double(env, args[1], &refreshRate)) {
+        LOGE("PluginRender SetFrameRate : refresh rate must be a number");
+        return nullptr;
+    }
+    LOGI("PluginRender::SetFrameRate get params is %{public}u, %{public}f", targetFps, refreshRate);
+
+    napi_value exportInstance;
+    if (napi_ok != napi_get_named_property(env, thisArg, OH_NATIVE_XCOMPONENT_OBJ, &exportInstance)) {
+        LOGE("PluginRender SetFrameRate : napi_get_named_property fail");
+        return nullptr;
+    }
+
+    OH_NativeXComponent *nativeXComponent = nullptr;
+    if (napi_ok != napi_unwrap(env, exportInstance, reinterpret_cast<void **>(&nativeXComponent))) {
+        LOGE("PluginRender SetFrameRate : napi_unwrap fail");
+        return nullptr;
+    }
+
+    char idStr[OH_XCOMPONENT_ID_LEN_MAX + 1] = {'\0'};
+    uint64_t idSize = OH_XCOMPONENT_ID_LEN_MAX + 1;
+    if (OH_NATIVEXCOMPONENT_RESULT_SUCCESS != OH_NativeXComponent_GetXComponentId(nativeXComponent, idStr, &idSize)) {
+        LOGE("PluginRender SetFrameRate : Unable to get XComponent id");
+        return nullptr;
+    }
+    std::string id(idStr);
+    PluginRender *render = PluginRender::GetInstance(id);
+    if (render == nullptr || render->m_vulkanexample == nullptr) {
+        return nullptr;
+    }
+    Command command;
+    command.type = Command::SET_FRAME_RATE;
+    command.uintValue = targetFps;
+    command.floatValue = static_cast<float>(refreshRate);
+    return render->PostCommand(env, command);
+}
+
+napi_value PluginRender::DumpTrace(napi_env env, napi_callback_info info)
+{
+    LOGI("PluginRender::DumpTrace called");
+
+    if ((nullptr == env) || (nullptr == info)) {
+        LOGE("PluginRender DumpTrace : env or info is null");
+        return nullptr;
+    }
+
+    napi_value thisArg;
+    if (napi_ok != napi_get_cb_info(env, info, nullptr, nullptr, &thisArg, nullptr)) {
+        LOGE("PluginRender DumpTrace : napi_get_cb_info fail");
+        return nullptr;
+    }
+
+    napi_value exportInstance;
+    if (napi_ok != napi_get_named_property(env, thisArg, OH_NATIVE_XCOMPONENT_OBJ, &exportInstance)) {
+        LOGE("PluginRender DumpTrace : napi_get_named_property fail");
+        return nullptr;
+    }
+
+    OH_NativeXComponent *nativeXComponent = nullptr;
+    if (napi_ok != napi_unwrap(env, exportInstance, reinterpret_cast<void **>(&nativeXComponent))) {
+        LOGE("PluginRender DumpTrace : napi_unwrap fail");
+        return nullptr;
+    }
+
+    char idStr[OH_XCOMPONENT_ID_LEN_MAX + 1] = {'\0'};
+    uint64_t idSize = OH_XCOMPONENT_ID_LEN_MAX + 1;
+    if (OH_NATIVEXCOMPONENT_RESULT_SUCCESS != OH_NativeXComponent_GetXComponentId(nativeXComponent, idStr, &idSize)) {
+        LOGE("PluginRender DumpTrace : Unable to get XComponent id");
+        return nullptr;
+    }
+    std::string id(idStr);
+    PluginRender *render = PluginRender::GetInstance(id);
+    if (render == nullptr || render->m_vulkanexample == nullptr) {
+        return nullptr;
+    }
+    Command command;
+    command.type = Command::DUMP_TRACE;
+    return render->PostCommand(env, command);
+}
+
+napi_value PluginRender::GetMemoryStats(napi_env env, napi_callback_info info)
+{
+    if ((nullptr == env) || (nullptr == info)) {
+        LOGE("PluginRender GetMemoryStats : env or info is null");
+        return nullptr;
+    }
+    MemoryTracker::Stats stats;
+    MemoryTracker::GetInstance()->GetStats(stats);
+
+    // { totalBytes, peakBytes, totalBudgetBytes, allocations, driverBudget,
+    //   categories: { gbuffer: { bytes, peakBytes, budgetBytes, allocations }, ... },
+    //   heaps: [{ size, deviceLocal, trackedBytes, usageBytes, budgetBytes }, ...] }
+    // Byte counts are doubles, exact up to 2^53
+    napi_value result;
+    napi_create_object(env, &result);
+    napi_value value;
+    napi_create_double(env, static_cast<double>(stats.totalBytes), &value);
+    napi_set_named_property(env, result, "totalBytes", value);
+    napi_create_double(env, static_cast<double>(stats.peakBytes), &value);
+    napi_set_named_property(env, result, "peakBytes", value);
+    napi_create_double(env, static_cast<double>(stats.totalBudgetBytes), &value);
+    napi_set_named_property(env, result, "totalBudgetBytes", value);
+    napi_create_uint32(env, stats.allocations, &value);
+    napi_set_named_property(env, result, "allocations", value);
+    napi_get_boolean(env, stats.driverBudget, &value);
+    napi_set_named_property(env, result, "driverBudget", value);
+
+    napi_value categories;
+    napi_create_object(env, &categories);
+    for (uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+        const MemoryTracker::CategoryStats &categoryStats = stats.categories[i];
+        napi_value category;
+        napi_create_object(env, &category);
+        napi_create_double(env, static_cast<double>(categoryStats.bytes), &value);
+        napi_set_named_property(env, category, "bytes", value);
+        napi_create_double(env, static_cast<double>(categoryStats.peakBytes), &value);
+        napi_set_named_property(env, category, "peakBytes", value);
+        napi_create_double(env, static_cast<double>(categoryStats.budgetBytes), &value);
+        napi_set_named_property(env, category, "budgetBytes", value);
+        napi_create_uint32(env, categoryStats.allocations, &value);
+        napi_set_named_property(env, category, "allocations", value);
+        napi_set_named_property(env, categories, MemoryTracker::GetCategoryName(i), category);
+    }
+    napi_set_named_property(env, result, "categories", categories);
+
+    napi_value heaps;
+    napi_create_array_with_length(env, stats.heaps.size(), &heaps);
+    for (uint32_t i = 0; i < stats.heaps.size(); i++) {
+        const MemoryTracker::HeapStats &heapStats = stats.heaps[i];
+        napi_value heap;
+        napi_create_object(env, &heap);
+        napi_create_double(env, static_cast<double>(heapStats.size), &value);
+        napi_set_named_property(env, heap, "size", value);
+        napi_get_boolean(env, heapStats.deviceLocal, &value);
+        napi_set_named_property(env, heap, "deviceLocal", value);
+        napi_create_double(env, static_cast<double>(heapStats.trackedBytes), &value);
+        napi_set_named_property(env, heap, "trackedBytes", value);
+        napi_create_double(env, static_cast<double>(heapStats.usageBytes), &value);
+        napi_set_named_property(env, heap, "usageBytes", value);
+        napi_create_double(env, static_cast<double>(heapStats.budgetBytes), &value);
+        napi_set_named_property(env, heap, "budgetBytes", value);
+        napi_set_element(env, heaps, i, heap);
+    }
+    napi_set_named_property(env, result, "heaps", heaps);
+    return result;
+}
+
+napi_value PluginRender::SetMemoryBudget(napi_env env, napi_callback_info info)
+{
+    if ((nullptr == env) || (nullptr == info)) {
+        LOGE("PluginRender SetMemoryBudget : env or info is null");
+        return nullptr;
+    }
+
+    size_t argc = 2;
+    napi_value args[2] = {nullptr};
+    if (napi_ok != napi_get_cb_info(env, info, &argc, args, nullptr, nullptr)) {
+        LOGE("PluginRender SetMemoryBudget : napi_get_cb_info fail");
+        return nullptr;
+    }
+    // A category name of getMemoryStats or "total", budget 0 removes the budget
+    char name[32] = {'\0'};
+    size_t nameLength = 0;
+    double budgetBytes = 0.0;
+    if (argc < 2 || napi_ok != napi_get_value_string_utf8(env, args[0], name, sizeof(name), &nameLength) ||
+        napi_ok != napi_get_value_double(env, args[1], &budgetBytes) || budgetBytes < 0.0) {
+        LOGE("PluginRender SetMemoryBudget : expects a category and a budget in bytes");
+        return nullptr;
+    }
+    LOGI("PluginRender::SetMemoryBudget get params is %{public}s, %{public}f", name, budgetBytes);
+
+    MemoryTracker *tracker = MemoryTracker::GetInstance();
+    if (strcmp(name, "total") == 0) {
+        tracker->SetTotalBudget(static_cast<VkDeviceSize>(budgetBytes));
+        return nullptr;
+    }
+    for (uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; i++) {
+        if (strcmp(name, MemoryTracker::GetCategoryName(i)) == 0) {
+            tracker->SetBudget(i, static_cast<VkDeviceSize>(budgetBytes));
+            return nullptr;
+        }
+    }
+    LOGE("PluginRender SetMemoryBudget : unknown category %{public}s", name);
+    return nullptr;
+}
+
+napi_value PluginRender::OnLowMemory(napi_env env, napi_callback_info info)
+{
+    if ((nullptr == env) || (nullptr == info)) {
+        LOGE("PluginRender OnLowMemory : env or info is null");
+        return nullptr;
+    }
+
+    size_t argc = 1;
+    napi_value args[1] = {nullptr};
+    napi_value thisArg;
+    if (napi_ok != napi_get_cb_info(env, info, &argc, args, &thisArg, nullptr)) {
+        LOGE("PluginRender OnLowMemory : napi_get_cb_info fail");
+        return nullptr;
+    }
+    // A function, null or undefined unregisters
+    napi_valuetype type = napi_undefined;
+    if (argc > 0) {
+        napi_typeof(env, args[0], &type);
+    }
+    if (type != napi_function && type != napi_null && type != napi_undefined) {
+        LOGE("PluginRender OnLowMemory : expects a function");
+        return nullptr;
+    }
+
+    napi_value exportInstance;
+    if (napi_ok != napi_get_named_property(env, thisArg, OH_NATIVE_XCOMPONENT_OBJ, &exportInstance)) {
+        LOGE("PluginRender OnLowMemory : napi_get_named_property fail");
+        return nullptr;
+    }
+
+    OH_NativeXComponent *nativeXComponent = nullptr;
+    if (napi_ok != napi_unwrap(env, exportInstance, reinterpret_cast<void **>(&nativeXComponent))) {
+        LOGE("PluginRender OnLowMemory : napi_unwrap fail");
+        return nullptr;
+    }
+
+    char idStr[OH_XCOMPONENT_ID_LEN_MAX + 1] = {'\0'};
+    uint64_t idSize = OH_XCOMPONENT_ID_LEN_MAX + 1;
+    if (OH_NATIVEXCOMPONENT_RESULT_SUCCESS != OH_NativeXComponent_GetXComponentId(nativeXComponent, idStr, &idSize)) {
+        LOGE("PluginRender OnLowMemory : Unable to get XComponent id");
+        return nullptr;
+    }
+    std::string id(idStr);
+    PluginRender *render = PluginRender::GetInstance(id);
+    if (render == nullptr) {
+        return nullptr;
+    }
+    render->ReleaseLowMemory();
+    if (type != napi_function) {
+        return nullptr;
     }
+
+    napi_value resourceName;
+    napi_create_string_utf8(env, "PluginRenderLowMemory", NAPI_AUTO_LENGTH, &resourceName);
+    napi_threadsafe_function lowMemory = nullptr;
+    if (napi_ok != napi_create_threadsafe_function(env, args[0], nullptr, resourceName, 0, 1, nullptr, nullptr,
+        nullptr, PluginRender::CallLowMemory, &lowMemory)) {
+        LOGE("PluginRender OnLowMemory : napi_create_threadsafe_function failed");
+        return nullptr;
+    }
+    // A registered callback must not keep the app alive
+    napi_unref_threadsafe_function(env, lowMemory);
+    render->m_lowMemory = lowMemory;
+    m_lowMemoryOwner = render;
+    MemoryTracker::GetInstance()->SetLowMemoryCallback([lowMemory](const MemoryTracker::LowMemoryEvent &event) {
+        // Budgets are crossed on any thread allocating memory, the event is handed over to the JS thread
+        MemoryTracker::LowMemoryEvent *data = new MemoryTracker::LowMemoryEvent(event);
+        if (napi_ok != napi_call_threadsafe_function(lowMemory, data, napi_tsfn_nonblocking)) {
+            delete data;
+        }
+    });
     return nullptr;
 }
 
@@ -319,23 +1079,56 @@ void PluginRender::Export(napi_env env, napi_value exports)
     napi_property_descriptor desc[] = {
         {"setUpscaleMethod", nullptr, PluginRender::SetUpscaleMethod, nullptr, nullptr, nullptr, napi_default, nullptr},
         {"setVRSUsed", nullptr, PluginRender::SetVRSUsed, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"setVRSPasses", nullptr, PluginRender::SetVRSPasses, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"setDebugOverlay", nullptr, PluginRender::SetDebugOverlay, nullptr, nullptr, nullptr, napi_default, nullptr},
         {"saveShadingRateImage", nullptr, PluginRender::SaveShadingRateImage, nullptr, nullptr, nullptr, napi_default, nullptr},
-        {"setLoadShadingImage", nullptr, PluginRender::SetLoadShadingImage, nullptr, nullptr, nullptr, napi_default, nullptr}};
+        {"setLoadShadingImage", nullptr, PluginRender::SetLoadShadingImage, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"runQualityBenchmark", nullptr, PluginRender::RunQualityBenchmark, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"getShadingRateStats", nullptr, PluginRender::GetShadingRateStats, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"setPresentMode", nullptr, PluginRender::SetPresentMode, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"setFrameRate", nullptr, PluginRender::SetFrameRate, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"dumpTrace", nullptr, PluginRender::DumpTrace, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"getMemoryStats", nullptr, PluginRender::GetMemoryStats, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"setMemoryBudget", nullptr, PluginRender::SetMemoryBudget, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"onLowMemory", nullptr, PluginRender::OnLowMemory, nullptr, nullptr, nullptr, napi_default, nullptr}};
 
     if (napi_ok != napi_define_properties(env, exports, sizeof(desc) / sizeof(desc[0]), desc)) {
         LOGE("PluginRender Export: napi_define_properties failed");
     }
+
+    if (m_completion != nullptr) {
+        return;
+    }
+    m_env = env;
+    napi_value resourceName;
+    napi_create_string_utf8(env, "PluginRenderCommand", NAPI_AUTO_LENGTH, &resourceName);
+    if (napi_ok != napi_create_threadsafe_function(env, nullptr, nullptr, resourceName, 0, 1, nullptr, nullptr,
+        nullptr, PluginRender::CompleteCommand, &m_completion)) {
+        // Commands still work, they just do not report back
+        LOGE("PluginRender Export: napi_create_threadsafe_function failed");
+        m_completion = nullptr;
+        return;
+    }
+    // Pending completions must not keep the app alive
+    napi_unref_threadsafe_function(env, m_completion);
 }
 
 void PluginRender::Release(std::string &id)
 {
-    LOGE("PluginRender start release");
-    PluginRender *render = PluginRender::GetInstance(id);
-    if (render != nullptr) {
-        std::unique_lock<std::mutex> locker(m_mutex);
-        stop = true;
-        m_con.notify_all();
-        m_instance.erase(m_instance.find(id));
-        delete render->m_vulkanexample;
+    LOGI("PluginRender release %{public}s", id.c_str());
+    auto iter = m_instance.find(id);
+    if (iter == m_instance.end()) {
+        return;
+    }
+    PluginRender *render = iter->second;
+    // Waits for the frame in progress of this instance only, the other surfaces keep rendering
+    render->m_stop = true;
+    if (render->m_renderThread.joinable()) {
+        render->m_renderThread.join();
     }
+    render->RejectCommands("render surface destroyed");
+    // The instance stays registered with PluginManager together with its exports and callbacks, a surface created
+    // again for the same XComponent renders through it with a new example
+    delete render->m_vulkanexample;
+    render->m_vulkanexample = nullptr;
 }
\ No newline at end of file
@@ -14,16 +14,43 @@
  */
 #ifndef RENDER_PLUGIN_RENDER_H
 #define RENDER_PLUGIN_RENDER_H
+#include <atomic>
 #include <string>
 #include <unordered_map>
-#include <condition_variable>
 #include <ace/xcomponent/native_interface_xcomponent.h>
+#include <napi/native_api.h>
 #include <thread>
-#include <condition_variable>
+#include "common/spsc_queue.h"
 #include "model_3d_sponza.h"
 
+#define RENDER_COMMAND_QUEUE_SIZE 64
+#define TRACE_DUMP_PATH "/data/storage/el2/base/haps/entry/cache/trace.json"
+
 class PluginRender {
 public:
+    // Control plane request from ArkTS, applied on the render thread between two frames
+    struct Command {
+        enum Type : uint32_t {
+            SET_UPSCALE_METHOD = 0,
+            SET_VRS_USED,
+            SET_VRS_PASSES,
+            SET_DEBUG_OVERLAY,
+            SET_LOAD_SHADING_IMAGE,
+            SAVE_SHADING_RATE_IMAGE,
+            RUN_QUALITY_BENCHMARK,
+            SET_PRESENT_MODE,
+            SET_FRAME_RATE,
+            DUMP_TRACE, // Chrome trace of the recent frames to TRACE_DUMP_PATH
+            SURFACE_CHANGED, // posted by the XComponent callback, uintValue x intValue pixels, no promise
+        };
+        Type type = SET_UPSCALE_METHOD;
+        int32_t intValue = 0;
+        uint32_t uintValue = 0;
+        bool boolValue = false;
+        float floatValue = 0.0f;
+        napi_deferred deferred = nullptr; // resolved once the render thread applied the command
+    };
+
     explicit PluginRender(std::string &id);
     ~PluginRender() {}
     
@@ -31,23 +58,53 @@ public:
     static void Release(std::string &id);
     static napi_value SetUpscaleMethod(napi_env env, napi_callback_info info);
     static napi_value SetVRSUsed(napi_env env, napi_callback_info info);
+    static napi_value SetVRSPasses(napi_env env, napi_callback_info info);
+    static napi_value SetDebugOverlay(napi_env env, napi_callback_info info);
     static napi_value SaveShadingRateImage(napi_env env, napi_callback_info info);
     static napi_value SetLoadShadingImage(napi_env env, napi_callback_info info);
+    static napi_value RunQualityBenchmark(napi_env env, napi_callback_info info);
+    static napi_value GetShadingRateStats(napi_env env, napi_callback_info info);
+    static napi_value SetPresentMode(napi_env env, napi_callback_info info);
+    static napi_value SetFrameRate(napi_env env, napi_callback_info info);
+    static napi_value DumpTrace(napi_env env, napi_callback_info info);
+    // Device memory of the process, see MemoryTracker. Not queued, the tracker is thread safe.
+    static napi_value GetMemoryStats(napi_env env, napi_callback_info info);
+    static napi_value SetMemoryBudget(napi_env env, napi_callback_info info);
+    static napi_value OnLowMemory(napi_env env, napi_callback_info info);
     static std::unordered_map<std::string, PluginRender *> m_instance;
     static OH_NativeXComponent_Callback m_callback;
-    static std::mutex m_mutex;
-    static std::condition_variable m_con;
-    static bool stop;
     
     void Export(napi_env env, napi_value exports);
-    void SetMode(int mode);
+    // JS thread only, returns a promise for the completion of the command
+    napi_value PostCommand(napi_env env, Command &command);
     void RenderThread();
     void RenderCreated(OH_NativeXComponent *component, void *window);
+    // Rotation and split screen, the render thread resizes the swapchain and the offscreen targets
+    void RenderChanged(OH_NativeXComponent *component, void *window);
     
     std::string m_id;
     void *m_window;
-    int m_mode = 0;
+    // Null between Release and the next surface. Every instance renders on its own thread, the examples share the
+    // Vulkan device and the pipeline cache, see VulkanExampleBase::initVulkan.
     VulkanExample *m_vulkanexample;
     std::thread m_renderThread;
+    std::atomic<bool> m_stop{false}; // ends the render loop of this instance
+
+private:
+    void ExecuteCommands();
+    void RejectCommands(const char *reason);
+    static void CompleteCommand(napi_env env, napi_value jsCallback, void *context, void *data);
+    static void CallLowMemory(napi_env env, napi_value jsCallback, void *context, void *data);
+    void ReleaseLowMemory();
+
+    // Filled by the JS thread and drained by the render thread at frame boundaries, so control plane calls neither
+    // wait for a frame nor change state a frame is using
+    SpscQueue<Command, RENDER_COMMAND_QUEUE_SIZE> m_commands;
+    napi_threadsafe_function m_completion = nullptr;
+    // Calls the onLowMemory callback on the JS thread with a MemoryTracker::LowMemoryEvent
+    napi_threadsafe_function m_lowMemory = nullptr;
+    // Instance whose onLowMemory callback the MemoryTracker calls, JS thread only
+    static PluginRender *m_lowMemoryOwner;
+    napi_env m_env = nullptr;
 };
 #endif // RENDER_PLUGIN_RENDER_H
\ No newline at end of file
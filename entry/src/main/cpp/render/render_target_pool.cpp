@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "render_target_pool.h"
+#include <algorithm>
+#include <numeric>
+#include "VulkanTools.h"
+#include "common/common.h"
+
+RenderTargetPool::~RenderTargetPool()
+{
+    if (m_device == VK_NULL_HANDLE) {
+        return;
+    }
+    if (!m_used.empty()) {
+        LOGW("RenderTargetPool destroyed with %{public}zu targets in use", m_used.size());
+    }
+    for (auto &used : m_used) {
+        vkFreeMemory(m_device, used.second.memory, nullptr);
+    }
+    for (auto &block : m_free) {
+        vkFreeMemory(m_device, block.memory, nullptr);
+    }
+}
+
+void RenderTargetPool::Init(vks::VulkanDevice *vulkanDevice)
+{
+    m_vulkanDevice = vulkanDevice;
+    m_device = vulkanDevice->logicalDevice;
+}
+
+uint32_t RenderTargetPool::GetBucket(uint32_t extent)
+{
+    return std::max<uint32_t>(1, (extent + RENDER_TARGET_BUCKET_SIZE - 1) / RENDER_TARGET_BUCKET_SIZE) *
+        RENDER_TARGET_BUCKET_SIZE;
+}
+
+bool RenderTargetPool::AllocateBlock(const VkImageCreateInfo &imageInfo, const Key &key,
+    const VkMemoryRequirements &memReqs, Block &block)
+{
+    // Size the memory for the largest extent of the bucket with a probe image, requirements grow with the extent
+    VkImageCreateInfo probeInfo = imageInfo;
+    probeInfo.extent.width = key.width;
+    probeInfo.extent.height = key.height;
+    VkMemoryRequirements probeReqs = memReqs;
+    VkImage probe = VK_NULL_HANDLE;
+    if (vkCreateImage(m_device, &probeInfo, nullptr, &probe) == VK_SUCCESS) {
+        vkGetImageMemoryRequirements(m_device, probe, &probeReqs);
+        vkDestroyImage(m_device, probe, nullptr);
+    }
+    uint32_t typeBits = memReqs.memoryTypeBits & probeReqs.memoryTypeBits;
+    if (typeBits == 0) {
+        typeBits = memReqs.memoryTypeBits;
+        probeReqs.size = memReqs.size;
+    }
+    if (!AllocateMemory(std::max(memReqs.size, probeReqs.size), typeBits, block)) {
+        return false;
+    }
+    block.key = key;
+    return true;
+}
+
+bool RenderTargetPool::AllocateMemory(VkDeviceSize size, uint32_t typeBits, Block &block)
+{
+    VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+    memAlloc.allocationSize = size;
+    memAlloc.memoryTypeIndex = m_vulkanDevice->getMemoryType(typeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VkResult res = vkAllocateMemory(m_device, &memAlloc, nullptr, &block.memory);
+    if (res != VK_SUCCESS) {
+        // Released memory of other buckets may be what is missing
+        Trim(0);
+        res = vkAllocateMemory(m_device, &memAlloc, nullptr, &block.memory);
+    }
+    if (res != VK_SUCCESS) {
+        LOGE("RenderTargetPool allocate %{public}llu bytes failed, result: %{public}d",
+            static_cast<unsigned long long>(memAlloc.allocationSize), res);
+        block.memory = VK_NULL_HANDLE;
+        return false;
+    }
+    block.size = memAlloc.allocationSize;
+    block.memoryTypeIndex = memAlloc.memoryTypeIndex;
+    block.users = 1;
+    block.aliasedBytes = 0;
+    m_stats.allocations++;
+    return true;
+}
+
+bool RenderTargetPool::TakeFreeBlock(const Key &key, VkDeviceSize size, uint32_t typeBits, Block &block)
+{
+    // Most recently released first, the one least likely to be trimmed next
+    auto found = std::find_if(m_free.rbegin(), m_free.rend(), [&key, size, typeBits](const Block &candidate) {
+        return candidate.key == key && candidate.size >= size && (typeBits & (1u << candidate.memoryTypeIndex)) != 0;
+    });
+    if (found == m_free.rend()) {
+        return false;
+    }
+    block = *found;
+    block.users = 1;
+    block.aliasedBytes = 0;
+    m_free.erase(std::next(found).base());
+    m_stats.reuses++;
+    return true;
+}
+
+bool RenderTargetPool::Acquire(const VkImageCreateInfo &imageInfo, VkImageAspectFlags aspectMask, VkImage &image,
+    VkImageView &view, VkDeviceMemory &memory)
+{
+    image = VK_NULL_HANDLE;
+    view = VK_NULL_HANDLE;
+    memory = VK_NULL_HANDLE;
+    VkResult res = vkCreateImage(m_device, &imageInfo, nullptr, &image);
+    if (res != VK_SUCCESS) {
+        LOGE("RenderTargetPool create %{public}ux%{public}u image failed, result: %{public}d",
+            imageInfo.extent.width, imageInfo.extent.height, res);
+        image = VK_NULL_HANDLE;
+        return false;
+    }
+    VkMemoryRequirements memReqs;
+    vkGetImageMemoryRequirements(m_device, image, &memReqs);
+
+    Key key = {imageInfo.format, imageInfo.usage, imageInfo.flags, GetBucket(imageInfo.extent.width),
+        GetBucket(imageInfo.extent.height)};
+    Block block;
+    if (!TakeFreeBlock(key, memReqs.size, memReqs.memoryTypeBits, block) &&
+        !AllocateBlock(imageInfo, key, memReqs, block)) {
+        vkDestroyImage(m_device, image, nullptr);
+        image = VK_NULL_HANDLE;
+        return false;
+    }
+    // Offset 0 satisfies every alignment
+    VK_CHECK_RESULT(vkBindImageMemory(m_device, image, block.memory, 0));
+
+    VkImageViewCreateInfo viewInfo = vks::initializers::imageViewCreateInfo();
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = imageInfo.format;
+    viewInfo.subresourceRange = {aspectMask, 0, 1, 0, 1};
+    viewInfo.image = image;
+    VK_CHECK_RESULT(vkCreateImageView(m_device, &viewInfo, nullptr, &view));
+
+    memory = block.memory;
+    m_used[memory] = block;
+    return true;
+}
+
+bool RenderTargetPool::AcquireAliased(std::vector<AliasedTarget> &targets)
+{
+    struct Slot {
+        uint32_t lifetime;
+        VkDeviceSize size;
+        VkDeviceSize requested;
+        uint32_t typeBits;
+        std::vector<size_t> users;
+    };
+    std::vector<VkMemoryRequirements> memReqs(targets.size());
+    bool created = true;
+    for (size_t i = 0; i < targets.size() && created; i++) {
+        AliasedTarget &target = targets[i];
+        VkResult res = vkCreateImage(m_device, &target.imageInfo, nullptr, &target.image);
+        if (res != VK_SUCCESS) {
+            LOGE("RenderTargetPool create aliased %{public}ux%{public}u image failed, result: %{public}d",
+                target.imageInfo.extent.width, target.imageInfo.extent.height, res);
+            target.image = VK_NULL_HANDLE;
+            created = false;
+            break;
+        }
+        vkGetImageMemoryRequirements(m_device, target.image, &memReqs[i]);
+    }
+
+    // Largest first, so the memory of a slot is sized by its first user in most cases
+    std::vector<size_t> order(targets.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&memReqs](size_t a, size_t b) {
+        return memReqs[a].size > memReqs[b].size;
+    });
+    std::vector<Slot> slots;
+    for (size_t i = 0; i < order.size() && created; i++) {
+        size_t index = order[i];
+        const VkMemoryRequirements &reqs = memReqs[index];
+        uint32_t lifetime = targets[index].lifetime;
+        auto slot = std::find_if(slots.begin(), slots.end(), [lifetime, &reqs](const Slot &candidate) {
+            return (candidate.lifetime & lifetime) == 0 && (candidate.typeBits & reqs.memoryTypeBits) != 0;
+        });
+        if (slot == slots.end()) {
+            slots.push_back({0, 0, 0, reqs.memoryTypeBits, {}});
+            slot = slots.end() - 1;
+        }
+        slot->lifetime |= lifetime;
+        slot->size = std::max(slot->size, reqs.size);
+        slot->requested += reqs.size;
+        slot->typeBits &= reqs.memoryTypeBits;
+        slot->users.push_back(index);
+    }
+
+    for (size_t i = 0; i < slots.size() && created; i++) {
+        Slot &slot = slots[i];
+        // Sized in granules, small resizes find the memory of the last size again
+        VkDeviceSize granules = (slot.size + RENDER_TARGET_ALIAS_GRANULARITY - 1) / RENDER_TARGET_ALIAS_GRANULARITY;
+        Key key = {VK_FORMAT_UNDEFINED, 0, 0, static_cast<uint32_t>(granules), 0};
+        VkDeviceSize size = granules * RENDER_TARGET_ALIAS_GRANULARITY;
+        Block block;
+        if (!TakeFreeBlock(key, size, slot.typeBits, block) && !AllocateMemory(size, slot.typeBits, block)) {
+            created = false;
+            break;
+        }
+        block.key = key;
+        block.users = static_cast<uint32_t>(slot.users.size());
+        block.aliasedBytes = slot.requested > block.size ? slot.requested - block.size : 0;
+        m_used[block.memory] = block;
+        for (size_t index : slot.users) {
+            AliasedTarget &target = targets[index];
+            VK_CHECK_RESULT(vkBindImageMemory(m_device, target.image, block.memory, 0));
+            target.memory = block.memory;
+            VkImageViewCreateInfo viewInfo = vks::initializers::imageViewCreateInfo();
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = target.imageInfo.format;
+            viewInfo.subresourceRange = {target.aspectMask, 0, 1, 0, 1};
+            viewInfo.image = target.image;
+            VK_CHECK_RESULT(vkCreateImageView(m_device, &viewInfo, nullptr, &target.view));
+        }
+    }
+    if (created) {
+        return true;
+    }
+    for (auto &target : targets) {
+        if (target.memory != VK_NULL_HANDLE) {
+            Release(target.image, target.view, target.memory);
+        } else if (target.image != VK_NULL_HANDLE) {
+            vkDestroyImage(m_device, target.image, nullptr);
+            target.image = VK_NULL_HANDLE;
+        }
+    }
+    return false;
+}
+
+void RenderTargetPool::Release(VkImage &image, VkImageView &view, VkDeviceMemory &memory)
+{
+    if (view != VK_NULL_HANDLE) {
+        vkDestroyImageView(m_device, view, nullptr);
+    }
+    if (image != VK_NULL_HANDLE) {
+        vkDestroyImage(m_device, image, nullptr);
+    }
+    auto used = m_used.find(memory);
+    if (used != m_used.end()) {
+        // Aliased memory stays in use until its last target is released
+        if (--used->second.users == 0) {
+            m_free.push_back(used->second);
+            m_used.erase(used);
+        }
+    } else if (memory != VK_NULL_HANDLE) {
+        LOGE("RenderTargetPool released memory it does not own");
+    }
+    image = VK_NULL_HANDLE;
+    view = VK_NULL_HANDLE;
+    memory = VK_NULL_HANDLE;
+}
+
+void RenderTargetPool::Trim(VkDeviceSize maxFreeBytes)
+{
+    VkDeviceSize freeBytes = 0;
+    for (auto &block : m_free) {
+        freeBytes += block.size;
+    }
+    auto it = m_free.begin();
+    while (it != m_free.end() && freeBytes > maxFreeBytes) {
+        vkFreeMemory(m_device, it->memory, nullptr);
+        freeBytes -= it->size;
+        it++;
+    }
+    m_free.erase(m_free.begin(), it);
+}
+
+void RenderTargetPool::GetStats(Stats &stats) const
+{
+    stats = m_stats;
+    stats.usedBytes = 0;
+    stats.freeBytes = 0;
+    stats.aliasedBytes = 0;
+    for (auto &used : m_used) {
+        stats.usedBytes += used.second.size;
+        stats.aliasedBytes += used.second.aliasedBytes;
+    }
+    for (auto &block : m_free) {
+        stats.freeBytes += block.size;
+    }
+}
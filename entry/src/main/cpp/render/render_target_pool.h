@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RENDER_RENDER_TARGET_POOL_H
+#define RENDER_RENDER_TARGET_POOL_H
+
+#include <map>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+
+#define RENDER_TARGET_BUCKET_SIZE 128 // pixels, extents are rounded up to a multiple of this to size the memory
+#define RENDER_TARGET_MAX_FREE_BYTES (64 * 1024 * 1024) // released memory kept after a resize, see Trim
+#define RENDER_TARGET_ALIAS_GRANULARITY (1024 * 1024) // bytes, sizes the memory shared by aliased targets
+
+// Device local memory of the size dependent render targets, recycled across resizes.
+// Targets are keyed by (format, usage, flags, extent bucket). The memory of a new bucket is sized for the largest
+// extent of the bucket, so a target released by a resize is rebound to the next target of the same bucket and
+// small resizes (split screen drags) or rotating back and forth create images and views only. Images and views are
+// always created at the exact extent, full screen passes sample them edge to edge.
+// Released memory is kept until Trim, a resize releases every target, acquires the new ones and trims afterwards.
+// Targets that are never live at the same time can share memory, see AcquireAliased.
+// Not thread safe, the caller makes sure the GPU is done with a target before releasing it.
+class RenderTargetPool {
+public:
+    struct Stats {
+        VkDeviceSize usedBytes = 0;
+        VkDeviceSize freeBytes = 0;
+        uint32_t allocations = 0; // vkAllocateMemory calls since Init
+        uint32_t reuses = 0;      // targets bound to released memory since Init
+        VkDeviceSize aliasedBytes = 0; // saved by the targets in use sharing memory
+    };
+
+    struct AliasedTarget {
+        VkImageCreateInfo imageInfo;
+        VkImageAspectFlags aspectMask;
+        // Bit per phase of the frame the target is written or read in, including the phases its content has to
+        // survive. Targets without a common bit share memory.
+        uint32_t lifetime;
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+    };
+
+    RenderTargetPool() {}
+    ~RenderTargetPool();
+
+    void Init(vks::VulkanDevice *vulkanDevice);
+
+    // Creates a single mip, single layer 2D image of imageInfo and a view of it. Returns false and leaves the
+    // handles null when the image can not be created.
+    bool Acquire(const VkImageCreateInfo &imageInfo, VkImageAspectFlags aspectMask, VkImage &image,
+        VkImageView &view, VkDeviceMemory &memory);
+    // Creates the targets and places them largest first into the first memory none of its users is live in
+    // together with them, the memory is as large as its largest user. Every target is bound at offset 0, its
+    // content and layout are undefined whenever another user of the memory ran since, a user must start from
+    // VK_IMAGE_LAYOUT_UNDEFINED and write before reading. Released like Acquire targets. On failure every target
+    // created here is released again.
+    bool AcquireAliased(std::vector<AliasedTarget> &targets);
+    // Destroys the image and its view and keeps the memory for the bucket once no aliased target uses it any
+    // more, the handles are reset
+    void Release(VkImage &image, VkImageView &view, VkDeviceMemory &memory);
+    // Frees released memory, oldest first, until at most maxFreeBytes are kept
+    void Trim(VkDeviceSize maxFreeBytes);
+    void GetStats(Stats &stats) const;
+
+private:
+    struct Key {
+        VkFormat format;
+        VkImageUsageFlags usage;
+        VkImageCreateFlags flags;
+        uint32_t width;  // bucket
+        uint32_t height;
+        bool operator==(const Key &other) const
+        {
+            return format == other.format && usage == other.usage && flags == other.flags &&
+                width == other.width && height == other.height;
+        }
+    };
+    struct Block {
+        Key key;
+        VkDeviceMemory memory;
+        VkDeviceSize size;
+        uint32_t memoryTypeIndex;
+        uint32_t users = 1;
+        VkDeviceSize aliasedBytes = 0; // requirements of the users beyond the size
+    };
+
+    static uint32_t GetBucket(uint32_t extent);
+    bool AllocateBlock(const VkImageCreateInfo &imageInfo, const Key &key, const VkMemoryRequirements &memReqs,
+        Block &block);
+    bool AllocateMemory(VkDeviceSize size, uint32_t typeBits, Block &block);
+    bool TakeFreeBlock(const Key &key, VkDeviceSize size, uint32_t typeBits, Block &block);
+
+    vks::VulkanDevice *m_vulkanDevice = nullptr;
+    VkDevice m_device = VK_NULL_HANDLE;
+    std::map<VkDeviceMemory, Block> m_used;
+    std::vector<Block> m_free; // in release order
+    Stats m_stats;
+};
+#endif // RENDER_RENDER_TARGET_POOL_H
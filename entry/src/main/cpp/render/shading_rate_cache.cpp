@@ -0,0 +1,318 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "shading_rate_cache.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include "common/common.h"
+#include "file/file.h"
+
+namespace {
+constexpr uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+constexpr uint64_t FNV_PRIME = 0x100000001b3ULL;
+constexpr size_t RLE_MAX_RUN = 255;
+constexpr uint32_t MAX_ENTRY_RAW_SIZE = 16 * 1024 * 1024;
+
+struct FileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+};
+
+struct EntryHeader {
+    uint32_t width;
+    uint32_t height;
+    uint32_t tileSize;
+    uint32_t format;
+    uint64_t sceneHash;
+    int32_t pose[5];
+    uint32_t rawSize;
+    uint32_t packedSize;
+};
+
+// Resample indexes the rates with the dimensions, they must describe rawSize exactly
+bool ValidEntryHeader(const EntryHeader &entryHeader)
+{
+    if (entryHeader.width == 0 || entryHeader.height == 0 || entryHeader.width > SHADING_RATE_CACHE_MAX_EXTENT ||
+        entryHeader.height > SHADING_RATE_CACHE_MAX_EXTENT) {
+        return false;
+    }
+    uint64_t pixels = static_cast<uint64_t>(entryHeader.width) * entryHeader.height;
+    return entryHeader.rawSize <= MAX_ENTRY_RAW_SIZE && entryHeader.rawSize == pixels &&
+        static_cast<uint64_t>(entryHeader.packedSize) <= static_cast<uint64_t>(entryHeader.rawSize) * 2;
+}
+
+int32_t Bucket(float value, float step)
+{
+    return static_cast<int32_t>(std::floor(value / step));
+}
+}
+
+void ShadingRateCache::QuantizePose(const float position[3], const float rotation[3], int32_t pose[5])
+{
+    for (int i = 0; i < 3; i++) {
+        pose[i] = Bucket(position[i], SHADING_RATE_POSE_POSITION_STEP);
+    }
+    // Shift by half a step so the bucket is centred on the angle, and wrap yaw into [0, 360)
+    float pitch = rotation[0] + SHADING_RATE_POSE_ANGLE_STEP * 0.5f;
+    float yaw = std::fmod(rotation[1] + SHADING_RATE_POSE_ANGLE_STEP * 0.5f, 360.0f);
+    if (yaw < 0.0f) {
+        yaw += 360.0f;
+    }
+    pose[3] = Bucket(pitch, SHADING_RATE_POSE_ANGLE_STEP);
+    pose[4] = Bucket(yaw, SHADING_RATE_POSE_ANGLE_STEP);
+}
+
+uint64_t ShadingRateCache::HashScene(const std::string &identity, uint64_t salt)
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (char c : identity) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * FNV_PRIME;
+    }
+    for (int i = 0; i < 8; i++) {
+        hash = (hash ^ ((salt >> (i * 8)) & 0xff)) * FNV_PRIME;
+    }
+    return hash;
+}
+
+void ShadingRateCache::Compress(const std::vector<uint8_t> &raw, std::vector<uint8_t> &packed)
+{
+    // (run length, value) pairs, flat regions of the image collapse to a couple of bytes per row
+    packed.clear();
+    size_t i = 0;
+    while (i < raw.size()) {
+        uint8_t value = raw[i];
+        size_t run = 1;
+        while (i + run < raw.size() && raw[i + run] == value && run < RLE_MAX_RUN) {
+            run++;
+        }
+        packed.push_back(static_cast<uint8_t>(run));
+        packed.push_back(value);
+        i += run;
+    }
+}
+
+bool ShadingRateCache::Decompress(const std::vector<uint8_t> &packed, size_t rawSize, std::vector<uint8_t> &raw)
+{
+    if (packed.size() % 2 != 0) {
+        return false;
+    }
+    raw.clear();
+    raw.reserve(rawSize);
+    for (size_t i = 0; i < packed.size(); i += 2) {
+        size_t run = packed[i];
+        if (run == 0 || raw.size() + run > rawSize) {
+            return false;
+        }
+        raw.insert(raw.end(), run, packed[i + 1]);
+    }
+    return raw.size() == rawSize;
+}
+
+bool ShadingRateCache::Load(const std::string &filePath)
+{
+    File file;
+    if (!file.Open(filePath, File::FILE_READ)) {
+        LOGE("ShadingRateCache Load: failed to open %{public}s", filePath.c_str());
+        return false;
+    }
+    FileHeader header;
+    if (file.Read(&header, sizeof(header)) != sizeof(header)) {
+        LOGE("ShadingRateCache Load: failed to read header");
+        file.Close();
+        return false;
+    }
+    if (header.magic != SHADING_RATE_CACHE_MAGIC || header.version != SHADING_RATE_CACHE_VERSION) {
+        LOGW("ShadingRateCache Load: unsupported cache version %{public}u, ignoring file", header.version);
+        file.Close();
+        return false;
+    }
+
+    std::vector<Entry> entries;
+    for (uint32_t i = 0; i < header.entryCount && i < SHADING_RATE_CACHE_MAX_ENTRIES; i++) {
+        EntryHeader entryHeader;
+        if (file.Read(&entryHeader, sizeof(entryHeader)) != sizeof(entryHeader) ||
+            !ValidEntryHeader(entryHeader)) {
+            LOGE("ShadingRateCache Load: corrupt entry %{public}u", i);
+            file.Close();
+            return false;
+        }
+        Entry entry;
+        entry.key.width = entryHeader.width;
+        entry.key.height = entryHeader.height;
+        entry.key.tileSize = entryHeader.tileSize;
+        entry.key.format = entryHeader.format;
+        entry.key.sceneHash = entryHeader.sceneHash;
+        for (int j = 0; j < 5; j++) {
+            entry.key.pose[j] = entryHeader.pose[j];
+        }
+        entry.rawSize = entryHeader.rawSize;
+        entry.packed.resize(entryHeader.packedSize);
+        if (file.Read(entry.packed.data(), entry.packed.size()) != entry.packed.size()) {
+            LOGE("ShadingRateCache Load: truncated entry %{public}u", i);
+            file.Close();
+            return false;
+        }
+        entries.push_back(std::move(entry));
+    }
+    file.Close();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries = std::move(entries);
+    LOGI("ShadingRateCache Load: %{public}zu entries", m_entries.size());
+    return true;
+}
+
+bool ShadingRateCache::Save(const std::string &filePath) const
+{
+    // Write next to the target and rename, a crash mid-write leaves the previous cache intact
+    std::string tmpPath = filePath + ".tmp";
+    File file;
+    if (!file.Open(tmpPath, File::FILE_CREATE) || !file.Truncate(0)) {
+        LOGE("ShadingRateCache Save: failed to create %{public}s", tmpPath.c_str());
+        return false;
+    }
+    bool written = true;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        FileHeader header = {SHADING_RATE_CACHE_MAGIC, SHADING_RATE_CACHE_VERSION,
+            static_cast<uint32_t>(m_entries.size())};
+        written = file.Write(&header, sizeof(header)) == sizeof(header);
+        for (size_t i = 0; written && i < m_entries.size(); i++) {
+            const Entry &entry = m_entries[i];
+            EntryHeader entryHeader = {entry.key.width, entry.key.height, entry.key.tileSize, entry.key.format,
+                entry.key.sceneHash, {entry.key.pose[0], entry.key.pose[1], entry.key.pose[2], entry.key.pose[3],
+                entry.key.pose[4]}, entry.rawSize, static_cast<uint32_t>(entry.packed.size())};
+            written = file.Write(&entryHeader, sizeof(entryHeader)) == sizeof(entryHeader) &&
+                file.Write(entry.packed.data(), entry.packed.size()) == entry.packed.size();
+        }
+    }
+    written = written && file.Sync() == 0;
+    file.Close();
+    if (!written || !File::Move(tmpPath, filePath)) {
+        LOGE("ShadingRateCache Save: failed to write %{public}s", filePath.c_str());
+        File::Remove(tmpPath);
+        return false;
+    }
+    return true;
+}
+
+void ShadingRateCache::Store(const Key &key, const std::vector<uint8_t> &rates)
+{
+    // Load rejects the whole file over such an entry
+    if (key.width == 0 || key.height == 0 || key.width > SHADING_RATE_CACHE_MAX_EXTENT ||
+        key.height > SHADING_RATE_CACHE_MAX_EXTENT || rates.size() > MAX_ENTRY_RAW_SIZE ||
+        rates.size() != static_cast<size_t>(key.width) * key.height) {
+        LOGE("ShadingRateCache Store: %{public}zu bytes for a %{public}ux%{public}u image", rates.size(), key.width,
+            key.height);
+        return;
+    }
+    Entry entry;
+    entry.key = key;
+    entry.rawSize = static_cast<uint32_t>(rates.size());
+    Compress(rates, entry.packed);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+        if (SameKey(it->key, key)) {
+            m_entries.erase(it);
+            break;
+        }
+    }
+    if (m_entries.size() >= SHADING_RATE_CACHE_MAX_ENTRIES) {
+        m_entries.erase(m_entries.begin());
+    }
+    m_entries.push_back(std::move(entry));
+}
+
+bool ShadingRateCache::Find(const Key &query, std::vector<uint8_t> &rates) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // Nearest pose wins, an entry of the requested size breaks ties so resampling is the exception
+    const Entry *best = nullptr;
+    uint32_t bestDistance = std::numeric_limits<uint32_t>::max();
+    bool bestExactSize = false;
+    for (const auto &entry : m_entries) {
+        if (entry.key.sceneHash != query.sceneHash || entry.key.tileSize != query.tileSize ||
+            entry.key.format != query.format) {
+            continue;
+        }
+        uint32_t distance = PoseDistance(entry.key.pose, query.pose);
+        bool exactSize = entry.key.width == query.width && entry.key.height == query.height;
+        if (distance < bestDistance || (distance == bestDistance && exactSize && !bestExactSize)) {
+            best = &entry;
+            bestDistance = distance;
+            bestExactSize = exactSize;
+        }
+    }
+    if (best == nullptr) {
+        return false;
+    }
+    std::vector<uint8_t> raw;
+    if (!Decompress(best->packed, best->rawSize, raw)) {
+        LOGE("ShadingRateCache Find: corrupt entry");
+        return false;
+    }
+    if (bestExactSize) {
+        rates = std::move(raw);
+    } else {
+        Resample(raw, best->key.width, best->key.height, rates, query.width, query.height);
+    }
+    return true;
+}
+
+size_t ShadingRateCache::GetEntryCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.size();
+}
+
+bool ShadingRateCache::SameKey(const Key &a, const Key &b)
+{
+    if (a.width != b.width || a.height != b.height || a.tileSize != b.tileSize || a.format != b.format ||
+        a.sceneHash != b.sceneHash) {
+        return false;
+    }
+    return PoseDistance(a.pose, b.pose) == 0;
+}
+
+uint32_t ShadingRateCache::PoseDistance(const int32_t a[5], const int32_t b[5])
+{
+    uint32_t distance = 0;
+    for (int i = 0; i < 4; i++) {
+        distance += static_cast<uint32_t>(std::abs(a[i] - b[i]));
+    }
+    // Yaw wraps around
+    const int32_t yawBuckets = static_cast<int32_t>(360.0f / SHADING_RATE_POSE_ANGLE_STEP);
+    int32_t yaw = std::abs(a[4] - b[4]) % yawBuckets;
+    distance += static_cast<uint32_t>(std::min(yaw, yawBuckets - yaw));
+    return distance;
+}
+
+void ShadingRateCache::Resample(const std::vector<uint8_t> &src, uint32_t srcWidth, uint32_t srcHeight,
+    std::vector<uint8_t> &dst, uint32_t dstWidth, uint32_t dstHeight)
+{
+    // Nearest neighbour, rates are enums and must not be blended
+    dst.resize(static_cast<size_t>(dstWidth) * dstHeight);
+    for (uint32_t y = 0; y < dstHeight; y++) {
+        uint32_t sy = static_cast<uint32_t>((static_cast<uint64_t>(y) * 2 + 1) * srcHeight / (dstHeight * 2ULL));
+        for (uint32_t x = 0; x < dstWidth; x++) {
+            uint32_t sx = static_cast<uint32_t>((static_cast<uint64_t>(x) * 2 + 1) * srcWidth / (dstWidth * 2ULL));
+            dst[static_cast<size_t>(y) * dstWidth + x] = src[static_cast<size_t>(sy) * srcWidth + sx];
+        }
+    }
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RENDER_SHADING_RATE_CACHE_H
+#define RENDER_SHADING_RATE_CACHE_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define SHADING_RATE_CACHE_MAGIC 0x43495253 // "SRIC"
+#define SHADING_RATE_CACHE_VERSION 1
+#define SHADING_RATE_CACHE_MAX_ENTRIES 64
+#define SHADING_RATE_CACHE_MAX_EXTENT 16384 // texels per side, a shading rate image never exceeds maxFramebufferWidth
+#define SHADING_RATE_POSE_POSITION_STEP 2.0f // meters per position bucket
+#define SHADING_RATE_POSE_ANGLE_STEP 45.0f   // degrees per yaw/pitch bucket
+
+// Persistent store of precomputed shading rate images.
+// Entries are keyed by shading rate image size, tile size, format, scene hash and a quantized camera pose, and the
+// rates are RLE compressed since neighbouring tiles mostly share a rate. Find returns the entry with the nearest pose
+// and resamples it when no entry of the requested size exists. Thread safe.
+class ShadingRateCache {
+public:
+    struct Key {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t tileSize = 0;
+        uint32_t format = 0;
+        uint64_t sceneHash = 0;
+        int32_t pose[5] = {0, 0, 0, 0, 0}; // position x, y, z, pitch, yaw buckets
+    };
+
+    static void QuantizePose(const float position[3], const float rotation[3], int32_t pose[5]);
+    static uint64_t HashScene(const std::string &identity, uint64_t salt);
+    static void Compress(const std::vector<uint8_t> &raw, std::vector<uint8_t> &packed);
+    static bool Decompress(const std::vector<uint8_t> &packed, size_t rawSize, std::vector<uint8_t> &raw);
+
+    bool Load(const std::string &filePath);
+    bool Save(const std::string &filePath) const;
+
+    // Replaces the entry with the same key, the oldest entry is dropped once the store is full.
+    void Store(const Key &key, const std::vector<uint8_t> &rates);
+    bool Find(const Key &query, std::vector<uint8_t> &rates) const;
+    size_t GetEntryCount() const;
+
+private:
+    struct Entry {
+        Key key;
+        uint32_t rawSize = 0;
+        std::vector<uint8_t> packed;
+    };
+    static bool SameKey(const Key &a, const Key &b);
+    static uint32_t PoseDistance(const int32_t a[5], const int32_t b[5]);
+    static void Resample(const std::vector<uint8_t> &src, uint32_t srcWidth, uint32_t srcHeight,
+        std::vector<uint8_t> &dst, uint32_t dstWidth, uint32_t dstHeight);
+
+    mutable std::mutex m_mutex;
+    std::vector<Entry> m_entries;
+};
+#endif // RENDER_SHADING_RATE_CACHE_H
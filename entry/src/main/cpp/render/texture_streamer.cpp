@@ -0,0 +1,384 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "texture_streamer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include "stb_image.h"
+#include "vulkan_obj_model.h"
+#include "common/common.h"
+#include "common/trace.h"
+#include "file/file_operator.h"
+
+vkOBJ::TextureStreamer::~TextureStreamer()
+{
+    VkDevice device = m_model->m_device->logicalDevice;
+    for (auto &entry : m_entries) {
+        if (entry->job != nullptr) {
+            JobSystem::GetInstance()->Wait(entry->job);
+        }
+        if (entry->staged != nullptr) {
+            m_uploadManager->Wait(entry->uploadValue);
+            vkDestroyImage(device, entry->staged->image, nullptr);
+            vkFreeMemory(device, entry->staged->deviceMemory, nullptr);
+        }
+    }
+    ReleaseRetired(0, true);
+}
+
+uint32_t vkOBJ::TextureStreamer::GetTailMip(uint32_t width, uint32_t height)
+{
+    uint32_t mip = 0;
+    while (std::max(width >> mip, height >> mip) > STREAMING_TAIL_SIZE) {
+        mip++;
+    }
+    return mip;
+}
+
+unsigned char *vkOBJ::TextureStreamer::DecodeImage(const std::string &rawPath, int &width, int &height,
+    int &components, int desiredComponents)
+{
+    TRACE_SCOPE("DecodeImage");
+    // Decoded straight from the mapped asset, the compressed bytes are never copied
+    MappedFile file;
+    if (!FileOperator::GetInstance()->MapAsset(rawPath, file)) {
+        return nullptr;
+    }
+    return stbi_load_from_memory(file.Data(), static_cast<int>(file.Size()), &width, &height, &components,
+        desiredComponents);
+}
+
+void vkOBJ::TextureStreamer::Downsample(const unsigned char *pixels, uint32_t width, uint32_t height,
+    uint32_t texelSize, uint32_t levels, std::vector<unsigned char> &out)
+{
+    out.assign(pixels, pixels + static_cast<size_t>(width) * height * texelSize);
+    std::vector<unsigned char> level;
+    for (uint32_t i = 0; i < levels && (width > 1 || height > 1); i++) {
+        // Same extents as the mip chain of the image, odd edges drop their last texel like a blit would
+        uint32_t dstWidth = std::max(1u, width >> 1);
+        uint32_t dstHeight = std::max(1u, height >> 1);
+        level.resize(static_cast<size_t>(dstWidth) * dstHeight * texelSize);
+        for (uint32_t y = 0; y < dstHeight; y++) {
+            const unsigned char *row0 = out.data() + static_cast<size_t>(std::min(y * 2, height - 1)) * width *
+                texelSize;
+            const unsigned char *row1 = out.data() + static_cast<size_t>(std::min(y * 2 + 1, height - 1)) * width *
+                texelSize;
+            unsigned char *dst = level.data() + static_cast<size_t>(y) * dstWidth * texelSize;
+            for (uint32_t x = 0; x < dstWidth; x++) {
+                size_t x0 = static_cast<size_t>(std::min(x * 2, width - 1)) * texelSize;
+                size_t x1 = static_cast<size_t>(std::min(x * 2 + 1, width - 1)) * texelSize;
+                for (uint32_t c = 0; c < texelSize; c++) {
+                    uint32_t sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+                    dst[x * texelSize + c] = static_cast<unsigned char>((sum + 2) / 4);
+                }
+            }
+        }
+        out.swap(level);
+        width = dstWidth;
+        height = dstHeight;
+    }
+}
+
+void vkOBJ::TextureStreamer::AddTexture(const std::shared_ptr<Texture> &texture, const std::string &rawPath,
+    uint32_t width, uint32_t height, uint32_t residentMip)
+{
+    std::unique_ptr<Entry> entry(new Entry());
+    entry->texture = texture;
+    entry->path = rawPath;
+    entry->width = width;
+    entry->height = height;
+    entry->mipCount = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+    entry->tailMip = residentMip;
+    entry->residentMip = residentMip;
+    entry->wantedMip = residentMip;
+    entry->distance = FLT_MAX;
+    m_committedBytes += texture->memorySize;
+    m_entryMap[texture.get()] = entry.get();
+    m_entries.push_back(std::move(entry));
+}
+
+bool vkOBJ::TextureStreamer::Update(const StreamingView &view, uint64_t frameIndex)
+{
+    ReleaseRetired(frameIndex, false);
+    bool changed = CompleteUploads(frameIndex);
+    StartUploads();
+    UpdateWantedMips(view);
+    Schedule();
+    m_uploadManager->Flush();
+    return changed;
+}
+
+void vkOBJ::TextureStreamer::GetStats(StreamingStats &stats) const
+{
+    stats = StreamingStats();
+    stats.budgetBytes = m_budget;
+    stats.textureCount = static_cast<uint32_t>(m_entries.size());
+    stats.inFlight = m_inFlight;
+    for (auto &entry : m_entries) {
+        stats.residentBytes += entry->texture->memorySize;
+        if (entry->staged != nullptr) {
+            stats.residentBytes += entry->staged->memorySize;
+        }
+        if (entry->residentMip <= entry->wantedMip) {
+            stats.sharpCount++;
+        }
+    }
+}
+
+VkDeviceSize vkOBJ::TextureStreamer::EstimateBytes(const Entry &entry, uint32_t mip) const
+{
+    VkDeviceSize bytes = 0;
+    for (uint32_t level = mip; level < entry.mipCount; level++) {
+        bytes += static_cast<VkDeviceSize>(std::max(1u, entry.width >> level)) *
+            std::max(1u, entry.height >> level) * entry.texture->texelSize;
+    }
+    return bytes;
+}
+
+void vkOBJ::TextureStreamer::UpdateWantedMips(const StreamingView &view)
+{
+    for (auto &entry : m_entries) {
+        entry->wantedMip = entry->tailMip;
+        entry->distance = FLT_MAX;
+    }
+    for (auto &mesh : m_model->m_meshes) {
+        uint32_t material = mesh->GetMaterialIndex();
+        if (material >= m_model->m_textures.size() || mesh->GetUVDensity() <= 0.0f) {
+            continue;
+        }
+        float distance = std::max(glm::length(view.position - mesh->GetCenter()) - mesh->GetRadius(),
+            STREAMING_MIN_DISTANCE);
+        for (auto &texture : m_model->m_textures[material]) {
+            auto item = m_entryMap.find(texture.get());
+            if (item == m_entryMap.end()) {
+                continue;
+            }
+            Entry &entry = *item->second;
+            // Texels of mip 0 per screen pixel at the closest point of the mesh, every mip halves it
+            float texelsPerPixel = std::sqrt(static_cast<float>(entry.width) * entry.height) *
+                mesh->GetUVDensity() * distance / view.pixelsPerUnit;
+            uint32_t level = texelsPerPixel > 1.0f ? static_cast<uint32_t>(std::log2(texelsPerPixel)) : 0;
+            // The sampler clamps to LOD 1, so the top level of the image is never sampled
+            uint32_t mip = std::min(std::max(level, 1u) - 1, entry.tailMip);
+            entry.wantedMip = std::max(std::min(entry.wantedMip, mip), entry.minMip);
+            entry.distance = std::min(entry.distance, distance);
+        }
+    }
+}
+
+void vkOBJ::TextureStreamer::Schedule()
+{
+    std::vector<Entry *> upgrades;
+    std::vector<Entry *> evictions;
+    for (auto &entry : m_entries) {
+        if (entry->state != STATE_IDLE) {
+            continue;
+        }
+        if (entry->wantedMip < entry->residentMip) {
+            upgrades.push_back(entry.get());
+        } else if (entry->residentMip < entry->tailMip) {
+            evictions.push_back(entry.get());
+        }
+    }
+    // Blurriest first, then closest
+    std::sort(upgrades.begin(), upgrades.end(), [](const Entry *a, const Entry *b) {
+        uint32_t gapA = a->residentMip - a->wantedMip;
+        uint32_t gapB = b->residentMip - b->wantedMip;
+        return gapA != gapB ? gapA > gapB : a->distance < b->distance;
+    });
+    // Textures the view no longer needs at their level first, then farthest
+    std::sort(evictions.begin(), evictions.end(), [](const Entry *a, const Entry *b) {
+        bool unneededA = a->wantedMip > a->residentMip;
+        bool unneededB = b->wantedMip > b->residentMip;
+        return unneededA != unneededB ? unneededA : a->distance > b->distance;
+    });
+    size_t nextEviction = 0;
+    auto evict = [this, &evictions, &nextEviction](bool unneededOnly) {
+        if (nextEviction >= evictions.size()) {
+            return false;
+        }
+        Entry &entry = *evictions[nextEviction];
+        bool unneeded = entry.wantedMip > entry.residentMip;
+        if (unneededOnly && !unneeded) {
+            return false;
+        }
+        nextEviction++;
+        Request(entry, unneeded ? entry.wantedMip : entry.residentMip + 1);
+        return true;
+    };
+
+    // Over budget, e.g. after it was lowered
+    while (m_committedBytes > m_budget && m_inFlight < STREAMING_MAX_IN_FLIGHT && evict(false)) {
+    }
+    for (Entry *entry : upgrades) {
+        if (m_inFlight >= STREAMING_MAX_IN_FLIGHT) {
+            break;
+        }
+        VkDeviceSize bytes = EstimateBytes(*entry, entry->wantedMip);
+        if (m_committedBytes + bytes > m_budget + entry->texture->memorySize) {
+            // The upgrade is retried once the evictions made room, needed textures are not evicted for it
+            while (m_committedBytes + bytes > m_budget + entry->texture->memorySize &&
+                m_inFlight < STREAMING_MAX_IN_FLIGHT && evict(true)) {
+            }
+            break;
+        }
+        Request(*entry, entry->wantedMip);
+    }
+}
+
+void vkOBJ::TextureStreamer::Request(Entry &entry, uint32_t targetMip)
+{
+    // The budget is charged for the new image and credited for the current one right away, both exist until the
+    // swap but only the new one stays
+    entry.reservedBytes = EstimateBytes(entry, targetMip);
+    m_committedBytes = m_committedBytes + entry.reservedBytes - entry.texture->memorySize;
+    entry.targetMip = targetMip;
+    entry.state = STATE_DECODING;
+    m_inFlight++;
+
+    Entry *target = &entry;
+    std::string path = entry.path;
+    uint32_t texelSize = entry.texture->texelSize;
+    entry.job = JobSystem::GetInstance()->Submit([target, path, texelSize, targetMip]() {
+        int width = 0;
+        int height = 0;
+        int components = 0;
+        unsigned char *pixels = DecodeImage(path, width, height, components, static_cast<int>(texelSize));
+        if (pixels == nullptr) {
+            LOGE("TextureStreamer decode %{public}s failed", path.c_str());
+            return;
+        }
+        if (static_cast<uint32_t>(width) == target->width && static_cast<uint32_t>(height) == target->height) {
+            Downsample(pixels, target->width, target->height, texelSize, targetMip, target->pixels);
+        }
+        stbi_image_free(pixels);
+    });
+}
+
+void vkOBJ::TextureStreamer::StartUploads()
+{
+    VkDevice device = m_model->m_device->logicalDevice;
+    for (auto &item : m_entries) {
+        Entry &entry = *item;
+        if (entry.state != STATE_DECODING || !JobSystem::GetInstance()->IsFinished(entry.job)) {
+            continue;
+        }
+        entry.job = nullptr;
+        uint64_t value = 0;
+        if (!entry.pixels.empty()) {
+            entry.staged = std::make_shared<Texture>();
+            Texture &staged = *entry.staged;
+            staged.device = m_model->m_device;
+            staged.format = entry.texture->format;
+            staged.texelSize = entry.texture->texelSize;
+            staged.width = std::max(1u, entry.width >> entry.targetMip);
+            staged.height = std::max(1u, entry.height >> entry.targetMip);
+            staged.mipLevels = entry.mipCount - entry.targetMip;
+            m_model->CreateTextureImage(&staged, staged.format);
+            value = m_uploadManager->UploadImage(staged.image, {staged.width, staged.height}, staged.texelSize,
+                staged.mipLevels, entry.pixels.data());
+            std::vector<unsigned char>().swap(entry.pixels);
+            if (value == 0) {
+                // Does not fit the staging ring, this level is not requested again
+                entry.minMip = std::min(entry.targetMip + 1, entry.tailMip);
+                vkDestroyImage(device, staged.image, nullptr);
+                vkFreeMemory(device, staged.deviceMemory, nullptr);
+                entry.staged = nullptr;
+            }
+        } else {
+            // Keep what is resident, retrying a broken file every update would only burn the workers
+            entry.minMip = entry.residentMip;
+            entry.tailMip = std::max(entry.tailMip, entry.residentMip);
+        }
+        if (value == 0) {
+            m_committedBytes = m_committedBytes + entry.texture->memorySize - entry.reservedBytes;
+            entry.reservedBytes = 0;
+            entry.state = STATE_IDLE;
+            m_inFlight--;
+            continue;
+        }
+        m_committedBytes = m_committedBytes + entry.staged->memorySize - entry.reservedBytes;
+        entry.reservedBytes = entry.staged->memorySize;
+        entry.uploadValue = value;
+        entry.state = STATE_UPLOADING;
+    }
+}
+
+bool vkOBJ::TextureStreamer::CompleteUploads(uint64_t frameIndex)
+{
+    std::vector<const Texture *> swapped;
+    for (auto &item : m_entries) {
+        Entry &entry = *item;
+        if (entry.state != STATE_UPLOADING || !m_uploadManager->IsComplete(entry.uploadValue)) {
+            continue;
+        }
+        Texture &staged = *entry.staged;
+        Texture &texture = *entry.texture;
+        staged.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        m_model->CreateTextureView(&staged, staged.format);
+        m_retired.push_back({texture.image, texture.deviceMemory, texture.view, texture.sampler, frameIndex});
+        texture.image = staged.image;
+        texture.deviceMemory = staged.deviceMemory;
+        texture.view = staged.view;
+        texture.sampler = staged.sampler;
+        texture.descriptor = staged.descriptor;
+        texture.imageLayout = staged.imageLayout;
+        texture.width = staged.width;
+        texture.height = staged.height;
+        texture.mipLevels = staged.mipLevels;
+        texture.memorySize = staged.memorySize;
+        entry.staged = nullptr;
+        entry.residentMip = entry.targetMip;
+        entry.reservedBytes = 0;
+        entry.state = STATE_IDLE;
+        m_inFlight--;
+        swapped.push_back(&texture);
+    }
+    if (swapped.empty()) {
+        return false;
+    }
+    for (auto &mesh : m_model->m_meshes) {
+        uint32_t material = mesh->GetMaterialIndex();
+        if (material >= m_model->m_textures.size()) {
+            continue;
+        }
+        auto &textures = m_model->m_textures[material];
+        bool uses = std::any_of(textures.begin(), textures.end(), [&swapped](const std::shared_ptr<Texture> &t) {
+            return std::find(swapped.begin(), swapped.end(), t.get()) != swapped.end();
+        });
+        if (uses) {
+            mesh->UpdateMaterialDescriptor();
+        }
+    }
+    return true;
+}
+
+void vkOBJ::TextureStreamer::ReleaseRetired(uint64_t frameIndex, bool all)
+{
+    VkDevice device = m_model->m_device->logicalDevice;
+    auto released = std::remove_if(m_retired.begin(), m_retired.end(), [device, frameIndex, all](
+        const Retired &retired) {
+        if (!all && frameIndex < retired.frame + STREAMING_RETIRE_FRAMES) {
+            return false;
+        }
+        vkDestroyImageView(device, retired.view, nullptr);
+        vkDestroySampler(device, retired.sampler, nullptr);
+        vkDestroyImage(device, retired.image, nullptr);
+        vkFreeMemory(device, retired.memory, nullptr);
+        return true;
+    });
+    m_retired.erase(released, m_retired.end());
+}
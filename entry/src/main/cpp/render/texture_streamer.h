@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RENDER_TEXTURE_STREAMER_H
+#define RENDER_TEXTURE_STREAMER_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "upload_manager.h"
+#include "common/jobs/job_system.h"
+
+#define STREAMING_TAIL_SIZE 128    // largest edge of the mips every texture keeps resident, loaded at startup
+#define STREAMING_MAX_IN_FLIGHT 2  // residency changes decoding or uploading at the same time
+#define STREAMING_RETIRE_FRAMES 3  // frames a replaced image outlives the swap
+#define STREAMING_MIN_DISTANCE 1.0f // model units, keeps surfaces the camera stands on finite
+
+namespace vkOBJ {
+    struct Texture;
+    class StaticModel;
+
+    struct StreamingView {
+        glm::vec3 position; // camera in model space
+        float pixelsPerUnit; // pixels covered by one unit at distance 1, height / (2 * tan(fovY / 2))
+    };
+
+    struct StreamingStats {
+        VkDeviceSize residentBytes = 0; // including the images being uploaded
+        VkDeviceSize budgetBytes = 0;
+        uint32_t textureCount = 0;
+        uint32_t sharpCount = 0; // textures at or above the level the view asks for
+        uint32_t inFlight = 0;
+    };
+
+    // Keeps the resolution of every model texture close to what the view needs within a device memory budget.
+    // Textures start with their mip tail. Each update estimates the level a texture needs from the distance and
+    // UV density of the meshes using it, decodes the source again on the job system and downsamples it to that
+    // level, uploads it into a new image through the upload manager and swaps the image in once the upload
+    // completed. When the budget is exhausted, textures the view no longer needs are dropped back first, then the
+    // farthest ones lose a level.
+    // Runs on the render thread, between frames: swapping rewrites descriptor sets in place, which requires that no
+    // submitted frame still uses them (submitFrame waits for its fence).
+    class TextureStreamer {
+    public:
+        TextureStreamer(StaticModel *model, UploadManager *uploadManager, VkDeviceSize budget)
+            : m_model(model), m_uploadManager(uploadManager), m_budget(budget) {}
+        ~TextureStreamer();
+
+        // First level of a width x height chain that fits STREAMING_TAIL_SIZE
+        static uint32_t GetTailMip(uint32_t width, uint32_t height);
+        // Decodes an image asset, stbi_image_free the result
+        static unsigned char *DecodeImage(const std::string &rawPath, int &width, int &height, int &components,
+            int desiredComponents);
+        // Box filters tightly packed texels down by levels mips, into out
+        static void Downsample(const unsigned char *pixels, uint32_t width, uint32_t height, uint32_t texelSize,
+            uint32_t levels, std::vector<unsigned char> &out);
+
+        // Registers a texture loaded from mip residentMip of a width x height source asset at rawPath
+        void AddTexture(const std::shared_ptr<Texture> &texture, const std::string &rawPath, uint32_t width,
+            uint32_t height, uint32_t residentMip);
+        // Returns true when descriptor sets were rewritten, command buffers recorded with them must be rebuilt
+        bool Update(const StreamingView &view, uint64_t frameIndex);
+        void GetStats(StreamingStats &stats) const;
+
+    private:
+        enum State : uint32_t {
+            STATE_IDLE = 0,
+            STATE_DECODING,
+            STATE_UPLOADING,
+        };
+        struct Entry {
+            std::shared_ptr<Texture> texture;
+            std::string path;
+            uint32_t width;
+            uint32_t height;
+            uint32_t mipCount;     // of the full chain
+            uint32_t tailMip;      // never evicted past this level
+            uint32_t minMip = 0;   // levels above do not fit the upload ring
+            uint32_t residentMip;  // full chain level of the top mip in the image
+            uint32_t wantedMip;
+            float distance;
+            State state = STATE_IDLE;
+            uint32_t targetMip = 0;
+            VkDeviceSize reservedBytes = 0; // budget taken by the image being streamed in
+            JobSystem::JobHandle job;
+            std::vector<unsigned char> pixels; // target level, written by the decode job
+            std::shared_ptr<Texture> staged;
+            uint64_t uploadValue = 0;
+        };
+        struct Retired {
+            VkImage image;
+            VkDeviceMemory memory;
+            VkImageView view;
+            VkSampler sampler;
+            uint64_t frame;
+        };
+
+        VkDeviceSize EstimateBytes(const Entry &entry, uint32_t mip) const;
+        void UpdateWantedMips(const StreamingView &view);
+        void Schedule();
+        void Request(Entry &entry, uint32_t targetMip);
+        void StartUploads();
+        bool CompleteUploads(uint64_t frameIndex);
+        void ReleaseRetired(uint64_t frameIndex, bool all);
+
+        StaticModel *m_model;
+        UploadManager *m_uploadManager;
+        VkDeviceSize m_budget;
+        VkDeviceSize m_committedBytes = 0;
+        uint32_t m_inFlight = 0;
+        std::vector<std::unique_ptr<Entry>> m_entries;
+        std::map<const Texture *, Entry *> m_entryMap;
+        std::vector<Retired> m_retired;
+    };
+}
+#endif // RENDER_TEXTURE_STREAMER_H
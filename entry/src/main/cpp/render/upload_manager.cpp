@@ -0,0 +1,423 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "upload_manager.h"
+#include <algorithm>
+#include <cstring>
+#include "VulkanTools.h"
+#include "common/common.h"
+#include "common/trace.h"
+#include "memory_tracker.h"
+
+UploadManager::~UploadManager()
+{
+    if (m_device == VK_NULL_HANDLE) {
+        return;
+    }
+    if (m_timeline != VK_NULL_HANDLE) {
+        Wait(Flush());
+        vkDestroySemaphore(m_device, m_timeline, nullptr);
+    }
+    if (m_ringMapped != nullptr) {
+        vkUnmapMemory(m_device, m_ringMemory);
+    }
+    if (m_ringBuffer != VK_NULL_HANDLE) {
+        vkDestroyBuffer(m_device, m_ringBuffer, nullptr);
+    }
+    if (m_ringMemory != VK_NULL_HANDLE) {
+        vkFreeMemory(m_device, m_ringMemory, nullptr);
+    }
+    // Destroying the pools frees the batch command buffers
+    if (m_transferPool != VK_NULL_HANDLE) {
+        vkDestroyCommandPool(m_device, m_transferPool, nullptr);
+    }
+    if (m_graphicsPool != VK_NULL_HANDLE) {
+        vkDestroyCommandPool(m_device, m_graphicsPool, nullptr);
+    }
+}
+
+bool UploadManager::Init(const InitParams &initParams)
+{
+    if (vkWaitSemaphores == nullptr || vkGetSemaphoreCounterValue == nullptr) {
+        LOGE("UploadManager Init: timeline semaphore functions are not available");
+        return false;
+    }
+    m_vulkanDevice = initParams.vulkanDevice;
+    m_device = m_vulkanDevice->logicalDevice;
+    m_transferQueue = initParams.transferQueue;
+    m_graphicsQueue = initParams.graphicsQueue;
+    m_transferFamily = m_vulkanDevice->queueFamilyIndices.transfer;
+    m_graphicsFamily = m_vulkanDevice->queueFamilyIndices.graphics;
+    m_dedicatedTransfer = m_transferFamily != m_graphicsFamily;
+    m_ringSize = initParams.ringSize;
+    // 16 bytes keep every copy offset a multiple of 4 and of the common texel sizes
+    m_copyAlignment = std::max<VkDeviceSize>(16, m_vulkanDevice->properties.limits.optimalBufferCopyOffsetAlignment);
+
+    VkSemaphoreTypeCreateInfo semaphoreTypeInfo{};
+    semaphoreTypeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    semaphoreTypeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    semaphoreTypeInfo.initialValue = 0;
+    VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+    semaphoreCreateInfo.pNext = &semaphoreTypeInfo;
+    VkResult res = vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr, &m_timeline);
+    if (res != VK_SUCCESS) {
+        LOGE("UploadManager Init: create timeline semaphore failed, result: %{public}d", res);
+        m_timeline = VK_NULL_HANDLE;
+        return false;
+    }
+
+    m_graphicsPool = m_vulkanDevice->createCommandPool(m_graphicsFamily);
+    if (m_dedicatedTransfer) {
+        m_transferPool = m_vulkanDevice->createCommandPool(m_transferFamily);
+    }
+    for (auto &batch : m_batches) {
+        VkCommandBufferAllocateInfo cmdBufAllocateInfo =
+            vks::initializers::commandBufferAllocateInfo(m_graphicsPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+        VK_CHECK_RESULT(vkAllocateCommandBuffers(m_device, &cmdBufAllocateInfo, &batch.graphicsCmd));
+        if (m_dedicatedTransfer) {
+            cmdBufAllocateInfo.commandPool = m_transferPool;
+            VK_CHECK_RESULT(vkAllocateCommandBuffers(m_device, &cmdBufAllocateInfo, &batch.transferCmd));
+        }
+    }
+
+    MemoryCategoryScope memoryScope(MEMORY_CATEGORY_STAGING);
+    res = m_vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_ringSize, &m_ringBuffer,
+        &m_ringMemory);
+    if (res != VK_SUCCESS) {
+        LOGE("UploadManager Init: create staging ring failed, result: %{public}d", res);
+        return false;
+    }
+    VK_CHECK_RESULT(vkMapMemory(m_device, m_ringMemory, 0, m_ringSize, 0, reinterpret_cast<void **>(&m_ringMapped)));
+    LOGI("UploadManager Init: ring %{public}llu bytes, %{public}s transfer queue",
+        static_cast<unsigned long long>(m_ringSize), m_dedicatedTransfer ? "dedicated" : "graphics");
+    return true;
+}
+
+uint64_t UploadManager::UploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void *data, VkDeviceSize size,
+    VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+{
+    VkDeviceSize stagingOffset = 0;
+    if (size == 0 || !AllocateStaging(size, m_copyAlignment, stagingOffset)) {
+        return 0;
+    }
+    BeginBatch();
+    memcpy(m_ringMapped + stagingOffset, data, size);
+    Batch &batch = m_batches[m_currentBatch];
+    VkBufferCopy copyRegion = {};
+    copyRegion.srcOffset = stagingOffset;
+    copyRegion.dstOffset = offset;
+    copyRegion.size = size;
+    vkCmdCopyBuffer(m_dedicatedTransfer ? batch.transferCmd : batch.graphicsCmd, m_ringBuffer, buffer, 1,
+        &copyRegion);
+
+    VkBufferMemoryBarrier barrier = vks::initializers::bufferMemoryBarrier();
+    barrier.buffer = buffer;
+    barrier.offset = offset;
+    barrier.size = size;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = dstAccess;
+    if (m_dedicatedTransfer) {
+        // The release half ignores the destination access, the acquire half the source access
+        barrier.srcQueueFamilyIndex = m_transferFamily;
+        barrier.dstQueueFamilyIndex = m_graphicsFamily;
+        barrier.dstAccessMask = 0;
+        m_bufferReleases.push_back(barrier);
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = dstAccess;
+    }
+    m_bufferAcquires.push_back(barrier);
+    m_bufferDstStages |= dstStage;
+    return GetRecordingValue();
+}
+
+uint64_t UploadManager::UploadImage(VkImage image, VkExtent2D extent, uint32_t texelSize, uint32_t mipLevels,
+    const void *data)
+{
+    VkDeviceSize size = static_cast<VkDeviceSize>(extent.width) * extent.height * texelSize;
+    if (size == 0) {
+        return 0;
+    }
+    // bufferOffset of an image copy must also be a multiple of the texel size, e.g. 48 for RGB8
+    VkDeviceSize alignment = m_copyAlignment;
+    while (alignment % texelSize != 0) {
+        alignment += m_copyAlignment;
+    }
+    VkDeviceSize stagingOffset = 0;
+    if (!AllocateStaging(size, alignment, stagingOffset)) {
+        return 0;
+    }
+    BeginBatch();
+    memcpy(m_ringMapped + stagingOffset, data, size);
+    Batch &batch = m_batches[m_currentBatch];
+    VkCommandBuffer copyCmd = m_dedicatedTransfer ? batch.transferCmd : batch.graphicsCmd;
+
+    VkImageMemoryBarrier barrier = vks::initializers::imageMemoryBarrier();
+    barrier.image = image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+        nullptr, 1, &barrier);
+
+    VkBufferImageCopy copyRegion = {};
+    copyRegion.bufferOffset = stagingOffset;
+    copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copyRegion.imageSubresource.mipLevel = 0;
+    copyRegion.imageSubresource.baseArrayLayer = 0;
+    copyRegion.imageSubresource.layerCount = 1;
+    copyRegion.imageExtent = {extent.width, extent.height, 1};
+    vkCmdCopyBufferToImage(copyCmd, m_ringBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+
+    // Mip 0 becomes the blit source on the graphics queue, both halves of a transfer carry the same layouts
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    if (m_dedicatedTransfer) {
+        barrier.srcQueueFamilyIndex = m_transferFamily;
+        barrier.dstQueueFamilyIndex = m_graphicsFamily;
+        barrier.dstAccessMask = 0;
+        m_imageReleases.push_back(barrier);
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    }
+    m_imageAcquires.push_back(barrier);
+    m_pendingImages.push_back({image, extent, std::max(1u, mipLevels)});
+    return GetRecordingValue();
+}
+
+uint64_t UploadManager::Flush()
+{
+    if (!m_recording) {
+        return m_submittedValue;
+    }
+    TRACE_SCOPE("UploadManager::Flush");
+    Batch &batch = m_batches[m_currentBatch];
+    uint64_t transferValue = m_submittedValue + 1;
+    uint64_t graphicsValue = m_submittedValue + 2;
+
+    if (m_dedicatedTransfer) {
+        if (!m_bufferReleases.empty() || !m_imageReleases.empty()) {
+            vkCmdPipelineBarrier(batch.transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, static_cast<uint32_t>(m_bufferReleases.size()),
+                m_bufferReleases.data(), static_cast<uint32_t>(m_imageReleases.size()), m_imageReleases.data());
+        }
+        VK_CHECK_RESULT(vkEndCommandBuffer(batch.transferCmd));
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.signalSemaphoreValueCount = 1;
+        timelineInfo.pSignalSemaphoreValues = &transferValue;
+        VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &batch.transferCmd;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &m_timeline;
+        std::lock_guard<std::mutex> lock(m_vulkanDevice->queueMutex);
+        VK_CHECK_RESULT(vkQueueSubmit(m_transferQueue, 1, &submitInfo, VK_NULL_HANDLE));
+    }
+
+    if (!m_bufferAcquires.empty()) {
+        vkCmdPipelineBarrier(batch.graphicsCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, m_bufferDstStages, 0, 0, nullptr,
+            static_cast<uint32_t>(m_bufferAcquires.size()), m_bufferAcquires.data(), 0, nullptr);
+    }
+    if (!m_imageAcquires.empty()) {
+        vkCmdPipelineBarrier(batch.graphicsCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+            nullptr, 0, nullptr, static_cast<uint32_t>(m_imageAcquires.size()), m_imageAcquires.data());
+    }
+    for (auto &pending : m_pendingImages) {
+        RecordImageMips(batch.graphicsCmd, pending);
+    }
+    VK_CHECK_RESULT(vkEndCommandBuffer(batch.graphicsCmd));
+
+    // Later graphics submissions are ordered after the acquire barriers, so rendering never waits on the semaphore
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = m_dedicatedTransfer ? 1 : 0;
+    timelineInfo.pWaitSemaphoreValues = &transferValue;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &graphicsValue;
+    VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.waitSemaphoreCount = m_dedicatedTransfer ? 1 : 0;
+    submitInfo.pWaitSemaphores = &m_timeline;
+    submitInfo.pWaitDstStageMask = &waitStage;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch.graphicsCmd;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &m_timeline;
+    {
+        std::lock_guard<std::mutex> lock(m_vulkanDevice->queueMutex);
+        VK_CHECK_RESULT(vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE));
+    }
+
+    batch.value = graphicsValue;
+    m_submittedValue = graphicsValue;
+    m_currentBatch = (m_currentBatch + 1) % UPLOAD_BATCH_COUNT;
+    m_recording = false;
+    m_bufferReleases.clear();
+    m_bufferAcquires.clear();
+    m_bufferDstStages = 0;
+    m_imageReleases.clear();
+    m_imageAcquires.clear();
+    m_pendingImages.clear();
+    return graphicsValue;
+}
+
+uint64_t UploadManager::GetCompletedValue() const
+{
+    uint64_t value = 0;
+    VK_CHECK_RESULT(vkGetSemaphoreCounterValue(m_device, m_timeline, &value));
+    return value;
+}
+
+void UploadManager::Wait(uint64_t value)
+{
+    if (value > m_submittedValue) {
+        Flush();
+        value = std::min(value, m_submittedValue);
+    }
+    if (value == 0) {
+        return;
+    }
+    TRACE_SCOPE("UploadManager::Wait");
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &m_timeline;
+    waitInfo.pValues = &value;
+    VK_CHECK_RESULT(vkWaitSemaphores(m_device, &waitInfo, UINT64_MAX));
+}
+
+void UploadManager::BeginBatch()
+{
+    if (m_recording) {
+        return;
+    }
+    Batch &batch = m_batches[m_currentBatch];
+    // The command buffers are reused once the batch that last used them completed
+    if (batch.value != 0) {
+        Wait(batch.value);
+    }
+    VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+    cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (m_dedicatedTransfer) {
+        VK_CHECK_RESULT(vkBeginCommandBuffer(batch.transferCmd, &cmdBufInfo));
+    }
+    VK_CHECK_RESULT(vkBeginCommandBuffer(batch.graphicsCmd, &cmdBufInfo));
+    m_recording = true;
+}
+
+bool UploadManager::AllocateStaging(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset)
+{
+    if (size > m_ringSize) {
+        LOGE("UploadManager upload of %{public}llu bytes exceeds the staging ring",
+            static_cast<unsigned long long>(size));
+        return false;
+    }
+    while (true) {
+        ReleaseCompleted();
+        if (FitStaging(size, alignment, offset)) {
+            m_regions.push_back({offset, offset + size, GetRecordingValue()});
+            return true;
+        }
+        // The oldest region is either in flight or part of the batch being recorded, Wait flushes the latter
+        Wait(m_regions.front().value);
+    }
+}
+
+bool UploadManager::FitStaging(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset) const
+{
+    if (m_regions.empty()) {
+        offset = 0;
+        return true;
+    }
+    VkDeviceSize tail = m_regions.front().begin;
+    VkDeviceSize head = m_regions.back().end;
+    VkDeviceSize aligned = (head + alignment - 1) / alignment * alignment;
+    if (head > tail) {
+        // Free space after the newest region, then wrapped in front of the oldest one
+        if (aligned + size <= m_ringSize) {
+            offset = aligned;
+            return true;
+        }
+        if (size <= tail) {
+            offset = 0;
+            return true;
+        }
+        return false;
+    }
+    if (aligned + size <= tail) {
+        offset = aligned;
+        return true;
+    }
+    return false;
+}
+
+void UploadManager::ReleaseCompleted()
+{
+    if (m_regions.empty()) {
+        return;
+    }
+    uint64_t completed = GetCompletedValue();
+    while (!m_regions.empty() && m_regions.front().value <= completed) {
+        m_regions.pop_front();
+    }
+}
+
+void UploadManager::RecordImageMips(VkCommandBuffer commandBuffer, const PendingImage &pending)
+{
+    VkImageMemoryBarrier barrier = vks::initializers::imageMemoryBarrier();
+    barrier.image = pending.image;
+    for (uint32_t i = 1; i < pending.mipLevels; i++) {
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1};
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+            nullptr, 0, nullptr, 1, &barrier);
+
+        VkImageBlit imageBlit{};
+        imageBlit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, i - 1, 0, 1};
+        imageBlit.srcOffsets[1].x = static_cast<int32_t>(std::max(1u, pending.extent.width >> (i - 1)));
+        imageBlit.srcOffsets[1].y = static_cast<int32_t>(std::max(1u, pending.extent.height >> (i - 1)));
+        imageBlit.srcOffsets[1].z = 1;
+        imageBlit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1};
+        imageBlit.dstOffsets[1].x = static_cast<int32_t>(std::max(1u, pending.extent.width >> i));
+        imageBlit.dstOffsets[1].y = static_cast<int32_t>(std::max(1u, pending.extent.height >> i));
+        imageBlit.dstOffsets[1].z = 1;
+        vkCmdBlitImage(commandBuffer, pending.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, pending.image,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+            nullptr, 0, nullptr, 1, &barrier);
+    }
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, pending.mipLevels, 0, 1};
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0,
+        nullptr, 0, nullptr, 1, &barrier);
+}
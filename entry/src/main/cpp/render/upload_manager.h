@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RENDER_UPLOAD_MANAGER_H
+#define RENDER_UPLOAD_MANAGER_H
+
+#include <deque>
+#include <vector>
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+
+#define UPLOAD_BATCH_COUNT 4
+
+// Streams buffer and image data to device local memory without blocking the caller.
+// Data is copied into a persistent, mapped staging ring and the copies are batched into one command buffer on the
+// transfer queue. When the transfer queue belongs to its own family, the batch releases the resources and a second
+// command buffer on the graphics queue acquires them (and generates mips, blits need a graphics queue), so rendering
+// submitted later on the graphics queue is ordered after the upload. Completion is tracked with a timeline semaphore:
+// every upload returns the value the semaphore reaches once the resource is ready, ring space is reclaimed when the
+// semaphore passes the value of the batch that used it.
+// Not thread safe, Flush submits to the graphics queue and must run on the thread that owns it.
+class UploadManager {
+public:
+    struct InitParams {
+        vks::VulkanDevice *vulkanDevice;
+        VkQueue transferQueue; // from vulkanDevice->queueFamilyIndices.transfer
+        VkQueue graphicsQueue;
+        VkDeviceSize ringSize;
+    };
+
+    UploadManager() {}
+    ~UploadManager();
+
+    // Needs the timelineSemaphore feature
+    bool Init(const InitParams &initParams);
+
+    // The buffer is ready for dstAccess in dstStage on the graphics queue once the returned value is reached,
+    // 0 when the data does not fit the ring.
+    uint64_t UploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void *data, VkDeviceSize size,
+        VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+    // Uploads tightly packed texels of mip 0 and blits the other mips, the image ends in SHADER_READ_ONLY_OPTIMAL.
+    // The image must be in UNDEFINED layout with TRANSFER_SRC | TRANSFER_DST usage.
+    uint64_t UploadImage(VkImage image, VkExtent2D extent, uint32_t texelSize, uint32_t mipLevels, const void *data);
+
+    // Submits the recorded uploads and returns their value, never waits for the GPU
+    uint64_t Flush();
+    uint64_t GetCompletedValue() const;
+    bool IsComplete(uint64_t value) const { return GetCompletedValue() >= value; }
+    // Flushes first when value belongs to the batch being recorded
+    void Wait(uint64_t value);
+
+private:
+    struct Batch {
+        VkCommandBuffer transferCmd = VK_NULL_HANDLE;
+        VkCommandBuffer graphicsCmd = VK_NULL_HANDLE;
+        uint64_t value = 0; // graphics side completion, 0 before the first submit
+    };
+    struct Region {
+        VkDeviceSize begin;
+        VkDeviceSize end;
+        uint64_t value;
+    };
+    struct PendingImage {
+        VkImage image;
+        VkExtent2D extent;
+        uint32_t mipLevels;
+    };
+
+    bool AllocateStaging(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset);
+    bool FitStaging(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset) const;
+    void ReleaseCompleted();
+    void BeginBatch();
+    void RecordImageMips(VkCommandBuffer commandBuffer, const PendingImage &pending);
+    // Value signalled by the graphics side of the batch being recorded
+    uint64_t GetRecordingValue() const { return m_submittedValue + 2; }
+
+    vks::VulkanDevice *m_vulkanDevice = nullptr;
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkQueue m_transferQueue = VK_NULL_HANDLE;
+    VkQueue m_graphicsQueue = VK_NULL_HANDLE;
+    uint32_t m_transferFamily = 0;
+    uint32_t m_graphicsFamily = 0;
+    // Copies run on a queue of another family and need ownership transfers
+    bool m_dedicatedTransfer = false;
+
+    VkCommandPool m_transferPool = VK_NULL_HANDLE;
+    VkCommandPool m_graphicsPool = VK_NULL_HANDLE;
+    Batch m_batches[UPLOAD_BATCH_COUNT];
+    uint32_t m_currentBatch = 0;
+    bool m_recording = false;
+    VkSemaphore m_timeline = VK_NULL_HANDLE;
+    // Odd values are signalled by the transfer side, even values by the graphics side
+    uint64_t m_submittedValue = 0;
+
+    VkBuffer m_ringBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory m_ringMemory = VK_NULL_HANDLE;
+    uint8_t *m_ringMapped = nullptr;
+    VkDeviceSize m_ringSize = 0;
+    VkDeviceSize m_copyAlignment = 1;
+    std::deque<Region> m_regions;
+
+    // Barriers of the batch being recorded, emitted by Flush
+    std::vector<VkBufferMemoryBarrier> m_bufferReleases;
+    std::vector<VkBufferMemoryBarrier> m_bufferAcquires;
+    VkPipelineStageFlags m_bufferDstStages = 0;
+    std::vector<VkImageMemoryBarrier> m_imageReleases;
+    std::vector<VkImageMemoryBarrier> m_imageAcquires;
+    std::vector<PendingImage> m_pendingImages;
+};
+#endif // RENDER_UPLOAD_MANAGER_H
@@ -14,7 +14,9 @@
  */
 
 #include "vulkan_obj_mesh.h"
+#include <cmath>
 #include "vulkan_obj_model.h"
+#include "memory_tracker.h"
 
 vkOBJ::StaticMeshNode::StaticMeshNode(vkOBJ::StaticModel* model, const aiMesh* mesh, vks::VulkanDevice *device)
     : m_model(model), m_materialIndex(mesh->mMaterialIndex), m_device(device)
@@ -63,10 +65,48 @@ vkOBJ::StaticMeshNode::StaticMeshNode(vkOBJ::StaticModel* model, const aiMesh* m
 
     vertices.range = sizeof(Vertex) * m_vertexs.size();
     indices.range = sizeof(unsigned int) * m_indices.size();
+    ComputeBounds(mesh->mTextureCoords[0] != nullptr);
+}
+
+void vkOBJ::StaticMeshNode::ComputeBounds(bool hasTexCoords)
+{
+    if (m_vertexs.empty()) {
+        return;
+    }
+    glm::vec3 minPosition = m_vertexs[0].Position;
+    glm::vec3 maxPosition = m_vertexs[0].Position;
+    for (const Vertex &vertex : m_vertexs) {
+        minPosition = glm::min(minPosition, vertex.Position);
+        maxPosition = glm::max(maxPosition, vertex.Position);
+    }
+    m_center = (minPosition + maxPosition) * 0.5f;
+    m_radius = glm::length(maxPosition - m_center);
+    if (!hasTexCoords) {
+        return;
+    }
+
+    float surfaceArea = 0.0f;
+    float uvArea = 0.0f;
+    for (size_t i = 0; i + 2 < m_indices.size(); i += 3) {
+        const Vertex &v0 = m_vertexs[m_indices[i]];
+        const Vertex &v1 = m_vertexs[m_indices[i + 1]];
+        const Vertex &v2 = m_vertexs[m_indices[i + 2]];
+        surfaceArea += glm::length(glm::cross(v1.Position - v0.Position, v2.Position - v0.Position)) * 0.5f;
+        glm::vec2 uv1 = v1.TexCoords - v0.TexCoords;
+        glm::vec2 uv2 = v2.TexCoords - v0.TexCoords;
+        uvArea += std::abs(uv1.x * uv2.y - uv1.y * uv2.x) * 0.5f;
+    }
+    m_uvDensity = surfaceArea > 0.0f ? std::sqrt(uvArea / surfaceArea) : 0.0f;
 }
 
 void vkOBJ::StaticMeshNode::InitMeshDescriptors(VkQueue transferQueue)
 {
+    UploadManager *uploadManager = m_model->m_uploadManager;
+    if (uploadManager != nullptr && UploadMeshBuffers(uploadManager)) {
+        InitMaterialDescriptor();
+        return;
+    }
+    MemoryCategoryScope stagingScope(MEMORY_CATEGORY_STAGING);
     VK_CHECK_RESULT(m_device->createBuffer(
         VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
@@ -83,6 +123,7 @@ void vkOBJ::StaticMeshNode::InitMeshDescriptors(VkQueue transferQueue)
         &indexStaging.memory,
         m_indices.data()));
     
+    MemoryCategoryScope meshScope(MEMORY_CATEGORY_MESHES);
     VK_CHECK_RESULT(m_device->createBuffer(
         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
@@ -112,7 +153,43 @@ void vkOBJ::StaticMeshNode::InitMeshDescriptors(VkQueue transferQueue)
     vkFreeMemory(m_device->logicalDevice, vertexStaging.memory, nullptr);
     vkDestroyBuffer(m_device->logicalDevice, indexStaging.buffer, nullptr);
     vkFreeMemory(m_device->logicalDevice, indexStaging.memory, nullptr);
-    
+    InitMaterialDescriptor();
+}
+
+bool vkOBJ::StaticMeshNode::UploadMeshBuffers(UploadManager *uploadManager)
+{
+    MemoryCategoryScope memoryScope(MEMORY_CATEGORY_MESHES);
+    VK_CHECK_RESULT(m_device->createBuffer(
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        vertices.range,
+        &vertices.buffer,
+        &vertices.memory));
+
+    VK_CHECK_RESULT(m_device->createBuffer(
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        indices.range,
+        &indices.buffer,
+        &indices.memory));
+
+    if (uploadManager->UploadBuffer(vertices.buffer, 0, m_vertexs.data(), vertices.range,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT) != 0 &&
+        uploadManager->UploadBuffer(indices.buffer, 0, m_indices.data(), indices.range,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT) != 0) {
+        return true;
+    }
+    // Too big for the staging ring, the caller uploads through one-off staging buffers instead
+    uploadManager->Wait(uploadManager->Flush());
+    vkDestroyBuffer(m_device->logicalDevice, vertices.buffer, nullptr);
+    vkFreeMemory(m_device->logicalDevice, vertices.memory, nullptr);
+    vkDestroyBuffer(m_device->logicalDevice, indices.buffer, nullptr);
+    vkFreeMemory(m_device->logicalDevice, indices.memory, nullptr);
+    return false;
+}
+
+void vkOBJ::StaticMeshNode::InitMaterialDescriptor()
+{
     if (m_materialIndex >= 0 && m_materialIndex < m_model->m_textures.size() &&
         !m_model->m_textures[m_materialIndex].empty()) {
         auto textures = m_model->m_textures[m_materialIndex];
@@ -123,7 +200,14 @@ void vkOBJ::StaticMeshNode::InitMeshDescriptors(VkQueue transferQueue)
         descriptorSetAllocInfo.pSetLayouts = &m_model->m_descriptorSetLayoutImage;
         descriptorSetAllocInfo.descriptorSetCount = 1;
         VK_CHECK_RESULT(vkAllocateDescriptorSets(m_device->logicalDevice, &descriptorSetAllocInfo, &m_descriptorSet));
+        UpdateMaterialDescriptor();
+    }
+}
 
+void vkOBJ::StaticMeshNode::UpdateMaterialDescriptor()
+{
+    if (m_descriptorSet != VK_NULL_HANDLE) {
+        auto &textures = m_model->m_textures[m_materialIndex];
         std::vector<VkWriteDescriptorSet> writeDescriptorSets{};
         for (int i = 0; i < textures.size(); i++) {
             VkWriteDescriptorSet writeDescriptorSet{};
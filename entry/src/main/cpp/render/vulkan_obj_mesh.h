@@ -34,6 +34,7 @@
 #include "assimp/postprocess.h"
 #include "vulkan/vulkan.h"
 #include "VulkanDevice.h"
+#include "upload_manager.h"
 
 namespace vkOBJ {
     class StaticModel;
@@ -61,6 +62,14 @@ namespace vkOBJ {
             m_indices.clear();
         }
         void InitMeshDescriptors(VkQueue transferQueue);
+        // Rewrites the material textures into m_descriptorSet, after the streamer replaced one of them
+        void UpdateMaterialDescriptor();
+        unsigned int GetMaterialIndex() const { return m_materialIndex; }
+        // Bounding sphere in model space
+        const glm::vec3 &GetCenter() const { return m_center; }
+        float GetRadius() const { return m_radius; }
+        // UV units per model unit, the square root of the UV area over the surface area, 0 without UVs
+        float GetUVDensity() const { return m_uvDensity; }
 
         struct Vertices {
             int count;
@@ -81,12 +90,18 @@ namespace vkOBJ {
         VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
 
     private:
+        bool UploadMeshBuffers(UploadManager *uploadManager);
+        void InitMaterialDescriptor();
+        void ComputeBounds(bool hasTexCoords);
         VkMemoryPropertyFlags memoryPropertyFlags = 0;
         StaticModel* m_model;
         vks::VulkanDevice *m_device;
         std::vector<Vertex> m_vertexs;
         std::vector<unsigned int> m_indices;
         unsigned int m_materialIndex;
+        glm::vec3 m_center = glm::vec3(0.0f);
+        float m_radius = 0.0f;
+        float m_uvDensity = 0.0f;
         struct StagingBuffer {
             VkBuffer buffer;
             VkDeviceMemory memory;
@@ -14,15 +14,28 @@
  */
 
 #include "vulkan_obj_model.h"
+#include <algorithm>
 #include "stb_image.h"
-#include "file/file_operator.h"
+#include "file/asset_io_system.h"
 #include "common/common.h"
-void vkOBJ::StaticModel::LoadFromFile(std::string filename, vks::VulkanDevice *device, VkQueue transferQueue)
+#include "common/jobs/job_system.h"
+#include "common/trace.h"
+#include "memory_tracker.h"
+void vkOBJ::StaticModel::LoadFromFile(std::string filename, vks::VulkanDevice *device, VkQueue transferQueue,
+    UploadManager *uploadManager)
 {
+    TRACE_SCOPE("StaticModel::LoadFromFile");
     m_device = device;
+    m_uploadManager = uploadManager;
     Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(filename, aiProcess_Triangulate | aiProcess_GenSmoothNormals |
-        aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+    // Reads the model and its materials from the assets in place, the importer owns the handler
+    importer.SetIOHandler(new AssetIOSystem());
+    const aiScene* scene;
+    {
+        TRACE_SCOPE("Assimp::ReadFile");
+        scene = importer.ReadFile(filename, aiProcess_Triangulate | aiProcess_GenSmoothNormals |
+            aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+    }
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
         LOGE("Model Assimp load model failed: %{public}s", importer.GetErrorString());
         return;
@@ -31,6 +44,9 @@ void vkOBJ::StaticModel::LoadFromFile(std::string filename, vks::VulkanDevice *d
     m_directory = filename.substr(0, filename.find_last_of('/'));
     LOGI("Model  Load model form dir: %{public}s, name is %{public}s", m_directory.c_str(), filename.c_str());
     m_meshCount = scene->mNumMeshes;
+    if (m_streamingBudget > 0 && m_uploadManager != nullptr) {
+        m_streamer = new TextureStreamer(this, m_uploadManager, m_streamingBudget);
+    }
     ProcessMaterialTextures(scene);
     ProcessNode(scene->mRootNode, scene);
     InitVulkanResource(transferQueue);
@@ -45,7 +61,7 @@ void  vkOBJ::StaticModel::ProcessMaterialTextures(const aiScene* scene)
             for (int j = 0; j < material->GetTextureCount(type); j++) {
                 aiString path;
                 material->GetTexture(type, j, &path);
-                LOGI("Model assimp get texture path is: %{public}s", path.C_Str());
+                LOGD("Model assimp get texture path is: %{public}s", path.C_Str());
                 auto item = m_texturesMap.find(path.C_Str());
                 if (item != m_texturesMap.end()) {
                     m_textures[i].push_back(item->second);
@@ -87,231 +103,290 @@ void vkOBJ::StaticModel::InitVulkanResource(VkQueue transferQueue)
 {
     InitVulkanTexture(m_transferQueue);
     InitVulkanDescriptor(m_transferQueue);
+    // Rendering submitted to the graphics queue later is ordered after the uploads, nothing waits here
+    if (m_uploadManager != nullptr) {
+        m_uploadManager->Flush();
+    }
 }
 
 void vkOBJ::StaticModel::InitVulkanTexture(VkQueue copyQueue)
 {
+    struct DecodedImage {
+        unsigned char *pixels = nullptr;
+        int width = 0;
+        int height = 0;
+        int components = 0;
+    };
+    std::vector<std::shared_ptr<Texture>> textures;
     for (auto& textureIter : m_texturesMap) {
-        VkCommandBuffer copyCmd = m_device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-        std::shared_ptr<Texture> texture = textureIter.second;
-        std::string name = "Sponza/text" + texture->path;
-        std::string texturePath = FileOperator::GetInstance()->GetFileAbsolutePath(name);
-        int width, height, nrComponents;
-        unsigned char *buffer = stbi_load(texturePath.c_str(), &width, &height, &nrComponents, 0);
-        VkDeviceSize bufferSize = width * height * nrComponents;
-        VkFormat format = nrComponents == 4 ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_R8G8B8_UNORM;
-        VkFormatProperties formatProperties;
-        texture->width = width;
-        texture->height = height;
-        texture->mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
-        VkBool32 useStaging = true;
-        
-        VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-        VkMemoryRequirements memReqs{};
-
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingMemory;
-
-        VkBufferCreateInfo bufferCreateInfo{};
-        bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        bufferCreateInfo.size = bufferSize;
-        bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-        bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-        VK_CHECK_RESULT(vkCreateBuffer(m_device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-        vkGetBufferMemoryRequirements(m_device->logicalDevice, stagingBuffer, &memReqs);
-        memAllocInfo.allocationSize = memReqs.size;
-        memAllocInfo.memoryTypeIndex = m_device->getMemoryType(memReqs.memoryTypeBits,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-        VK_CHECK_RESULT(vkAllocateMemory(m_device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-        VK_CHECK_RESULT(vkBindBufferMemory(m_device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-        uint8_t* data;
-        uint64_t size =  memReqs.size;
-        VK_CHECK_RESULT(vkMapMemory(m_device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-        memcpy(data, buffer, bufferSize);
-        vkUnmapMemory(m_device->logicalDevice, stagingMemory);
+        textures.push_back(textureIter.second);
+    }
+    // Images are decoded a batch at a time on the job system, the batch bounds the decoded memory in flight.
+    // Uploads stay on this thread, which owns the queue.
+    JobSystem *jobSystem = JobSystem::GetInstance();
+    size_t batchSize = jobSystem->GetWorkerCount() + 1;
+    std::vector<DecodedImage> decoded(batchSize);
+    std::vector<std::string> paths(textures.size());
+    for (size_t t = 0; t < textures.size(); t++) {
+        size_t slot = t % batchSize;
+        if (slot == 0) {
+            uint32_t batchCount = static_cast<uint32_t>(std::min(batchSize, textures.size() - t));
+            jobSystem->ParallelFor(batchCount, 1, [&textures, &decoded, &paths, t](uint32_t first, uint32_t count) {
+                for (uint32_t k = first; k < first + count; k++) {
+                    paths[t + k] = "Sponza/text" + textures[t + k]->path;
+                    DecodedImage &image = decoded[k];
+                    image.pixels = TextureStreamer::DecodeImage(paths[t + k], image.width, image.height,
+                        image.components, 0);
+                }
+            });
+        }
+        TRACE_SCOPE("upload texture");
+        std::shared_ptr<Texture> texture = textures[t];
+        int nrComponents = decoded[slot].components;
+        unsigned char *buffer = decoded[slot].pixels;
+        uint32_t width = static_cast<uint32_t>(decoded[slot].width);
+        uint32_t height = static_cast<uint32_t>(decoded[slot].height);
+        uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+        texture->format = nrComponents == 4 ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_R8G8B8_UNORM;
+        texture->texelSize = static_cast<uint32_t>(nrComponents);
+        // With streaming only the mip tail is loaded here, the streamer brings in the levels the view needs
+        uint32_t baseMip = m_streamer != nullptr ? TextureStreamer::GetTailMip(width, height) : 0;
+        std::vector<unsigned char> tail;
+        const unsigned char *pixels = buffer;
+        if (baseMip > 0) {
+            TextureStreamer::Downsample(buffer, width, height, texture->texelSize, baseMip, tail);
+            pixels = tail.data();
+        }
+        texture->width = std::max(1u, width >> baseMip);
+        texture->height = std::max(1u, height >> baseMip);
+        texture->mipLevels = mipLevels - baseMip;
+        CreateTextureImage(texture.get(), texture->format);
+        // The upload manager returns 0 when the image does not fit its staging ring
+        if (m_uploadManager == nullptr || m_uploadManager->UploadImage(texture->image,
+            {texture->width, texture->height}, texture->texelSize, texture->mipLevels, pixels) == 0) {
+            UploadTexture(texture.get(), pixels, texture->texelSize, copyQueue);
+        }
         stbi_image_free(buffer);
+        texture->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        CreateTextureView(texture.get(), texture->format);
+        if (m_streamer != nullptr) {
+            m_streamer->AddTexture(texture, paths[t], width, height, baseMip);
+        }
+    }
+}
 
-        VkImageCreateInfo imageCreateInfo{};
-        imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-        imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-        imageCreateInfo.format = format;
-        imageCreateInfo.mipLevels = texture->mipLevels;
-        imageCreateInfo.arrayLayers = 1;
-        imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-        imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-        imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
-        imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-        imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        imageCreateInfo.extent = { (uint32_t)width, (uint32_t)height, 1 };
-        imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
-            VK_IMAGE_USAGE_SAMPLED_BIT;
-
-        VK_CHECK_RESULT(vkCreateImage(m_device->logicalDevice, &imageCreateInfo, nullptr, &texture->image));
-
-        vkGetImageMemoryRequirements(m_device->logicalDevice, texture->image, &memReqs);
-        memAllocInfo.allocationSize = memReqs.size;
-        memAllocInfo.memoryTypeIndex = m_device->getMemoryType(memReqs.memoryTypeBits,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-        VK_CHECK_RESULT(vkAllocateMemory(m_device->logicalDevice, &memAllocInfo, nullptr, &texture->deviceMemory));
-        VK_CHECK_RESULT(vkBindImageMemory(m_device->logicalDevice, texture->image, texture->deviceMemory, 0));
-
-        VkImageMemoryBarrier imageMemoryBarrier{};
-        VkImageSubresourceRange subresourceRange = {};
-        subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        subresourceRange.levelCount = 1;
-        subresourceRange.layerCount = 1;
-
-        imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        imageMemoryBarrier.srcAccessMask = 0;
-        imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        imageMemoryBarrier.image = texture->image;
-        imageMemoryBarrier.subresourceRange = subresourceRange;
-        vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr,
-            0, nullptr, 1, &imageMemoryBarrier);
-        
-        VkBufferImageCopy bufferCopyRegion = {};
-        bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        bufferCopyRegion.imageSubresource.mipLevel = 0;
-        bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-        bufferCopyRegion.imageSubresource.layerCount = 1;
-        bufferCopyRegion.imageExtent.width = width;
-        bufferCopyRegion.imageExtent.height = height;
-        bufferCopyRegion.imageExtent.depth = 1;
-
-        vkCmdCopyBufferToImage(copyCmd, stagingBuffer, texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
-            &bufferCopyRegion);
-
-        imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-        imageMemoryBarrier.image = texture->image;
-        imageMemoryBarrier.subresourceRange = subresourceRange;
-        vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
-                             nullptr, 1, &imageMemoryBarrier);
-
-        m_device->flushCommandBuffer(copyCmd, copyQueue, true);
-
-        vkDestroyBuffer(m_device->logicalDevice, stagingBuffer, nullptr);
-        vkFreeMemory(m_device->logicalDevice, stagingMemory, nullptr);
-
-        VkCommandBuffer blitCmd = m_device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-        
-        for (uint32_t i = 1; i < texture->mipLevels; i++) {
-            VkImageBlit imageBlit{};
-
-            imageBlit.srcOffsets[0] = {0, 0, 0};
-            imageBlit.srcOffsets[1].x = int32_t(texture->width >> (i - 1));
-            imageBlit.srcOffsets[1].y = int32_t(texture->height >> (i - 1));
-            imageBlit.srcOffsets[1].z = 1;
-            imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            imageBlit.srcSubresource.mipLevel = i - 1;
-            imageBlit.srcSubresource.baseArrayLayer = 0;
-            imageBlit.srcSubresource.layerCount = 1;
-            imageBlit.dstOffsets[0] = {0, 0, 0};
-            imageBlit.dstOffsets[1].x = int32_t(texture->width >> i);
-            imageBlit.dstOffsets[1].y = int32_t(texture->height >> i);
-            imageBlit.dstOffsets[1].z = 1;
-            imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            imageBlit.dstSubresource.layerCount = 1;
-            imageBlit.dstSubresource.mipLevel = i;
-            imageBlit.dstSubresource.baseArrayLayer = 0;
-
-            VkImageSubresourceRange mipSubRange = {};
-            mipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            mipSubRange.baseMipLevel = i;
-            mipSubRange.levelCount = 1;
-            mipSubRange.layerCount = 1;
-
-            {
-                VkImageMemoryBarrier imageMemoryBarrier{};
-                imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-                imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-                imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-                imageMemoryBarrier.srcAccessMask = 0;
-                imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-                imageMemoryBarrier.image = texture->image;
-                imageMemoryBarrier.subresourceRange = mipSubRange;
-                vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
-                                     nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-            }
+void vkOBJ::StaticModel::CreateTextureImage(Texture *texture, VkFormat format)
+{
+    VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+    VkMemoryRequirements memReqs{};
+
+    VkImageCreateInfo imageCreateInfo{};
+    imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageCreateInfo.format = format;
+    imageCreateInfo.mipLevels = texture->mipLevels;
+    imageCreateInfo.arrayLayers = 1;
+    imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageCreateInfo.extent = { texture->width, texture->height, 1 };
+    imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+        VK_IMAGE_USAGE_SAMPLED_BIT;
+
+    VK_CHECK_RESULT(vkCreateImage(m_device->logicalDevice, &imageCreateInfo, nullptr, &texture->image));
+
+    vkGetImageMemoryRequirements(m_device->logicalDevice, texture->image, &memReqs);
+    memAllocInfo.allocationSize = memReqs.size;
+    memAllocInfo.memoryTypeIndex = m_device->getMemoryType(memReqs.memoryTypeBits,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    MemoryCategoryScope memoryScope(MEMORY_CATEGORY_TEXTURES);
+    VK_CHECK_RESULT(vkAllocateMemory(m_device->logicalDevice, &memAllocInfo, nullptr, &texture->deviceMemory));
+    texture->memorySize = memReqs.size;
+    VK_CHECK_RESULT(vkBindImageMemory(m_device->logicalDevice, texture->image, texture->deviceMemory, 0));
+}
 
-            vkCmdBlitImage(blitCmd, texture->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, texture->image,
-                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
-
-            {
-                VkImageMemoryBarrier imageMemoryBarrier{};
-                imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-                imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-                imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-                imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-                imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-                imageMemoryBarrier.image = texture->image;
-                imageMemoryBarrier.subresourceRange = mipSubRange;
-                vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
-                                     nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-            }
-            
-            imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-            imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-            imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-            vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                                 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+void vkOBJ::StaticModel::UploadTexture(Texture *texture, const unsigned char *pixels, uint32_t texelSize,
+    VkQueue copyQueue)
+{
+    VkDeviceSize bufferSize = static_cast<VkDeviceSize>(texture->width) * texture->height * texelSize;
+    VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+    VkMemoryRequirements memReqs{};
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingMemory;
+
+    VkBufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCreateInfo.size = bufferSize;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VK_CHECK_RESULT(vkCreateBuffer(m_device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
+
+    vkGetBufferMemoryRequirements(m_device->logicalDevice, stagingBuffer, &memReqs);
+    memAllocInfo.allocationSize = memReqs.size;
+    memAllocInfo.memoryTypeIndex = m_device->getMemoryType(memReqs.memoryTypeBits,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    MemoryCategoryScope memoryScope(MEMORY_CATEGORY_STAGING);
+    VK_CHECK_RESULT(vkAllocateMemory(m_device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
+    VK_CHECK_RESULT(vkBindBufferMemory(m_device->logicalDevice, stagingBuffer, stagingMemory, 0));
+
+    uint8_t* data;
+    VK_CHECK_RESULT(vkMapMemory(m_device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
+    memcpy(data, pixels, bufferSize);
+    vkUnmapMemory(m_device->logicalDevice, stagingMemory);
+
+    VkCommandBuffer copyCmd = m_device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+    VkImageMemoryBarrier imageMemoryBarrier{};
+    VkImageSubresourceRange subresourceRange = {};
+    subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    subresourceRange.levelCount = 1;
+    subresourceRange.layerCount = 1;
+
+    imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    imageMemoryBarrier.srcAccessMask = 0;
+    imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    imageMemoryBarrier.image = texture->image;
+    imageMemoryBarrier.subresourceRange = subresourceRange;
+    vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr,
+        0, nullptr, 1, &imageMemoryBarrier);
+
+    VkBufferImageCopy bufferCopyRegion = {};
+    bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    bufferCopyRegion.imageSubresource.mipLevel = 0;
+    bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+    bufferCopyRegion.imageSubresource.layerCount = 1;
+    bufferCopyRegion.imageExtent.width = texture->width;
+    bufferCopyRegion.imageExtent.height = texture->height;
+    bufferCopyRegion.imageExtent.depth = 1;
+
+    vkCmdCopyBufferToImage(copyCmd, stagingBuffer, texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+        &bufferCopyRegion);
+
+    imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    imageMemoryBarrier.image = texture->image;
+    imageMemoryBarrier.subresourceRange = subresourceRange;
+    vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                         nullptr, 1, &imageMemoryBarrier);
+
+    m_device->flushCommandBuffer(copyCmd, copyQueue, true);
+
+    vkDestroyBuffer(m_device->logicalDevice, stagingBuffer, nullptr);
+    vkFreeMemory(m_device->logicalDevice, stagingMemory, nullptr);
+
+    VkCommandBuffer blitCmd = m_device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+
+    for (uint32_t i = 1; i < texture->mipLevels; i++) {
+        VkImageBlit imageBlit{};
+
+        imageBlit.srcOffsets[0] = {0, 0, 0};
+        imageBlit.srcOffsets[1].x = int32_t(texture->width >> (i - 1));
+        imageBlit.srcOffsets[1].y = int32_t(texture->height >> (i - 1));
+        imageBlit.srcOffsets[1].z = 1;
+        imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        imageBlit.srcSubresource.mipLevel = i - 1;
+        imageBlit.srcSubresource.baseArrayLayer = 0;
+        imageBlit.srcSubresource.layerCount = 1;
+        imageBlit.dstOffsets[0] = {0, 0, 0};
+        imageBlit.dstOffsets[1].x = int32_t(texture->width >> i);
+        imageBlit.dstOffsets[1].y = int32_t(texture->height >> i);
+        imageBlit.dstOffsets[1].z = 1;
+        imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        imageBlit.dstSubresource.layerCount = 1;
+        imageBlit.dstSubresource.mipLevel = i;
+        imageBlit.dstSubresource.baseArrayLayer = 0;
+
+        VkImageSubresourceRange mipSubRange = {};
+        mipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        mipSubRange.baseMipLevel = i;
+        mipSubRange.levelCount = 1;
+        mipSubRange.layerCount = 1;
+
+        {
+            VkImageMemoryBarrier imageMemoryBarrier{};
+            imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            imageMemoryBarrier.srcAccessMask = 0;
+            imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            imageMemoryBarrier.image = texture->image;
+            imageMemoryBarrier.subresourceRange = mipSubRange;
+            vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                                 nullptr, 0, nullptr, 1, &imageMemoryBarrier);
         }
 
-        subresourceRange.levelCount = texture->mipLevels;
-        texture->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        vkCmdBlitImage(blitCmd, texture->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, texture->image,
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+
+        {
+            VkImageMemoryBarrier imageMemoryBarrier{};
+            imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            imageMemoryBarrier.image = texture->image;
+            imageMemoryBarrier.subresourceRange = mipSubRange;
+            vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                                 nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+        }
 
-        imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-        imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        imageMemoryBarrier.image = texture->image;
-        imageMemoryBarrier.subresourceRange = subresourceRange;
-        vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0,
-                             nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-        m_device->flushCommandBuffer(blitCmd, copyQueue, true);
-
-        VkImageViewCreateInfo viewInfo{};
-        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-        viewInfo.image = texture->image;
-        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-        viewInfo.format = format;
-        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        viewInfo.subresourceRange.layerCount = 1;
-        viewInfo.subresourceRange.levelCount = texture->mipLevels;
-        VK_CHECK_RESULT(vkCreateImageView(m_device->logicalDevice, &viewInfo, nullptr, &texture->view));
-
-        VkSampler sampler;
-        VkSamplerCreateInfo samplerInfo{};
-        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-        samplerInfo.magFilter = VK_FILTER_LINEAR;
-        samplerInfo.minFilter = VK_FILTER_LINEAR;
-        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-        samplerInfo.mipLodBias = 0;
-        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
-        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
-        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
-        samplerInfo.compareOp = VK_COMPARE_OP_NEVER;
-        samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-        samplerInfo.maxAnisotropy = 8.0f;
-        samplerInfo.anisotropyEnable = VK_TRUE;
-        samplerInfo.minLod = 1.0f;
-        samplerInfo.maxLod = texture->mipLevels;
-        VK_CHECK_RESULT(vkCreateSampler(m_device->logicalDevice, &samplerInfo, nullptr, &sampler));
-        texture->sampler = sampler;
-        texture->descriptor.sampler = sampler;
-        texture->descriptor.imageView = texture->view;
-        texture->descriptor.imageLayout = texture->imageLayout;
     }
+
+    subresourceRange.levelCount = texture->mipLevels;
+
+    imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    imageMemoryBarrier.image = texture->image;
+    imageMemoryBarrier.subresourceRange = subresourceRange;
+    vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0,
+                         nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+    m_device->flushCommandBuffer(blitCmd, copyQueue, true);
+}
+
+void vkOBJ::StaticModel::CreateTextureView(Texture *texture, VkFormat format)
+{
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = texture->image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.layerCount = 1;
+    viewInfo.subresourceRange.levelCount = texture->mipLevels;
+    VK_CHECK_RESULT(vkCreateImageView(m_device->logicalDevice, &viewInfo, nullptr, &texture->view));
+
+    VkSampler sampler;
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.mipLodBias = 0;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+    samplerInfo.compareOp = VK_COMPARE_OP_NEVER;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    samplerInfo.maxAnisotropy = 8.0f;
+    samplerInfo.anisotropyEnable = VK_TRUE;
+    samplerInfo.minLod = 1.0f;
+    samplerInfo.maxLod = texture->mipLevels;
+    VK_CHECK_RESULT(vkCreateSampler(m_device->logicalDevice, &samplerInfo, nullptr, &sampler));
+    texture->sampler = sampler;
+    texture->descriptor.sampler = sampler;
+    texture->descriptor.imageView = texture->view;
+    texture->descriptor.imageLayout = texture->imageLayout;
 }
 
 void vkOBJ::StaticModel::InitVulkanDescriptor(VkQueue copyQueue)
@@ -347,7 +422,15 @@ void vkOBJ::StaticModel::InitVulkanDescriptor(VkQueue copyQueue)
 void vkOBJ::StaticModel::Draw(VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout,
     uint32_t bindImageSet)
 {
-    for (auto mesh : m_meshes) {
+    DrawRange(commandBuffer, renderFlags, pipelineLayout, bindImageSet, 0, GetMeshCount());
+}
+
+void vkOBJ::StaticModel::DrawRange(VkCommandBuffer commandBuffer, uint32_t renderFlags,
+    VkPipelineLayout pipelineLayout, uint32_t bindImageSet, uint32_t firstMesh, uint32_t meshCount)
+{
+    uint32_t lastMesh = std::min(firstMesh + meshCount, GetMeshCount());
+    for (uint32_t i = firstMesh; i < lastMesh; i++) {
+        const std::shared_ptr<StaticMeshNode> &mesh = m_meshes[i];
         const VkDeviceSize offsets[1] = { 0 };
         vkCmdBindVertexBuffers(commandBuffer, 0, 1, &mesh->vertices.buffer, offsets);
         vkCmdBindIndexBuffer(commandBuffer, mesh->indices.buffer, 0, VK_INDEX_TYPE_UINT32);
@@ -359,8 +442,28 @@ void vkOBJ::StaticModel::Draw(VkCommandBuffer commandBuffer, uint32_t renderFlag
     }
 }
 
+bool vkOBJ::StaticModel::UpdateStreaming(const StreamingView &view, uint64_t frameIndex)
+{
+    return m_streamer != nullptr && m_streamer->Update(view, frameIndex);
+}
+
+bool vkOBJ::StaticModel::GetStreamingStats(StreamingStats &stats) const
+{
+    if (m_streamer == nullptr) {
+        return false;
+    }
+    m_streamer->GetStats(stats);
+    return true;
+}
+
 void vkOBJ::StaticModel::ReleaseVulkanResource()
 {
+    // Buffers and images may still be targets of uploads
+    delete m_streamer;
+    m_streamer = nullptr;
+    if (m_uploadManager != nullptr) {
+        m_uploadManager->Wait(m_uploadManager->Flush());
+    }
     for (int i = 0; i < m_textures.size(); i++) {
         for (int j = 0; j < m_textures[i].size(); j++) {
             m_textures[i][j]->Destory(m_device->logicalDevice);
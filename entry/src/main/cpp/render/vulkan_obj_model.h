@@ -35,21 +35,26 @@
 #include "vulkan/vulkan.h"
 #include "VulkanDevice.h"
 #include "vulkan_obj_mesh.h"
+#include "upload_manager.h"
+#include "texture_streamer.h"
 
 namespace vkOBJ {
     enum class VertexComponent {Position, Normal, UV};
     static std::vector<aiTextureType> textureTypes = {aiTextureType_DIFFUSE};
     struct Texture {
         vks::VulkanDevice* device = nullptr;
-        VkImage image;
+        VkImage image = VK_NULL_HANDLE;
         VkImageLayout imageLayout;
-        VkDeviceMemory deviceMemory;
-        VkImageView view;
+        VkDeviceMemory deviceMemory = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
         uint32_t width, height;
         uint32_t mipLevels;
         uint32_t layerCount;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        uint32_t texelSize = 0;
+        VkDeviceSize memorySize = 0;
         VkDescriptorImageInfo descriptor;
-        VkSampler sampler;
+        VkSampler sampler = VK_NULL_HANDLE;
         VkDescriptorSet descriptorSet;
         std::string path;
         std::string type;
@@ -70,6 +75,7 @@ namespace vkOBJ {
 
     class StaticModel {
         friend class StaticMeshNode;
+        friend class TextureStreamer;
     public:
         StaticModel() = default;
         StaticModel(vks::VulkanDevice *device):m_device(device) {}
@@ -77,15 +83,30 @@ namespace vkOBJ {
         {
 
         }
-        void LoadFromFile(std::string filename, vks::VulkanDevice *device, VkQueue transferQueue);
+        // Uploads go through uploadManager when given, otherwise each one blocks on transferQueue
+        void LoadFromFile(std::string filename, vks::VulkanDevice *device, VkQueue transferQueue,
+            UploadManager *uploadManager = nullptr);
         void Draw(VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout,
             uint32_t bindImageSet);
+        // Draws meshes [firstMesh, firstMesh + meshCount), lets several threads record one model
+        void DrawRange(VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout,
+            uint32_t bindImageSet, uint32_t firstMesh, uint32_t meshCount);
+        uint32_t GetMeshCount() const { return static_cast<uint32_t>(m_meshes.size()); }
+        // Call before LoadFromFile. Textures then load their mip tail and stream the levels the view needs within
+        // budget bytes, needs an upload manager.
+        void EnableStreaming(VkDeviceSize budget) { m_streamingBudget = budget; }
+        // Returns true when descriptor sets were rewritten, command buffers recorded with them must be rebuilt
+        bool UpdateStreaming(const StreamingView &view, uint64_t frameIndex);
+        bool GetStreamingStats(StreamingStats &stats) const;
         VkDescriptorSetLayout m_descriptorSetLayoutImage;
         void Destory() { ReleaseVulkanResource(); }
 
     protected:
         void InitVulkanResource(VkQueue transferQueue);
         void InitVulkanTexture(VkQueue copyQueue);
+        void CreateTextureImage(Texture *texture, VkFormat format);
+        void UploadTexture(Texture *texture, const unsigned char *pixels, uint32_t texelSize, VkQueue copyQueue);
+        void CreateTextureView(Texture *texture, VkFormat format);
         void GenerateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight,
             uint32_t mipLevels);
         void InitVulkanDescriptor(VkQueue copyQueue);
@@ -98,6 +119,9 @@ namespace vkOBJ {
         vks::VulkanDevice* m_device;
         VkDescriptorPool m_descriptorPool;
         VkQueue m_transferQueue;
+        UploadManager *m_uploadManager = nullptr;
+        VkDeviceSize m_streamingBudget = 0;
+        TextureStreamer *m_streamer = nullptr;
         std::string m_directory;
         std::vector<std::shared_ptr<StaticMeshNode>> m_meshes;
         std::vector<std::vector<std::shared_ptr<Texture>>> m_textures;
@@ -10,6 +10,7 @@
 
 #include <VulkanDevice.h>
 #include <unordered_set>
+#include "common/trace.h"
 
 namespace vks
 {	
@@ -60,9 +61,10 @@ namespace vks
 	*/
 	VulkanDevice::~VulkanDevice()
 	{
-		if (commandPool)
+		// commandPool is the pool of the thread that created the device
+		for (auto &threadCommandPool : threadCommandPools)
 		{
-			vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
+			vkDestroyCommandPool(logicalDevice, threadCommandPool.second, nullptr);
 		}
 		if (logicalDevice)
 		{
@@ -283,6 +285,7 @@ namespace vks
 		}
 
 		this->enabledFeatures = enabledFeatures;
+		this->enabledExtensions.assign(deviceExtensions.begin(), deviceExtensions.end());
 
         LOGI("vkCreateDevice device： &deviceCreateInfo :p %{public}p", &deviceCreateInfo);
         VkResult result = vkCreateDevice(physicalDevice, &deviceCreateInfo, nullptr, &logicalDevice);
@@ -295,6 +298,7 @@ namespace vks
 
 		// Create a default command pool for graphics command buffers
 		commandPool = createCommandPool(queueFamilyIndices.graphics);
+		threadCommandPools[std::this_thread::get_id()] = commandPool;
 
 		return result;
 	}
@@ -494,7 +498,45 @@ namespace vks
 			
 	VkCommandBuffer VulkanDevice::createCommandBuffer(VkCommandBufferLevel level, bool begin)
 	{
-		return createCommandBuffer(level, commandPool, begin);
+		return createCommandBuffer(level, getThreadCommandPool(), begin);
+	}
+
+	/**
+	* Get the default command pool of the calling thread, created on first use
+	*
+	* @note A thread that stops calls destroyThreadCommandPool, the device destroys the pools left at its destruction
+	*
+	* @return A command pool for the graphics queue family index only the calling thread uses
+	*/
+	VkCommandPool VulkanDevice::getThreadCommandPool()
+	{
+		std::lock_guard<std::mutex> lock(threadCommandPoolMutex);
+		VkCommandPool &pool = threadCommandPools[std::this_thread::get_id()];
+		if (pool == VK_NULL_HANDLE)
+		{
+			pool = createCommandPool(queueFamilyIndices.graphics);
+		}
+		return pool;
+	}
+
+	/**
+	* Destroy the default command pool of the calling thread, called by a thread that stops using the device
+	*
+	* @note Command buffers allocated from the pool must have completed execution, the pool of the thread that created the device is kept
+	*/
+	void VulkanDevice::destroyThreadCommandPool()
+	{
+		std::lock_guard<std::mutex> lock(threadCommandPoolMutex);
+		auto threadCommandPool = threadCommandPools.find(std::this_thread::get_id());
+		if (threadCommandPool == threadCommandPools.end() || threadCommandPool->second == commandPool)
+		{
+			return;
+		}
+		if (threadCommandPool->second != VK_NULL_HANDLE)
+		{
+			vkDestroyCommandPool(logicalDevice, threadCommandPool->second, nullptr);
+		}
+		threadCommandPools.erase(threadCommandPool);
 	}
 
 	/**
@@ -514,6 +556,7 @@ namespace vks
 		{
 			return;
 		}
+		TRACE_SCOPE("flushCommandBuffer");
 
 		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
 
@@ -525,7 +568,10 @@ namespace vks
 		VkFence fence;
 		VK_CHECK_RESULT(vkCreateFence(logicalDevice, &fenceInfo, nullptr, &fence));
 		// Submit to the queue
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
+		}
 		// Wait for the fence to signal that command buffer has finished executing
 		VK_CHECK_RESULT(vkWaitForFences(logicalDevice, 1, &fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
 		vkDestroyFence(logicalDevice, fence, nullptr);
@@ -537,7 +583,20 @@ namespace vks
 
 	void VulkanDevice::flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, bool free)
 	{
-		return flushCommandBuffer(commandBuffer, queue, commandPool, free);
+		return flushCommandBuffer(commandBuffer, queue, getThreadCommandPool(), free);
+	}
+
+	/**
+	* Wait until every queue of the device is idle
+	*
+	* @note The queues are shared, this waits for the work of every render thread
+	*
+	* @return VkResult of vkDeviceWaitIdle
+	*/
+	VkResult VulkanDevice::waitIdle()
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		return vkDeviceWaitIdle(logicalDevice);
 	}
 
 	/**
@@ -15,6 +15,9 @@
 #include <algorithm>
 #include <assert.h>
 #include <exception>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
 namespace vks
 {
@@ -30,14 +33,21 @@ struct VulkanDevice
 	VkPhysicalDeviceFeatures features;
 	/** @brief Features that have been enabled for use on the physical device */
 	VkPhysicalDeviceFeatures enabledFeatures;
+	/** @brief Extensions the logical device has been created with */
+	std::vector<std::string> enabledExtensions;
 	/** @brief Memory types and heaps of the physical device */
 	VkPhysicalDeviceMemoryProperties memoryProperties;
 	/** @brief Queue family properties of the physical device */
 	std::vector<VkQueueFamilyProperties> queueFamilyProperties;
 	/** @brief List of extensions supported by the device */
 	std::vector<std::string> supportedExtensions;
-	/** @brief Default command pool for the graphics queue family index */
+	/** @brief Default command pool for the graphics queue family index, of the thread that created the device */
 	VkCommandPool commandPool = VK_NULL_HANDLE;
+	/** @brief Default command pools by thread, a pool and its command buffers must not be used by two threads at once */
+	std::unordered_map<std::thread::id, VkCommandPool> threadCommandPools;
+	std::mutex threadCommandPoolMutex;
+	/** @brief Held around queue submissions, presents and wait idles, the device is shared by every render thread */
+	std::mutex queueMutex;
 	/** @brief Contains queue family indices */
 	struct
 	{
@@ -60,9 +70,12 @@ struct VulkanDevice
 	VkCommandPool   createCommandPool(uint32_t queueFamilyIndex, VkCommandPoolCreateFlags createFlags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 	VkCommandBuffer createCommandBuffer(VkCommandBufferLevel level, VkCommandPool pool, bool begin = false);
 	VkCommandBuffer createCommandBuffer(VkCommandBufferLevel level, bool begin = false);
+	VkCommandPool   getThreadCommandPool();
+	void            destroyThreadCommandPool();
 	void            flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, VkCommandPool pool, bool free = true);
 	void            flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, bool free = true);
 	bool            extensionSupported(std::string extension);
+	VkResult        waitIdle();
 	VkFormat        getSupportedDepthFormat(bool checkSamplingSupport);
 };
 }        // namespace vks
@@ -24,6 +24,7 @@ PFN_vkGetPhysicalDeviceFeatures vkGetPhysicalDeviceFeatures;
 PFN_vkGetPhysicalDeviceFeatures2 vkGetPhysicalDeviceFeatures2;
 PFN_vkGetPhysicalDeviceQueueFamilyProperties vkGetPhysicalDeviceQueueFamilyProperties;
 PFN_vkGetPhysicalDeviceMemoryProperties vkGetPhysicalDeviceMemoryProperties;
+PFN_vkGetPhysicalDeviceMemoryProperties2 vkGetPhysicalDeviceMemoryProperties2;
 PFN_vkEnumerateInstanceExtensionProperties vkEnumerateInstanceExtensionProperties;
 PFN_vkEnumerateInstanceLayerProperties vkEnumerateInstanceLayerProperties;
 PFN_vkCmdPipelineBarrier vkCmdPipelineBarrier;
@@ -41,6 +42,7 @@ PFN_vkBindImageMemory vkBindImageMemory;
 PFN_vkGetImageSubresourceLayout vkGetImageSubresourceLayout;
 PFN_vkCmdCopyBuffer vkCmdCopyBuffer;
 PFN_vkCmdCopyBufferToImage vkCmdCopyBufferToImage;
+PFN_vkCmdCopyImageToBuffer vkCmdCopyImageToBuffer;
 PFN_vkCmdCopyImage vkCmdCopyImage;
 PFN_vkCmdBlitImage vkCmdBlitImage;
 PFN_vkCmdClearAttachments vkCmdClearAttachments;
@@ -64,6 +66,7 @@ PFN_vkCreateFence vkCreateFence;
 PFN_vkDestroyFence vkDestroyFence;
 PFN_vkWaitForFences vkWaitForFences;
 PFN_vkResetFences vkResetFences;
+PFN_vkGetFenceStatus vkGetFenceStatus;
 PFN_vkResetDescriptorPool vkResetDescriptorPool;
 PFN_vkCreateCommandPool vkCreateCommandPool;
 PFN_vkDestroyCommandPool vkDestroyCommandPool;
@@ -115,6 +118,7 @@ PFN_vkCmdBeginQuery vkCmdBeginQuery;
 PFN_vkCmdEndQuery vkCmdEndQuery;
 PFN_vkCmdResetQueryPool vkCmdResetQueryPool;
 PFN_vkCmdCopyQueryPoolResults vkCmdCopyQueryPoolResults;
+PFN_vkCmdWriteTimestamp vkCmdWriteTimestamp;
 
 PFN_vkCreateSurfaceOHOS vkCreateSurfaceOHOS;
 PFN_vkDestroySurfaceKHR vkDestroySurfaceKHR;
@@ -123,6 +127,10 @@ PFN_vkCmdFillBuffer vkCmdFillBuffer;
 PFN_vkGetPhysicalDeviceFragmentShadingRatesKHR vkGetPhysicalDeviceFragmentShadingRatesKHR;
 PFN_vkCmdSetFragmentShadingRateKHR vkCmdSetFragmentShadingRateKHR;
 PFN_vkCreateRenderPass2KHR vkCreateRenderPass2KHR;
+PFN_vkWaitSemaphores vkWaitSemaphores;
+PFN_vkGetSemaphoreCounterValue vkGetSemaphoreCounterValue;
+PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT vkGetPhysicalDeviceCalibrateableTimeDomainsEXT;
+PFN_vkGetCalibratedTimestampsEXT vkGetCalibratedTimestampsEXT;
 
 void *libVulkan;
 
@@ -173,6 +181,8 @@ namespace vks {
                 vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFormatProperties"));
             vkGetPhysicalDeviceMemoryProperties = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties>(
                 vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties"));
+            vkGetPhysicalDeviceMemoryProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2>(
+                vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2"));
             vkCmdPipelineBarrier =
                 reinterpret_cast<PFN_vkCmdPipelineBarrier>(vkGetInstanceProcAddr(instance, "vkCmdPipelineBarrier"));
             vkCreateShaderModule =
@@ -227,6 +237,8 @@ namespace vks {
             vkCmdCopyBuffer = reinterpret_cast<PFN_vkCmdCopyBuffer>(vkGetInstanceProcAddr(instance, "vkCmdCopyBuffer"));
             vkCmdCopyBufferToImage =
                 reinterpret_cast<PFN_vkCmdCopyBufferToImage>(vkGetInstanceProcAddr(instance, "vkCmdCopyBufferToImage"));
+            vkCmdCopyImageToBuffer =
+                reinterpret_cast<PFN_vkCmdCopyImageToBuffer>(vkGetInstanceProcAddr(instance, "vkCmdCopyImageToBuffer"));
 
             vkCreateSampler = reinterpret_cast<PFN_vkCreateSampler>(vkGetInstanceProcAddr(instance, "vkCreateSampler"));
             vkDestroySampler =
@@ -242,6 +254,8 @@ namespace vks {
             vkDestroyFence = reinterpret_cast<PFN_vkDestroyFence>(vkGetInstanceProcAddr(instance, "vkDestroyFence"));
             vkWaitForFences = reinterpret_cast<PFN_vkWaitForFences>(vkGetInstanceProcAddr(instance, "vkWaitForFences"));
             vkResetFences = reinterpret_cast<PFN_vkResetFences>(vkGetInstanceProcAddr(instance, "vkResetFences"));
+            vkGetFenceStatus =
+                reinterpret_cast<PFN_vkGetFenceStatus>(vkGetInstanceProcAddr(instance, "vkGetFenceStatus"));
             ;
             vkResetDescriptorPool =
                 reinterpret_cast<PFN_vkResetDescriptorPool>(vkGetInstanceProcAddr(instance, "vkResetDescriptorPool"));
@@ -354,6 +368,8 @@ namespace vks {
                 reinterpret_cast<PFN_vkCmdResetQueryPool>(vkGetInstanceProcAddr(instance, "vkCmdResetQueryPool"));
             vkCmdCopyQueryPoolResults = reinterpret_cast<PFN_vkCmdCopyQueryPoolResults>(
                 vkGetInstanceProcAddr(instance, "vkCmdCopyQueryPoolResults"));
+            vkCmdWriteTimestamp =
+                reinterpret_cast<PFN_vkCmdWriteTimestamp>(vkGetInstanceProcAddr(instance, "vkCmdWriteTimestamp"));
 
             vkCreateSurfaceOHOS =
                 reinterpret_cast<PFN_vkCreateSurfaceOHOS>(vkGetInstanceProcAddr(instance, "vkCreateSurfaceOHOS"));
@@ -372,6 +388,12 @@ namespace vks {
                     reinterpret_cast<PFN_vkGetPhysicalDeviceFragmentShadingRatesKHR>(
                         vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFragmentShadingRatesKHR"));
             }
+
+            if (!vkGetPhysicalDeviceCalibrateableTimeDomainsEXT) {
+                vkGetPhysicalDeviceCalibrateableTimeDomainsEXT =
+                    reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT>(
+                        vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"));
+            }
         }
         void freeVulkanLibrary() { dlclose(libVulkan); }
 
@@ -381,6 +403,20 @@ namespace vks {
                 vkCmdSetFragmentShadingRateKHR = reinterpret_cast<PFN_vkCmdSetFragmentShadingRateKHR>(
                     vkGetDeviceProcAddr(device, "vkCmdSetFragmentShadingRateKHR"));
             }
+            // Timeline semaphores are core in 1.2, used by the upload manager
+            if (!vkWaitSemaphores) {
+                vkWaitSemaphores =
+                    reinterpret_cast<PFN_vkWaitSemaphores>(vkGetDeviceProcAddr(device, "vkWaitSemaphores"));
+            }
+            if (!vkGetSemaphoreCounterValue) {
+                vkGetSemaphoreCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValue>(
+                    vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValue"));
+            }
+            // VK_EXT_calibrated_timestamps, null when the device does not have it
+            if (!vkGetCalibratedTimestampsEXT) {
+                vkGetCalibratedTimestampsEXT = reinterpret_cast<PFN_vkGetCalibratedTimestampsEXT>(
+                    vkGetDeviceProcAddr(device, "vkGetCalibratedTimestampsEXT"));
+            }
         }
     }
 }
\ No newline at end of file
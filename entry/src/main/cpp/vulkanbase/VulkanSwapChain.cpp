@@ -169,7 +169,6 @@ void VulkanSwapChain::connect(VkInstance instance, VkPhysicalDevice physicalDevi
 * 
 * @param width Pointer to the width of the swapchain (may be adjusted to fit the requirements of the swapchain)
 * @param height Pointer to the height of the swapchain (may be adjusted to fit the requirements of the swapchain)
-* @param vsync (Optional) Can be used to force vsync-ed rendering (by using VK_PRESENT_MODE_FIFO_KHR as presentation mode)
 */
 void VulkanSwapChain::create(uint32_t *width, uint32_t *height)
 {
@@ -211,7 +210,20 @@ void VulkanSwapChain::create(uint32_t *width, uint32_t *height)
 
 	// The VK_PRESENT_MODE_FIFO_KHR mode must always be present as per spec
 	// This mode waits for the vertical blank ("v-sync")
-	VkPresentModeKHR swapchainPresentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+	VkPresentModeKHR swapchainPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+	for (VkPresentModeKHR mode : presentModes)
+	{
+		if (mode == presentMode)
+		{
+			swapchainPresentMode = presentMode;
+			break;
+		}
+	}
+	if (swapchainPresentMode != presentMode)
+	{
+		LOGW("VulkanSwapChain present mode %{public}d not supported, using FIFO", presentMode);
+	}
+	activePresentMode = swapchainPresentMode;
 
 	// Determine the number of images
 	uint32_t desiredNumberOfSwapchainImages = surfCaps.minImageCount + 1;
@@ -54,6 +54,10 @@ public:
 	std::vector<VkImage> images;
 	std::vector<SwapChainBuffer> buffers;
 	uint32_t queueNodeIndex = UINT32_MAX;
+	// Requested by the application, create falls back to FIFO when the surface does not support it
+	VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+	// Mode of the current swap chain
+	VkPresentModeKHR activePresentMode = VK_PRESENT_MODE_FIFO_KHR;
 
 	void initSurface(NativeWindow* window);
 
@@ -7,6 +7,7 @@
 */
 
 #include <VulkanTexture.h>
+#include "file/mapped_file.h"
 
 namespace vks
 {
@@ -45,7 +46,12 @@ namespace vks
 		delete[] textureData;
 #else
 
-		result = ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, target);			
+		// libktx copies the image data out of the mapping, it can go away right after
+		MappedFile file;
+		if (!file.Open(filename)) {
+			return KTX_FILE_OPEN_FAILED;
+		}
+		result = ktxTexture_CreateFromMemory(file.Data(), file.Size(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, target);
 #endif		
 		return result;
 	}
@@ -7,6 +7,7 @@
 */
 
 #include "VulkanTools.h"
+#include "file/mapped_file.h"
 
 
 namespace vks
@@ -292,28 +293,21 @@ namespace vks
 
 		VkShaderModule loadShader(const char *fileName, VkDevice device)
 		{
-			std::ifstream is(fileName, std::ios::binary | std::ios::in | std::ios::ate);
-
-			if (is.is_open())
+			// Page aligned mapping, so pCode is suitably aligned without a copy
+			MappedFile file;
+			if (file.Open(fileName, MappedFile::ACCESS_WILLNEED))
 			{
-				size_t size = is.tellg();
-				is.seekg(0, std::ios::beg);
-				char* shaderCode = new char[size];
-				is.read(shaderCode, size);
-				is.close();
-
+				size_t size = file.Size();
 				assert(size > 0);
 
 				VkShaderModule shaderModule;
 				VkShaderModuleCreateInfo moduleCreateInfo{};
 				moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
 				moduleCreateInfo.codeSize = size;
-				moduleCreateInfo.pCode = (uint32_t*)shaderCode;
+				moduleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(file.Data());
 
 				VK_CHECK_RESULT(vkCreateShaderModule(device, &moduleCreateInfo, NULL, &shaderModule));
 
-				delete[] shaderCode;
-
 				return shaderModule;
 			}
 			else
@@ -8,6 +8,10 @@
 
 #include "vulkanexamplebase.h"
 #include "common/common.h"
+#include "common/trace.h"
+
+VulkanExampleBase::SharedContext VulkanExampleBase::sharedContext;
+std::mutex VulkanExampleBase::sharedContextMutex;
 
 VkResult VulkanExampleBase::createInstance()
 {
@@ -87,9 +91,8 @@ void VulkanExampleBase::destroyCommandBuffers()
 
 void VulkanExampleBase::createPipelineCache()
 {
-	VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
-	pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-	VK_CHECK_RESULT(vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache));
+	// Created with the shared device, pipelines of one example are compiled once for all of them
+	pipelineCache = sharedContext.pipelineCache;
 }
 
 bool VulkanExampleBase::prepare()
@@ -124,39 +127,73 @@ VkPipelineShaderStageCreateInfo VulkanExampleBase::loadShader(std::string fileNa
 	return shaderStage;
 }
 
-void VulkanExampleBase::renderLoop()
+void VulkanExampleBase::renderLoop(const std::function<bool()> &beginFrame)
 {
 	destWidth = screenWidth;
 	destHeight = screenHeight;
 	lastTimestamp = std::chrono::high_resolution_clock::now();
+	frameCounter = 0;
+	framePacer.Reset();
 
-    // Render frame
-    if (prepared)
+    while (prepared && beginFrame())
     {
+        TRACE_SCOPE("frame");
+        // The frame delta includes the pacing wait, the camera moves at wall clock speed whatever the frame rate
+        float frameDelta;
+        {
+            TRACE_SCOPE("pace");
+            frameDelta = framePacer.BeginFrame();
+        }
         auto tStart = std::chrono::high_resolution_clock::now();
-        render();
+        {
+            TRACE_SCOPE("render");
+            render();
+        }
         frameCounter++;
         auto tEnd = std::chrono::high_resolution_clock::now();
         auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
         frameTimer = tDiff / 1000.0f;
-        camera.update(frameTimer);
+        camera.update(frameDelta);
         float fpsTimer = std::chrono::duration<double, std::milli>(tEnd - lastTimestamp).count();
         if (fpsTimer > 1000.0f) {
             lastFPS = (float)frameCounter * (1000.0f / fpsTimer);
             frameCounter = 0;
             lastTimestamp = tEnd;
         }
-        LOGD("VulkanExampleBase cost time: %{public}f", fpsTimer);
-        bool updateView = false;
+        LOGD_RATE(1000, "VulkanExampleBase cost time: %{public}f, fps %{public}u", tDiff, lastFPS);
     }
 	// Flush device to make sure all resources can be freed
-	if (device != VK_NULL_HANDLE) {
-        vkDeviceWaitIdle(device);
+	if (vulkanDevice != nullptr) {
+        vulkanDevice->waitIdle();
     }
 }
 
+void VulkanExampleBase::setPresentMode(VkPresentModeKHR presentMode)
+{
+	LOGI("VulkanExampleBase::setPresentMode %{public}d", presentMode);
+	if (swapChain.presentMode == presentMode) {
+		return;
+	}
+	swapChain.presentMode = presentMode;
+	// Before prepare the mode is picked up by the first swap chain
+	if (prepared) {
+		windowResize();
+	}
+}
+
+void VulkanExampleBase::setFrameRateLimit(uint32_t targetFps, float displayRefreshRate)
+{
+	framePacer.SetTargetFps(targetFps, displayRefreshRate);
+}
+
+void VulkanExampleBase::drawUI(const VkCommandBuffer commandBuffer)
+{
+	// Samples without an overlay draw nothing
+}
+
 void VulkanExampleBase::prepareFrame()
 {
+	TRACE_SCOPE("acquire");
 	// Acquire the next image from the swap chain
 	VkResult result = swapChain.acquireNextImage(semaphores.presentComplete, &currentBuffer);
 	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE) or no longer optimal for presentation (SUBOPTIMAL)
@@ -174,7 +211,12 @@ void VulkanExampleBase::prepareFrame()
 
 void VulkanExampleBase::submitFrame()
 {
-	VkResult result = swapChain.queuePresent(queue, currentBuffer, semaphores.renderComplete);
+	VkResult result;
+	{
+		TRACE_SCOPE("present");
+		std::lock_guard<std::mutex> lock(vulkanDevice->queueMutex);
+		result = swapChain.queuePresent(queue, currentBuffer, semaphores.renderComplete);
+	}
     if (!((result == VK_SUCCESS) || (result == VK_SUBOPTIMAL_KHR))) {
 		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
 			// Swap chain is no longer compatible with the surface and needs to be recreated
@@ -186,7 +228,9 @@ void VulkanExampleBase::submitFrame()
 		}
 	}
     
-	VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+	// Waits for this example's frame only, a queue wait idle would hold every render thread sharing the queue
+	TRACE_SCOPE("vkWaitForFences");
+	VK_CHECK_RESULT(vkWaitForFences(device, 1, &waitFences[currentBuffer], VK_TRUE, UINT64_MAX));
 }
 
 VulkanExampleBase::VulkanExampleBase()
@@ -229,8 +273,6 @@ VulkanExampleBase::~VulkanExampleBase()
 	vkDestroyImage(device, depthStencil.image, nullptr);
 	vkFreeMemory(device, depthStencil.mem, nullptr);
 
-	vkDestroyPipelineCache(device, pipelineCache, nullptr);
-
 	vkDestroyCommandPool(device, cmdPool, nullptr);
 
 	vkDestroySemaphore(device, semaphores.presentComplete, nullptr);
@@ -239,13 +281,48 @@ VulkanExampleBase::~VulkanExampleBase()
 		vkDestroyFence(device, fence, nullptr);
 	}
 
-	delete vulkanDevice;
+	releaseSharedContext();
+}
 
-	vkDestroyInstance(instance, nullptr);
+void VulkanExampleBase::releaseSharedContext()
+{
+	if (!sharesContext) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(sharedContextMutex);
+	sharesContext = false;
+	if (--sharedContext.users > 0) {
+		return;
+	}
+	vkDestroyPipelineCache(sharedContext.vulkanDevice->logicalDevice, sharedContext.pipelineCache, nullptr);
+	delete sharedContext.vulkanDevice;
+	vkDestroyInstance(sharedContext.instance, nullptr);
+	sharedContext = SharedContext();
 }
 
 
 
+bool VulkanExampleBase::sharedDeviceSupportsRequest() const
+{
+	// VkPhysicalDeviceFeatures is a plain array of VkBool32
+	const VkBool32 *requested = reinterpret_cast<const VkBool32 *>(&enabledFeatures);
+	const VkBool32 *enabled = reinterpret_cast<const VkBool32 *>(&sharedContext.vulkanDevice->enabledFeatures);
+	for (size_t i = 0; i < sizeof(VkPhysicalDeviceFeatures) / sizeof(VkBool32); i++) {
+		if (requested[i] && !enabled[i]) {
+			LOGE("shared device was created without feature %{public}zu", i);
+			return false;
+		}
+	}
+	const std::vector<std::string> &extensions = sharedContext.vulkanDevice->enabledExtensions;
+	for (const char *extension : enabledDeviceExtensions) {
+		if (std::find(extensions.begin(), extensions.end(), extension) == extensions.end()) {
+			LOGE("shared device was created without extension %{public}s", extension);
+			return false;
+		}
+	}
+	return true;
+}
+
 bool VulkanExampleBase::initVulkan()
 {
 	VkResult err;
@@ -254,60 +331,94 @@ bool VulkanExampleBase::initVulkan()
         return false;
     }
 
-	// Vulkan instance
-	err = createInstance();
-	if (err) {
-		std::cout << "Could not create Vulkan instance : " << err << std::endl;
-		return false;
-	}
+	// The first example creates the instance and the device, the other examples render with them too
+	std::lock_guard<std::mutex> lock(sharedContextMutex);
+	bool shared = sharedContext.users > 0;
+	if (shared) {
+		instance = sharedContext.instance;
+		physicalDevice = sharedContext.physicalDevice;
+	} else {
+		// Vulkan instance
+		err = createInstance();
+		if (err) {
+			std::cout << "Could not create Vulkan instance : " << err << std::endl;
+			return false;
+		}
 
-	vks::ohos::loadVulkanFunctions(instance);
+		vks::ohos::loadVulkanFunctions(instance);
 
-	// Physical device
-	uint32_t gpuCount = 0;
-	// Get number of available physical devices
-    VK_CHECK_RESULT(vkEnumeratePhysicalDevices(instance, &gpuCount, nullptr));
-    if (gpuCount == 0) {
-		std::cout << "No device with Vulkan support found" << std::endl;
-		return false;
-	}
-	// Enumerate devices
-	std::vector<VkPhysicalDevice> physicalDevices(gpuCount);
-	err = vkEnumeratePhysicalDevices(instance, &gpuCount, physicalDevices.data());
-	if (err) {
-		std::cout << "Could not enumerate physical devices : \n";
-		return false;
-	}
+		// Physical device
+		uint32_t gpuCount = 0;
+		// Get number of available physical devices
+		VK_CHECK_RESULT(vkEnumeratePhysicalDevices(instance, &gpuCount, nullptr));
+		if (gpuCount == 0) {
+			std::cout << "No device with Vulkan support found" << std::endl;
+			vkDestroyInstance(instance, nullptr);
+			return false;
+		}
+		// Enumerate devices
+		std::vector<VkPhysicalDevice> physicalDevices(gpuCount);
+		err = vkEnumeratePhysicalDevices(instance, &gpuCount, physicalDevices.data());
+		if (err) {
+			std::cout << "Could not enumerate physical devices : \n";
+			vkDestroyInstance(instance, nullptr);
+			return false;
+		}
 
-	// GPU selection
+		// GPU selection
 
-	// Select physical device to be used for the Vulkan example
-	// Defaults to the first device unless specified by command line
-	uint32_t selectedDevice = 0;
+		// Select physical device to be used for the Vulkan example
+		// Defaults to the first device unless specified by command line
+		uint32_t selectedDevice = 0;
 
-	physicalDevice = physicalDevices[selectedDevice];
+		physicalDevice = physicalDevices[selectedDevice];
+	}
 
 	// Store properties (including limits), features and memory properties of the physical device (so that examples can check against them)
 	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
 	vkGetPhysicalDeviceFeatures(physicalDevice, &deviceFeatures);
 	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &deviceMemoryProperties);
     
+    // Also run for a shared device, examples read back the features and extensions they asked for
     getEnabledFeatures();
 
-	// Vulkan device creation
-	// This is handled by a separate class that gets a logical device representation
-	// and encapsulates functions related to a device
-	vulkanDevice = new vks::VulkanDevice(physicalDevice);
-	VkResult res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions, deviceCreatepNextChain);
-	if (res != VK_SUCCESS) {
-		LOGE("create logic device failed");
-		return false;
+	if (shared) {
+		// Created with the features and extensions of the first example, a later one may only request a subset
+		if (!sharedDeviceSupportsRequest()) {
+			return false;
+		}
+		vulkanDevice = sharedContext.vulkanDevice;
+	} else {
+		// Vulkan device creation
+		// This is handled by a separate class that gets a logical device representation
+		// and encapsulates functions related to a device
+		vulkanDevice = new vks::VulkanDevice(physicalDevice);
+		VkResult res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions,
+			deviceCreatepNextChain, true, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT);
+		if (res != VK_SUCCESS) {
+			LOGE("create logic device failed");
+			delete vulkanDevice;
+			vulkanDevice = nullptr;
+			vkDestroyInstance(instance, nullptr);
+			return false;
+		}
+		vks::ohos::loadDeviceFunc(vulkanDevice->logicalDevice);
+
+		VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
+		pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		VK_CHECK_RESULT(vkCreatePipelineCache(vulkanDevice->logicalDevice, &pipelineCacheCreateInfo, nullptr,
+			&sharedContext.pipelineCache));
+		sharedContext.instance = instance;
+		sharedContext.physicalDevice = physicalDevice;
+		sharedContext.vulkanDevice = vulkanDevice;
 	}
+	sharedContext.users++;
+	sharesContext = true;
 	device = vulkanDevice->logicalDevice;
-    vks::ohos::loadDeviceFunc(device);
 
     // Get a graphics queue from the device
     vkGetDeviceQueue(device, vulkanDevice->queueFamilyIndices.graphics, 0, &queue);
+    vkGetDeviceQueue(device, vulkanDevice->queueFamilyIndices.transfer, 0, &transferQueue);
 
     // Find a suitable depth format
 	VkBool32 validDepthFormat = vks::tools::getSupportedDepthFormat(physicalDevice, &depthFormat);
@@ -521,7 +632,7 @@ void VulkanExampleBase::windowResize()
 	resized = true;
 
 	// Ensure all operations on the device have been finished before destroying resources
-	vkDeviceWaitIdle(device);
+	vulkanDevice->waitIdle();
 
 	// Recreate swap chain
 	screenWidth = destWidth;
@@ -542,6 +653,8 @@ void VulkanExampleBase::windowResize()
 	// references to the recreated frame buffer
 	destroyCommandBuffers();
 	createCommandBuffers();
+	// Notify derived class, size dependent resources are recreated before they are recorded
+	windowResized();
 	buildCommandBuffers();
 
 	// SRS - Recreate fences in case number of swapchain images has changed on resize
@@ -550,10 +663,8 @@ void VulkanExampleBase::windowResize()
 	}
 	createSynchronizationPrimitives();
 
-	vkDeviceWaitIdle(device);
+	vulkanDevice->waitIdle();
 
-	// Notify derived class
-	windowResized();
 	viewChanged();
     camera.setPerspective(60.0f, (float)screenWidth / (float)screenHeight, m_zNear, m_zFar);
 	prepared = true;
@@ -562,6 +673,17 @@ void VulkanExampleBase::windowResize()
 
 void VulkanExampleBase::windowResized() {}
 
+void VulkanExampleBase::surfaceChanged(uint32_t width, uint32_t height)
+{
+	LOGI("VulkanExampleBase::surfaceChanged w:%{public}u, h:%{public}u", width, height);
+	destWidth = width;
+	destHeight = height;
+	// Before prepare the size is picked up by the first swap chain
+	if (prepared && (width != screenWidth || height != screenHeight)) {
+		windowResize();
+	}
+}
+
 void VulkanExampleBase::initSwapchain()
 {
      LOGI("VulkanExampleBase::initSwapchain");
@@ -572,11 +694,9 @@ void VulkanExampleBase::setupSwapChain()
 {
     LOGI("VulkanExampleBase::setupSwapChain w:%{public}lu, d:%{public}lu", screenWidth, screenHeight);
 	swapChain.create(&screenWidth, &screenHeight);
-	if (initDeferredSize == false) {
-		 highResWidth = screenWidth * noUpscale;
-		 highResHeight = screenHeight * noUpscale;
-		 lowResWidth = screenWidth * useUpScale;
-		 lowResHeight = screenHeight * useUpScale;
-		 initDeferredSize = true;
-	}
+	// Follows the swapchain on every resize and rotation, windowResized recreates what depends on it
+	highResWidth = screenWidth * noUpscale;
+	highResHeight = screenHeight * noUpscale;
+	lowResWidth = screenWidth * useUpScale;
+	lowResHeight = screenHeight * useUpScale;
 }
@@ -21,6 +21,8 @@
 #include <chrono>
 #include <random>
 #include <algorithm>
+#include <functional>
+#include <mutex>
 #include <sys/stat.h>
 
 
@@ -45,6 +47,7 @@
 #include "camera.hpp"
 #include "VulkanInitializers.hpp"
 #include "VulkanTools.h"
+#include "common/frame_pacer.h"
 
 #define DEFAULT_FENCE_TIMEOUT 100000000000
 class VulkanExampleBase
@@ -55,7 +58,6 @@ public:
 	uint32_t destWidth;
 	uint32_t destHeight;
 	bool resizing = false;
-	bool initDeferredSize = false;
 	void handleMouseMove(int32_t x, int32_t y);
 	void createPipelineCache();
 	void createCommandPool();
@@ -69,6 +71,8 @@ protected:
 	uint32_t frameCounter = 0;
 	uint32_t lastFPS = 0;
 	std::chrono::time_point<std::chrono::high_resolution_clock> lastTimestamp;
+	// Starts the frames of renderLoop, also provides the smoothed frame time the camera moves with
+	FramePacer framePacer;
 	// Vulkan instance, stores all per-application states
 	VkInstance instance;
 	std::vector<std::string> supportedInstanceExtensions;
@@ -91,6 +95,8 @@ protected:
 	VkDevice device;
 	// Handle to the device graphics queue that command buffers are submitted to
 	VkQueue queue;
+	// Queue of queueFamilyIndices.transfer, the graphics queue when the device has no other transfer family
+	VkQueue transferQueue = VK_NULL_HANDLE;
 	// Depth buffer format (selected during Vulkan initialization)
 	VkFormat depthFormat;
 	// Command buffer pool
@@ -125,6 +131,23 @@ protected:
 	} semaphores;
 	std::vector<VkFence> waitFences;
 
+	/** @brief Instance, device and pipeline cache shared by every example of the process. The first example creates
+	 * them in initVulkan with its features and extensions, the last one destroys them. */
+	struct SharedContext {
+		VkInstance instance = VK_NULL_HANDLE;
+		VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+		vks::VulkanDevice *vulkanDevice = nullptr;
+		VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+		uint32_t users = 0;
+	};
+	static SharedContext sharedContext;
+	static std::mutex sharedContextMutex;
+	// initVulkan succeeded, the example counts as a user of sharedContext
+	bool sharesContext = false;
+	void releaseSharedContext();
+	// The shared device was created with every feature and extension this example requests
+	bool sharedDeviceSupportsRequest() const;
+
 public:
 	uint32_t highResWidth;
 	uint32_t highResHeight;
@@ -146,8 +169,8 @@ public:
     /** @brief Last frame time measured using a high performance timer (if available) */
 	float frameTimer = 1.0f;
 
-	/** @brief Encapsulated physical and logical vulkan device */
-	vks::VulkanDevice *vulkanDevice;
+	/** @brief Encapsulated physical and logical vulkan device, shared with the other examples */
+	vks::VulkanDevice *vulkanDevice = nullptr;
     vks::Texture lowImage;
 	VkClearColorValue defaultClearColor = { { 0.025f, 0.025f, 0.025f, 1.0f } };
 
@@ -177,6 +200,8 @@ public:
 	/** @brief Setup the vulkan instance, enable required extensions and connect to the physical device (GPU) */
 	bool initVulkan();
     void windowResize();
+	/** @brief Surface size reported by the window, recreates the swapchain and the size dependent resources */
+	void surfaceChanged(uint32_t width, uint32_t height);
 
     void setupWindow(NativeWindow* nativeWindow)
 	{
@@ -191,7 +216,7 @@ public:
 	virtual void viewChanged();
 	/** @brief (Virtual) Called after a key was pressed, can be used to do custom key handling */
 	virtual void keyPressed(uint32_t);
-	/** @brief (Virtual) Called when the window has been resized, can be used by the sample application to recreate resources */
+	/** @brief (Virtual) Called when the window has been resized, before the command buffers are built again, can be used by the sample application to recreate resources */
 	virtual void windowResized();
 	/** @brief (Virtual) Called when resources have been recreated that require a rebuild of the command buffers (e.g. frame buffer), to be implemented by the sample application */
 	virtual void buildCommandBuffers();
@@ -210,15 +235,21 @@ public:
 	/** @brief Loads a SPIR-V shader file for the given shader stage */
 	VkPipelineShaderStageCreateInfo loadShader(std::string fileName, VkShaderStageFlagBits stage, bool isBase = true);
 
-	/** @brief Entry point for the main render loop */
-	void renderLoop();
+	/** @brief Entry point for the main render loop, renders frames until beginFrame returns false */
+	void renderLoop(const std::function<bool()> &beginFrame);
+	/** @brief Recreates the swap chain with presentMode, FIFO is used when the surface does not support it */
+	void setPresentMode(VkPresentModeKHR presentMode);
+	/** @brief Limits the frame rate, 0 = no limit. displayRefreshRate (Hz, 0 = unknown) snaps the frame interval to
+	 * whole display periods */
+	void setFrameRateLimit(uint32_t targetFps, float displayRefreshRate);
 
-	/** @brief Adds the drawing commands for the ImGui overlay to the given command buffer */
-	void drawUI(const VkCommandBuffer commandBuffer);
+	/** @brief (Virtual) Adds the drawing commands for the debug overlay, called inside the swapchain render pass */
+	virtual void drawUI(const VkCommandBuffer commandBuffer);
 
 	/** Prepare the next frame for workload submission by acquiring the next swap chain image */
 	void prepareFrame();
-	/** @brief Presents the current image to the swap chain */
+	/** @brief Presents the current image to the swap chain and waits until the frame completed, the frame submission
+	 * must signal waitFences[currentBuffer] */
 	void submitFrame();
 	/** @brief (Virtual) Default image acquire + submission and command buffer submission function */
 	virtual void renderFrame();
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Debug overlay quads, built with: glslc overlay.frag -o overlay.frag.spv
+// The mode values match render/debug_overlay.cpp.
+#version 450
+
+#define MODE_SOLID 0
+#define MODE_GLYPH 1
+#define MODE_SHADING_RATE 2
+#define MODE_POSITION 3
+#define MODE_NORMAL 4
+#define MODE_ALBEDO 5
+#define MODE_VIEW_NORMAL 6
+
+// Scene position range mapped to [0, 1] in the position view
+#define POSITION_RANGE 20.0
+
+layout (binding = 0) uniform sampler2D glyphAtlas;
+layout (binding = 1) uniform usampler2D shadingRate;
+layout (binding = 2) uniform sampler2D gPosition;
+layout (binding = 3) uniform sampler2D gNormal;
+layout (binding = 4) uniform sampler2D gAlbedo;
+layout (binding = 5) uniform sampler2D gViewNormal;
+
+layout (location = 0) in vec2 inUV;
+layout (location = 1) in vec4 inColor;
+layout (location = 2) flat in uint inMode;
+
+layout (location = 0) out vec4 outFragColor;
+
+vec3 RateColor(uint rate)
+{
+    // (log2 width << 2) | log2 height, colored by the number of pixels sharing one invocation
+    uint pixels = (1u << ((rate >> 2) & 3u)) * (1u << (rate & 3u));
+    if (pixels <= 1u) {
+        return vec3(0.0, 0.0, 1.0);
+    } else if (pixels == 2u) {
+        return vec3(0.0, 1.0, 0.0);
+    } else if (pixels == 4u) {
+        return vec3(1.0, 1.0, 0.0);
+    } else if (pixels == 8u) {
+        return vec3(1.0, 0.5, 0.0);
+    }
+    return vec3(1.0, 0.0, 0.0);
+}
+
+void main()
+{
+    switch (inMode) {
+        case MODE_SOLID:
+            outFragColor = inColor;
+            break;
+        case MODE_GLYPH:
+            outFragColor = vec4(inColor.rgb, inColor.a * texture(glyphAtlas, inUV).r);
+            break;
+        case MODE_SHADING_RATE:
+            outFragColor = vec4(RateColor(texture(shadingRate, inUV).r), inColor.a);
+            break;
+        case MODE_POSITION:
+            outFragColor = vec4(abs(texture(gPosition, inUV).xyz) / POSITION_RANGE, inColor.a);
+            break;
+        case MODE_NORMAL:
+            outFragColor = vec4(texture(gNormal, inUV).rgb, inColor.a);
+            break;
+        case MODE_ALBEDO:
+            outFragColor = vec4(texture(gAlbedo, inUV).rgb, inColor.a);
+            break;
+        case MODE_VIEW_NORMAL:
+            outFragColor = vec4(texture(gViewNormal, inUV).rgb, inColor.a);
+            break;
+        default:
+            outFragColor = vec4(1.0, 0.0, 1.0, 1.0);
+            break;
+    }
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2024 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Debug overlay quads, built with: glslc overlay.vert -o overlay.vert.spv
+// Positions are already in normalized device coordinates, see render/debug_overlay.cpp.
+#version 450
+
+layout (location = 0) in vec2 inPos;
+layout (location = 1) in vec2 inUV;
+layout (location = 2) in vec4 inColor;
+layout (location = 3) in uint inMode;
+
+layout (location = 0) out vec2 outUV;
+layout (location = 1) out vec4 outColor;
+layout (location = 2) flat out uint outMode;
+
+void main()
+{
+    outUV = inUV;
+    outColor = inColor;
+    outMode = inMode;
+    gl_Position = vec4(inPos, 0.0, 1.0);
+}